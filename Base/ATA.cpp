@@ -22,6 +22,7 @@
 
 #include "ATA.h"
 #include "Frame.h"
+#include "State.h"
 
 // ToDo: support slave device on the same interface
 
@@ -54,6 +55,17 @@ void CATADevice::Reset (bool fSoft_/*=false*/)
     m_f8bit = m_f8bitOnReset = fSoft_ ? m_f8bitOnReset : false;
 }
 
+// Save or restore the device registers and any transfer in progress
+void CATADevice::Serialize (CState &state_)
+{
+    state_.Value(m_sRegs);
+    state_.Value(m_abSectorData);
+    state_.Value(m_uBuffer);
+    state_.Pointer(m_pbBuffer, m_abSectorData);
+    state_.Value(m_f8bitOnReset);
+    state_.Value(m_f8bit);
+}
+
 
 WORD CATADevice::In (WORD wPort_)
 {
@@ -103,6 +103,8 @@ typedef struct
 ATA_GEOMETRY;
 
 
+class CState;
+
 // Base class for a generic ATA device
 class CATADevice
 {
@@ -116,6 +118,7 @@ class CATADevice
         void Reset (bool fSoft_=false);
         WORD In (WORD wPort_);
         void Out (WORD wPort_, WORD wVal_);
+        void Serialize (CState &state_);
 
     public:
         const ATA_GEOMETRY* GetGeometry() const { return &m_sGeometry; };
@@ -28,22 +28,22 @@
 namespace AVI
 {
 
-static BYTE *pbCurr, *pbResample;
+static MACHINE_LOCAL BYTE *pbCurr, *pbResample;
 
-static char szPath[MAX_PATH], *pszFile;
-static FILE *f;
+static MACHINE_LOCAL char szPath[MAX_PATH], *pszFile;
+static MACHINE_LOCAL FILE *f;
 
-static WORD width, height;
-static bool fHalfSize = false;
+static MACHINE_LOCAL WORD width, height;
+static MACHINE_LOCAL bool fHalfSize = false;
 
-static long lRiffPos, lMoviPos;
-static long lVideoMax, lAudioMax;
-static DWORD dwVideoFrames, dwAudioFrames, dwAudioSamples;
-static bool fWantVideo;
+static MACHINE_LOCAL long lRiffPos, lMoviPos;
+static MACHINE_LOCAL long lVideoMax, lAudioMax;
+static MACHINE_LOCAL DWORD dwVideoFrames, dwAudioFrames, dwAudioSamples;
+static MACHINE_LOCAL bool fWantVideo;
 
 // These hold the option settings during recording, so they can't change
-static int nAudioReduce = 0;
-static bool fScanlines = false;
+static MACHINE_LOCAL int nAudioReduce = 0;
+static MACHINE_LOCAL bool fScanlines = false;
 
 static bool WriteLittleEndianWORD (WORD w_)
 {
@@ -594,7 +594,7 @@ void AddFrame (CScreen *pScreen_)
     for (int y = height-1 ; y > 0 ; y--)
     {
         BYTE *pbLine = pScreen_->GetLine(y>>(fHalfSize?0:1));
-        static BYTE abLine[WIDTH_PIXELS*2];
+        static MACHINE_LOCAL BYTE abLine[WIDTH_PIXELS*2];
 
         // Is the recording low-res?
         if (fHalfSize)
@@ -713,7 +713,7 @@ void AddFrame (const BYTE *pb_, UINT uLen_)
     // Do we need to reduce the audio size?
     if (nAudioReduce)
     {
-        static bool fOddLast = false;
+        static MACHINE_LOCAL bool fOddLast = false;
 
         // Allocate resample buffer if it doesn't already exist
         if (!pbResample && !(pbResample = new BYTE[uLen_]))
@@ -31,6 +31,8 @@
 #include "Input.h"
 #include "Options.h"
 #include "Parallel.h"
+#include "Perf.h"
+#include "Rewind.h"
 #include "Sound.h"
 #include "Tape.h"
 #include "UI.h"
@@ -49,7 +51,8 @@ const char* aszActions[MAX_ACTION] =
     "Toggle Smoothing", "Toggle scanlines", "Toggle greyscale", "Mute sound", "Release mouse capture",
     "Toggle printer online", "Flush printer", "About SimCoupe", "Minimise window", "Record GIF animation", "Record GIF loop",
     "Stop GIF Recording", "Record WAV audio", "Record WAV segment", "Stop WAV Recording", "Record AVI video", "Record AVI half-size", "Stop AVI Recording",
-    "Speed Faster", "Speed Slower", "Speed Normal", "Paste Clipboard", "Insert Tape", "Eject Tape", "Tape Browser"
+    "Speed Faster", "Speed Slower", "Speed Normal", "Paste Clipboard", "Insert Tape", "Eject Tape", "Tape Browser",
+    "Rewind (when held)", "Toggle timing stats", "Save timing stats"
 };
 
 
@@ -221,6 +224,30 @@ bool Do (int nAction_, bool fPressed_/*=true*/)
                 }
                 break;
 
+            case actRewind:
+                if (!GetOption(rewind))
+                    Frame::SetStatus("Rewind is disabled");
+                else
+                    Rewind::SetActive(true);
+                break;
+
+            case actTogglePerfStats:
+                SetOption(perfstats, !GetOption(perfstats));
+                Frame::SetStatus("Timing stats %s", GetOption(perfstats) ? "enabled" : "disabled");
+                break;
+
+            case actSavePerfStats:
+            {
+                char szPath[MAX_PATH];
+                const char *pcszFile = Util::GetUniqueFile("csv", szPath, sizeof(szPath));
+
+                if (!Perf::Save(szPath))
+                    Frame::SetStatus("Failed to save timing stats");
+                else
+                    Frame::SetStatus("Saved %s", pcszFile);
+                break;
+            }
+
             case actReleaseMouse:
                 if (Input::IsMouseAcquired())
                 {
@@ -346,6 +373,10 @@ bool Do (int nAction_, bool fPressed_/*=true*/)
                 g_nTurbo = 0;
                 break;
 
+            case actRewind:
+                Rewind::SetActive(false);
+                break;
+
             // Not processed
             default:
                 return false;
@@ -21,6 +21,8 @@
 #include "SimCoupe.h"
 #include "AtaAdapter.h"
 
+#include "State.h"
+
 
 CAtaAdapter::~CAtaAdapter ()
 {
@@ -61,6 +63,26 @@ void CAtaAdapter::Reset ()
 }
 
 
+void CAtaAdapter::Serialize (CState &state_)
+{
+    state_.Section(STATE_TAG('A','T','A',' '));
+    state_.Value(m_uActive);
+
+    // The attached disks must match those present when the state was saved
+    bool fDisk0 = m_pDisk0 != nullptr, fDisk1 = m_pDisk1 != nullptr;
+    state_.Value(fDisk0);
+    state_.Value(fDisk1);
+
+    if (fDisk0 != (m_pDisk0 != nullptr) || fDisk1 != (m_pDisk1 != nullptr))
+        state_.SetError();
+    else
+    {
+        if (m_pDisk0) m_pDisk0->Serialize(state_);
+        if (m_pDisk1) m_pDisk1->Serialize(state_);
+    }
+}
+
+
 bool CAtaAdapter::Attach (const char *pcszDisk_, int nDevice_)
 {
     // Return if successfully or path is empty
@@ -37,6 +37,7 @@ class CAtaAdapter : public CIoDevice
 
         void Reset () override;
         void FrameEnd () override { if (m_uActive) m_uActive--; }
+        void Serialize (CState &state_) override;
 
     public:
         bool IsActive () const { return m_uActive != 0; }
@@ -57,6 +58,6 @@ class CAtaAdapter : public CIoDevice
         CHardDisk *m_pDisk1 = nullptr;
 };
 
-extern CAtaAdapter *pAtom, *pAtomLite, *pSDIDE;
+extern MACHINE_LOCAL CAtaAdapter *pAtom, *pAtomLite, *pSDIDE;
 
 #endif // ATAADAPTER_H
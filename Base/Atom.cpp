@@ -25,6 +25,7 @@
 
 #include "Atom.h"
 #include "Options.h"
+#include "State.h"
 
 
 BYTE CAtomDevice::In (WORD wPort_)
@@ -96,6 +97,16 @@ void CAtomDevice::Out (WORD wPort_, BYTE bVal_)
 }
 
 
+void CAtomDevice::Serialize (CState &state_)
+{
+    CAtaAdapter::Serialize(state_);
+
+    state_.Value(m_bAddressLatch);
+    state_.Value(m_bReadLatch);
+    state_.Value(m_bWriteLatch);
+}
+
+
 bool CAtomDevice::Attach (CHardDisk *pDisk_, int nDevice_)
 {
     if (pDisk_)
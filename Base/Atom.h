@@ -32,6 +32,7 @@ class CAtomDevice : public CAtaAdapter
     public:
         BYTE In (WORD wPort_) override;
         void Out (WORD wPort_, BYTE bVal_) override;
+        void Serialize (CState &state_) override;
 
     public:
         bool Attach (CHardDisk *pDisk_, int nDevice_) override;
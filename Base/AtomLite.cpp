@@ -22,6 +22,7 @@
 
 #include "AtomLite.h"
 #include "Options.h"
+#include "State.h"
 
 
 BYTE CAtomLiteDevice::In (WORD wPort_)
@@ -90,6 +91,15 @@ void CAtomLiteDevice::Out (WORD wPort_, BYTE bVal_)
 }
 
 
+void CAtomLiteDevice::Serialize (CState &state_)
+{
+    CAtaAdapter::Serialize(state_);
+    m_Dallas.Serialize(state_);
+
+    state_.Value(m_bAddressLatch);
+}
+
+
 bool CAtomLiteDevice::Attach (CHardDisk *pDisk_, int nDevice_)
 {
     if (pDisk_)
@@ -90,6 +90,10 @@ public:
 	typedef blip_resampled_time_t resampled_time_t;
 	blargg_err_t sample_rate( long r ) { return set_sample_rate( r ); }
 	blargg_err_t sample_rate( long r, int msec ) { return set_sample_rate( r, msec ); }
+	
+	// Get/set sample reader accumulator, for saving and restoring state
+	long reader_state() const { return reader_accum; }
+	void reader_state( long accum ) { reader_accum = accum; }
 private:
 	// noncopyable
 	Blip_Buffer( const Blip_Buffer& );
@@ -171,6 +175,10 @@ public:
 	Blip_Buffer* output() const                 { return impl.buf; }
 	void output( Blip_Buffer* b )               { impl.buf = b; impl.last_amp = 0; }
 	
+	// Get/set last amplitude, for saving and restoring state
+	int last_amp() const                        { return impl.last_amp; }
+	void last_amp( int amp )                    { impl.last_amp = amp; }
+	
 	// Update amplitude of waveform at given time. Using this requires a separate
 	// Blip_Synth for each waveform.
 	void update( blip_time_t time, int amplitude );
@@ -37,6 +37,7 @@
 #include "CPU.h"
 #include "Options.h"
 #include "Sound.h"
+#include "State.h"
 
 #define PORTA_CLOCK             0x01
 #define PORTB_DAC_ENABLE        0x01
@@ -56,6 +57,16 @@ void CBlueAlphaDevice::Reset ()
     m_bControl = 0x18;  // control (initialised to BlueAlpha signature?)
 }
 
+void CBlueAlphaDevice::Serialize (CState &state_)
+{
+    state_.Section(STATE_TAG('B','L','U','E'));
+
+    state_.Value(m_bControl);
+    state_.Value(m_bPortA);
+    state_.Value(m_bPortB);
+    state_.Value(m_bPortC);
+}
+
 bool CBlueAlphaDevice::Clock ()
 {
     // Toggle clock bit every half period
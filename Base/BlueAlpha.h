@@ -32,6 +32,7 @@ class CBlueAlphaDevice final : public CIoDevice
 
     public:
         void Reset () override;
+        void Serialize (CState &state_) override;
 
         BYTE In (WORD wPort_) override;
         void Out (WORD wPort_, BYTE bVal_) override;
@@ -47,6 +48,6 @@ class CBlueAlphaDevice final : public CIoDevice
         BYTE m_bPortC = 0;
 };
 
-extern CBlueAlphaDevice *pBlueAlpha;
+extern MACHINE_LOCAL CBlueAlphaDevice *pBlueAlpha;
 
 #endif  // BLUEALPHA_H
@@ -21,11 +21,110 @@
 #include "SimCoupe.h"
 #include "Breakpoint.h"
 
+#include <vector>
+
 #include "Debug.h"
+#include "Guard.h"
 #include "Memory.h"
 
+const size_t BREAK_MAP_SIZE = (TOTAL_PAGES*MEM_PAGE_SIZE + 7) / 8;
+
+static MACHINE_LOCAL BREAKPT *pBreakpoints;
+static MACHINE_LOCAL bool fIndexDirty, fIndexed;          // index needs rebuilding, index covers all breakpoints
+static MACHINE_LOCAL bool fGuardable;                     // all breakpoints are RAM writes, which page protection can catch
+static MACHINE_LOCAL std::vector<BYTE> vExecMap, vReadMap, vWriteMap;
+
+MACHINE_LOCAL BYTE *pbBreakExec, *pbBreakRead, *pbBreakWrite;
+MACHINE_LOCAL BYTE abBreakPorts[0x10000];
+MACHINE_LOCAL BYTE bBreakInts;
+
+
+// Mark the physical memory range in a breakpoint map, allocating the map on first use
+static void SetMapRange (std::vector<BYTE> &vMap_, const void *pvFrom_, const void *pvTo_)
+{
+    const BYTE *pb = reinterpret_cast<const BYTE*>(pvFrom_), *pbTo = reinterpret_cast<const BYTE*>(pvTo_);
 
-static BREAKPT *pBreakpoints;
+    if (vMap_.empty())
+        vMap_.assign(BREAK_MAP_SIZE, 0);
+
+    for ( ; pb <= pbTo ; pb++)
+    {
+        size_t uOffset = static_cast<size_t>(pb - pMemory);
+        if (uOffset < BREAK_MAP_SIZE*8)
+            vMap_[uOffset >> 3] |= 1 << (uOffset & 7);
+    }
+}
+
+// Rebuild the index from the enabled breakpoints, so disabled ones don't cause possible hits
+static void UpdateIndex ()
+{
+    fIndexDirty = false;
+    fIndexed = fGuardable = true;
+    bBreakInts = 0;
+    memset(abBreakPorts, 0, sizeof(abBreakPorts));
+
+    // Maps are only allocated if they're used, so unused ones can be skipped
+    std::vector<BYTE>().swap(vExecMap);
+    std::vector<BYTE>().swap(vReadMap);
+    std::vector<BYTE>().swap(vWriteMap);
+
+    for (BREAKPT *p = pBreakpoints ; p ; p = p->pNext)
+    {
+        if (!p->fEnabled)
+            continue;
+
+        // Writes to ROM go to the scratch page rather than the watched location
+        if (p->nType != btMemory || p->Mem.nAccess != atWrite || PtrPage(p->Mem.pPhysAddrTo) >= ROM0)
+            fGuardable = false;
+
+        switch (p->nType)
+        {
+            case btNone:
+                break;
+
+            // Expressions must be evaluated after every instruction
+            case btUntil:
+                fIndexed = false;
+                break;
+
+            case btTemp:
+                if (p->pExpr)
+                    fIndexed = false;
+                else if (p->Temp.pPhysAddr)
+                    SetMapRange(vExecMap, p->Temp.pPhysAddr, p->Temp.pPhysAddr);
+                break;
+
+            case btExecute:
+                SetMapRange(vExecMap, p->Exec.pPhysAddr, p->Exec.pPhysAddr);
+                break;
+
+            case btMemory:
+                if (p->Mem.nAccess & atRead)
+                    SetMapRange(vReadMap, p->Mem.pPhysAddrFrom, p->Mem.pPhysAddrTo);
+                if (p->Mem.nAccess & atWrite)
+                    SetMapRange(vWriteMap, p->Mem.pPhysAddrFrom, p->Mem.pPhysAddrTo);
+                break;
+
+            case btPort:
+                for (UINT u = 0 ; u < 0x10000 ; u++)
+                {
+                    if ((u & p->Port.wMask) == p->Port.wCompare)
+                        abBreakPorts[u] |= p->Port.nAccess;
+                }
+                break;
+
+            case btInt:
+                bBreakInts |= p->Int.bMask;
+                break;
+        }
+    }
+
+    pbBreakExec = vExecMap.empty() ? nullptr : vExecMap.data();
+    pbBreakRead = vReadMap.empty() ? nullptr : vReadMap.data();
+    pbBreakWrite = vWriteMap.empty() ? nullptr : vWriteMap.data();
+
+    Guard::SetMap(fGuardable ? pbBreakWrite : nullptr);
+}
 
 
 bool Breakpoint::IsSet ()
@@ -33,8 +132,33 @@ bool Breakpoint::IsSet ()
     return pBreakpoints != nullptr;
 }
 
+// Return whether the index covers all breakpoints, so the full list need only be checked on a possible hit
+bool Breakpoint::IsIndexed ()
+{
+    if (fIndexDirty)
+        UpdateIndex();
+
+    return pBreakpoints && fIndexed;
+}
+
+// Return whether all breakpoints are write watchpoints caught by page protection, so the core needn't check
+bool Breakpoint::IsGuarded ()
+{
+    if (fIndexDirty)
+        UpdateIndex();
+
+    return pBreakpoints && fGuardable && Guard::IsAvailable() && !Guard::IsBusy();
+}
+
 // Return whether any of the active breakpoints have been hit
 bool Breakpoint::IsHit ()
+{
+    BREAKPT *p = FindHit();
+    return p && Debug::Start(p);
+}
+
+// Return the first active breakpoint hit at the current instruction, logging any tracepoints hit before it if wanted
+BREAKPT *Breakpoint::FindHit (bool fTrace_/*=true*/)
 {
     // Fetch the 'physical' address of PC
     void* pPC = AddrReadPtr(PC);
@@ -131,11 +255,20 @@ bool Breakpoint::IsHit ()
         if (p->pExpr && !Expr::Eval(p->pExpr))
             continue;
 
+        // Tracepoints log the hit and let execution continue
+        if (p->pTrace)
+        {
+            if (fTrace_)
+                Tracepoint::Hit(p->pTrace);
+
+            continue;
+        }
+
         // Breakpoint hit!
-        return Debug::Start(p);
+        return p;
     }
 
-    return false;
+    return nullptr;
 }
 
 void Breakpoint::Add (BREAKPT *pBreak_)
@@ -156,8 +289,11 @@ void Breakpoint::Add (BREAKPT *pBreak_)
         p->pNext = pBreak_;
     }
 
-    // Break from the main execution loop to activate breakpoint testing
+    fIndexDirty = true;
+
+    // Break from the main execution loop to activate breakpoint testing, without waiting for the next event
     g_fBreak = true;
+    g_dwEventDeadline = 0;
 }
 
 bool Breakpoint::IsExecAddr (WORD wAddr_)
@@ -239,6 +375,7 @@ void Breakpoint::AddInterrupt (BYTE bIntMask_, EXPR *pExpr_)
     if (p)
     {
         p->Int.bMask |= bIntMask_;
+        fIndexDirty = true;
         return;
     }
 
@@ -250,7 +387,7 @@ void Breakpoint::AddInterrupt (BYTE bIntMask_, EXPR *pExpr_)
 
 const char *Breakpoint::GetDesc (BREAKPT *pBreak_)
 {
-    static char sz[512];
+    static MACHINE_LOCAL char sz[512];
     char *psz = sz;
     const void *pPhysAddr = nullptr;
     UINT uExtent = 0;
@@ -365,6 +502,12 @@ const char *Breakpoint::GetDesc (BREAKPT *pBreak_)
     if (pBreak_->pExpr && pBreak_->nType != btUntil)
         psz += sprintf(psz, " if %s", pBreak_->pExpr->pcszExpr);
 
+    if (pBreak_->pTrace)
+    {
+        snprintf(psz, sz+sizeof(sz)-psz, " trace \"%s\" (%llu hits)", Tracepoint::GetFormat(pBreak_->pTrace),
+                 static_cast<unsigned long long>(Tracepoint::GetHits(pBreak_->pTrace)));
+    }
+
     return sz;
 }
 
@@ -385,6 +528,31 @@ BREAKPT *Breakpoint::GetAt (int nIndex_)
     return p;
 }
 
+// Enable or disable a breakpoint, updating the index to match
+void Breakpoint::SetEnabled (BREAKPT *pBreak_, bool fEnabled_)
+{
+    pBreak_->fEnabled = fEnabled_;
+    fIndexDirty = true;
+
+    // Return to the main loop to select the core for the new breakpoint set
+    g_fBreak = true;
+    g_dwEventDeadline = 0;
+}
+
+// Give a breakpoint a log format to make it a tracepoint, or restore a normal breakpoint if none is given
+bool Breakpoint::SetTrace (int nIndex_, const char *pcszFormat_)
+{
+    BREAKPT *p = GetAt(nIndex_);
+    TRACEPOINT *pTrace = nullptr;
+
+    if (!p || p->nType == btTemp || (pcszFormat_ && !(pTrace = Tracepoint::Compile(pcszFormat_))))
+        return false;
+
+    Tracepoint::Release(p->pTrace);
+    p->pTrace = pTrace;
+    return true;
+}
+
 bool Breakpoint::RemoveAt (int nIndex_)
 {
     BREAKPT *p = pBreakpoints;
@@ -401,6 +569,7 @@ bool Breakpoint::RemoveAt (int nIndex_)
             pBreakpoints = p->pNext;
 
         delete p;
+        fIndexDirty = true;
         return true;
     }
 
@@ -415,4 +584,6 @@ void Breakpoint::RemoveAll ()
         pBreakpoints = pBreakpoints->pNext;
         delete p;
     }
+
+    fIndexDirty = true;
 }
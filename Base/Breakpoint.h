@@ -22,6 +22,7 @@
 #define BREAKPOINT_H
 
 #include "Expr.h"
+#include "Tracepoint.h"
 
 enum BreakpointType { btNone, btTemp, btUntil, btExecute, btMemory, btPort, btInt };
 enum AccessType { atNone, atRead, atWrite, atReadWrite };
@@ -68,10 +69,11 @@ typedef struct tagBREAKPT
         : nType(nType_), pExpr(pExpr_) { }
     tagBREAKPT (const tagBREAKPT &) = delete;
     void operator= (const tagBREAKPT &) = delete;
-    ~tagBREAKPT() { Expr::Release(pExpr); }
+    ~tagBREAKPT() { Expr::Release(pExpr); Tracepoint::Release(pTrace); }
 
     BreakpointType nType;
     EXPR* pExpr = nullptr;
+    TRACEPOINT* pTrace = nullptr;   // log format if it's a tracepoint, which doesn't stop
     bool fEnabled = true;
 
     union
@@ -87,11 +89,20 @@ typedef struct tagBREAKPT
 } BREAKPT;
 
 
+// Breakpoint index, to find possible hits without walking the full list
+extern MACHINE_LOCAL BYTE *pbBreakExec, *pbBreakRead, *pbBreakWrite;  // bit per byte of pMemory, or null if unused
+extern MACHINE_LOCAL BYTE abBreakPorts[0x10000];                      // AccessType flags per port
+extern MACHINE_LOCAL BYTE bBreakInts;                                 // interrupt sources with breakpoints
+
+
 class Breakpoint
 {
     public:
         static bool IsSet ();
+        static bool IsIndexed ();
+        static bool IsGuarded ();
         static bool IsHit ();
+        static BREAKPT *FindHit (bool fTrace_=true);
         static void Add (BREAKPT *pBreak_);
         static void AddTemp (void *pPhysAddr_, EXPR *pExpr_);
         static void AddUntil (EXPR *pExpr_);
@@ -101,9 +112,11 @@ class Breakpoint
         static void AddInterrupt (BYTE bIntMask_, EXPR *pExpr_);
         static const char *GetDesc (BREAKPT *pBreak_);
         static BREAKPT *GetAt (int nIndex_);
+        static void SetEnabled (BREAKPT *pBreak_, bool fEnabled_);
         static bool IsExecAddr (WORD wAddr_);
         static int GetIndex (BREAKPT *pBreak_);
         static int GetExecIndex (void *pPhysAddr_);
+        static bool SetTrace (int nIndex_, const char *pcszFormat_);
         static bool RemoveAt (int nIndex_);
         static void RemoveAll ();
 };
@@ -35,14 +35,24 @@
 
 #include "BlueAlpha.h"
 #include "Debug.h"
+#include "Dynarec.h"
 #include "Frame.h"
 #include "GUI.h"
+#include "Guard.h"
+#include "Heatmap.h"
 #include "Input.h"
 #include "IO.h"
 #include "Memory.h"
 #include "Mouse.h"
 #include "Options.h"
+#include "Perf.h"
+#include "Profile.h"
+#include "Reverse.h"
+#include "Rewind.h"
+#include "State.h"
 #include "Tape.h"
+#include "TraceLog.h"
+#include "Tracepoint.h"
 #include "UI.h"
 #include "Util.h"
 
@@ -50,11 +60,11 @@
 #undef USE_FLAG_TABLES      // Experimental - disabled for now
 
 // Look up table for the parity (and other common flags) for logical operations
-BYTE g_abParity[256];
+MACHINE_LOCAL BYTE g_abParity[256];
 #define parity(a) (g_abParity[a])
 
 #ifdef USE_FLAG_TABLES
-BYTE g_abInc[256], g_abDec[256];
+MACHINE_LOCAL BYTE g_abInc[256], g_abDec[256];
 #endif
 
 #define rflags(b_,c_)   (F = (c_) | parity(b_))
@@ -81,36 +91,79 @@ BYTE g_abInc[256], g_abDec[256];
 //              CPU can only access I/O port 1 out of every 8 T-States
 #define PORT_ACCESS(a)  do { g_dwCycleCounter += 4; if ((a) >= BASE_ASIC_PORT) g_dwCycleCounter += abPortContention[g_dwCycleCounter&7]; } while (0)
 
+// Record the physical location of a data access, for breakpoints and the debugger
+// This is only done by CPU cores that need it, which have fTrack_ set
+#define TRACK_ACCESS(p,loc)   (fTrack_ ? ((p) = (loc)) : (loc))
 
-BYTE bOpcode;
-bool g_fReset, g_fBreak, g_fPaused;
-int g_nTurbo;
+// Add a physical memory access to the heatmap, only done by cores with fHeat_ set
+#define HEAT_ACCESS(p,type)   do { if (fHeat_) Heatmap::Access(p, type); } while (0)
 
-DWORD g_dwCycleCounter;     // Global cycle counter used for various timings
+
+// CPU core features, with each combination used compiled as a separate core
+#define CORE_TRACK      0x01    // record data accesses for breakpoints, the debugger and compiled blocks
+#define CORE_BREAK      0x02    // check breakpoints after every instruction
+#define CORE_DYNAREC    0x04    // run compiled blocks where possible
+#define CORE_IDLE       0x08    // skip ahead through HALTs and idle polling loops
+#define CORE_WATCH      0x10    // check the breakpoint index after every instruction, and the full list on a possible hit
+#define CORE_LOG        0x20    // record every instruction to the trace log
+#define CORE_PROFILE    0x40    // charge every instruction to the profiler, and track calls
+#define CORE_HEAT       0x80    // add every memory access to the heatmap
+#define CORE_GUARD      0x100   // check for writes caught by page protection when the core is interrupted
+#define CORE_DEBUG      (CORE_TRACK|CORE_BREAK)
+
+
+MACHINE_LOCAL BYTE bOpcode;
+MACHINE_LOCAL bool g_fReset, g_fBreak, g_fPaused;
+MACHINE_LOCAL int g_nTurbo;
+
+MACHINE_LOCAL DWORD g_dwCycleCounter;     // Global cycle counter used for various timings
 
 #ifdef _DEBUG
-bool g_fDebug;              // Debug only helper variable, to trigger the debugger when set
+MACHINE_LOCAL bool g_fDebug;              // Debug only helper variable, to trigger the debugger when set
 #endif
 
 // Memory access tracking for the debugger
-BYTE *pbMemRead1, *pbMemRead2, *pbMemWrite1, *pbMemWrite2;
+MACHINE_LOCAL BYTE *pbMemRead1, *pbMemRead2, *pbMemWrite1, *pbMemWrite2;
 
-Z80Regs regs;
+MACHINE_LOCAL Z80Regs regs;
 
-WORD* pHlIxIy, *pNewHlIxIy;
-CPU_EVENT asCpuEvents[MAX_EVENTS], *psNextEvent, *psFreeEvent;
+MACHINE_LOCAL WORD* pHlIxIy, *pNewHlIxIy;
+MACHINE_LOCAL CPU_EVENT asCpuEvents[MAX_EVENTS];
+MACHINE_LOCAL int nCpuEvents;
+MACHINE_LOCAL DWORD dwCpuEventSeq, g_dwEventDeadline;
 
 
 namespace CPU
 {
 // Memory access contention table
-static BYTE abContention1[TSTATES_PER_FRAME+64], abContention234[TSTATES_PER_FRAME+64], abContention4T[TSTATES_PER_FRAME+64];
-static const BYTE *pMemContention = abContention1;
-static bool fContention = true;
+static MACHINE_LOCAL BYTE abContention1[TSTATES_PER_FRAME+64], abContention234[TSTATES_PER_FRAME+64], abContention4T[TSTATES_PER_FRAME+64];
+static MACHINE_LOCAL const BYTE *pMemContention = abContention1;
+static MACHINE_LOCAL bool fContention = true;
 static const BYTE abPortContention[] = { 6, 5, 4, 3, 2, 1, 0, 7 };
 //                                      T1 T2 T3 T4 T1 T2 T3 T4
 
-inline void CheckInterrupt ();
+// Idle polling loop detection
+typedef struct
+{
+    WORD wAddr;         // memory address accessed (unused for the port read)
+    bool fPort;         // port read rather than memory access
+    BYTE bExtra;        // T-states added after the access
+}
+IDLE_ACCESS;
+
+const int MAX_IDLE_INSTRS = 16;                     // longest polling loop considered
+static MACHINE_LOCAL IDLE_ACCESS asIdleAccesses[MAX_IDLE_INSTRS*3];
+static MACHINE_LOCAL int nIdleAccesses, nIdleR;                   // accesses and R increments for one loop iteration
+static MACHINE_LOCAL bool fIdleSkip, fIdlePolled, fIdlePrev;      // idle core active, port just polled, previous poll valid
+static MACHINE_LOCAL WORD wPollPC;                                // address following the last polling instruction
+static MACHINE_LOCAL Z80Regs sIdleRegs;                           // registers after the previous poll, excluding R
+static MACHINE_LOCAL BYTE bIdleR;                                 // R after the previous poll
+static MACHINE_LOCAL DWORD dwIdleTime;                            // time of the previous poll
+
+template <bool fTrack_, bool fProfile_, bool fHeat_> inline void CheckInterrupt ();
+#if !defined(USE_ONECPUCORE)
+static void ExecuteOp (BYTE bOpcode_);
+#endif
 
 
 bool Init (bool fFirstInit_/*=false*/)
@@ -159,6 +212,11 @@ bool Init (bool fFirstInit_/*=false*/)
 
         // Set up RAM and initial I/O settings
         fRet &= Memory::Init(true) && IO::Init(true);
+
+#if !defined(USE_ONECPUCORE)
+        // The recompiler is optional, so it's not an error if it's unavailable
+        Dynarec::Init(ExecuteOp);
+#endif
     }
 
     // Perform a general reset by pressing and releasing the reset button
@@ -170,6 +228,13 @@ bool Init (bool fFirstInit_/*=false*/)
 
 void Exit (bool fReInit_/*=false*/)
 {
+    TraceLog::Exit(fReInit_);
+    Profile::Exit(fReInit_);
+    Heatmap::Exit(fReInit_);
+    Tracepoint::Exit(fReInit_);
+    Rewind::Exit(fReInit_);
+    Reverse::Exit(fReInit_);
+    Dynarec::Exit(fReInit_);
     IO::Exit(fReInit_);
     Memory::Exit(fReInit_);
 
@@ -178,6 +243,49 @@ void Exit (bool fReInit_/*=false*/)
 }
 
 
+// Save or restore the CPU state
+void Serialize (CState &state_)
+{
+    state_.Section(STATE_TAG('C','P','U',' '));
+
+    state_.Value(regs);
+    state_.Value(g_dwCycleCounter);
+    state_.Value(bOpcode);
+    state_.Value(g_fReset);
+
+    // Index prefix state, as 0=HL, 1=IX, 2=IY
+    WORD* apwIndex[] = { &HL, &IX, &IY };
+    BYTE bIndex = static_cast<BYTE>(std::find(apwIndex, apwIndex+3, pNewHlIxIy) - apwIndex);
+    state_.Value(bIndex);
+
+    // Pending events in queue order, padded so the state size is fixed
+    CPU_EVENT asEvents[MAX_EVENTS] {};
+    BYTE bEvents = static_cast<BYTE>(GetCpuEvents(asEvents));
+
+    state_.Value(bEvents);
+    for (auto &sEvent : asEvents)
+    {
+        state_.Value(sEvent.nEvent);
+        state_.Value(sEvent.dwTime);
+    }
+
+    if (!state_.IsLoading())
+        return;
+
+    if (bEvents > MAX_EVENTS || bIndex >= 3)
+        state_.SetError();
+    else
+    {
+        pHlIxIy = pNewHlIxIy = apwIndex[bIndex];
+
+        // Rebuild the queue, which preserves the order of events due at the same time
+        InitCpuEvents();
+        for (int i = 0 ; i < bEvents ; i++)
+            AddCpuEvent(asEvents[i].nEvent, asEvents[i].dwTime);
+    }
+}
+
+
 bool IsContentionActive ()
 {
     return fContention;
@@ -196,72 +304,100 @@ void UpdateContention (bool fActive_/*=true*/)
 
 
 // Read an instruction byte and update timing
+template <bool fHeat_=false>
 inline BYTE timed_read_code_byte (WORD addr)
 {
     MEM_ACCESS(addr);
+    HEAT_ACCESS(AddrReadPtr(addr), htExec);
     return read_byte(addr);
 }
 
 // Read a data byte and update timing
+template <bool fTrack_=true, bool fHeat_=false>
 inline BYTE timed_read_byte (WORD addr)
 {
     MEM_ACCESS(addr);
-    return *(pbMemRead1 = AddrReadPtr(addr));
+    HEAT_ACCESS(AddrReadPtr(addr), htRead);
+    return *TRACK_ACCESS(pbMemRead1, AddrReadPtr(addr));
 }
 
 // Read an instruction word and update timing
+template <bool fHeat_=false>
 inline WORD timed_read_code_word (WORD addr)
 {
     MEM_ACCESS(addr);
     MEM_ACCESS(addr + 1);
+    HEAT_ACCESS(AddrReadPtr(addr), htExec);
+    HEAT_ACCESS(AddrReadPtr(addr + 1), htExec);
     return read_word(addr);
 }
 
 // Read a data word and update timing
+template <bool fTrack_=true, bool fHeat_=false>
 inline WORD timed_read_word (WORD addr)
 {
     MEM_ACCESS(addr);
     MEM_ACCESS(addr + 1);
-    return *(pbMemRead1 = AddrReadPtr(addr)) | (*(pbMemRead2 = AddrReadPtr(addr + 1)) << 8);
+    HEAT_ACCESS(AddrReadPtr(addr), htRead);
+    HEAT_ACCESS(AddrReadPtr(addr + 1), htRead);
+    return *TRACK_ACCESS(pbMemRead1, AddrReadPtr(addr)) | (*TRACK_ACCESS(pbMemRead2, AddrReadPtr(addr + 1)) << 8);
 }
 
 // Write a byte and update timing
+template <bool fTrack_=true, bool fHeat_=false>
 inline void timed_write_byte (WORD addr, BYTE contents)
 {
     MEM_ACCESS(addr);
     check_video_write(addr);
-    pbMemWrite1 = AddrReadPtr(addr); // breakpoints act on read location!
+    TRACK_ACCESS(pbMemWrite1, AddrReadPtr(addr)); // breakpoints act on read location!
+    HEAT_ACCESS(AddrReadPtr(addr), htWrite);
     *AddrWritePtr(addr) = contents;
 }
 
 // Write a word and update timing
+template <bool fTrack_=true, bool fHeat_=false>
 inline void timed_write_word (WORD addr, WORD contents)
 {
     MEM_ACCESS(addr);
     check_video_write(addr);
-    pbMemWrite1 = AddrReadPtr(addr);
+    TRACK_ACCESS(pbMemWrite1, AddrReadPtr(addr));
+    HEAT_ACCESS(AddrReadPtr(addr), htWrite);
     *AddrWritePtr(addr) = contents & 0xff;
 
     MEM_ACCESS(addr + 1);
     check_video_write(addr + 1);
-    pbMemWrite2 = AddrReadPtr(addr + 1);
+    TRACK_ACCESS(pbMemWrite2, AddrReadPtr(addr + 1));
+    HEAT_ACCESS(AddrReadPtr(addr + 1), htWrite);
     *AddrWritePtr(addr + 1) = contents >> 8;
 }
 
 // Write a word and update timing (high-byte first - used by stack functions)
+template <bool fTrack_=true, bool fHeat_=false>
 inline void timed_write_word_reversed (WORD addr, WORD contents)
 {
     MEM_ACCESS(addr + 1);
     check_video_write(addr + 1);
-    pbMemWrite2 = AddrReadPtr(addr + 1);
+    TRACK_ACCESS(pbMemWrite2, AddrReadPtr(addr + 1));
+    HEAT_ACCESS(AddrReadPtr(addr + 1), htWrite);
     *AddrWritePtr(addr + 1) = contents >> 8;
 
     MEM_ACCESS(addr);
     check_video_write(addr);
-    pbMemWrite1 = AddrReadPtr(addr);
+    TRACK_ACCESS(pbMemWrite1, AddrReadPtr(addr));
+    HEAT_ACCESS(AddrReadPtr(addr), htWrite);
     *AddrWritePtr(addr) = contents & 0xff;
 }
 
+// The instruction tables call the memory access functions without template arguments, so route
+// them to the variant selected by the fTrack_ and fHeat_ constants in scope at the point of use
+#define timed_read_code_byte        timed_read_code_byte<fHeat_>
+#define timed_read_code_word        timed_read_code_word<fHeat_>
+#define timed_read_byte             timed_read_byte<fTrack_, fHeat_>
+#define timed_read_word             timed_read_word<fTrack_, fHeat_>
+#define timed_write_byte            timed_write_byte<fTrack_, fHeat_>
+#define timed_write_word            timed_write_word<fTrack_, fHeat_>
+#define timed_write_word_reversed   timed_write_word_reversed<fTrack_, fHeat_>
+
 
 // Execute the CPU event specified
 void ExecuteEvent (CPU_EVENT sThisEvent)
@@ -340,62 +476,353 @@ void ExecuteEvent (CPU_EVENT sThisEvent)
 }
 
 
-// Execute until the end of a frame, or a breakpoint, whichever comes first
-void ExecuteChunk ()
+// Set the time the main loop next needs to check for events and interrupts
+static inline void UpdateEventDeadline ()
 {
-    // Is the reset button is held in?
-    if (g_fReset)
-    {
-        // Advance to the end of the frame
-        g_dwCycleCounter = TSTATES_PER_FRAME;
-    }
+    // Active interrupts are checked after every instruction, which only lasts a few T-states
+    g_dwEventDeadline = (status_reg != STATUS_INT_NONE) ? 0 : GetNextEventTime();
+}
 
-// Execute the first CPU core if only 1 CPU core is compiled in
-#if defined(USE_ONECPUCORE)
-    if (1)
-#else
-    if (Debug::IsBreakpointSet())
-#endif
+// Continue a repeating LDIR/LDDR without returning to the main loop, until the next event is due
+// Each iteration has the full timing of the instruction being run again, and the final iteration
+// is left to the normal instruction, so the result is identical to running it one step at a time
+static void BlockLd (int nStep_)
+{
+    while (BC > 1 && g_dwCycleCounter < g_dwEventDeadline)
     {
-        // Loop until we've reached the end of the frame
-        for (g_fBreak = false ; !g_fBreak ; )
+        // Limit the run to the remainder of the current source and destination sections
+        int nSrcAvail = (nStep_ > 0) ? MEM_PAGE_SIZE - (HL & (MEM_PAGE_SIZE-1)) : (HL & (MEM_PAGE_SIZE-1)) + 1;
+        int nDstAvail = (nStep_ > 0) ? MEM_PAGE_SIZE - (DE & (MEM_PAGE_SIZE-1)) : (DE & (MEM_PAGE_SIZE-1)) + 1;
+        int nMax = std::min(BC-1, std::min(nSrcAvail, nDstAvail));
+
+        WORD wSrc = HL, wDst = DE;
+        const BYTE *pbSrc = AddrReadPtr(wSrc);
+        BYTE *pbDst = AddrWritePtr(wDst);
+
+        // Display writes must be seen before each write, and overlapping copies repeat data as
+        // they go, so those are copied a byte at a time, and the rest in one block at the end
+        const BYTE *pbSrcLow = pbSrc - ((nStep_ < 0) ? nMax-1 : 0);
+        BYTE *pbDstLow = pbDst - ((nStep_ < 0) ? nMax-1 : 0);
+        bool fVideo = AddrPage(wDst) == vmpr_page1 || AddrPage(wDst) == vmpr_page2;
+        bool fOverlap = pbDstLow < pbSrcLow+nMax && pbSrcLow < pbDstLow+nMax;
+        bool fBytewise = fVideo || fOverlap;
+
+        int n;
+        for (n = 0 ; n < nMax && g_dwCycleCounter < g_dwEventDeadline ; n++)
         {
-            // Keep track of the current and previous state of whether we're processing an indexed instruction
-            pHlIxIy = pNewHlIxIy;
-            pNewHlIxIy = &HL;
+            MEM_ACCESS(PC);             // ED prefix fetch
+            g_dwCycleCounter += 1;
+            MEM_ACCESS(PC + 1);         // opcode fetch
+            g_dwCycleCounter += 1;
 
-            // Fetch... (and advance PC)
-            bOpcode = timed_read_code_byte(PC++);
-            R++;
+            MEM_ACCESS(wSrc);
+            MEM_ACCESS(wDst);
 
-            // ... Decode ...
-            switch (bOpcode)
+            if (fBytewise)
             {
-#include "Z80ops.h"     // ... Execute!
+                check_video_write(wDst);
+                pbDst[n*nStep_] = pbSrc[n*nStep_];
             }
 
-            // Update the line/global counters and check/process for pending events
-            CheckCpuEvents();
+            // Transfer, and repeat
+            g_dwCycleCounter += 2 + 5;
+
+            wSrc += nStep_;
+            wDst += nStep_;
+        }
 
-            // Are there any active interrupts?
-            if (status_reg != STATUS_INT_NONE && IFF1)
-                CheckInterrupt();
+        if (!fBytewise)
+            memmove(pbDst - ((nStep_ < 0) ? n-1 : 0), pbSrc - ((nStep_ < 0) ? n-1 : 0), n);
 
-            // If we're not in an IX/IY instruction, check for breakpoints
-            if (pNewHlIxIy == &HL && Debug::BreakpointHit())
-                break;
+        // Only the last byte copied affects the flags
+        BYTE x = pbSrc[(n-1)*nStep_] + A;
+        F = (F & 0xc1) | (x & 0x08) | ((x & 0x02) << 4) | FLAG_P;
 
-#ifdef _DEBUG
-            if (g_fDebug) g_fDebug = !Debug::Start();
-#endif
-        }
+        R += static_cast<BYTE>(n*2);
+        HL = wSrc;
+        DE = wDst;
+        BC -= n;
+    }
+}
+
+// Continue a repeating CPIR/CPDR without returning to the main loop, until the next event is due
+// As with BlockLd, the matching or final iteration is left to the normal instruction
+static void BlockCp (int nStep_)
+{
+    BYTE bLast = 0;
+    int n = 0;
+
+    for ( ; BC > 1 && g_dwCycleCounter < g_dwEventDeadline && read_byte(HL) != A ; n++)
+    {
+        MEM_ACCESS(PC);             // ED prefix fetch
+        g_dwCycleCounter += 1;
+        MEM_ACCESS(PC + 1);         // opcode fetch
+        g_dwCycleCounter += 1;
+
+        MEM_ACCESS(HL);
+        bLast = read_byte(HL);
+
+        // Compare, and repeat
+        g_dwCycleCounter += 2 + 5;
+
+        HL += nStep_;
+        BC--;
+    }
+
+    if (n)
+    {
+        // Only the last comparison affects the flags
+        BYTE carry = F & FLAG_C, sum = A - bLast, z = A ^ bLast ^ sum;
+        F = (sum & 0x80) | (((sum - ((z&0x10)>>4)) & 2) << 4) | (z & 0x10) | ((sum - ((z >> 4) & 1)) & 8) | FLAG_P | FLAG_N | carry;
+        if ((sum & 15) == 8 && (z & 16) != 0)
+            F &= ~8;
+
+        R += static_cast<BYTE>(n*2);
+    }
+}
+
+// Skip the remaining repeats of a HALT, until the next event is due
+// Each repeat is just a timed opcode fetch, so the result is identical to running them one at a time
+static void SkipHalt ()
+{
+    if (g_dwCycleCounter >= g_dwEventDeadline)
+        return;
+
+    // Without contention each repeat takes exactly 4 T-states
+    if (!afSectionContended[AddrSection(PC)])
+    {
+        DWORD dwRepeats = (g_dwEventDeadline - g_dwCycleCounter + 3) / 4;
+        g_dwCycleCounter += dwRepeats * 4;
+        R += static_cast<BYTE>(dwRepeats);
     }
-#if !defined(USE_ONECPUCORE)
     else
     {
-        // Loop until we've reached the end of the frame
-        for (g_fBreak = false ; !g_fBreak ; )
+        while (g_dwCycleCounter < g_dwEventDeadline)
+        {
+            MEM_ACCESS(PC);
+            g_dwCycleCounter += 1;
+            R++;
+        }
+    }
+}
+
+// Add an access made by an instruction in a polling loop
+static inline void AddIdleAccess (WORD wAddr_, bool fPort_, BYTE bExtra_)
+{
+    IDLE_ACCESS &s = asIdleAccesses[nIdleAccesses++];
+    s.wAddr = wAddr_;
+    s.fPort = fPort_;
+    s.bExtra = bExtra_;
+}
+
+// Decode the loop around the polling instruction, recording the accesses made by one iteration
+// Only register operations are allowed, along with the single port read and a single jump back
+static bool DecodeIdleLoop ()
+{
+    WORD wPC = wPollPC;
+    bool fJumped = false;
+    int nPorts = 0, nPortInstr = -1;
+
+    nIdleAccesses = nIdleR = 0;
+
+    for (int i = 0 ; i < MAX_IDLE_INSTRS ; i++)
+    {
+        BYTE bOp = read_byte(wPC), bOp2 = read_byte(wPC + 1);
+        AddIdleAccess(wPC, false, 1);
+        nIdleR++;
+
+        if (bOp == 0xdb)                                        // in a,(n)
+        {
+            AddIdleAccess(wPC + 1, false, 0);
+            AddIdleAccess(0, true, 0);
+            nPortInstr = i;
+            nPorts++;
+            wPC += 2;
+        }
+        else if (bOp == 0xed && (bOp2 & 0xc7) == 0x40)          // in r,(c)
+        {
+            AddIdleAccess(wPC + 1, false, 1);
+            AddIdleAccess(0, true, 0);
+            nIdleR++;
+            nPortInstr = i;
+            nPorts++;
+            wPC += 2;
+        }
+        else if (bOp == 0xcb && (bOp2 & 7) != 6)                // cb ops on registers
+        {
+            AddIdleAccess(wPC + 1, false, 1);
+            nIdleR++;
+            wPC += 2;
+        }
+        else if ((bOp & 0xc7) == 0x06 && bOp != 0x36)           // ld r,n
+        {
+            AddIdleAccess(wPC + 1, false, 0);
+            wPC += 2;
+        }
+        else if ((bOp & 0xc7) == 0xc6)                          // alu n
+        {
+            AddIdleAccess(wPC + 1, false, 0);
+            wPC += 2;
+        }
+        else if ((bOp >= 0x40 && bOp < 0xc0 && (bOp & 7) != 6 && !(bOp < 0x80 && (bOp & 0x38) == 0x30)) ||  // ld r,r' / alu r
+                 ((bOp & 0xc6) == 0x04 && (bOp & 0x38) != 0x30) ||     // inc/dec r
+                 (bOp & 0xc7) == 0x07 || bOp == 0x00)                   // rotates and flags, nop
+        {
+            wPC++;
+        }
+        else if (!fJumped && (bOp == 0x18 || (bOp & 0xe7) == 0x20))   // jr e / jr cc,e
+        {
+            AddIdleAccess(wPC + 1, false, 5);
+            wPC += 2 + static_cast<signed char>(bOp2);
+            fJumped = true;
+        }
+        else if (!fJumped && (bOp == 0xc3 || (bOp & 0xc7) == 0xc2))   // jp nn / jp cc,nn
+        {
+            AddIdleAccess(wPC + 1, false, 0);
+            AddIdleAccess(wPC + 2, false, 0);
+            wPC = read_word(wPC + 1);
+            fJumped = true;
+        }
+        else
+            return false;
+
+        // Complete once the jump has brought us back to where we started, just after the poll
+        if (fJumped && wPC == wPollPC)
+            return nPorts == 1 && nPortInstr == i;
+    }
+
+    return false;
+}
+
+// Return the time after one iteration of the decoded loop, stopping early if the limit is reached
+static DWORD IdleLoopTime (DWORD dwTime_, DWORD dwLimit_)
+{
+    for (int i = 0 ; i < nIdleAccesses && dwTime_ < dwLimit_ ; i++)
+    {
+        const IDLE_ACCESS &s = asIdleAccesses[i];
+
+        // The only port read is from an ASIC port, so it's always subject to contention
+        if (s.fPort)
         {
+            dwTime_ += 4;
+            dwTime_ += abPortContention[dwTime_ & 7];
+        }
+        else
+        {
+            dwTime_ += 3;
+            if (afSectionContended[AddrSection(s.wAddr)])
+                dwTime_ += pMemContention[dwTime_];
+        }
+
+        dwTime_ += s.bExtra;
+    }
+
+    return dwTime_;
+}
+
+// Skip iterations of a polling loop that can't change anything until the next event is due
+// The registers must match those at the previous poll, with the previous iteration following the
+// decoded loop exactly, so later iterations up to the next event must be identical to it
+static void SkipIdleLoop ()
+{
+    fIdlePolled = false;
+
+    // An interrupt may have been accepted after the poll
+    if (PC != wPollPC || pNewHlIxIy != &HL)
+    {
+        fIdlePrev = false;
+        return;
+    }
+
+    Z80Regs sRegs;
+    memcpy(&sRegs, &regs, sizeof(sRegs));
+    sRegs.r = 0;
+
+    bool fRepeated = fIdlePrev && !memcmp(&sRegs, &sIdleRegs, sizeof(sRegs));
+    BYTE bPrevR = bIdleR;
+    DWORD dwPrevTime = dwIdleTime;
+
+    memcpy(&sIdleRegs, &sRegs, sizeof(sIdleRegs));
+    bIdleR = R;
+    dwIdleTime = g_dwCycleCounter;
+    fIdlePrev = true;
+
+    if (!fRepeated || !DecodeIdleLoop())
+        return;
+
+    // Check the previous iteration matches the decoded loop, in both instruction count and timing
+    if (((R - bPrevR) & 0x7f) != (nIdleR & 0x7f) || IdleLoopTime(dwPrevTime, g_dwCycleCounter+1) != g_dwCycleCounter)
+        return;
+
+    // Skip only whole iterations that complete before the next event
+    DWORD dwLimit = std::min(g_dwEventDeadline, static_cast<DWORD>(TSTATES_PER_FRAME));
+    for (DWORD dwEnd ; (dwEnd = IdleLoopTime(g_dwCycleCounter, dwLimit)) < dwLimit ; )
+    {
+        g_dwCycleCounter = dwEnd;
+        R += static_cast<BYTE>(nIdleR);
+    }
+
+    bIdleR = R;
+    dwIdleTime = g_dwCycleCounter;
+}
+
+// Note a read from the status or keyboard ports, which may be from an idle polling loop
+void IdlePoll ()
+{
+    if (fIdleSkip)
+    {
+        // Return to the main loop after the current instruction, to check for a loop
+        fIdlePolled = true;
+        wPollPC = PC;
+        g_dwEventDeadline = 0;
+    }
+}
+
+// Test a physical memory location in a breakpoint index map, which is null if unused
+static inline bool BreakMapHit (const BYTE *pbMap_, const BYTE *pb_)
+{
+    size_t uOffset = static_cast<size_t>(pb_ - pMemory);
+    return pbMap_ && pb_ && uOffset < TOTAL_PAGES*MEM_PAGE_SIZE && (pbMap_[uOffset >> 3] & (1 << (uOffset & 7)));
+}
+
+// Return whether the breakpoint index shows a possible hit at the current instruction boundary
+static inline bool BreakIndexHit ()
+{
+    return BreakMapHit(pbBreakExec, AddrReadPtr(PC)) ||
+           BreakMapHit(pbBreakRead, pbMemRead1) || BreakMapHit(pbBreakRead, pbMemRead2) ||
+           BreakMapHit(pbBreakWrite, pbMemWrite1) || BreakMapHit(pbBreakWrite, pbMemWrite2) ||
+           (abBreakPorts[wPortRead] & atRead) || (abBreakPorts[wPortWrite] & atWrite) ||
+           (bBreakInts & ~status_reg);
+}
+
+// Execute until the end of a frame, or a breakpoint if they're checked, using the supplied core features
+template <int nCore_>
+static void ExecuteCoreChunk ()
+{
+    constexpr bool fTrack_ = (nCore_ & CORE_TRACK) != 0;
+    constexpr bool fIdle_ = (nCore_ & CORE_IDLE) != 0;
+    constexpr bool fProfile_ = (nCore_ & CORE_PROFILE) != 0;
+    constexpr bool fHeat_ = (nCore_ & CORE_HEAT) != 0;
+    constexpr bool fGuard_ = (nCore_ & CORE_GUARD) != 0;
+
+    // Loop until we've reached the end of the frame
+    for (g_fBreak = false ; !g_fBreak ; )
+    {
+        // Run instructions until the next event is due, an event has run during I/O, the breakpoint
+        // index has a possible hit, or after every instruction if breakpoints are being checked
+        do
+        {
+            // Compiled blocks start on whole instructions, so there can't be an index prefix pending
+            if ((nCore_ & CORE_DYNAREC) && pNewHlIxIy == &HL && Dynarec::Execute(pMemContention))
+                continue;
+
+            // Log the state before each whole instruction, along with the accesses by the previous one
+            if ((nCore_ & CORE_LOG) && pNewHlIxIy == &HL)
+                TraceLog::Record();
+
+            if (fProfile_ && pNewHlIxIy == &HL)
+                Profile::Record();
+
             // Keep track of the current and previous state of whether we're processing an indexed instruction
             pHlIxIy = pNewHlIxIy;
             pNewHlIxIy = &HL;
@@ -409,20 +836,144 @@ void ExecuteChunk ()
             {
 #include "Z80ops.h"     // ... Execute!
             }
+        }
+        while (!(nCore_ & CORE_BREAK) && g_dwCycleCounter < g_dwEventDeadline && !(fGuard_ && g_nGuardStop) &&
+               !((nCore_ & CORE_WATCH) && pNewHlIxIy == &HL && BreakIndexHit()));
+
+        // Too many protection faults return to the main loop, to select the indexed core
+        if (fGuard_ && g_nGuardStop && Guard::TakeBusy())
+            g_fBreak = true;
+
+        // Update the line/global counters and check/process for pending events
+        CheckCpuEvents();
+
+        // Are there any active interrupts?
+        if (status_reg != STATUS_INT_NONE && IFF1)
+            CheckInterrupt<fTrack_, fProfile_, fHeat_>();
+
+        UpdateEventDeadline();
+
+        // Look for an idle loop if the last instruction polled the keyboard or status ports
+        if (fIdle_ && fIdlePolled)
+            SkipIdleLoop();
+
+        // If we're not in an IX/IY instruction, check for breakpoints
+        if ((nCore_ & CORE_BREAK) && pNewHlIxIy == &HL && Debug::BreakpointHit())
+            break;
 
-            // Update the line/global counters and check/process for pending events
-            CheckCpuEvents();
+        // With an index, the full list is only checked if there may be a hit
+        if ((nCore_ & CORE_WATCH) && pNewHlIxIy == &HL)
+        {
+            if (BreakIndexHit() && Debug::IndexedBreakpointHit())
+                break;
 
-            // Are there any active interrupts?
-            if (status_reg != STATUS_INT_NONE && IFF1)
-                CheckInterrupt();
+            // The accesses have been checked, so don't let them end later runs of instructions
+            // On a hit they're kept for the debugger to highlight, and it clears them on close
+            pbMemRead1 = pbMemRead2 = pbMemWrite1 = pbMemWrite2 = nullptr;
+            wPortRead = wPortWrite = 0;
+        }
+
+        // Writes caught by page protection have ended the run of instructions, and need the full list checked
+        if (fGuard_ && pNewHlIxIy == &HL && Guard::IsHit() && Debug::GuardedBreakpointHit())
+            break;
 
 #ifdef _DEBUG
-            if (g_fDebug) g_fDebug = !Debug::Start();
+        if (g_fDebug) g_fDebug = !Debug::Start();
 #endif
-        }
     }
+}
+
+#if !defined(USE_ONECPUCORE)
+// Execute a single instruction for the recompiler, with the opcode fetch already timed
+static void ExecuteOp (BYTE bOpcode_)
+{
+    // Compiled blocks check the write locations for self-modifying code
+    constexpr bool fTrack_ = true;
+    constexpr bool fIdle_ = false;
+    constexpr bool fProfile_ = false;
+    constexpr bool fHeat_ = false;
+    constexpr bool fGuard_ = false;
+
+    switch (bOpcode = bOpcode_)
+    {
+#include "Z80ops.h"
+    }
+}
 #endif  // !defined(USE_ONECPUCORE)
+
+// Execute until the end of a frame, or a breakpoint, whichever comes first
+void ExecuteChunk ()
+{
+    // Is the reset button is held in?
+    if (g_fReset)
+    {
+        // Advance to the end of the frame
+        g_dwCycleCounter = TSTATES_PER_FRAME;
+    }
+
+    // Events or interrupts may have changed outside the main loop
+    UpdateEventDeadline();
+
+    // Idle loops are only tracked within a chunk, as state may be changed between them
+    fIdleSkip = fIdlePolled = fIdlePrev = false;
+
+    // Select the core once for the chunk, with only the debugger core compiled in if only 1 CPU core is wanted
+#if !defined(USE_ONECPUCORE)
+    // Replaying history for the debugger stops at an exact instruction, so checks after every one
+    if (Reverse::IsReplaying())
+        ExecuteCoreChunk<CORE_DEBUG>();
+    // Trace logging, profiling and the heatmap need every instruction run individually, so they have
+    // their own cores.  The heatmap is rarely combined with the others, so those share a debug core
+    else if (Heatmap::IsActive() && TraceLog::IsActive() && Profile::IsActive())
+        ExecuteCoreChunk<CORE_DEBUG|CORE_LOG|CORE_PROFILE|CORE_HEAT>();
+    else if (Heatmap::IsActive() && TraceLog::IsActive())
+        ExecuteCoreChunk<CORE_DEBUG|CORE_LOG|CORE_HEAT>();
+    else if (Heatmap::IsActive() && Profile::IsActive())
+        ExecuteCoreChunk<CORE_DEBUG|CORE_PROFILE|CORE_HEAT>();
+    else if (Heatmap::IsActive())
+        Debug::IsBreakpointSet() ? ExecuteCoreChunk<CORE_DEBUG|CORE_HEAT>() : ExecuteCoreChunk<CORE_HEAT>();
+    else if (TraceLog::IsActive() && Profile::IsActive())
+        Debug::IsBreakpointSet() ? ExecuteCoreChunk<CORE_DEBUG|CORE_LOG|CORE_PROFILE>() : ExecuteCoreChunk<CORE_TRACK|CORE_LOG|CORE_PROFILE>();
+    else if (TraceLog::IsActive())
+        Debug::IsBreakpointSet() ? ExecuteCoreChunk<CORE_DEBUG|CORE_LOG>() : ExecuteCoreChunk<CORE_TRACK|CORE_LOG>();
+    else if (Profile::IsActive())
+        Debug::IsBreakpointSet() ? ExecuteCoreChunk<CORE_DEBUG|CORE_PROFILE>() : ExecuteCoreChunk<CORE_PROFILE>();
+    // Compiled blocks and idle skipping don't check for breakpoints, so they're only used without any set.
+    // Skipped polling loops wouldn't have their port reads logged for reverse execution, so aren't skipped then
+    else if (!Debug::IsBreakpointSet())
+    {
+        fIdleSkip = GetOption(idleskip) && !Reverse::IsRecording();
+        bool fDynarec = GetOption(dynarec) && Dynarec::IsAvailable();
+
+        if (fIdleSkip)
+            fDynarec ? ExecuteCoreChunk<CORE_DYNAREC|CORE_IDLE>() : ExecuteCoreChunk<CORE_IDLE>();
+        else
+            fDynarec ? ExecuteCoreChunk<CORE_DYNAREC>() : ExecuteCoreChunk<0>();
+
+        fIdleSkip = false;
+    }
+    // Write watchpoints caught by page protection leave the core free of checks, though compiled blocks only
+    // stop at their end so aren't used.  Pages are only protected while the core runs, for other writers
+    else if (Debug::IsBreakpointGuarded())
+    {
+        fIdleSkip = GetOption(idleskip) && !Reverse::IsRecording();
+        Guard::Arm();
+
+        fIdleSkip ? ExecuteCoreChunk<CORE_GUARD|CORE_IDLE>() : ExecuteCoreChunk<CORE_GUARD>();
+
+        Guard::Disarm();
+        fIdleSkip = false;
+
+        // Protection that proved too busy ends the run early, leaving the index to check the rest
+        if (Guard::IsBusy() && !Debug::IsActive())
+            ExecuteCoreChunk<CORE_TRACK|CORE_WATCH>();
+    }
+    // Breakpoints that can all be found through the index avoid checking the full list every instruction
+    else if (Debug::IsBreakpointIndexed())
+        ExecuteCoreChunk<CORE_TRACK|CORE_WATCH>();
+    else
+#endif
+        ExecuteCoreChunk<CORE_DEBUG>();
 }
 
 
@@ -435,35 +986,73 @@ void Run ()
         if (g_fPaused)
             continue;
 
-        // If fast booting is active, don't draw any video
-        if (g_nTurbo & TURBO_BOOT)
-            fDrawFrame = GUI::IsActive();
+        RunFrame();
+    }
+
+    TRACE("Quitting main emulation loop...\n");
+}
 
-        // Prepare start of frame image, in case we've already started it
-        Frame::Begin();
+// Handle the real end of the SAM frame
+static void FrameEnd ()
+{
+    CpuEventFrame(TSTATES_PER_FRAME);
 
-        // CPU execution continues unless the debugger is active or there's a modal GUI dialog active
-        if (!Debug::IsActive() && !GUI::IsModal())
-            ExecuteChunk();
+    IO::FrameUpdate();
+    Debug::FrameEnd();
+    Frame::Flyback();
 
-        // Finish end of frame image, in case we haven't finished it
-        Frame::End();
+    // Step back up to start the next frame
+    g_dwCycleCounter %= TSTATES_PER_FRAME;
+    TraceLog::FrameEnd();
+    Profile::FrameEnd();
+    Heatmap::FrameEnd();
 
-        // The real end of the SAM frame requires some additional handling
-        if (g_dwCycleCounter >= TSTATES_PER_FRAME)
-        {
-            CpuEventFrame(TSTATES_PER_FRAME);
+    {
+        CPerfScope perf(ptRecord);
+        Rewind::FrameEnd();
+        Reverse::FrameEnd();
+    }
 
-            IO::FrameUpdate();
-            Debug::FrameEnd();
-            Frame::Flyback();
+    Perf::FrameEnd();
+}
 
-            // Step back up to start the next frame
-            g_dwCycleCounter %= TSTATES_PER_FRAME;
-        }
+// Run a single chunk of emulation, normally a complete frame unless a breakpoint is hit
+void RunFrame ()
+{
+    // If fast booting is active, don't draw any video
+    if (g_nTurbo & TURBO_BOOT)
+        fDrawFrame = GUI::IsActive();
+
+    // Prepare start of frame image, in case we've already started it
+    Frame::Begin();
+
+    // CPU execution continues unless the debugger is active or there's a modal GUI dialog active
+    if (!Debug::IsActive() && !GUI::IsModal())
+    {
+        // Step back through the rewind history while it's active, then replay that frame
+        if (Rewind::IsActive())
+            Rewind::Step();
+
+        CPerfScope perf(ptCPU);
+        ExecuteChunk();
     }
 
-    TRACE("Quitting main emulation loop...\n");
+    // Finish end of frame image, in case we haven't finished it
+    Frame::End();
+
+    // The real end of the SAM frame requires some additional handling
+    if (g_dwCycleCounter >= TSTATES_PER_FRAME)
+        FrameEnd();
+}
+
+// Run the rest of the frame without presenting it, for the debugger to replay history
+// Returns early if the debugger's reverse execution stops mid-frame
+void ReplayFrame ()
+{
+    ExecuteChunk();
+
+    if (g_dwCycleCounter >= TSTATES_PER_FRAME)
+        FrameEnd();
 }
 
 
@@ -486,6 +1075,9 @@ void Reset (bool fPress_)
         // Clear the CPU events queue
         InitCpuEvents();
 
+        // The reset can't be replayed, so history from before it is no use
+        Reverse::Clear();
+
         // Schedule the first end of line event, and an update check 3/4 through the frame
         AddCpuEvent(evtEndOfFrame, TSTATES_PER_FRAME);
         AddCpuEvent(evtInputUpdate, TSTATES_PER_FRAME*3/4);
@@ -505,6 +1097,13 @@ void Reset (bool fPress_)
 
 void NMI()
 {
+    // The stack write is recorded for the debugger, as it's outside the main loop
+    constexpr bool fTrack_ = true;
+    constexpr bool fHeat_ = false;
+
+    // The button press can't be replayed, so history from before it is no use
+    Reverse::Clear();
+
     // R is incremented when the interrupt is acknowledged
     R++;
 
@@ -529,6 +1128,7 @@ void NMI()
 }
 
 
+template <bool fTrack_, bool fProfile_, bool fHeat_>
 inline void CheckInterrupt ()
 {
     // Only process if not delayed after a DI/EI and not in the middle of an indexed instruction
@@ -579,6 +1179,9 @@ inline void CheckInterrupt ()
                 break;
             }
         }
+
+        if (fProfile_)
+            Profile::OnCall();
     }
 }
 
@@ -29,6 +29,7 @@
 
 struct _CPU_EVENT;
 struct _Z80Regs;
+class CState;
 
 namespace CPU
 {
@@ -36,6 +37,8 @@ namespace CPU
     void Exit (bool fReInit_=false);
 
     void Run ();
+    void RunFrame ();
+    void ReplayFrame ();
     bool IsContentionActive ();
     void UpdateContention (bool fActive_ = true);
     void ExecuteEvent (struct _CPU_EVENT sThisEvent);
@@ -43,21 +46,24 @@ namespace CPU
 
     void Reset (bool fPress_);
     void NMI ();
+    void IdlePoll ();
+
+    void Serialize (CState &state_);
 
     void InitTests ();
 }
 
 
-extern struct _Z80Regs regs;
-extern DWORD g_dwCycleCounter;
-extern bool g_fReset, g_fBreak, g_fPaused;
-extern int g_nTurbo;
-extern BYTE *pbMemRead1, *pbMemRead2, *pbMemWrite1, *pbMemWrite2;
+extern MACHINE_LOCAL struct _Z80Regs regs;
+extern MACHINE_LOCAL DWORD g_dwCycleCounter;
+extern MACHINE_LOCAL bool g_fReset, g_fBreak, g_fPaused;
+extern MACHINE_LOCAL int g_nTurbo;
+extern MACHINE_LOCAL BYTE *pbMemRead1, *pbMemRead2, *pbMemWrite1, *pbMemWrite2;
 
 enum { TURBO_BOOT=0x01, TURBO_KEY=0x02, TURBO_DISK=0x04, TURBO_TAPE=0x08, TURBO_KEYIN=0x10 };
 
 #ifdef _DEBUG
-extern bool g_fDebug;
+extern MACHINE_LOCAL bool g_fDebug;
 #endif
 
 const BYTE OP_NOP   = 0x00;     // Z80 opcode for NOP
@@ -105,7 +111,7 @@ typedef struct _CPU_EVENT
 {
     int nEvent = -1;
     DWORD dwTime = 0;
-    struct _CPU_EVENT *psNext = nullptr;
+    DWORD dwSeq = 0;        // order added, so events due at the same time run in that order
 } CPU_EVENT;
 
 
@@ -195,85 +201,139 @@ enum {
 
 const int MAX_EVENTS = 16;
 
-extern CPU_EVENT asCpuEvents[MAX_EVENTS], *psNextEvent, *psFreeEvent;
+extern MACHINE_LOCAL CPU_EVENT asCpuEvents[MAX_EVENTS];   // binary heap, with the next event due first
+extern MACHINE_LOCAL int nCpuEvents;
+extern MACHINE_LOCAL DWORD dwCpuEventSeq;
+extern MACHINE_LOCAL DWORD g_dwEventDeadline;             // time the main loop must next check events and interrupts
+
+
+// Compare events by the time due, and then by the order they were added
+inline bool CpuEventBefore (const CPU_EVENT &sA_, const CPU_EVENT &sB_)
+{
+    return sA_.dwTime < sB_.dwTime || (sA_.dwTime == sB_.dwTime && static_cast<int>(sA_.dwSeq - sB_.dwSeq) < 0);
+}
+
+// Move a heap entry up to its correct position
+inline void CpuEventSiftUp (int nIndex_)
+{
+    CPU_EVENT sEvent = asCpuEvents[nIndex_];
+
+    for (int nParent ; nIndex_ > 0 && CpuEventBefore(sEvent, asCpuEvents[nParent = (nIndex_-1)/2]) ; nIndex_ = nParent)
+        asCpuEvents[nIndex_] = asCpuEvents[nParent];
+
+    asCpuEvents[nIndex_] = sEvent;
+}
+
+// Move a heap entry down to its correct position
+inline void CpuEventSiftDown (int nIndex_)
+{
+    CPU_EVENT sEvent = asCpuEvents[nIndex_];
+
+    for (int nChild ; (nChild = nIndex_*2+1) < nCpuEvents ; nIndex_ = nChild)
+    {
+        if (nChild+1 < nCpuEvents && CpuEventBefore(asCpuEvents[nChild+1], asCpuEvents[nChild]))
+            nChild++;
+
+        if (!CpuEventBefore(asCpuEvents[nChild], sEvent))
+            break;
+
+        asCpuEvents[nIndex_] = asCpuEvents[nChild];
+    }
+
+    asCpuEvents[nIndex_] = sEvent;
+}
+
+// Remove the event at a heap position
+inline void RemoveCpuEvent (int nIndex_)
+{
+    asCpuEvents[nIndex_] = asCpuEvents[--nCpuEvents];
+
+    if (nIndex_ < nCpuEvents)
+    {
+        CpuEventSiftUp(nIndex_);
+        CpuEventSiftDown(nIndex_);
+    }
+}
 
 
 // Initialise the CPU events queue
 inline void InitCpuEvents ()
 {
-    for (int n = 0 ; n < MAX_EVENTS ; n++)
-        asCpuEvents[n].psNext = &asCpuEvents[(n+1) % MAX_EVENTS];
-
-    psFreeEvent = asCpuEvents;
-    psNextEvent = nullptr;
+    nCpuEvents = 0;
+    dwCpuEventSeq = 0;
+    g_dwEventDeadline = 0;
 }
 
 // Add a CPU event into the queue
 inline void AddCpuEvent (int nEvent_, DWORD dwTime_)
 {
-    CPU_EVENT *psNextFree = psFreeEvent->psNext;
-    CPU_EVENT **ppsEvent = &psNextEvent;
-
-    // Search through the queue while the events come before the new one
-    // New events with equal time are inserted after existing entries
-    while (*ppsEvent && (*ppsEvent)->dwTime <= dwTime_)
-        ppsEvent = &((*ppsEvent)->psNext);
-
-    // Set this event (note - psFreeEvent will never be nullptr)
-    psFreeEvent->nEvent = nEvent_;
-    psFreeEvent->dwTime = dwTime_;
-
-    // Link the events
-    psFreeEvent->psNext = *ppsEvent;
-    *ppsEvent = psFreeEvent;
-    psFreeEvent = psNextFree;
+    // Only a few events are ever pending, but never overrun the queue
+    if (nCpuEvents == MAX_EVENTS)
+        return;
+
+    CPU_EVENT &sEvent = asCpuEvents[nCpuEvents];
+    sEvent.nEvent = nEvent_;
+    sEvent.dwTime = dwTime_;
+    sEvent.dwSeq = dwCpuEventSeq++;
+    CpuEventSiftUp(nCpuEvents++);
+
+    // Bring the deadline forward if this event is due sooner
+    if (dwTime_ < g_dwEventDeadline)
+        g_dwEventDeadline = dwTime_;
 }
 
 // Remove events of a specific type from the queue
 inline void CancelCpuEvent (int nEvent_)
 {
-    CPU_EVENT **ppsEvent = &psNextEvent;
-
-    while (*ppsEvent)
+    // A later deadline is left alone, as checking early is harmless
+    for (int i = nCpuEvents-1 ; i >= 0 ; i--)
     {
-        if ((*ppsEvent)->nEvent != nEvent_)
-            ppsEvent = &((*ppsEvent)->psNext);
-        else
-        {
-            CPU_EVENT *psNext = (*ppsEvent)->psNext;
-            (*ppsEvent)->psNext = psFreeEvent;
-            psFreeEvent = *ppsEvent;
-            *ppsEvent = psNext;
-        }
+        if (asCpuEvents[i].nEvent == nEvent_)
+            RemoveCpuEvent(i);
     }
 }
 
-// Return time until the next event of a specific  type
+// Return time until the next event of a specific type
 inline DWORD GetEventTime (int nEvent_)
 {
-    CPU_EVENT *psEvent;
+    const CPU_EVENT *psNext = nullptr;
 
-    for (psEvent = psNextEvent ; psEvent ; psEvent = psEvent->psNext)
+    for (int i = 0 ; i < nCpuEvents ; i++)
     {
-        if (psEvent->nEvent == nEvent_)
-            return psEvent->dwTime - g_dwCycleCounter;
+        if (asCpuEvents[i].nEvent == nEvent_ && (!psNext || CpuEventBefore(asCpuEvents[i], *psNext)))
+            psNext = &asCpuEvents[i];
     }
 
-    return 0;
+    return psNext ? psNext->dwTime - g_dwCycleCounter : 0;
+}
+
+// Return the time the next event is due
+inline DWORD GetNextEventTime ()
+{
+    return nCpuEvents ? asCpuEvents[0].dwTime : ~0U;
+}
+
+// Fill the supplied array with the pending events in the order they're due, returning how many
+inline int GetCpuEvents (CPU_EVENT *pasEvents_)
+{
+    std::copy(asCpuEvents, asCpuEvents+nCpuEvents, pasEvents_);
+    std::sort(pasEvents_, pasEvents_+nCpuEvents, CpuEventBefore);
+    return nCpuEvents;
 }
 
 // Update the line/global counters and check for pending events
 inline void CheckCpuEvents ()
 {
-    // Check for pending CPU events (note - psNextEvent will never be nullptr *at this stage*)
-    while (g_dwCycleCounter >= psNextEvent->dwTime)
+    // Check for pending CPU events
+    while (nCpuEvents && g_dwCycleCounter >= asCpuEvents[0].dwTime)
     {
         // Get the event from the queue and remove it before new events are added
-        CPU_EVENT sThisEvent = *psNextEvent;
-        psNextEvent->psNext = psFreeEvent;
-        psFreeEvent = psNextEvent;
-        psNextEvent = sThisEvent.psNext;
+        CPU_EVENT sThisEvent = asCpuEvents[0];
+        RemoveCpuEvent(0);
         CPU::ExecuteEvent(sThisEvent);
+
+        // Events may raise interrupts or end the frame, so the main loop must take a look
+        g_dwEventDeadline = 0;
     }
 }
 
@@ -281,8 +341,10 @@ inline void CheckCpuEvents ()
 inline void CpuEventFrame (DWORD dwFrameTime_)
 {
     // Process all queued events, due sometime in the next or a later frame
-    for (CPU_EVENT *psEvent = psNextEvent ; psEvent ; psEvent = psEvent->psNext)
-        psEvent->dwTime -= dwFrameTime_;
+    for (int i = 0 ; i < nCpuEvents ; i++)
+        asCpuEvents[i].dwTime -= dwFrameTime_;
+
+    g_dwEventDeadline = (g_dwEventDeadline > dwFrameTime_) ? g_dwEventDeadline - dwFrameTime_ : 0;
 }
 
 #endif  // CPU_H
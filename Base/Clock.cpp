@@ -33,8 +33,22 @@
 
 #include "Clock.h"
 #include "Options.h"
+#include "State.h"
 
 
+// Break a time into its parts, without sharing the result buffer when several machines may be running
+static tm LocalTime (time_t t_)
+{
+    tm t = {};
+#ifdef USE_MACHINES
+    localtime_r(&t_, &t);
+#else
+    if (tm *ptm = localtime(&t_))
+        t = *ptm;
+#endif
+    return t;
+}
+
 CClockDevice::CClockDevice ()
 {
     // Initialise the clock to the current date/time
@@ -48,7 +62,7 @@ void CClockDevice::Reset ()
     m_tLast = time(nullptr);
 
     // Break the current time into it's parts
-    tm *ptm = localtime(&m_tLast);
+    tm sTime = LocalTime(m_tLast), *ptm = &sTime;
 
     m_st.nCentury = Encode((1900+ptm->tm_year) / 100);
     m_st.nYear  = Encode(ptm->tm_year % 100);
@@ -164,10 +178,20 @@ bool CClockDevice::Update ()
     return true;
 }
 
+// Save or restore the clock time, which continues from the host time it was saved
+void CClockDevice::Serialize (CState &state_)
+{
+    state_.Section(STATE_TAG('R','T','C',' '));
+
+    state_.Value(m_tLast);
+    state_.Value(m_st);
+    state_.Value(m_fBCD);
+}
+
 // Get the day of the week for the current SAMTIME
 int CClockDevice::GetDayOfWeek ()
 {
-    struct tm t, *ptm;
+    struct tm t;
 
     // Set the date and hour, just in case daylight savings is important
     t.tm_year = Decode(m_st.nCentury)*100 + Decode(m_st.nYear);
@@ -181,7 +205,7 @@ int CClockDevice::GetDayOfWeek ()
     time_t tNow = mktime(&t);
 
     // Convert back to a tm structure to get the day of the week :-)
-    return (ptm = localtime(&tNow)) ? ptm->tm_wday : 0;
+    return LocalTime(tNow).tm_wday;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -272,11 +296,17 @@ bool CSambusClock::Update ()
     m_abRegs[0x09] = (m_st.nMonth  & 0xf0) >> 4;    // Months (tens)
     m_abRegs[0x0a] =  m_st.nYear   & 0x0f;          // Year (ones)
     m_abRegs[0x0b] = (m_st.nYear   & 0xf0) >> 4;    // Year (tens)
-    m_abRegs[0x0c] = localtime(&m_tLast)->tm_wday;  // Day of week (unsupported)
+    m_abRegs[0x0c] = LocalTime(m_tLast).tm_wday;    // Day of week (unsupported)
 
     return true;
 }
 
+void CSambusClock::Serialize (CState &state_)
+{
+    CClockDevice::Serialize(state_);
+    state_.Value(m_abRegs);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #define BANK1 0x40  // Bank 1 register offset
@@ -448,6 +478,14 @@ bool CDallasClock::Update ()
     return true;
 }
 
+void CDallasClock::Serialize (CState &state_)
+{
+    CClockDevice::Serialize(state_);
+    state_.Value(m_bReg);
+    state_.Value(m_abRegs);
+    state_.Value(m_abRAM);
+}
+
 
 // Load NVRAM contents from file
 bool CDallasClock::LoadState (const char *pcszFile_)
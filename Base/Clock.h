@@ -44,6 +44,7 @@ class CClockDevice : public CIoDevice
 
     public:
         void Reset () override;
+        void Serialize (CState &state_) override;
         virtual bool Update ();
         int GetDayOfWeek ();
 
@@ -67,6 +68,7 @@ class CSambusClock final : public CClockDevice
         BYTE In (WORD wPort_) override;
         void Out (WORD wPort_, BYTE bVal_) override;
         bool Update () override;
+        void Serialize (CState &state_) override;
 
     protected:
         BYTE m_abRegs[16];    // 16 registers
@@ -82,6 +84,7 @@ class CDallasClock final : public CClockDevice
         BYTE In (WORD wPort_) override;
         void Out (WORD wPort_, BYTE bVal_) override;
         bool Update () override;
+        void Serialize (CState &state_) override;
 
         bool LoadState (const char *pcszFile_) override;
         bool SaveState (const char *pcszFile_) override;
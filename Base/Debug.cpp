@@ -24,10 +24,14 @@
 #include "CPU.h"
 #include "Disassem.h"
 #include "Frame.h"
+#include "Guard.h"
+#include "Heatmap.h"
 #include "Keyboard.h"
 #include "Memory.h"
 #include "Options.h"
+#include "Reverse.h"
 #include "Symbol.h"
+#include "TraceLog.h"
 #include "Util.h"
 
 
@@ -62,34 +66,47 @@ static const char * aszBasicKeywords[] = {
 
 static const int ROW_GAP = 2;
 static const int ROW_HEIGHT = ROW_GAP+sFixedFont.wHeight+ROW_GAP;
-static const int CHAR_WIDTH = sFixedFont.wWidth+CHAR_SPACING;
-
-typedef struct
-{
-    WORD wPC;                         // PC value
-    BYTE abInstr[MAX_Z80_INSTR_LEN];  // Instruction at PC
-    Z80Regs regs;                     // Register values
-} TRACEDATA;
+static const int FIXED_CHAR_WIDTH = sFixedFont.wWidth+CHAR_SPACING;
 
 
-CDebugger* pDebugger;
+MACHINE_LOCAL CDebugger* pDebugger;
 
 // Stack position used to track stepping out
-int nStepOutSP = -1;
+MACHINE_LOCAL int nStepOutSP = -1;
 
 // Last position of debugger window and last register values
-int nDebugX, nDebugY;
-Z80Regs sLastRegs, sCurrRegs;
-BYTE bLastStatus;
-DWORD dwLastCycle;
-int nLastFrames;
-ViewType nLastView = vtDis;
-WORD wLastAddr;
+MACHINE_LOCAL int nDebugX, nDebugY;
+MACHINE_LOCAL Z80Regs sLastRegs, sCurrRegs;
+MACHINE_LOCAL BYTE bLastStatus;
+MACHINE_LOCAL DWORD dwLastCycle;
+MACHINE_LOCAL int nLastFrames;
+MACHINE_LOCAL ViewType nLastView = vtDis;
+MACHINE_LOCAL WORD wLastAddr;
 
 // Instruction tracing
 #define TRACE_SLOTS 1000
-TRACEDATA aTrace[TRACE_SLOTS];
-int nNumTraces;
+MACHINE_LOCAL TRACEDATA aTrace[TRACE_SLOTS];
+MACHINE_LOCAL int nNumTraces;
+
+// Trace loaded from a log file, shown instead of the live trace if present
+#define MAX_LOADED_TRACES 1000000
+static MACHINE_LOCAL std::vector<TRACEDATA> vLoadedTrace;
+
+
+// Add a new trace entry if PC has changed
+static void AddTrace ()
+{
+    if (aTrace[nNumTraces % TRACE_SLOTS].wPC != PC)
+    {
+        TRACEDATA *p = &aTrace[(++nNumTraces) % TRACE_SLOTS];
+        p->wPC = PC;
+        p->abInstr[0] = read_byte(PC);
+        p->abInstr[1] = read_byte(PC+1);
+        p->abInstr[2] = read_byte(PC+2);
+        p->abInstr[3] = read_byte(PC+3);
+        p->regs = regs;
+    }
+}
 
 
 namespace Debug
@@ -101,6 +118,9 @@ bool Start (BREAKPT* pBreak_)
     // Restore memory contention in case of a timing measurement
     CPU::UpdateContention();
 
+    // Complete any tracepoint log file, so it can be inspected while we're stopped
+    Tracepoint::Flush();
+
     // Reset the last entry counters, unless we're started from a triggered breakpoint
     if (!pBreak_ && nStepOutSP == -1)
     {
@@ -111,8 +131,8 @@ bool Start (BREAKPT* pBreak_)
         sLastRegs = sCurrRegs = regs;
         bLastStatus = status_reg;
 
-        // If there's no breakpoint set any existing trace is meaningless
-        if (!Breakpoint::IsSet())
+        // If there's no breakpoint set, or only indexed ones, any existing trace is meaningless
+        if (!Breakpoint::IsSet() || Breakpoint::IsIndexed())
         {
             // Set the previous entry to have the current register values
             aTrace[nNumTraces = 0].regs = regs;
@@ -195,8 +215,8 @@ bool RetZHook ()
     // Are we in in HDNSTP in ROM1, about to start an auto-executing code file?
     if (PC == 0xe294 && GetSectionPage(SECTION_D) == ROM1 && !(F & FLAG_Z))
     {
-        // If the option is enabled, set a temporary breakpoint for the start
-        if (GetOption(breakonexec))
+        // If the option is enabled, set a temporary breakpoint for the start, unless replaying history
+        if (GetOption(breakonexec) && !Reverse::IsReplaying())
             Breakpoint::AddTemp(nullptr, Expr::Compile("autoexec"));
     }
 
@@ -217,24 +237,43 @@ bool IsBreakpointSet ()
     return Breakpoint::IsSet();
 }
 
+bool IsBreakpointIndexed ()
+{
+    return Breakpoint::IsIndexed();
+}
+
+bool IsBreakpointGuarded ()
+{
+    return Breakpoint::IsGuarded();
+}
+
 // Return whether any of the active breakpoints have been hit
 bool BreakpointHit ()
 {
-    // Add a new trace entry if PC has changed
-    if (aTrace[nNumTraces % TRACE_SLOTS].wPC != PC)
-    {
-        TRACEDATA *p = &aTrace[(++nNumTraces) % TRACE_SLOTS];
-        p->wPC = PC;
-        p->abInstr[0] = read_byte(PC);
-        p->abInstr[1] = read_byte(PC+1);
-        p->abInstr[2] = read_byte(PC+2);
-        p->abInstr[3] = read_byte(PC+3);
-        p->regs = regs;
-    }
+    // Replaying history for reverse execution only needs to know where to stop
+    if (Reverse::IsReplaying())
+        return Reverse::CheckStop();
 
+    AddTrace();
     return Breakpoint::IsHit();
 }
 
+// Check for a breakpoint hit after the index has found a possible match
+// No trace is kept between checks, so start a new one from the current location
+bool IndexedBreakpointHit ()
+{
+    aTrace[nNumTraces = 0].regs = regs;
+    return BreakpointHit();
+}
+
+// Check for a breakpoint hit after page protection has caught a write to a watched location
+// The core doesn't track accesses, so the caught writes are supplied as if it had
+bool GuardedBreakpointHit ()
+{
+    Guard::TakeHits(&pbMemWrite1, &pbMemWrite2);
+    return IndexedBreakpointHit();
+}
+
 } // namespace Debug
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -347,6 +386,28 @@ void cmdStepOut ()
     Debug::Stop();
 }
 
+// Show where reverse execution has arrived, which is a new stopping point
+void cmdReverse (bool fArrived_)
+{
+    if (!fArrived_)
+    {
+        pDebugger->SetStatus("\aYNo match in the reverse history", true, &sPropFont);
+        return;
+    }
+
+    // Show changes from where we were, and time from here
+    sLastRegs = sCurrRegs;
+    sCurrRegs = regs;
+    dwLastCycle = g_dwCycleCounter;
+    nLastFrames = 0;
+
+    // The existing trace is in the future, so start a new one
+    aTrace[nNumTraces = 0].regs = regs;
+    AddTrace();
+
+    pDebugger->SetAddress((nLastView == vtDis) ? PC : wLastAddr, false);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 CInputDialog::CInputDialog (CWindow* pParent_/*=nullptr*/, const char* pcszCaption_, const char* pcszPrompt_, PFNINPUTPROC pfnNotify_)
@@ -554,7 +615,7 @@ bool CTextView::cmdNavigate (int nKey_, int /*nMods_*/)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool CDebugger::s_fTransparent = false;
+MACHINE_LOCAL bool CDebugger::s_fTransparent = false;
 
 CDebugger::CDebugger (BREAKPT* pBreak_/*=nullptr*/)
     : CDialog(nullptr, 433, 260+36+2, "")
@@ -670,6 +731,18 @@ void CDebugger::SetView (ViewType nView_)
         case vtTrc:
             pNewView = new CTrcView(this);
             break;
+
+        case vtPrf:
+            pNewView = new CPrfView(this);
+            break;
+
+        case vtHeat:
+            pNewView = new CHeatView(this);
+            break;
+
+        case vtTpl:
+            pNewView = new CTplView(this);
+            break;
     }
 
     // New view created?
@@ -837,6 +910,14 @@ bool CDebugger::OnMessage (int nMessage_, int nParam1_, int nParam2_)
                 SetView(vtHex);
                 break;
 
+            case 'p':
+                SetView(vtPrf);
+                break;
+
+            case 'e':
+                SetView(vtHeat);
+                break;
+
             case 'g':
                 SetView(vtGfx);
                 break;
@@ -881,6 +962,10 @@ bool CDebugger::OnMessage (int nMessage_, int nParam1_, int nParam2_)
                 new CInputDialog(this, "Execute until", "Expression:", OnUntilNotify);
                 break;
 
+            case 'z':
+                cmdReverse(fShift ? Reverse::RunBack() : Reverse::StepBack());
+                break;
+
             case HK_KP0:
                 IO::OutLmpr(lmpr ^ LMPR_ROM0_OFF);
                 break;
@@ -1149,6 +1234,50 @@ bool CDebugger::Execute (const char* pcszCommand_)
             fRet = false;
     }
 
+    // rs [count]
+    else if (!strcasecmp(pszCommand, "rs"))
+    {
+        if (fCommandOnly)
+            nParam = 1;
+        else if (nParam == -1 || *pszExprEnd)
+            fRet = false;
+
+        if (fRet)
+            cmdReverse(Reverse::StepBack(nParam));
+    }
+
+    // rc
+    else if (fCommandOnly && !strcasecmp(pszCommand, "rc"))
+    {
+        cmdReverse(Reverse::RunBack());
+    }
+
+    // rw addr
+    else if (!strcasecmp(pszCommand, "rw") && nParam != -1 && !*pszExprEnd)
+    {
+        cmdReverse(Reverse::RunBackToWrite(nParam));
+    }
+
+    // rev [clear]
+    else if (!strcasecmp(pszCommand, "rev"))
+    {
+        if (!strcasecmp(pszParam, "clear"))
+            Reverse::Clear();
+        else if (!fCommandOnly)
+            fRet = false;
+
+        if (fRet)
+        {
+            REVERSE_STATS s;
+            Reverse::GetStats(&s);
+
+            char sz[128];
+            snprintf(sz, sizeof(sz), "Reverse: %.1fs in %d checkpoints, %d-%d frames apart, %uK, replay %.0f fps",
+                     s.dSeconds, s.nCheckpoints, s.nMinSpacing, s.nMaxSpacing, static_cast<UINT>(s.uTotalBytes/1024), s.dReplayFps);
+            SetStatus(sz, true, &sPropFont);
+        }
+    }
+
     // bpu cond
     else if (!strcasecmp(pszCommand, "bpu") && nParam != -1 && !*pszExprEnd)
     {
@@ -1463,7 +1592,7 @@ bool CDebugger::Execute (const char* pcszCommand_)
         {
             BREAKPT *pBreak = Breakpoint::GetAt(nParam);
             if (pBreak)
-                pBreak->fEnabled = fNewState;
+                Breakpoint::SetEnabled(pBreak, fNewState);
             else
                 fRet = false;
         }
@@ -1471,7 +1600,7 @@ bool CDebugger::Execute (const char* pcszCommand_)
         {
             BREAKPT *pBreak = nullptr;
             for (int i = 0 ; (pBreak = Breakpoint::GetAt(i)) ; i++)
-                pBreak->fEnabled = fNewState;
+                Breakpoint::SetEnabled(pBreak, fNewState);
         }
         else
             fRet = false;
@@ -1584,6 +1713,103 @@ bool CDebugger::Execute (const char* pcszCommand_)
         else
             fRet = false;
     }
+
+    // trace [off|<file>|load <file>]
+    else if (!strcasecmp(pszCommand, "trace"))
+    {
+        // trace  or  trace off
+        if (fCommandOnly || !strcasecmp(pszParam, "off"))
+            TraceLog::Stop();
+
+        // trace load <file>
+        else if (!strncasecmp(pszParam, "load ", 5))
+        {
+            for (psz = pszParam+5 ; *psz == ' ' ; psz++);
+            fRet = *psz && TraceLog::Load(psz, vLoadedTrace, MAX_LOADED_TRACES);
+
+            if (fRet)
+                SetView(vtTrc);
+        }
+
+        // trace <file>
+        else
+            fRet = TraceLog::Start(pszParam);
+    }
+
+    // profile [on|off|reset|callgrind <file>|folded <file>]
+    else if (!strcasecmp(pszCommand, "profile"))
+    {
+        if (fCommandOnly)
+            SetView(vtPrf);
+        else if (!strcasecmp(pszParam, "on"))
+            Profile::Start();
+        else if (!strcasecmp(pszParam, "off"))
+            Profile::Stop();
+        else if (!strcasecmp(pszParam, "reset"))
+            Profile::Reset();
+        else if (!strncasecmp(pszParam, "callgrind ", 10) || !strncasecmp(pszParam, "folded ", 7))
+        {
+            bool fFolded = tolower(*pszParam) == 'f';
+            for (psz = strchr(pszParam, ' ') ; *psz == ' ' ; psz++);
+            fRet = *psz && Profile::Save(psz, fFolded);
+        }
+        else
+            fRet = false;
+    }
+
+    // tp n [format]
+    else if (!strcasecmp(pszCommand, "tp") && nParam != -1)
+    {
+        // Skip spaces and any quotes around the format
+        for (psz = pszExprEnd ; *psz == ' ' ; psz++);
+        size_t uLen = strlen(psz);
+        if (uLen >= 2 && *psz == '"' && psz[uLen-1] == '"')
+        {
+            psz[uLen-1] = '\0';
+            psz++;
+        }
+
+        fRet = Breakpoint::SetTrace(nParam, *psz ? psz : nullptr);
+    }
+
+    // tplog [off|clear|<file>|save <file>]
+    else if (!strcasecmp(pszCommand, "tplog"))
+    {
+        if (fCommandOnly)
+            SetView(vtTpl);
+        else if (!strcasecmp(pszParam, "off"))
+            Tracepoint::SetFile(nullptr);
+        else if (!strcasecmp(pszParam, "clear"))
+            Tracepoint::Clear();
+        else if (!strncasecmp(pszParam, "save ", 5))
+        {
+            for (psz = pszParam+5 ; *psz == ' ' ; psz++);
+            fRet = *psz && Tracepoint::Save(psz);
+        }
+        else
+            fRet = Tracepoint::SetFile(pszParam);
+    }
+
+    // heatmap [on|off|reset|save <file>|csv <file>]
+    else if (!strcasecmp(pszCommand, "heatmap"))
+    {
+        if (fCommandOnly)
+            SetView(vtHeat);
+        else if (!strcasecmp(pszParam, "on"))
+            Heatmap::Start();
+        else if (!strcasecmp(pszParam, "off"))
+            Heatmap::Stop();
+        else if (!strcasecmp(pszParam, "reset"))
+            Heatmap::Reset();
+        else if (!strncasecmp(pszParam, "save ", 5) || !strncasecmp(pszParam, "csv ", 4))
+        {
+            bool fCSV = tolower(*pszParam) == 'c';
+            for (psz = strchr(pszParam, ' ') ; *psz == ' ' ; psz++);
+            fRet = *psz && Heatmap::Save(psz, fCSV);
+        }
+        else
+            fRet = false;
+    }
     else
         fRet = false;
 
@@ -1598,8 +1824,8 @@ bool CDebugger::Execute (const char* pcszCommand_)
 #define MAX_LABEL_LEN  19
 #define BAR_CHAR_LEN   54
 
-WORD CDisView::s_wAddrs[64];
-bool CDisView::m_fUseSymbols = true;
+MACHINE_LOCAL WORD CDisView::s_wAddrs[64];
+MACHINE_LOCAL bool CDisView::m_fUseSymbols = true;
 
 CDisView::CDisView (CWindow* pParent_)
     : CView(pParent_)
@@ -1609,7 +1835,7 @@ CDisView::CDisView (CWindow* pParent_)
 
     // Calculate the number of rows and columns in the view
     m_uRows = m_nHeight / ROW_HEIGHT;
-    m_uColumns = m_nWidth / CHAR_WIDTH;
+    m_uColumns = m_nWidth / FIXED_CHAR_WIDTH;
 
     // Allocate enough for a full screen of characters, plus room for colour codes
     m_pszData = new char[m_uRows * m_uColumns * 2];
@@ -1707,12 +1933,12 @@ void CDisView::Draw (CScreen* pScreen_)
         {
             // The location bar is green for a change in code flow or yellow otherwise, with black text
             BYTE bBarColour = (m_uCodeTarget != INVALID_TARGET) ? GREEN_7 : YELLOW_7;
-            pScreen_->FillRect(nX-1, nY-1, BAR_CHAR_LEN*CHAR_WIDTH+1, ROW_HEIGHT-3, bBarColour);
+            pScreen_->FillRect(nX-1, nY-1, BAR_CHAR_LEN*FIXED_CHAR_WIDTH+1, ROW_HEIGHT-3, bBarColour);
             bColour = 'k';
 
             // Add a direction arrow if we have a code target
             if (m_uCodeTarget != INVALID_TARGET)
-                pScreen_->DrawString(nX+CHAR_WIDTH*(BAR_CHAR_LEN-1), nY, (m_uCodeTarget<=PC)?"\x80":"\x81", BLACK);
+                pScreen_->DrawString(nX+FIXED_CHAR_WIDTH*(BAR_CHAR_LEN-1), nY, (m_uCodeTarget<=PC)?"\x80":"\x81", BLACK);
         }
 
         // Check for a breakpoint at the current address.
@@ -1812,8 +2038,11 @@ void CDisView::Draw (CScreen* pScreen_)
 
     pScreen_->DrawString(nX, nY+240, "\agEvents");
 
-    CPU_EVENT *pEvent = psNextEvent;
-    for (i = 0 ; i < 3 && pEvent ; i++, pEvent = pEvent->psNext)
+    CPU_EVENT asEvents[MAX_EVENTS];
+    int nEvents = GetCpuEvents(asEvents);
+
+    CPU_EVENT *pEvent = asEvents;
+    for (i = 0 ; i < 3 && pEvent < asEvents+nEvents ; i++, pEvent++)
     {
         const char *pcszEvent = "????";
         switch (pEvent->nEvent)
@@ -2206,7 +2435,7 @@ bool CDisView::SetDataTarget ()
     // Do we have something to display?
     if (m_uDataTarget != INVALID_TARGET)
     {
-        static char sz[128];
+        static MACHINE_LOCAL char sz[128];
         m_pcszDataTarget = sz;
 
         if (f16Bit)
@@ -2288,7 +2517,7 @@ bool CTxtView::GetAddrPosition (WORD wAddr_, int &x_, int &y_)
 	if (nRow >= m_nRows)
 		return false;
 
-	x_ = m_nX + (4 + 2 + nCol) * CHAR_WIDTH;
+	x_ = m_nX + (4 + 2 + nCol) * FIXED_CHAR_WIDTH;
 	y_ = m_nY + nRow * ROW_HEIGHT;
 
 	return true;
@@ -2306,7 +2535,7 @@ void CTxtView::Draw (CScreen* pScreen_)
 		BYTE bColour = (fRead && fWrite) ? YELLOW_3 : fWrite ? RED_3 : GREEN_3;
 		if (GetAddrPosition(wAddr, nX, nY))
 		{
-			pScreen_->FillRect(nX - 1, nY - 1, CHAR_WIDTH + 1, ROW_HEIGHT - 3, bColour);
+			pScreen_->FillRect(nX - 1, nY - 1, FIXED_CHAR_WIDTH + 1, ROW_HEIGHT - 3, bColour);
 		}
 	}
 
@@ -2324,7 +2553,7 @@ void CTxtView::Draw (CScreen* pScreen_)
         BYTE b = read_byte(m_wEditAddr);
         char ch = (b >= ' ' && b <= 0x7f) ? b : '.';
 
-        pScreen_->FillRect(nX-1, nY-1, CHAR_WIDTH+1, ROW_HEIGHT-3, YELLOW_8);
+        pScreen_->FillRect(nX-1, nY-1, FIXED_CHAR_WIDTH+1, ROW_HEIGHT-3, YELLOW_8);
         pScreen_->Printf(nX, nY, "\ak%c", ch);
 
         pDebugger->SetStatusByte(m_wEditAddr);
@@ -2511,9 +2740,9 @@ bool CHexView::GetAddrPosition (WORD wAddr_, int &x_, int &y_, int &textx_)
 	if (nRow >= m_nRows)
 		return false;
 
-	x_ = m_nX + (4 + 2 + nCol * 3) * CHAR_WIDTH;
+	x_ = m_nX + (4 + 2 + nCol * 3) * FIXED_CHAR_WIDTH;
 	y_ = m_nY + ROW_HEIGHT * nRow;
-	textx_ = m_nX + (4 + 2 + HEX_COLUMNS * 3 + 1 + nCol) * CHAR_WIDTH;
+	textx_ = m_nX + (4 + 2 + HEX_COLUMNS * 3 + 1 + nCol) * FIXED_CHAR_WIDTH;
 
 	return true;
 }
@@ -2530,8 +2759,8 @@ void CHexView::Draw (CScreen* pScreen_)
 		BYTE bColour = (fRead && fWrite) ? YELLOW_3 : fWrite ? RED_3 : GREEN_3;
 		if (GetAddrPosition(wAddr, nX, nY, nTextX))
 		{
-			pScreen_->FillRect(nX - 1, nY - 1, CHAR_WIDTH * 2 + 1, ROW_HEIGHT - 3, bColour);
-			pScreen_->FillRect(nTextX - 1, nY - 1, CHAR_WIDTH + 1, ROW_HEIGHT - 3, bColour);
+			pScreen_->FillRect(nX - 1, nY - 1, FIXED_CHAR_WIDTH * 2 + 1, ROW_HEIGHT - 3, bColour);
+			pScreen_->FillRect(nTextX - 1, nY - 1, FIXED_CHAR_WIDTH + 1, ROW_HEIGHT - 3, bColour);
 		}
 	}
 	
@@ -2551,13 +2780,13 @@ void CHexView::Draw (CScreen* pScreen_)
         snprintf(sz, 3, "%02X", b);
 
 		if (m_fRightNibble)
-			nY += CHAR_WIDTH;
+			nY += FIXED_CHAR_WIDTH;
 
-        pScreen_->FillRect(nX-1, nY-1, CHAR_WIDTH+1, ROW_HEIGHT-3, YELLOW_8);
+        pScreen_->FillRect(nX-1, nY-1, FIXED_CHAR_WIDTH+1, ROW_HEIGHT-3, YELLOW_8);
         pScreen_->Printf(nX, nY, "\ak%c", sz[m_fRightNibble]);
 
         char ch = (b >= ' ' && b <= 0x7f) ? b : '.';
-        pScreen_->FillRect(nTextX-1, nY-1, CHAR_WIDTH+1, ROW_HEIGHT-3, GREY_6);
+        pScreen_->FillRect(nTextX-1, nY-1, FIXED_CHAR_WIDTH+1, ROW_HEIGHT-3, GREY_6);
         pScreen_->Printf(nTextX, nY, "\ak%c", ch);
     }
 }
@@ -2738,7 +2967,7 @@ void CMemView::Draw (CScreen* pScreen_)
 // Graphics View
 
 static const int STRIP_GAP = 8;
-UINT CGfxView::s_uMode = 4, CGfxView::s_uWidth = 8, CGfxView::s_uZoom = 1;
+MACHINE_LOCAL UINT CGfxView::s_uMode = 4, CGfxView::s_uWidth = 8, CGfxView::s_uZoom = 1;
 
 CGfxView::CGfxView (CWindow* pParent_)
     : CView(pParent_)
@@ -3019,7 +3248,7 @@ bool CBptView::OnMessage (int nMessage_, int nParam1_, int nParam2_)
             if (IsOver() && nIndex >= 0 && nIndex < m_nLines)
             {
                 BREAKPT *pBreak = Breakpoint::GetAt(nIndex);
-                pBreak->fEnabled = !pBreak->fEnabled;
+                Breakpoint::SetEnabled(pBreak, !pBreak->fEnabled);
             }
             break;
         }
@@ -3066,11 +3295,20 @@ bool CBptView::cmdNavigate (int nKey_, int nMods_)
 ////////////////////////////////////////////////////////////////////////////////
 // Trace View
 
+// Return the trace entry for a view line, from the loaded trace if there is one
+static TRACEDATA* GetTraceEntry (int nLine_, int nLines_)
+{
+    if (!vLoadedTrace.empty())
+        return &vLoadedTrace[nLine_];
+
+    return &aTrace[(nNumTraces - nLines_ + 1 + nLine_ + TRACE_SLOTS) % TRACE_SLOTS];
+}
+
 CTrcView::CTrcView (CWindow* pParent_)
     : CTextView(pParent_)
 {
-    SetText("Trace");
-    SetLines(std::min(nNumTraces,TRACE_SLOTS));
+    SetText(vLoadedTrace.empty() ? "Trace" : "Trace (log)");
+    SetLines(vLoadedTrace.empty() ? std::min(nNumTraces,TRACE_SLOTS) : static_cast<int>(vLoadedTrace.size()));
     cmdNavigate(HK_END, 0);
 }
 
@@ -3082,18 +3320,15 @@ void CTrcView::DrawLine (CScreen *pScreen_, int nX_, int nY_, int nLine_)
     {
         char szDis[32], sz[128], *psz = sz;
 
-        int nPos = (nNumTraces - GetLines() + 1 + nLine_ + TRACE_SLOTS) % TRACE_SLOTS;
-        TRACEDATA *pTD = &aTrace[nPos];
+        TRACEDATA *pTD = GetTraceEntry(nLine_, GetLines());
 
         Disassemble(pTD->abInstr, pTD->wPC, szDis, sizeof(szDis));
         psz += sprintf(psz, "%04X  %-18s", pTD->wPC, szDis);
 
         if (nLine_ != GetLines()-1)
         {
-            int nPos0 = (nPos + 0 + TRACE_SLOTS) % TRACE_SLOTS;
-            int nPos1 = (nPos + 1 + TRACE_SLOTS) % TRACE_SLOTS;
-            TRACEDATA *p0 = &aTrace[nPos0];
-            TRACEDATA *p1 = &aTrace[nPos1];
+            TRACEDATA *p0 = pTD;
+            TRACEDATA *p1 = GetTraceEntry(nLine_+1, GetLines());
 
 // Macro-tastic!
 #define CHG_S(r)	(p1->regs.r != p0->regs.r)
@@ -3119,7 +3354,7 @@ void CTrcView::DrawLine (CScreen *pScreen_, int nX_, int nY_, int nLine_)
             // Same for BC+DE+HL changing in block instructions
             else if (CHG_D(bc) && CHG_D(de) && CHG_D(hl))
             {
-                psz += sprintf(psz, "\agBC\aX->%04X \agDE\aX->%04X \agHL\aX->%04X", BC, DE, HL);
+                psz += sprintf(psz, "\agBC\aX->%04X \agDE\aX->%04X \agHL\aX->%04X", p1->regs.bc.w, p1->regs.de.w, p1->regs.hl.w);
             }
             else
             {
@@ -3179,8 +3414,7 @@ bool CTrcView::cmdNavigate (int nKey_, int nMods_)
 
 void CTrcView::OnDblClick (int nLine_)
 {
-    int nPos = (nNumTraces - GetLines() + 1 + GetTopLine() + nLine_ + TRACE_SLOTS) % TRACE_SLOTS;
-    TRACEDATA *pTD = &aTrace[nPos];
+    TRACEDATA *pTD = GetTraceEntry(GetTopLine() + nLine_, GetLines());
 
     CView::SetAddress(pTD->wPC, true);
     pDebugger->SetView(vtDis);
@@ -3189,5 +3423,294 @@ void CTrcView::OnDblClick (int nLine_)
 void CTrcView::OnDelete ()
 {
     nNumTraces = 0;
+    std::vector<TRACEDATA>().swap(vLoadedTrace);
+    SetLines(0);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Profile View
+
+#define MAX_PROFILE_ADDRS   1000
+
+MACHINE_LOCAL bool CPrfView::s_fAddrMode = false;
+
+CPrfView::CPrfView (CWindow* pParent_)
+    : CTextView(pParent_)
+{
+    Update();
+}
+
+// Refresh the profile results, by function or by instruction location
+void CPrfView::Update ()
+{
+    SetText(s_fAddrMode ? "Profile (addresses)" : "Profile (functions)");
+
+    if (s_fAddrMode)
+        Profile::GetAddresses(m_vEntries, MAX_PROFILE_ADDRS);
+    else
+        Profile::GetFunctions(m_vEntries);
+
+    m_ullTotal = Profile::GetTotal();
+
+    // The first line holds the column headings
+    SetLines(m_ullTotal ? static_cast<int>(m_vEntries.size())+1 : 0);
+    cmdNavigate(HK_HOME, 0);
+}
+
+void CPrfView::DrawLine (CScreen *pScreen_, int nX_, int nY_, int nLine_)
+{
+    char sz[128];
+
+    if (!GetLines())
+    {
+        pScreen_->DrawString(nX_, nY_, Profile::IsActive() ? "No profile data yet" : "No profile data (use: profile on)", WHITE);
+        return;
+    }
+
+    if (!nLine_)
+    {
+        if (s_fAddrMode)
+            sprintf(sz, "\agAddr  %-18s  Time%%      Count", "Location");
+        else
+            sprintf(sz, "\agAddr  %-18s  Self%%  Total%%    Calls", "Function");
+    }
+    else
+    {
+        const PROFILE_ENTRY &entry = m_vEntries[nLine_-1];
+        double dSelf = entry.ullSelf * 100.0 / m_ullTotal;
+
+        if (s_fAddrMode)
+            sprintf(sz, "%04X  %-18.18s %6.2f %10llu", entry.wAddr, entry.sName.c_str(), dSelf,
+                    static_cast<unsigned long long>(entry.ullCount));
+        else
+            sprintf(sz, "%04X  %-18.18s %6.2f %6.2f %8llu", entry.wAddr, entry.sName.c_str(), dSelf,
+                    entry.ullTotal * 100.0 / m_ullTotal, static_cast<unsigned long long>(entry.ullCount));
+    }
+
+    pScreen_->DrawString(nX_, nY_, sz, WHITE);
+}
+
+bool CPrfView::cmdNavigate (int nKey_, int nMods_)
+{
+    if (nKey_ == HK_SPACE)
+    {
+        s_fAddrMode = !s_fAddrMode;
+        Update();
+        pDebugger->SetSubTitle(GetText());
+        return true;
+    }
+
+    return CTextView::cmdNavigate(nKey_, nMods_);
+}
+
+void CPrfView::OnDblClick (int nLine_)
+{
+    int nIndex = GetTopLine() + nLine_ - 1;
+
+    if (nIndex >= 0 && nIndex < static_cast<int>(m_vEntries.size()) && m_vEntries[nIndex].nPage >= 0)
+    {
+        CView::SetAddress(m_vEntries[nIndex].wAddr, true);
+        pDebugger->SetView(vtDis);
+    }
+}
+
+void CPrfView::OnDelete ()
+{
+    Profile::Reset();
+    Update();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Tracepoint Log View
+
+CTplView::CTplView (CWindow* pParent_)
+    : CTextView(pParent_)
+{
+    SetText("Tracepoint log");
+    SetLines(static_cast<int>(Tracepoint::GetLineCount()));
+
+    // Start with the most recent lines
+    cmdNavigate(HK_END, 0);
+}
+
+void CTplView::DrawLine (CScreen *pScreen_, int nX_, int nY_, int nLine_)
+{
+    if (!GetLines())
+        pScreen_->DrawString(nX_, nY_, "No tracepoint hits (use: tp n format)", WHITE);
+    else
+        pScreen_->DrawString(nX_, nY_, Tracepoint::GetLine(nLine_), WHITE);
+}
+
+void CTplView::OnDelete ()
+{
+    Tracepoint::Clear();
     SetLines(0);
 }
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Heatmap View
+
+static const int HEAT_LINE_BYTES = 256;     // locations in each line of the map
+static const int HEAT_BLOCK_GAP = 2;        // lines between the pages shown
+
+MACHINE_LOCAL bool CHeatView::s_fCoverage = false;
+MACHINE_LOCAL int CHeatView::s_nPage = -1;
+
+// Reduce a heat value to one of 4 colour intensities
+static int HeatLevel (BYTE bHeat_)
+{
+    return !bHeat_ ? 0 : (bHeat_ < HEAT_STEP) ? 1 : (bHeat_ < 160) ? 2 : 3;
+}
+
+// Form a SAM palette colour from 2-bit red, green and blue intensities
+static BYTE HeatColour (int nRed_, int nGreen_, int nBlue_)
+{
+    return static_cast<BYTE>((nBlue_ & 1) | ((nRed_ & 1) << 1) | ((nGreen_ & 1) << 2) |
+                             ((nBlue_ & 2) << 3) | ((nRed_ & 2) << 4) | ((nGreen_ & 2) << 5));
+}
+
+CHeatView::CHeatView (CWindow* pParent_)
+    : CView(pParent_)
+{
+    SetText("Heatmap");
+    SetFont(&sFixedFont);
+}
+
+// Return the page shown in one of the 4 blocks, following the current paging unless a page was chosen
+int CHeatView::GetViewPage (int nBlock_) const
+{
+    if (s_nPage < 0)
+        return anReadPages[GetSectionPage(static_cast<eSection>(nBlock_))];
+
+    int nPage = s_nPage + nBlock_;
+    return (nPage <= ROM1) ? nPage : -1;
+}
+
+void CHeatView::SetAddress (WORD wAddr_, bool /*fForceTop_*/)
+{
+    CView::SetAddress(wAddr_);
+
+    BYTE *pb = m_abData;
+
+    for (int i = 0 ; i < 4 ; i++)
+    {
+        const HEAT_PAGE *pPage = Heatmap::GetPage(GetViewPage(i));
+
+        // Reads are shown in green, writes in red and execution in blue
+        for (int j = 0 ; j < MEM_PAGE_SIZE ; j++)
+        {
+            if (!pPage)
+                *pb++ = BLACK;
+            else if (s_fCoverage)
+            {
+                BYTE bCover = pPage->abCover[j];
+                *pb++ = HeatColour((bCover & (1 << htWrite)) ? 3 : 0, (bCover & (1 << htRead)) ? 3 : 0,
+                                   (bCover & (1 << htExec)) ? 3 : 0);
+            }
+            else
+            {
+                *pb++ = HeatColour(HeatLevel(pPage->abHeat[htWrite][j]), HeatLevel(pPage->abHeat[htRead][j]),
+                                   HeatLevel(pPage->abHeat[htExec][j]));
+            }
+        }
+    }
+
+    char sz[128]={};
+    snprintf(sz, sizeof(sz)-1, "%s  %s%s", s_fCoverage ? "Coverage" : "Recent accesses",
+             (s_nPage < 0) ? "Paged in" : "Physical pages", Heatmap::IsActive() ? "" : "  (use: heatmap on)");
+    pDebugger->SetStatus(sz, false, &sFixedFont);
+}
+
+void CHeatView::Draw (CScreen* pScreen_)
+{
+    static const int BLOCK_LINES = MEM_PAGE_SIZE / HEAT_LINE_BYTES;
+    int nX = m_nX + HEAT_LINE_BYTES + 8;
+
+    const BYTE *pb = m_abData;
+
+    for (int i = 0 ; i < 4 ; i++)
+    {
+        int nY = m_nY + i*(BLOCK_LINES+HEAT_BLOCK_GAP);
+
+        for (int j = 0 ; j < BLOCK_LINES ; j++, pb += HEAT_LINE_BYTES)
+            pScreen_->Poke(m_nX, nY+j, pb, HEAT_LINE_BYTES);
+
+        // Label the block with its address and page
+        int nPage = GetViewPage(i);
+        char sz[32];
+        snprintf(sz, sizeof(sz), "%04X %s", (s_nPage < 0) ? i*MEM_PAGE_SIZE : 0, (nPage >= 0) ? Memory::PageDesc(nPage) : "-");
+        pScreen_->DrawString(nX, nY, sz, WHITE);
+    }
+
+    // Colour key
+    static const char *aszTypes[] = { "Read", "Write", "Exec" };
+    static const BYTE abColours[] = { HeatColour(0,3,0), HeatColour(3,0,0), HeatColour(0,0,3) };
+
+    for (int i = 0 ; i < MAX_HEAT_TYPES ; i++)
+    {
+        int nY = m_nY + m_nHeight - (MAX_HEAT_TYPES-i)*ROW_HEIGHT;
+        pScreen_->FillRect(nX, nY+2, 8, 6, abColours[i]);
+        pScreen_->DrawString(nX+12, nY, aszTypes[i], WHITE);
+    }
+}
+
+bool CHeatView::OnMessage (int nMessage_, int nParam1_, int nParam2_)
+{
+    switch (nMessage_)
+    {
+        case GM_CHAR:
+            return cmdNavigate(nParam1_, nParam2_);
+
+        case GM_MOUSEWHEEL:
+            return cmdNavigate((nParam1_ < 0) ? HK_PGUP : HK_PGDN, 0);
+    }
+
+    return false;
+}
+
+bool CHeatView::cmdNavigate (int nKey_, int nMods_)
+{
+    bool fCtrl = (nMods_ & HM_CTRL) != 0;
+
+    switch (nKey_)
+    {
+        // Toggle between recent accesses and coverage
+        case HK_SPACE:
+            s_fCoverage = !s_fCoverage;
+            break;
+
+        // Home shows the paged memory, Ctrl-Home the first physical page
+        case HK_HOME:
+            s_nPage = fCtrl ? INTMEM : -1;
+            break;
+
+        // End shows the ROMs
+        case HK_END:
+            s_nPage = ROM0;
+            break;
+
+        case HK_PGUP:
+            s_nPage = (s_nPage >= 4) ? s_nPage-4 : -1;
+            break;
+
+        case HK_PGDN:
+            if (s_nPage < 0)
+                s_nPage = INTMEM;
+            else if (s_nPage+4 <= ROM1)
+                s_nPage += 4;
+            break;
+
+        case HK_DELETE:
+            Heatmap::Reset();
+            break;
+
+        default:
+            return CView::cmdNavigate(nKey_, nMods_);
+    }
+
+    SetAddress(GetAddress(), true);
+    return true;
+}
@@ -23,6 +23,7 @@
 
 #include "Breakpoint.h"
 #include "GUI.h"
+#include "Profile.h"
 #include "Screen.h"
 
 namespace Debug
@@ -37,10 +38,14 @@ namespace Debug
 
 	bool IsActive ();
 	bool IsBreakpointSet ();
+	bool IsBreakpointIndexed ();
+	bool IsBreakpointGuarded ();
 	bool BreakpointHit ();
+	bool IndexedBreakpointHit ();
+	bool GuardedBreakpointHit ();
 }
 
-enum ViewType { vtDis, vtTxt, vtHex, vtGfx, vtBpt, vtTrc };
+enum ViewType { vtDis, vtTxt, vtHex, vtGfx, vtBpt, vtTrc, vtPrf, vtHeat, vtTpl };
 
 class CView : public CWindow
 {
@@ -115,8 +120,8 @@ class CDisView : public CView
         const char *m_pcszDataTarget = nullptr;
         char *m_pszData = nullptr;
 
-        static WORD s_wAddrs[];
-        static bool m_fUseSymbols;
+        static MACHINE_LOCAL WORD s_wAddrs[];
+        static MACHINE_LOCAL bool m_fUseSymbols;
 };
 
 
@@ -205,7 +210,7 @@ class CGfxView : public CView
         UINT m_uStrips = 0, m_uStripWidth = 0, m_uStripLines = 0;
         BYTE *m_pbData = nullptr;
 
-        static UINT s_uMode, s_uWidth, s_uZoom;
+        static MACHINE_LOCAL UINT s_uMode, s_uWidth, s_uZoom;
 };
 
 class CBptView : public CView
@@ -247,6 +252,64 @@ class CTrcView final : public CTextView
         bool m_fFullMode = false;
 };
 
+class CPrfView final : public CTextView
+{
+    public:
+        CPrfView (CWindow* pParent_);
+        CPrfView (const CPrfView &) = delete;
+        void operator= (const CPrfView &) = delete;
+
+    public:
+        void DrawLine (CScreen* pScreen_, int nX_, int nY_, int nLine_) override;
+        bool cmdNavigate (int nKey_, int nMods_) override;
+        void OnDblClick (int nLine_) override;
+        void OnDelete () override;
+
+    protected:
+        void Update ();
+
+    private:
+        std::vector<PROFILE_ENTRY> m_vEntries {};
+        uint64_t m_ullTotal = 0;
+
+        static MACHINE_LOCAL bool s_fAddrMode;
+};
+
+class CTplView final : public CTextView
+{
+    public:
+        CTplView (CWindow* pParent_);
+        CTplView (const CTplView &) = delete;
+        void operator= (const CTplView &) = delete;
+
+    public:
+        void DrawLine (CScreen* pScreen_, int nX_, int nY_, int nLine_) override;
+        void OnDelete () override;
+};
+
+class CHeatView final : public CView
+{
+    public:
+        CHeatView (CWindow* pParent_);
+        CHeatView (const CHeatView &) = delete;
+        void operator= (const CHeatView &) = delete;
+
+    public:
+        void SetAddress (WORD wAddr_, bool fForceTop_=false) override;
+        void Draw (CScreen* pScreen_) override;
+        bool OnMessage (int nMessage_, int nParam1_, int nParam2_) override;
+
+    protected:
+        bool cmdNavigate (int nKey_, int nMods_) override;
+        int GetViewPage (int nBlock_) const;
+
+    private:
+        BYTE m_abData[4*MEM_PAGE_SIZE] = {};   // one pixel for each location shown
+
+        static MACHINE_LOCAL bool s_fCoverage;
+        static MACHINE_LOCAL int s_nPage;
+};
+
 
 class CDebugger final : public CDialog
 {
@@ -276,7 +339,7 @@ class CDebugger final : public CDialog
 
         std::string m_sStatus {};
 
-        static bool s_fTransparent;
+        static MACHINE_LOCAL bool s_fTransparent;
 };
 
 
@@ -69,14 +69,14 @@ static const char* aszStrings[] =
 };
 
 
-static WORD wPC = 0;
-static char szOutput[64], *pszOut;
-static BYTE bOpcode, *pbOpcode;
-static BYTE abStack[10], *pbStack;
+static MACHINE_LOCAL WORD wPC = 0;
+static MACHINE_LOCAL char szOutput[64], *pszOut;
+static MACHINE_LOCAL BYTE bOpcode, *pbOpcode;
+static MACHINE_LOCAL BYTE abStack[10], *pbStack;
 
-int nType = 0;
+MACHINE_LOCAL int nType = 0;
 
-bool fHex = true, fLowerCase = false;
+MACHINE_LOCAL bool fHex = true, fLowerCase = false;
 
 
 // Skip the rest of the [ ] block, including any nested blocks
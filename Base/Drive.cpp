@@ -27,6 +27,8 @@
 #include "Drive.h"
 
 #include "CPU.h"
+#include "Perf.h"
+#include "State.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -58,6 +60,24 @@ void CDrive::Reset ()
     m_bSide = 0;
 }
 
+// Save or restore the controller state (but not the disk contents)
+void CDrive::Serialize (CState &state_)
+{
+    state_.Section(STATE_TAG('F','D','C',' '));
+    CDiskDevice::Serialize(state_);
+
+    state_.Value(m_bSide);
+    state_.Value(m_sRegs);
+    state_.Value(m_bHeadCyl);
+    state_.Value(m_bSectorIndex);
+    state_.Value(m_abBuffer);
+    state_.Pointer(m_pbBuffer, m_abBuffer);
+    state_.Value(m_uBuffer);
+    state_.Value(m_bDataStatus);
+    state_.Value(m_nState);
+    state_.Value(m_nMotorDelay);
+}
+
 // Insert a new disk from the named source (usually a file)
 bool CDrive::Insert (const char* pcszSource_, bool fAutoLoad_)
 {
@@ -97,7 +117,10 @@ void CDrive::FrameEnd ()
 
         // Close any real floppy device to ensure any changes are flushed
         if (m_pDisk)
+        {
+            CPerfScope perf(ptDisk);
             m_pDisk->Flush();
+        }
     }
 }
 
@@ -279,7 +302,7 @@ BYTE CDrive::In (WORD wPort_)
                         bRet |= SPIN_UP;
 
                     // Toggle the index pulse status bit periodically to show the disk is spinning
-                    static int n = 0;
+                    static MACHINE_LOCAL int n = 0;
                     if (IsMotorOn() && !(++n % 1024))   // FIXME: use an event for the correct index timing
                         bRet |= INDEX_PULSE;
                 }
@@ -289,8 +312,8 @@ BYTE CDrive::In (WORD wPort_)
             // SAM DICE uses a deliberate READ_ADDRESS data timeout as a synchronisation mechanism.
             else if (m_uBuffer)
             {
-				static int nDataTimeout = 0;
-				static UINT uLastBuffer = 0;
+				static MACHINE_LOCAL int nDataTimeout = 0;
+				static MACHINE_LOCAL UINT uLastBuffer = 0;
 
                 // Clear busy after 16 polls of the status port
                 if (uLastBuffer != m_uBuffer)
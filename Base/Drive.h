@@ -47,6 +47,7 @@ class CDrive final : public CDiskDevice
         BYTE In (WORD wPort_) override;
         void Out (WORD wPort_, BYTE bVal_) override;
         void FrameEnd () override;
+        void Serialize (CState &state_) override;
 
     public:
         bool Insert (const char* pcszSource_, bool fAutoLoad_=false) override;
@@ -0,0 +1,949 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Dynarec.cpp: Dynamic recompiler for hot Z80 code blocks
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  Executions are counted for each physical code address, and once an
+//  address is hot the run of instructions from it up to the next unconditional
+//  change of flow is translated to x86-64 code, with conditional branches
+//  leaving the block when taken.  The generated code makes the same
+//  register, timing and contention updates as the interpreter.  Common
+//  register, ALU and jump instructions are generated inline, and everything
+//  else calls back into the interpreter for that one instruction.
+//
+//  Events and interrupts are only handled by the main loop, so a block exits
+//  as soon as an instruction reaches the next event time.  Instructions that
+//  may change the interrupt or event state (I/O, EI/DI, HALT) end a block.
+//
+//  Blocks are found by physical address, so paging changes select different
+//  blocks without needing any invalidation.  Each block checks its code
+//  bytes, logical address and contention on entry, and leaves early if it
+//  writes to its own code, so modified code is recompiled when next reached.
+
+#include "SimCoupe.h"
+#include "Dynarec.h"
+
+#ifdef USE_DYNAREC
+
+#include <cpuid.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <initializer_list>
+#include <vector>
+
+#include "CPU.h"
+#include "Memory.h"
+
+// Interpreter state from CPU.cpp
+extern MACHINE_LOCAL BYTE bOpcode;
+extern MACHINE_LOCAL WORD *pHlIxIy, *pNewHlIxIy;
+
+const BYTE HOT_COUNT = 32;                  // executions of an address before it's compiled
+const int MAX_BLOCK_STEPS = 64;             // longest block, with prefixes counting as steps
+const size_t CODE_SIZE = 8*1024*1024;       // executable buffer, flushed when full
+const size_t MAX_BLOCK_CODE = 256*MAX_BLOCK_STEPS;  // upper bound on the code for one block
+
+// x86 conditional jump opcodes (second byte)
+const BYTE JB = 0x82, JAE = 0x83, JZ = 0x84, JNZ = 0x85;
+
+typedef bool (*PFNBLOCK)(const BYTE *pbContention_, DWORD dwDeadline_);
+
+// Compiled blocks and execution counts for one physical memory page
+typedef struct
+{
+    PFNBLOCK apfnBlocks[MEM_PAGE_SIZE];
+    BYTE abCounts[MEM_PAGE_SIZE];
+}
+DYNAREC_PAGE;
+
+// One interpreter step, which is an instruction or a lone index prefix
+typedef struct
+{
+    WORD wPC;               // address of the opcode
+    BYTE bOpcode;           // opcode, which is the CB or ED prefix for those sets
+    BYTE bLen;              // length including operands
+    WORD *pHlIxIy;          // index register in use
+    bool fNative;           // generated inline rather than interpreted
+    bool fWrite;            // may write to memory
+    bool fBranch;           // may change PC, with the block continuing only if it doesn't
+}
+STEP;
+
+// Interpreter state to store when leaving a block
+typedef struct
+{
+    BYTE *pbJump;           // jump to patch with the exit code address
+    bool fPC;               // store PC?
+    WORD wPC;
+    BYTE bR;                // R increments still to apply
+    WORD *pHlIxIy, *pNewHlIxIy;
+    WORD *pHlIxIyMem;       // pHlIxIy value already in memory
+    bool fOpcode;           // store bOpcode?
+    BYTE bOpcode;
+}
+EXIT;
+
+#define REG(r)  static_cast<BYTE>(offsetof(Z80Regs, r))
+
+// Register offsets for the 3-bit register field in opcodes, with (hl) unused
+static const BYTE abRegs[8] = { REG(bc.b.h), REG(bc.b.l), REG(de.b.h), REG(de.b.l), REG(hl.b.h), REG(hl.b.l), 0, REG(af.b.h) };
+static const BYTE abRegPairs[4] = { REG(bc.w), REG(de.w), REG(hl.w), REG(sp.w) };
+static const BYTE REG_A = REG(af.b.h), REG_F = REG(af.b.l);
+
+static MACHINE_LOCAL PFNEXECUTEOP pfnExecuteOp;
+static MACHINE_LOCAL BYTE *pbCodeBase, *pbCodeNext;
+static MACHINE_LOCAL DYNAREC_PAGE *apPages[TOTAL_PAGES];
+
+// Compiler state
+static MACHINE_LOCAL BYTE *pb;                // code write position
+static MACHINE_LOCAL int nCycles;             // T-states not yet added to the cycle register
+static MACHINE_LOCAL int nR;                  // R increments not yet applied
+static MACHINE_LOCAL bool fContended;         // code section is contended
+static MACHINE_LOCAL WORD *pHlIxIyMem;        // pHlIxIy value known to be in memory, or nullptr
+static MACHINE_LOCAL std::vector<EXIT> vExits;
+static MACHINE_LOCAL std::vector<BYTE*> vMisses;
+
+
+// Marks addresses that aren't worth compiling
+static bool NoBlock (const BYTE * /*pbContention_*/, DWORD /*dwDeadline_*/)
+{
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Instruction decoding
+
+// Number of operand bytes following an unprefixed opcode
+static int OperandBytes (BYTE bOp_)
+{
+    if ((bOp_ & 0xc7) == 0x06 || (bOp_ & 0xc7) == 0xc6 || ((bOp_ & 0xc7) == 0x00 && bOp_ >= 0x10) ||
+         bOp_ == 0xd3 || bOp_ == 0xdb)
+        return 1;
+
+    if ((bOp_ & 0xcf) == 0x01 || (bOp_ & 0xe7) == 0x22 || (bOp_ & 0xc7) == 0xc2 || (bOp_ & 0xc7) == 0xc4 ||
+         bOp_ == 0xc3 || bOp_ == 0xcd)
+        return 2;
+
+    return 0;
+}
+
+// Does an opcode use (hl), which takes a displacement when indexed?
+static bool UsesHL (BYTE bOp_)
+{
+    return bOp_ == 0x34 || bOp_ == 0x35 || bOp_ == 0x36 || (bOp_ & 0xc7) == 0x86 ||
+          ((bOp_ & 0xc0) == 0x40 && bOp_ != 0x76 && ((bOp_ & 7) == 6 || (bOp_ & 0x38) == 0x30));
+}
+
+// Does an opcode always change the flow of execution, or change the interrupt or event state?
+static bool EndsBlock (BYTE bOp_)
+{
+    switch (bOp_)
+    {
+        case 0x18: case 0xc3: case 0xcd: case 0xc9: case 0xe9:     // jr, jp, call, ret, jp (hl)
+        case 0xc8:                                                  // ret z, which has ROM traps
+        case 0x76: case 0xd3: case 0xdb: case 0xf3: case 0xfb:     // halt, out, in, di, ei
+            return true;
+    }
+
+    return (bOp_ & 0xc7) == 0xc7;       // rst
+}
+
+// Does an opcode conditionally change the flow of execution?
+static bool IsBranch (BYTE bOp_)
+{
+    return bOp_ == 0x10 || (bOp_ & 0xe7) == 0x20 ||                 // djnz, jr cc
+          (bOp_ & 0xc7) == 0xc0 || (bOp_ & 0xc7) == 0xc2 || (bOp_ & 0xc7) == 0xc4;   // ret cc, jp cc, call cc
+}
+
+// Can an opcode write to memory?
+static bool WritesMemory (BYTE bOp_)
+{
+    return bOp_ == 0x02 || bOp_ == 0x12 || bOp_ == 0x22 || bOp_ == 0x32 ||
+           bOp_ == 0x34 || bOp_ == 0x35 || bOp_ == 0x36 || (bOp_ >= 0x70 && bOp_ <= 0x77 && bOp_ != 0x76) ||
+          (bOp_ & 0xcf) == 0xc5 || bOp_ == 0xe3;
+}
+
+// Can an unprefixed opcode be generated inline?
+static bool IsNative (BYTE bOp_)
+{
+    switch (bOp_)
+    {
+        case 0x00: case 0x08: case 0xd9: case 0xeb:                     // nop, ex af,af', exx, ex de,hl
+        case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // djnz, jr, jr cc
+        case 0xc3:                                                      // jp nn
+            return true;
+    }
+
+    if ((bOp_ & 0xcf) == 0x01 || (bOp_ & 0xc7) == 0x03)                // ld rr,nn ; inc/dec rr
+        return true;
+
+    if ((bOp_ & 0xc6) == 0x04 || (bOp_ & 0xc7) == 0x06)                 // inc/dec r ; ld r,n
+        return bOp_ < 0x30 || bOp_ >= 0x38;
+
+    if ((bOp_ & 0xc0) == 0x40)                                          // ld r,r'
+        return (bOp_ & 7) != 6 && (bOp_ & 0x38) != 0x30;
+
+    if ((bOp_ & 0xc0) == 0x80)                                          // alu r
+        return (bOp_ & 7) != 6;
+
+    return (bOp_ & 0xc7) == 0xc6 || (bOp_ & 0xc7) == 0xc2;             // alu n ; jp cc,nn
+}
+
+// Decode the step at the supplied code, returning its length, or 0 if it doesn't fit
+static int DecodeStep (const BYTE *pb_, int nAvail_, STEP &s_, bool &fEnd_)
+{
+    bool fIndexed = s_.pHlIxIy != &HL;
+    BYTE bOp = s_.bOpcode = pb_[0];
+    int nLen = 1;
+
+    s_.fNative = s_.fWrite = s_.fBranch = fEnd_ = false;
+
+    if (bOp == IX_PREFIX || bOp == IY_PREFIX)
+        s_.fNative = true;
+    else if (bOp == CB_PREFIX)
+    {
+        nLen = fIndexed ? 3 : 2;
+        if (nLen > nAvail_)
+            return 0;
+
+        // Everything but bit writes back, and only (hl) and indexed forms touch memory
+        BYTE bOp2 = pb_[nLen-1];
+        s_.fWrite = (bOp2 & 0xc0) != 0x40 && (fIndexed || (bOp2 & 7) == 6);
+    }
+    else if (bOp == ED_PREFIX)
+    {
+        if (nAvail_ < 2)
+            return 0;
+
+        BYTE bOp2 = pb_[1];
+        nLen = ((bOp2 & 0xc7) == 0x43) ? 4 : 2;
+        s_.fWrite = (bOp2 & 0xc7) == 0x43 || bOp2 == 0x67 || bOp2 == 0x6f || (bOp2 & 0xe7) == 0xa0;
+
+        // I/O (including the block forms) and retn/reti end the block, and the repeating block instructions may loop
+        fEnd_ = ((bOp2 & 0xc0) == 0x40 && (bOp2 & 7) <= 1) || ((bOp2 & 0xe4) == 0xa0 && (bOp2 & 2)) || (bOp2 & 0xc7) == 0x45;
+        s_.fBranch = (bOp2 & 0xf4) == 0xb0;
+    }
+    else
+    {
+        nLen += OperandBytes(bOp) + (fIndexed && UsesHL(bOp));
+        s_.fNative = !fIndexed && IsNative(bOp);
+        s_.fWrite = WritesMemory(bOp);
+        s_.fBranch = IsBranch(bOp);
+        fEnd_ = EndsBlock(bOp);
+    }
+
+    if (nLen > nAvail_)
+        return 0;
+
+    s_.bLen = static_cast<BYTE>(nLen);
+    return nLen;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Code generation
+//
+// Register use in generated code:
+//  rbx = &regs, r12d = cycle counter, r13 = contention table, r14d = next event time,
+//  r15 = &g_dwCycleCounter, with rax/rcx/rdx/rdi as scratch.
+
+static inline void Emit (std::initializer_list<BYTE> l_)
+{
+    for (BYTE b : l_)
+        *pb++ = b;
+}
+
+template <typename T>
+static inline void EmitValue (T t_)
+{
+    memcpy(pb, &t_, sizeof(t_));
+    pb += sizeof(t_);
+}
+
+static inline void EmitPtr (const void *pv_)
+{
+    EmitValue(reinterpret_cast<uint64_t>(pv_));
+}
+
+// Emit a jump, returning the location of the offset for patching
+static BYTE *EmitJump (BYTE bCondition_=0)
+{
+    if (bCondition_)
+        Emit({ 0x0f, bCondition_ });
+    else
+        Emit({ 0xe9 });
+
+    BYTE *pbRel = pb;
+    EmitValue<int32_t>(0);
+    return pbRel;
+}
+
+static void PatchJump (BYTE *pbRel_, const BYTE *pbTarget_)
+{
+    int32_t nRel = static_cast<int32_t>(pbTarget_ - (pbRel_ + sizeof(int32_t)));
+    memcpy(pbRel_, &nRel, sizeof(nRel));
+}
+
+// Store a pointer value to a global variable
+static void EmitStorePtr (void *pvVar_, const void *pvValue_)
+{
+    Emit({ 0x48, 0xb8 }); EmitPtr(pvValue_);    // mov rax,value
+    Emit({ 0x48, 0xb9 }); EmitPtr(pvVar_);      // mov rcx,var
+    Emit({ 0x48, 0x89, 0x01 });                 // mov [rcx],rax
+}
+
+static void EmitStorePC (WORD wPC_)
+{
+    Emit({ 0x66, 0xc7, 0x43, REG(pc.w) });      // mov word [rbx+pc],n
+    EmitValue(wPC_);
+}
+
+// Add any pending T-states to the cycle counter
+static void FlushCycles ()
+{
+    if (nCycles)
+    {
+        if (nCycles < 0x80)
+            Emit({ 0x41, 0x83, 0xc4, static_cast<BYTE>(nCycles) }); // add r12d,n
+        else
+        {
+            Emit({ 0x41, 0x81, 0xc4 });
+            EmitValue<DWORD>(nCycles);
+        }
+
+        nCycles = 0;
+    }
+}
+
+// Add any pending increments to R
+static void FlushR ()
+{
+    if (nR & 0xff)
+        Emit({ 0x80, 0x43, REG(r), static_cast<BYTE>(nR) });       // add byte [rbx+r],n
+
+    nR = 0;
+}
+
+// Time a memory access in the code section, matching MEM_ACCESS()
+static void CodeAccess ()
+{
+    nCycles += 3;
+
+    if (fContended)
+    {
+        FlushCycles();
+        Emit({ 0x43, 0x0f, 0xb6, 0x44, 0x25, 0x00 });   // movzx eax,byte [r13+r12]
+        Emit({ 0x41, 0x01, 0xc4 });                     // add r12d,eax
+    }
+}
+
+// Interpreter state after the supplied step
+static EXIT StepExit (const STEP &s_)
+{
+    EXIT e;
+    e.pbJump = nullptr;
+    e.fPC = s_.fNative;     // interpreted instructions leave PC correct
+    e.wPC = s_.wPC + s_.bLen;
+    e.bR = static_cast<BYTE>(nR);
+    e.pHlIxIy = s_.pHlIxIy;
+    e.pNewHlIxIy = (s_.bOpcode == IX_PREFIX && s_.fNative) ? &IX : (s_.bOpcode == IY_PREFIX && s_.fNative) ? &IY : &HL;
+    e.pHlIxIyMem = pHlIxIyMem;
+    e.fOpcode = s_.fNative;
+    e.bOpcode = s_.bOpcode;
+    return e;
+}
+
+// Conditional jump to an exit that leaves the state after the supplied step
+static void EmitExitJump (const STEP &s_, BYTE bCondition_)
+{
+    EXIT e = StepExit(s_);
+    e.pbJump = EmitJump(bCondition_);
+    vExits.push_back(e);
+}
+
+static void EmitExitState (const EXIT &e_)
+{
+    if (e_.fPC)
+        EmitStorePC(e_.wPC);
+
+    if (e_.bR)
+        Emit({ 0x80, 0x43, REG(r), e_.bR });
+
+    if (e_.pHlIxIy != e_.pHlIxIyMem)
+        EmitStorePtr(&pHlIxIy, e_.pHlIxIy);
+
+    if (e_.pNewHlIxIy != &HL)
+        EmitStorePtr(&pNewHlIxIy, e_.pNewHlIxIy);
+
+    if (e_.fOpcode)
+    {
+        Emit({ 0x48, 0xb9 }); EmitPtr(&bOpcode);    // mov rcx,&bOpcode
+        Emit({ 0xc6, 0x01, e_.bOpcode });           // mov byte [rcx],n
+    }
+}
+
+// Build F from LAHF in AH, SETO in CL and bits 5+3 in DL
+static void EmitFlags (BYTE bHostMask_, bool fOverflow_, bool fKeepCarry_, BYTE bSet_)
+{
+    Emit({ 0x80, 0xe2, 0x28 });                     // and dl,0x28
+    Emit({ 0x80, 0xe4, bHostMask_ });               // and ah,mask
+    Emit({ 0x08, 0xe2 });                           // or dl,ah
+
+    if (fOverflow_)
+        Emit({ 0xc0, 0xe1, 0x02, 0x08, 0xca });     // shl cl,2 ; or dl,cl
+
+    if (fKeepCarry_)
+        Emit({ 0x8a, 0x43, REG_F, 0x24, 0x01, 0x08, 0xc2 });   // mov al,[F] ; and al,1 ; or dl,al
+
+    if (bSet_)
+        Emit({ 0x80, 0xca, bSet_ });                // or dl,n
+
+    Emit({ 0x88, 0x53, REG_F });                    // mov [F],dl
+}
+
+// 8-bit arithmetic and logic on A, with a register source (0-7) or immediate (-1)
+static void EmitAlu (int nOp_, int nReg_, BYTE bImm_)
+{
+    static const BYTE abRegOps[] = { 0x02, 0x12, 0x2a, 0x1a, 0x22, 0x32, 0x0a, 0x3a };
+    static const BYTE abImmOps[] = { 0x04, 0x14, 0x2c, 0x1c, 0x24, 0x34, 0x0c, 0x3c };
+
+    // cp takes bits 5+3 from the operand rather than the result
+    if (nOp_ == 7)
+    {
+        Emit({ 0x8a, 0x43, REG_A });                // mov al,[A]
+        if (nReg_ >= 0)
+            Emit({ 0x8a, 0x53, abRegs[nReg_] });    // mov dl,[r]
+        else
+            Emit({ 0xb2, bImm_ });                  // mov dl,n
+        Emit({ 0x38, 0xd0 });                       // cmp al,dl
+        Emit({ 0x9f, 0x0f, 0x90, 0xc1 });           // lahf ; seto cl
+        EmitFlags(0xd1, true, false, FLAG_N);
+        return;
+    }
+
+    bool fCarryIn = nOp_ == 1 || nOp_ == 3, fArith = nOp_ < 4;
+
+    if (fCarryIn)
+        Emit({ 0x8a, 0x4b, REG_F });                // mov cl,[F]
+    Emit({ 0x8a, 0x43, REG_A });                    // mov al,[A]
+    if (fCarryIn)
+        Emit({ 0xd0, 0xe9 });                       // shr cl,1
+
+    if (nReg_ >= 0)
+        Emit({ abRegOps[nOp_], 0x43, abRegs[nReg_] });
+    else
+        Emit({ abImmOps[nOp_], bImm_ });
+
+    Emit({ 0x9f });                                 // lahf
+    if (fArith)
+        Emit({ 0x0f, 0x90, 0xc1 });                 // seto cl
+    Emit({ 0x88, 0x43, REG_A, 0x88, 0xc2 });        // mov [A],al ; mov dl,al
+
+    if (fArith)
+        EmitFlags(0xd1, true, false, (nOp_ >= 2) ? FLAG_N : 0);
+    else
+        EmitFlags(0xc4, false, false, (nOp_ == 4) ? FLAG_H : 0);
+}
+
+// Test a condition (0-7 = nz,z,nc,c,po,pe,p,m), returning a jump taken if it's false
+static BYTE *EmitCondition (int nCondition_)
+{
+    static const BYTE abMasks[] = { FLAG_Z, FLAG_Z, FLAG_C, FLAG_C, FLAG_P, FLAG_P, FLAG_S, FLAG_S };
+    Emit({ 0xf6, 0x43, REG_F, abMasks[nCondition_] });     // test byte [F],mask
+    return EmitJump((nCondition_ & 1) ? JZ : JNZ);
+}
+
+// Set PC for a conditional branch, with optional extra T-states when it's taken
+static void EmitBranch (const STEP &s_, bool fLast_, BYTE *pbNotTaken_, WORD wTarget_, int nTakenCycles_)
+{
+    if (nTakenCycles_)
+        Emit({ 0x41, 0x83, 0xc4, static_cast<BYTE>(nTakenCycles_) });  // add r12d,n
+    EmitStorePC(wTarget_);
+
+    // Mid-block branches leave the block when taken, and carry on when not
+    if (!fLast_)
+    {
+        EXIT e = StepExit(s_);
+        e.fPC = false;
+        e.pbJump = EmitJump();
+        vExits.push_back(e);
+
+        PatchJump(pbNotTaken_, pb);
+        return;
+    }
+
+    BYTE *pbDone = EmitJump();
+    PatchJump(pbNotTaken_, pb);
+    EmitStorePC(s_.wPC + s_.bLen);
+    PatchJump(pbDone, pb);
+}
+
+static void EmitSwap16 (BYTE bReg1_, BYTE bReg2_)
+{
+    Emit({ 0x66, 0x8b, 0x43, bReg1_, 0x66, 0x8b, 0x4b, bReg2_ });     // mov ax,[r1] ; mov cx,[r2]
+    Emit({ 0x66, 0x89, 0x4b, bReg1_, 0x66, 0x89, 0x43, bReg2_ });     // mov [r1],cx ; mov [r2],ax
+}
+
+// Generate an instruction inline, after its opcode fetch, returning true if it set PC
+static bool EmitNative (const STEP &s_, const BYTE *pbOp_, bool fLast_)
+{
+    BYTE ab[4] = {};
+    memcpy(ab, pbOp_, s_.bLen);
+
+    BYTE bOp = s_.bOpcode, bOperand = ab[1];
+    WORD wOperand = ab[1] | (ab[2] << 8), wNext = s_.wPC + s_.bLen;
+    int nDst = (bOp >> 3) & 7, nSrc = bOp & 7;
+
+    // All native instructions have a 4 T-state first M-cycle, except those adjusted below
+    nCycles++;
+
+    switch (bOp)
+    {
+        case IX_PREFIX: case IY_PREFIX:
+        case 0x00:                              // nop
+            return false;
+
+        case 0x08:                              // ex af,af'
+            EmitSwap16(REG(af.w), REG(af_.w));
+            return false;
+
+        case 0xd9:                              // exx
+            EmitSwap16(REG(bc.w), REG(bc_.w));
+            EmitSwap16(REG(de.w), REG(de_.w));
+            EmitSwap16(REG(hl.w), REG(hl_.w));
+            return false;
+
+        case 0xeb:                              // ex de,hl
+            EmitSwap16(REG(de.w), REG(hl.w));
+            return false;
+
+        case 0x10:                              // djnz e
+        {
+            nCycles++;
+            CodeAccess();
+            FlushCycles();
+            Emit({ 0xfe, 0x4b, abRegs[0] });    // dec byte [B]
+            EmitBranch(s_, fLast_, EmitJump(JZ), wNext + static_cast<signed char>(bOperand), 5);
+            return fLast_;
+        }
+
+        case 0x18:                              // jr e
+            CodeAccess();
+            nCycles += 5;
+            EmitStorePC(wNext + static_cast<signed char>(bOperand));
+            return true;
+
+        case 0x20: case 0x28: case 0x30: case 0x38: // jr cc,e
+            CodeAccess();
+            FlushCycles();
+            EmitBranch(s_, fLast_, EmitCondition(nDst & 3), wNext + static_cast<signed char>(bOperand), 5);
+            return fLast_;
+
+        case 0xc3:                              // jp nn
+            CodeAccess();
+            CodeAccess();
+            EmitStorePC(wOperand);
+            return true;
+    }
+
+    if ((bOp & 0xc7) == 0xc2)                   // jp cc,nn
+    {
+        CodeAccess();
+        CodeAccess();
+        FlushCycles();
+        EmitBranch(s_, fLast_, EmitCondition(nDst), wOperand, 0);
+        return fLast_;
+    }
+
+    if ((bOp & 0xcf) == 0x01)                   // ld rr,nn
+    {
+        CodeAccess();
+        CodeAccess();
+        Emit({ 0x66, 0xc7, 0x43, abRegPairs[bOp >> 4] });
+        EmitValue(wOperand);
+    }
+    else if ((bOp & 0xc7) == 0x03)              // inc/dec rr
+    {
+        nCycles += 2;
+        Emit({ 0x66, 0xff, static_cast<BYTE>((bOp & 0x08) ? 0x4b : 0x43), abRegPairs[bOp >> 4] });
+    }
+    else if ((bOp & 0xc6) == 0x04)              // inc/dec r
+    {
+        bool fDec = (bOp & 1) != 0;
+        Emit({ 0x8a, 0x43, abRegs[nDst] });                         // mov al,[r]
+        Emit({ 0xfe, static_cast<BYTE>(fDec ? 0xc8 : 0xc0) });      // inc/dec al
+        Emit({ 0x9f, 0x0f, 0x90, 0xc1 });                           // lahf ; seto cl
+        Emit({ 0x88, 0x43, abRegs[nDst], 0x88, 0xc2 });             // mov [r],al ; mov dl,al
+        EmitFlags(0xd0, true, true, fDec ? FLAG_N : 0);
+    }
+    else if ((bOp & 0xc7) == 0x06)              // ld r,n
+    {
+        CodeAccess();
+        Emit({ 0xc6, 0x43, abRegs[nDst], bOperand });
+    }
+    else if ((bOp & 0xc0) == 0x40)              // ld r,r'
+    {
+        if (nDst != nSrc)
+            Emit({ 0x8a, 0x43, abRegs[nSrc], 0x88, 0x43, abRegs[nDst] });
+    }
+    else if ((bOp & 0xc0) == 0x80)              // alu r
+        EmitAlu(nDst, nSrc, 0);
+    else if ((bOp & 0xc7) == 0xc6)              // alu n
+    {
+        CodeAccess();
+        EmitAlu(nDst, -1, bOperand);
+    }
+
+    return false;
+}
+
+// Call the interpreter for a single instruction, after its opcode fetch
+static void EmitInterpreted (const STEP &s_, bool fLast_)
+{
+    bool fCheckWrite = s_.fWrite && !fLast_;
+
+    FlushCycles();
+    Emit({ 0x45, 0x89, 0x27 });                 // mov [r15],r12d
+    EmitStorePC(s_.wPC + 1);
+    FlushR();
+
+    if (pHlIxIyMem != s_.pHlIxIy)
+    {
+        EmitStorePtr(&pHlIxIy, s_.pHlIxIy);
+        pHlIxIyMem = s_.pHlIxIy;
+    }
+
+    // Clear the write tracking so we can tell if the block code is written
+    if (fCheckWrite)
+    {
+        Emit({ 0x31, 0xc0 });                                       // xor eax,eax
+        Emit({ 0x48, 0xb9 }); EmitPtr(&pbMemWrite1);
+        Emit({ 0x48, 0x89, 0x01 });                                 // mov [rcx],rax
+        Emit({ 0x48, 0xb9 }); EmitPtr(&pbMemWrite2);
+        Emit({ 0x48, 0x89, 0x01 });
+    }
+
+    Emit({ 0xbf }); EmitValue<DWORD>(s_.bOpcode);                   // mov edi,opcode
+    Emit({ 0x48, 0xb8 }); EmitPtr(reinterpret_cast<void*>(pfnExecuteOp));
+    Emit({ 0xff, 0xd0 });                                           // call rax
+    Emit({ 0x45, 0x8b, 0x27 });                                     // mov r12d,[r15]
+}
+
+// Leave the block if the last instruction wrote anywhere in its code
+static void EmitWriteCheck (const STEP &s_, const BYTE *pbCode_, size_t uLen_)
+{
+    BYTE **appbWrites[] = { &pbMemWrite1, &pbMemWrite2 };
+
+    for (auto ppbWrite : appbWrites)
+    {
+        Emit({ 0x48, 0xb9 }); EmitPtr(ppbWrite);
+        Emit({ 0x48, 0x8b, 0x01 });                                 // mov rax,[rcx]
+        Emit({ 0x48, 0xba }); EmitPtr(pbCode_);
+        Emit({ 0x48, 0x29, 0xd0 });                                 // sub rax,rdx
+        Emit({ 0x48, 0x3d }); EmitValue<DWORD>(static_cast<DWORD>(uLen_));   // cmp rax,len
+        EmitExitJump(s_, JB);
+    }
+}
+
+// Compile the block starting at the supplied code, or return nullptr if it's not worth it
+static PFNBLOCK Compile (const BYTE *pbCode_, WORD wPC_)
+{
+    STEP asSteps[MAX_BLOCK_STEPS];
+    int nSteps = 0, nAvail = MEM_PAGE_SIZE - PtrOffset(pbCode_);
+    size_t uLen = 0;
+    WORD *pHl = &HL;
+
+    // Decode up to the next unconditional change of flow, staying within the code page
+    while (nSteps < MAX_BLOCK_STEPS)
+    {
+        STEP &s = asSteps[nSteps];
+        bool fEnd;
+
+        s.wPC = wPC_ + static_cast<WORD>(uLen);
+        s.pHlIxIy = pHl;
+        if (uLen >= static_cast<size_t>(nAvail) || !DecodeStep(pbCode_ + uLen, nAvail - static_cast<int>(uLen), s, fEnd))
+            break;
+
+        uLen += s.bLen;
+        nSteps++;
+
+        if (s.bOpcode == IX_PREFIX || s.bOpcode == IY_PREFIX)
+            pHl = (s.bOpcode == IX_PREFIX) ? &IX : &IY;
+        else
+            pHl = &HL;
+
+        if (fEnd)
+            break;
+    }
+
+    // Single instructions are left to the interpreter, as they can't cover the entry cost
+    if (nSteps < 2)
+        return nullptr;
+
+    // Make space for the new block, discarding all others if necessary
+    if (static_cast<size_t>(pbCodeBase + CODE_SIZE - pbCodeNext) < MAX_BLOCK_CODE)
+    {
+        for (auto pPage : apPages)
+        {
+            if (pPage)
+                memset(pPage, 0, sizeof(*pPage));
+        }
+
+        pbCodeNext = pbCodeBase;
+    }
+
+    pb = pbCodeNext;
+    nCycles = nR = 0;
+    fContended = afSectionContended[AddrSection(wPC_)];
+    pHlIxIyMem = nullptr;
+    vExits.clear();
+    vMisses.clear();
+
+    BYTE *pbEntry = pb;
+
+    // Check the code is unchanged, using only scratch registers
+    Emit({ 0x48, 0xba }); EmitPtr(pbCode_);                         // mov rdx,code
+    for (size_t u = 0, uChunk ; u < uLen ; u += uChunk)
+    {
+        size_t uLeft = uLen - u;
+        int32_t nDisp = static_cast<int32_t>(u);
+
+        if (uLeft >= 8)
+        {
+            uint64_t qw; memcpy(&qw, pbCode_+u, 8);
+            Emit({ 0x48, 0xb8 }); EmitValue(qw);                    // mov rax,n
+            Emit({ 0x48, 0x39, 0x82 }); EmitValue(nDisp);           // cmp [rdx+u],rax
+            uChunk = 8;
+        }
+        else if (uLeft >= 4)
+        {
+            DWORD dw; memcpy(&dw, pbCode_+u, 4);
+            Emit({ 0x81, 0xba }); EmitValue(nDisp); EmitValue(dw);  // cmp dword [rdx+u],n
+            uChunk = 4;
+        }
+        else if (uLeft >= 2)
+        {
+            WORD w; memcpy(&w, pbCode_+u, 2);
+            Emit({ 0x66, 0x81, 0xba }); EmitValue(nDisp); EmitValue(w);
+            uChunk = 2;
+        }
+        else
+        {
+            Emit({ 0x80, 0xba }); EmitValue(nDisp); EmitValue(pbCode_[u]);
+            uChunk = 1;
+        }
+
+        vMisses.push_back(EmitJump(JNZ));
+    }
+
+    // Check the logical address and contention, which depend on the paging
+    Emit({ 0x48, 0xb8 }); EmitPtr(&PC);
+    Emit({ 0x66, 0x81, 0x38 }); EmitValue(wPC_);                   // cmp word [rax],pc
+    vMisses.push_back(EmitJump(JNZ));
+    Emit({ 0x48, 0xb8 }); EmitPtr(&afSectionContended[AddrSection(wPC_)]);
+    Emit({ 0x80, 0x38, static_cast<BYTE>(fContended) });           // cmp byte [rax],n
+    vMisses.push_back(EmitJump(JNZ));
+
+    Emit({ 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 }); // push rbx,r12-r15
+    Emit({ 0x48, 0xbb }); EmitPtr(&regs);                           // mov rbx,&regs
+    Emit({ 0x49, 0xbf }); EmitPtr(&g_dwCycleCounter);               // mov r15,&g_dwCycleCounter
+    Emit({ 0x49, 0x89, 0xfd });                                     // mov r13,rdi
+    Emit({ 0x41, 0x89, 0xf6 });                                     // mov r14d,esi
+    Emit({ 0x45, 0x8b, 0x27 });                                     // mov r12d,[r15]
+
+    bool fSetPC = false;
+
+    for (int i = 0 ; i < nSteps ; i++)
+    {
+        const STEP &s = asSteps[i];
+        bool fLast = i == nSteps-1;
+
+        // Opcode fetch
+        CodeAccess();
+        nR++;
+
+        if (s.fNative)
+            fSetPC = EmitNative(s, pbCode_ + (s.wPC - wPC_), fLast);
+        else
+        {
+            EmitInterpreted(s, fLast);
+            if (s.fWrite && !fLast)
+                EmitWriteCheck(s, pbCode_, uLen);
+
+            // Leave if a branch was taken
+            if (s.fBranch && !fLast)
+            {
+                Emit({ 0x66, 0x81, 0x7b, REG(pc.w) });              // cmp word [rbx+pc],next
+                EmitValue<WORD>(s.wPC + s.bLen);
+                EmitExitJump(s, JNZ);
+            }
+
+            fSetPC = true;
+        }
+
+        // Events are due once the counter reaches the next event time
+        if (!fLast)
+        {
+            FlushCycles();
+            Emit({ 0x45, 0x39, 0xf4 });                             // cmp r12d,r14d
+            EmitExitJump(s, JAE);
+        }
+    }
+
+    // Fall through to the normal exit, with the state after the last step
+    EXIT eLast = StepExit(asSteps[nSteps-1]);
+    eLast.fPC = !fSetPC;
+    FlushCycles();
+    EmitExitState(eLast);
+
+    BYTE *pbEpilogue = pb;
+    Emit({ 0x45, 0x89, 0x27 });                                     // mov [r15],r12d
+    Emit({ 0xb8, 0x01, 0x00, 0x00, 0x00 });                         // mov eax,1
+    Emit({ 0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c, 0x5b, 0xc3 }); // pop r15-r12,rbx ; ret
+
+    for (auto &e : vExits)
+    {
+        PatchJump(e.pbJump, pb);
+        EmitExitState(e);
+        PatchJump(EmitJump(), pbEpilogue);
+    }
+
+    for (auto pbMiss : vMisses)
+        PatchJump(pbMiss, pb);
+    Emit({ 0x31, 0xc0, 0xc3 });                                     // xor eax,eax ; ret
+
+    // Keep blocks 16-byte aligned
+    pbCodeNext = pbCodeBase + ((pb - pbCodeBase + 15) & ~15);
+    return reinterpret_cast<PFNBLOCK>(pbEntry);
+}
+
+
+namespace Dynarec
+{
+
+bool Init (PFNEXECUTEOP pfnExecuteOp_)
+{
+    pfnExecuteOp = pfnExecuteOp_;
+
+    // LAHF is used for the flags, and was missing from some early x86-64 CPUs
+    unsigned int uA, uB, uC, uD;
+    if (!__get_cpuid(0x80000001, &uA, &uB, &uC, &uD) || !(uC & bit_LAHF_LM))
+        return false;
+
+    if (!pbCodeBase)
+    {
+        int nFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_JIT
+        nFlags |= MAP_JIT;
+#endif
+        void *pv = mmap(nullptr, CODE_SIZE, PROT_READ|PROT_WRITE|PROT_EXEC, nFlags, -1, 0);
+        if (pv == MAP_FAILED)
+        {
+            TRACE("Dynarec::Init(): failed to allocate executable memory\n");
+            return false;
+        }
+
+        pbCodeBase = pbCodeNext = reinterpret_cast<BYTE*>(pv);
+    }
+
+    return true;
+}
+
+void Exit (bool fReInit_/*=false*/)
+{
+    // Memory may be reallocated, so discard everything found by physical address
+    for (auto &pPage : apPages)
+    {
+        delete pPage;
+        pPage = nullptr;
+    }
+
+    pbCodeNext = pbCodeBase;
+
+    if (!fReInit_ && pbCodeBase)
+    {
+        munmap(pbCodeBase, CODE_SIZE);
+        pbCodeBase = pbCodeNext = nullptr;
+    }
+}
+
+
+bool IsAvailable ()
+{
+    return pbCodeBase != nullptr;
+}
+
+// Run the compiled block at PC, returning false if there isn't one
+bool Execute (const BYTE *pbContention_)
+{
+    const BYTE *pbCode = AddrReadPtr(PC);
+    DYNAREC_PAGE *&pPage = apPages[PtrPage(pbCode)];
+    int nOffset = PtrOffset(pbCode);
+
+    if (!pPage)
+        pPage = new DYNAREC_PAGE();
+
+    PFNBLOCK pfnBlock = pPage->apfnBlocks[nOffset];
+
+    if (!pfnBlock)
+    {
+        if (++pPage->abCounts[nOffset] < HOT_COUNT)
+            return false;
+
+        pfnBlock = Compile(pbCode, PC);
+        pPage->apfnBlocks[nOffset] = pfnBlock ? pfnBlock : NoBlock;
+    }
+
+    if (!pfnBlock || pfnBlock == NoBlock)
+        return false;
+
+    if (pfnBlock(pbContention_, g_dwEventDeadline))
+        return true;
+
+    // The code or paging has changed, so count executions for a new block
+    pPage->apfnBlocks[nOffset] = nullptr;
+    pPage->abCounts[nOffset] = 0;
+    return false;
+}
+
+
+// Return the host memory used by the generated code and the block tables
+size_t GetMemoryUsed ()
+{
+    size_t uUsed = static_cast<size_t>(pbCodeNext - pbCodeBase);
+
+    for (auto pPage : apPages)
+        uUsed += pPage ? sizeof(*pPage) : 0;
+
+    return uUsed;
+}
+
+} // namespace Dynarec
+
+#else
+
+namespace Dynarec
+{
+bool Init (PFNEXECUTEOP /*pfnExecuteOp_*/) { return false; }
+void Exit (bool /*fReInit_=false*/) { }
+bool IsAvailable () { return false; }
+bool Execute (const BYTE * /*pbContention_*/) { return false; }
+size_t GetMemoryUsed () { return 0; }
+}
+
+#endif  // USE_DYNAREC
@@ -0,0 +1,43 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Dynarec.h: Dynamic recompiler for hot Z80 code blocks
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DYNAREC_H
+#define DYNAREC_H
+
+// Native code generation is only supported for x86-64 with the System V calling convention
+#if defined(__x86_64__) && !defined(_WIN32)
+#define USE_DYNAREC
+#endif
+
+// Interpreter callback to execute one instruction, once its opcode fetch has been timed
+typedef void (*PFNEXECUTEOP)(BYTE bOpcode_);
+
+namespace Dynarec
+{
+    bool Init (PFNEXECUTEOP pfnExecuteOp_);
+    void Exit (bool fReInit_=false);
+
+    bool IsAvailable ();
+    bool Execute (const BYTE *pbContention_);
+
+    size_t GetMemoryUsed ();
+}
+
+#endif  // DYNAREC_H
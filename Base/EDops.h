@@ -81,6 +81,9 @@
                                 ((!A) << 6)                                         /* Z          */ \
                         )
 
+// Repeating block instructions continue in bulk, except in cores that must see every access, write or heatmap access
+#define block_repeat(x) do { if (!fTrack_ && !fGuard_ && !fHeat_) x; } while (0)
+
 // Load; increment; [repeat]
 #define ldi(loop)       do { \
                             BYTE x = timed_read_byte(HL); \
@@ -94,6 +97,7 @@
                             if (loop) { \
                                 g_dwCycleCounter += 5; \
                                 PC -= 2; \
+                                block_repeat(BlockLd(1)); \
                             } \
                         } while (0)
 
@@ -110,6 +114,7 @@
                             if (loop) { \
                                 g_dwCycleCounter += 5; \
                                 PC -= 2; \
+                                block_repeat(BlockLd(-1)); \
                             } \
                         } while (0)
 
@@ -126,6 +131,7 @@
                             if (loop) { \
                                 g_dwCycleCounter += 5; \
                                 PC -= 2; \
+                                block_repeat(BlockCp(1)); \
                             } \
                         } while (0)
 
@@ -142,6 +148,7 @@
                             if (loop) { \
                                 g_dwCycleCounter += 5; \
                                 PC -= 2; \
+                                block_repeat(BlockCp(-1)); \
                             } \
                         } while (0)
 
@@ -20,18 +20,35 @@
 
 #include "SimCoupe.h"
 
+#include <vector>
+
 #include "Expr.h"
 #include "Memory.h"
 #include "Options.h"
 #include "Symbol.h"
 
 
-static const char* p;
-static EXPR *pHead, *pTail;
-static int nFlags;
+const int MAX_EXPR_STACK = 128;     // evaluation stack depth, also limiting the compiled tree depth
+
+// Compiled expressions are a tree of nodes, each evaluated by a function specialised for the operation
+typedef int (*PFNEXPRCODE)(const EXPRCODE* pCode_);
+
+typedef struct tagEXPRCODE
+{
+    PFNEXPRCODE pfn;                // node evaluation function
+    const EXPRCODE *pLeft, *pRight; // operand nodes
+    int nValue;                     // constant, constant right operand, or register/variable number
+    const void *pv;                 // register location for direct loads
+} EXPRCODE;
+
+static MACHINE_LOCAL const char* p;
+static MACHINE_LOCAL EXPR *pHead, *pTail;
+static MACHINE_LOCAL int nFlags;
+
+static EXPRCODE* CompileCode (const EXPR* pExpr_);
 
-EXPR Expr::Counter = { T_VARIABLE, VAR_COUNT, nullptr, "(counter)" };
-int Expr::nCount;
+EXPR Expr::Counter = { T_VARIABLE, VAR_COUNT, nullptr, "(counter)", nullptr };
+MACHINE_LOCAL int Expr::nCount;
 
 // Free all elements in an expression list
 void Expr::Release (EXPR* pExpr_)
@@ -40,6 +57,7 @@ void Expr::Release (EXPR* pExpr_)
     if (pExpr_ && pExpr_ != &Counter)
     {
         delete[] pExpr_->pcszExpr;
+        delete[] pExpr_->pCode;
         for (EXPR* pDel ; (pDel = pExpr_) ; pExpr_ = pExpr_->pNext, delete pDel);
     }
 }
@@ -61,6 +79,7 @@ static EXPR* AddNode (int nType_, int nValue_)
     pExpr->nValue = nValue_;
     pExpr->pNext = nullptr;
     pExpr->pcszExpr = nullptr;
+    pExpr->pCode = nullptr;
 
     return AddNode(pExpr);
 }
@@ -155,6 +174,9 @@ EXPR* Expr::Compile (const char* pcsz_, char** ppszEnd_/*=nullptr*/, int nFlags_
     // Keep a copy of the original expression text in the head item
     pHead->pcszExpr = strcpy(new char[strlen(pcsz_)+1], pcsz_);
 
+    // Compile it for faster evaluation, falling back on the interpreter if that's not possible
+    pHead->pCode = CompileCode(pHead);
+
     // Return the expression list
     return pHead;
 }
@@ -278,15 +300,374 @@ void Expr::SetReg (int nReg_, int nValue_)
 }
 
 
-// Evaluate a compiled expression
+// Apply a unary operator
+static inline int UnaryOp (int nOp_, int x)
+{
+    switch (nOp_)
+    {
+        case OP_UMINUS: x = -x; break;
+        case OP_UPLUS:          break;
+        case OP_BNOT:   x = ~x; break;
+        case OP_NOT:    x = !x; break;
+        case OP_DEREF:  x = read_byte(x); break;
+        case OP_PEEK:   x = read_byte(x); break;
+        case OP_DPEEK:  x = read_word(x); break;
+    }
+
+    return x;
+}
+
+// Apply a binary operator
+static inline int BinaryOp (int nOp_, int a, int b)
+{
+    int c = 0;
+
+    switch (nOp_)
+    {
+        case OP_OR:     c = a || b; break;
+        case OP_AND:    c = a && b; break;
+        case OP_BOR:    c = a | b;  break;
+        case OP_BXOR:   c = a ^ b;  break;
+        case OP_BAND:   c = a & b;  break;
+        case OP_EQ:     c = a == b; break;
+        case OP_NE:     c = a != b; break;
+        case OP_LT:     c = a < b;  break;
+        case OP_LE:     c = a <= b; break;
+        case OP_GE:     c = a >= b; break;
+        case OP_GT:     c = a > b;  break;
+        case OP_SHIFTL: c = a << b; break;
+        case OP_SHIFTR: c = a >> b; break;
+        case OP_ADD:    c = a + b;  break;
+        case OP_SUB:    c = a - b;  break;
+        case OP_MUL:    c = a * b;  break;
+        case OP_DIV:    c = b ? a/b : 0; break; // Avoid/ignore division by zero
+        case OP_MOD:    c = b ? a%b : 0; break;
+    }
+
+    return c;
+}
+
+// Return the current value of a variable
+static int GetVar (int nVar_)
+{
+    int r = 0;
+
+    switch (nVar_)
+    {
+        case VAR_EI:        r = !!IFF1; break;
+        case VAR_DI:        r = !IFF1;  break;
+
+        case VAR_DLINE:
+        {
+            int nLine;
+            Frame::GetRasterPos(&nLine);
+            r = nLine;
+            break;
+        }
+
+        case VAR_SLINE:
+        {
+            int nLine;
+            Frame::GetRasterPos(&nLine);
+            if (nLine >= TOP_BORDER_LINES && nLine < (TOP_BORDER_LINES+SCREEN_LINES))
+                r = nLine - TOP_BORDER_LINES;
+            else
+                r = -1;
+            break;
+        }
+
+        case VAR_ROM0:      r = !(lmpr & LMPR_ROM0_OFF);  break;
+        case VAR_ROM1:      r = !!(lmpr & LMPR_ROM1);     break;
+        case VAR_WPROT:     r = !!(lmpr & LMPR_WPROT);    break;
+
+        case VAR_LEPAGE:    r = lepr; break;
+        case VAR_HEPAGE:    r = hepr; break;
+        case VAR_LPAGE:     r = lmpr & LMPR_PAGE_MASK;    break;
+        case VAR_HPAGE:     r = hmpr & HMPR_PAGE_MASK;    break;
+        case VAR_VPAGE:     r = vmpr & VMPR_PAGE_MASK;    break;
+        case VAR_VMODE:     r = ((vmpr & VMPR_MODE_MASK) >> VMPR_MODE_SHIFT)+1; break;
+
+        case VAR_INVAL:     r = bPortInVal;               break;
+        case VAR_OUTVAL:    r = bPortOutVal;              break;
+
+        case VAR_LEPR:      r = LEPR_PORT;                break;	// 128
+        case VAR_HEPR:      r = HEPR_PORT;                break;	// 129
+        case VAR_LPEN:      r = LPEN_PORT;                break;	// 248
+        case VAR_HPEN:      r = HPEN_PORT;                break;	// 248+256
+        case VAR_STATUS:    r = STATUS_PORT;              break;	// 249
+        case VAR_LMPR:      r = LMPR_PORT;                break;	// 250
+        case VAR_HMPR:      r = HMPR_PORT;                break;	// 251
+        case VAR_VMPR:      r = VMPR_PORT;                break;	// 252
+        case VAR_MIDI:      r = MIDI_PORT;                break;	// 253
+        case VAR_BORDER:    r = BORDER_PORT;              break;	// 254
+        case VAR_ATTR:      r = ATTR_PORT;                break;	// 255
+
+        case VAR_INROM:     r = (!(lmpr & LMPR_ROM0_OFF) && PC < 0x4000) || (lmpr & LMPR_ROM1 && PC >= 0xc000); break;
+        case VAR_CALL:      r = PC == HL && !(lmpr & LMPR_ROM0_OFF) && (read_word(SP) == 0x180d); break;
+        case VAR_AUTOEXEC:  r = PC == HL && !(lmpr & LMPR_ROM0_OFF) && (read_word(SP) == 0x0213) && (read_word(SP+2) == 0x5f00); break;
+
+        case VAR_COUNT:     r = Expr::nCount ? !--Expr::nCount : 1; break;
+    }
+
+    return r;
+}
+
+// Return the location of a byte register, or nullptr if it isn't held as one
+static const BYTE* GetRegBytePtr (int nReg_)
+{
+    switch (nReg_)
+    {
+        case REG_A:     return &A;
+        case REG_F:     return &F;
+        case REG_B:     return &B;
+        case REG_C:     return &C;
+        case REG_D:     return &D;
+        case REG_E:     return &E;
+        case REG_H:     return &H;
+        case REG_L:     return &L;
+
+        case REG_ALT_A: return &A_;
+        case REG_ALT_F: return &F_;
+        case REG_ALT_B: return &B_;
+        case REG_ALT_C: return &C_;
+        case REG_ALT_D: return &D_;
+        case REG_ALT_E: return &E_;
+        case REG_ALT_H: return &H_;
+        case REG_ALT_L: return &L_;
+
+        case REG_IXH:   return &IXH;
+        case REG_IXL:   return &IXL;
+        case REG_IYH:   return &IYH;
+        case REG_IYL:   return &IYL;
+        case REG_SPH:   return &SPH;
+        case REG_SPL:   return &SPL;
+        case REG_PCH:   return &PCH;
+        case REG_PCL:   return &PCL;
+
+        case REG_I:     return &I;
+        case REG_IFF1:  return &IFF1;
+        case REG_IFF2:  return &IFF2;
+        case REG_IM:    return &IM;
+    }
+
+    return nullptr;
+}
+
+// Return the location of a register pair, or nullptr if it isn't one
+static const WORD* GetRegWordPtr (int nReg_)
+{
+    switch (nReg_)
+    {
+        case REG_AF:     return &AF;
+        case REG_BC:     return &BC;
+        case REG_DE:     return &DE;
+        case REG_HL:     return &HL;
+
+        case REG_ALT_AF: return &AF_;
+        case REG_ALT_BC: return &BC_;
+        case REG_ALT_DE: return &DE_;
+        case REG_ALT_HL: return &HL_;
+
+        case REG_IX:     return &IX;
+        case REG_IY:     return &IY;
+        case REG_SP:     return &SP;
+        case REG_PC:     return &PC;
+    }
+
+    return nullptr;
+}
+
+// Leaf nodes
+static int EvalConst (const EXPRCODE* p_) { return p_->nValue; }
+static int EvalLoad8 (const EXPRCODE* p_) { return *reinterpret_cast<const BYTE*>(p_->pv); }
+static int EvalLoad16 (const EXPRCODE* p_) { return *reinterpret_cast<const WORD*>(p_->pv); }
+static int EvalReg (const EXPRCODE* p_) { return Expr::GetReg(p_->nValue); }
+static int EvalVar (const EXPRCODE* p_) { return GetVar(p_->nValue); }
+static int EvalPeek (const EXPRCODE* p_) { return read_byte(static_cast<WORD>(p_->nValue)); }
+static int EvalDPeek (const EXPRCODE* p_) { return read_word(static_cast<WORD>(p_->nValue)); }
+static int EvalPeekReg (const EXPRCODE* p_) { return read_byte(*reinterpret_cast<const WORD*>(p_->pv)); }
+static int EvalDPeekReg (const EXPRCODE* p_) { return read_word(*reinterpret_cast<const WORD*>(p_->pv)); }
+
+// Operator nodes, with the left operand evaluated first to match the interpreter
+template <int nOp_>
+static int EvalUnary (const EXPRCODE* p_)
+{
+    return UnaryOp(nOp_, p_->pLeft->pfn(p_->pLeft));
+}
+
+template <int nOp_>
+static int EvalBinary (const EXPRCODE* p_)
+{
+    int a = p_->pLeft->pfn(p_->pLeft);
+    return BinaryOp(nOp_, a, p_->pRight->pfn(p_->pRight));
+}
+
+template <int nOp_>
+static int EvalBinaryConst (const EXPRCODE* p_)
+{
+    return BinaryOp(nOp_, p_->pLeft->pfn(p_->pLeft), p_->nValue);
+}
+
+// Operator node functions, indexed by OP_* value
+static const PFNEXPRCODE apfnUnary[] =
+{
+    EvalUnary<OP_UMINUS>, EvalUnary<OP_UPLUS>, EvalUnary<OP_BNOT>, EvalUnary<OP_NOT>,
+    EvalUnary<OP_DEREF>, EvalUnary<OP_PEEK>, EvalUnary<OP_DPEEK>
+};
+
+static const PFNEXPRCODE apfnBinary[] =
+{
+    EvalBinary<OP_AND>, EvalBinary<OP_OR>, EvalBinary<OP_BOR>, EvalBinary<OP_BXOR>, EvalBinary<OP_BAND>,
+    EvalBinary<OP_EQ>, EvalBinary<OP_NE>, EvalBinary<OP_LT>, EvalBinary<OP_LE>, EvalBinary<OP_GE>,
+    EvalBinary<OP_GT>, EvalBinary<OP_SHIFTL>, EvalBinary<OP_SHIFTR>, EvalBinary<OP_ADD>, EvalBinary<OP_SUB>,
+    EvalBinary<OP_MUL>, EvalBinary<OP_DIV>, EvalBinary<OP_MOD>
+};
+
+static const PFNEXPRCODE apfnBinaryConst[] =
+{
+    EvalBinaryConst<OP_AND>, EvalBinaryConst<OP_OR>, EvalBinaryConst<OP_BOR>, EvalBinaryConst<OP_BXOR>, EvalBinaryConst<OP_BAND>,
+    EvalBinaryConst<OP_EQ>, EvalBinaryConst<OP_NE>, EvalBinaryConst<OP_LT>, EvalBinaryConst<OP_LE>, EvalBinaryConst<OP_GE>,
+    EvalBinaryConst<OP_GT>, EvalBinaryConst<OP_SHIFTL>, EvalBinaryConst<OP_SHIFTR>, EvalBinaryConst<OP_ADD>, EvalBinaryConst<OP_SUB>,
+    EvalBinaryConst<OP_MUL>, EvalBinaryConst<OP_DIV>, EvalBinaryConst<OP_MOD>
+};
+
+// Compile a postfix expression list to a tree of evaluation nodes, folding constant
+// sub-expressions and resolving registers and memory reads to direct loads where possible
+static EXPRCODE* CompileCode (const EXPR* pExpr_)
+{
+    typedef struct { PFNEXPRCODE pfn; int nLeft, nRight, nValue; const void *pv; int nDepth; } NODE;
+    std::vector<NODE> vNodes;
+    std::vector<int> vStack;
+
+    for ( ; pExpr_ ; pExpr_ = pExpr_->pNext)
+    {
+        NODE n = { EvalConst, -1, -1, pExpr_->nValue, nullptr, 1 };
+
+        switch (pExpr_->nType)
+        {
+            case T_NUMBER:
+                break;
+
+            case T_REGISTER:
+                if ((n.pv = GetRegBytePtr(pExpr_->nValue)))
+                    n.pfn = EvalLoad8;
+                else if ((n.pv = GetRegWordPtr(pExpr_->nValue)))
+                    n.pfn = EvalLoad16;
+                else
+                    n.pfn = EvalReg;
+                break;
+
+            case T_VARIABLE:
+                // Port number variables are constant
+                if (pExpr_->nValue >= VAR_LEPR && pExpr_->nValue <= VAR_ATTR)
+                    n.nValue = GetVar(pExpr_->nValue);
+                else
+                    n.pfn = EvalVar;
+                break;
+
+            case T_UNARY_OP:
+            {
+                if (vStack.empty() || pExpr_->nValue < 0 || pExpr_->nValue > OP_DPEEK)
+                    return nullptr;
+
+                // Memory reads from a constant address or register pair are done directly
+                NODE &l = vNodes[vStack.back()];
+                bool fPeek = pExpr_->nValue == OP_PEEK || pExpr_->nValue == OP_DEREF, fDPeek = pExpr_->nValue == OP_DPEEK;
+
+                if (l.pfn == EvalConst && (fPeek || fDPeek))
+                    l.pfn = fPeek ? EvalPeek : EvalDPeek;
+                else if (l.pfn == EvalLoad16 && (fPeek || fDPeek))
+                    l.pfn = fPeek ? EvalPeekReg : EvalDPeekReg;
+                else if (l.pfn == EvalConst)
+                    l.nValue = UnaryOp(pExpr_->nValue, l.nValue);
+                else
+                {
+                    n = { apfnUnary[pExpr_->nValue], vStack.back(), -1, 0, nullptr, l.nDepth+1 };
+                    vStack.pop_back();
+                    break;
+                }
+
+                continue;
+            }
+
+            case T_BINARY_OP:
+            {
+                if (vStack.size() < 2 || pExpr_->nValue < 0 || pExpr_->nValue > OP_MOD)
+                    return nullptr;
+
+                int nRight = vStack.back(); vStack.pop_back();
+                int nLeft = vStack.back(); vStack.pop_back();
+                NODE &l = vNodes[nLeft], &r = vNodes[nRight];
+
+                // Fold constant operands, leaving the unused right node behind
+                if (l.pfn == EvalConst && r.pfn == EvalConst)
+                {
+                    l.nValue = BinaryOp(pExpr_->nValue, l.nValue, r.nValue);
+                    vStack.push_back(nLeft);
+                    continue;
+                }
+                else if (r.pfn == EvalConst)
+                    n = { apfnBinaryConst[pExpr_->nValue], nLeft, -1, r.nValue, nullptr, l.nDepth+1 };
+                else
+                    n = { apfnBinary[pExpr_->nValue], nLeft, nRight, 0, nullptr, std::max(l.nDepth, r.nDepth)+1 };
+                break;
+            }
+
+            default:
+                return nullptr;
+        }
+
+        // Keep the evaluation recursion within the same limit as the interpreter stack
+        if (n.nDepth > MAX_EXPR_STACK)
+            return nullptr;
+
+        vStack.push_back(static_cast<int>(vNodes.size()));
+        vNodes.push_back(n);
+    }
+
+    if (vStack.size() != 1)
+        return nullptr;
+
+    // Link the final nodes, moving the root node to the start
+    int nRoot = vStack.back(), nNodes = static_cast<int>(vNodes.size());
+    EXPRCODE *pCode = new EXPRCODE[nNodes];
+    auto Node = [&] (int i) { return (i < 0) ? nullptr : &pCode[(i == nRoot) ? 0 : (i < nRoot) ? i+1 : i]; };
+
+    for (int i = 0 ; i < nNodes ; i++)
+    {
+        const NODE &n = vNodes[i];
+        EXPRCODE *p = Node(i);
+        *p = { n.pfn, Node(n.nLeft), Node(n.nRight), n.nValue, n.pv };
+    }
+
+    return pCode;
+}
+
+
+// Evaluate an expression, using the compiled form if available
 int Expr::Eval (const EXPR* pExpr_)
+{
+    // No expression?
+    if (!pExpr_)
+        return -1;
+
+    // Fall back on interpreting sub-expressions and built-in expressions, which aren't compiled
+    const EXPRCODE *pCode = pExpr_->pCode;
+    if (!pCode)
+        return Interpret(pExpr_);
+
+    return pCode->pfn(pCode);
+}
+
+// Evaluate an expression by walking the postfix list
+int Expr::Interpret (const EXPR* pExpr_)
 {
     // No expression?
     if (!pExpr_)
         return -1;
 
     // Value stack
-    int an[128], n = 0;
+    int an[MAX_EXPR_STACK], n = 0;
 
     // Walk the expression list
     for ( ; pExpr_ ; pExpr_ = pExpr_->pNext)
@@ -304,22 +685,9 @@ int Expr::Eval (const EXPR* pExpr_)
                 if (n < 1)
                     break;
 
-                // Pop one argument
+                // Pop one argument, and push the result
                 int x = an[--n];
-
-                switch (pExpr_->nValue)
-                {
-                    case OP_UMINUS: x = -x; break;
-                    case OP_UPLUS:          break;
-                    case OP_BNOT:   x = ~x; break;
-                    case OP_NOT:    x = !x; break;
-                    case OP_DEREF:  x = read_byte(x); break;
-                    case OP_PEEK:   x = read_byte(x); break;
-                    case OP_DPEEK:  x = read_word(x); break;
-                }
-
-                // Push the result
-                an[n++] = x;
+                an[n++] = UnaryOp(pExpr_->nValue, x);
                 break;
             }
 
@@ -329,111 +697,22 @@ int Expr::Eval (const EXPR* pExpr_)
                 if (n < 2)
                     break;
 
-                // Pop the arguments (in reverse order)
+                // Pop the arguments (in reverse order), and push the result
                 int b = an[--n];
                 int a = an[--n];
-                int c = 0;
-
-                switch (pExpr_->nValue)
-                {
-                    case OP_OR:     c = a || b; break;
-                    case OP_AND:    c = a && b; break;
-                    case OP_BOR:    c = a | b;  break;
-                    case OP_BXOR:   c = a ^ b;  break;
-                    case OP_BAND:   c = a & b;  break;
-                    case OP_EQ:     c = a == b; break;
-                    case OP_NE:     c = a != b; break;
-                    case OP_LT:     c = a < b;  break;
-                    case OP_LE:     c = a <= b; break;
-                    case OP_GE:     c = a >= b; break;
-                    case OP_GT:     c = a > b;  break;
-                    case OP_SHIFTL: c = a << b; break;
-                    case OP_SHIFTR: c = a >> b; break;
-                    case OP_ADD:    c = a + b;  break;
-                    case OP_SUB:    c = a - b;  break;
-                    case OP_MUL:    c = a * b;  break;
-                    case OP_DIV:    c = b ? a/b : 0; break; // Avoid/ignore division by zero
-                    case OP_MOD:    c = b ? a%b : 0; break;
-                }
-
-                // Push the result
-                an[n++] = c;
+                an[n++] = BinaryOp(pExpr_->nValue, a, b);
                 break;
             }
 
             case T_REGISTER:
-            {
                 // Push register value
-                int r = GetReg(pExpr_->nValue);
-                an[n++] = r;
+                an[n++] = GetReg(pExpr_->nValue);
                 break;
-            }
 
             case T_VARIABLE:
-            {
-                int r = 0;
-
-                switch (pExpr_->nValue)
-                {
-                    case VAR_EI:        r = !!IFF1; break;
-                    case VAR_DI:        r = !IFF1;  break;
-
-                    case VAR_DLINE:
-                    {
-                        int nLine;
-                        Frame::GetRasterPos(&nLine);
-                        r = nLine;
-                        break;
-                    }
-
-                    case VAR_SLINE:
-                    {
-                        int nLine;
-                        Frame::GetRasterPos(&nLine);
-                        if (nLine >= TOP_BORDER_LINES && nLine < (TOP_BORDER_LINES+SCREEN_LINES))
-                            r = nLine - TOP_BORDER_LINES;
-                        else
-                            r = -1;
-                        break;
-                    }
-
-                    case VAR_ROM0:      r = !(lmpr & LMPR_ROM0_OFF);  break;
-                    case VAR_ROM1:      r = !!(lmpr & LMPR_ROM1);     break;
-                    case VAR_WPROT:     r = !!(lmpr & LMPR_WPROT);    break;
-
-                    case VAR_LEPAGE:    r = lepr; break;
-                    case VAR_HEPAGE:    r = hepr; break;
-                    case VAR_LPAGE:     r = lmpr & LMPR_PAGE_MASK;    break;
-                    case VAR_HPAGE:     r = hmpr & HMPR_PAGE_MASK;    break;
-                    case VAR_VPAGE:     r = vmpr & VMPR_PAGE_MASK;    break;
-                    case VAR_VMODE:     r = ((vmpr & VMPR_MODE_MASK) >> VMPR_MODE_SHIFT)+1; break;
-
-                    case VAR_INVAL:     r = bPortInVal;               break;
-                    case VAR_OUTVAL:    r = bPortOutVal;              break;
-
-                    case VAR_LEPR:      r = LEPR_PORT;                break;	// 128
-                    case VAR_HEPR:      r = HEPR_PORT;                break;	// 129
-                    case VAR_LPEN:      r = LPEN_PORT;                break;	// 248
-                    case VAR_HPEN:      r = HPEN_PORT;                break;	// 248+256
-                    case VAR_STATUS:    r = STATUS_PORT;              break;	// 249
-                    case VAR_LMPR:      r = LMPR_PORT;                break;	// 250
-                    case VAR_HMPR:      r = HMPR_PORT;                break;	// 251
-                    case VAR_VMPR:      r = VMPR_PORT;                break;	// 252
-                    case VAR_MIDI:      r = MIDI_PORT;                break;	// 253
-                    case VAR_BORDER:    r = BORDER_PORT;              break;	// 254
-                    case VAR_ATTR:      r = ATTR_PORT;                break;	// 255
-
-                    case VAR_INROM:     r = (!(lmpr & LMPR_ROM0_OFF) && PC < 0x4000) || (lmpr & LMPR_ROM1 && PC >= 0xc000); break;
-                    case VAR_CALL:      r = PC == HL && !(lmpr & LMPR_ROM0_OFF) && (read_word(SP) == 0x180d); break;
-                    case VAR_AUTOEXEC:  r = PC == HL && !(lmpr & LMPR_ROM0_OFF) && (read_word(SP) == 0x0213) && (read_word(SP+2) == 0x5f00); break;
-
-                    case VAR_COUNT:     r = nCount ? !--nCount : 1; break;
-                }
-
                 // Push variable value
-                an[n++] = r;
+                an[n++] = GetVar(pExpr_->nValue);
                 break;
-            }
 /*
             case T_FUNCTION:
             {
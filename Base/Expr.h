@@ -22,6 +22,7 @@
 #define EXPR_H
 
 typedef struct tagEXPR EXPR;
+typedef struct tagEXPRCODE EXPRCODE;
 
 class Expr
 {
@@ -34,6 +35,7 @@ class Expr
         static EXPR* Compile (const char* pcsz_, char** ppszEnd_=nullptr, int nFlags_=none);
         static void Release (EXPR* pExpr_);
         static int Eval (const EXPR* pExpr_);
+        static int Interpret (const EXPR* pExpr_);
         static bool Eval (const char* pcsz_, int *pnValue_, char** ppszEnd_=nullptr, int nFlags_=none);
 
     public:
@@ -42,7 +44,7 @@ class Expr
 
     public:
         static EXPR Counter;
-        static int nCount;
+        static MACHINE_LOCAL int nCount;
 
     protected:
         static bool Term (int n_=0);
@@ -55,6 +57,7 @@ typedef struct tagEXPR
     int nType, nValue;      // Item type and type-specific value
     struct tagEXPR* pNext;  // Link to next item in expression
     const char *pcszExpr;   // Original expression text (head item only)
+    EXPRCODE *pCode;        // Compiled form for fast evaluation (head item only)
 
 private:
     ~tagEXPR () = default;  // Use Expr::Release() to delete Expr chains
@@ -25,6 +25,18 @@
 //
 //  The actual drawing work is done by a template class in Frame.h, depending
 //  on whether or not the current line is high resolution.
+//
+//  If the display offers its native pixel buffer, and nothing needs the full
+//  CScreen frame, each line segment is drawn to a short scratch line and
+//  converted straight to the display format through the display's palette.
+//  The GUI, screenshots and recordings still use the CScreen frames, as do
+//  the few lines under the on-screen display, which is drawn over them.
+//
+//  Each line remembers the display settings it was last drawn with, and is
+//  flagged when its screen data is written.  A line drawn whole with the same
+//  settings and no writes is left with its previous pixels, so only lines that
+//  change are redrawn and passed on to the display.  The SAM frame is kept in
+//  a single CScreen for this, while the GUI frames are double-buffered.
 
 // ToDo:
 //  - change from dirty lines to dirty rectangles, to reduce rendering further
@@ -43,10 +55,22 @@
 #include "Memory.h"
 #include "Options.h"
 #include "OSD.h"
+#include "Perf.h"
 #include "PNG.h"
 #include "Sound.h"
+#include "State.h"
 #include "Util.h"
 #include "UI.h"
+#include "Video.h"
+
+#ifdef __LIBRETRO__
+extern "C" {
+#define LIBCO_C 
+#include "libco/libco.h"
+extern cothread_t mainThread;
+extern cothread_t emuThread;
+}
+#endif
 
 
 // SAM palette colours to use for the floppy drive LED states
@@ -58,23 +82,29 @@ const BYTE LED_OFF_COLOUR       = GREY_2;   // Grey for off
 const unsigned int STATUS_ACTIVE_TIME = 2500;   // Time the status text is visible for (in ms)
 const unsigned int FPS_IN_TURBO_MODE = 5;       // Number of FPS to limit to in (non-key) Turbo mode
 
-int s_nViewTop, s_nViewBottom;
-int s_nViewLeft, s_nViewRight;
+MACHINE_LOCAL int s_nViewTop, s_nViewBottom;
+MACHINE_LOCAL int s_nViewLeft, s_nViewRight;
+
+MACHINE_LOCAL CScreen *pScreen, *pGuiScreen, *pLastGuiScreen, *pDisplayScreen;
+MACHINE_LOCAL CFrame *pFrame;
 
-CScreen *pScreen, *pLastScreen, *pGuiScreen, *pLastGuiScreen, *pDisplayScreen;
-CFrame *pFrame;
+MACHINE_LOCAL bool fDrawFrame, g_fFlashPhase, fSaveScreen;
+MACHINE_LOCAL int nFrame, nFlash;
 
-bool fDrawFrame, g_fFlashPhase, fSaveScreen;
-int nFrame;
+MACHINE_LOCAL int nLastLine, nLastBlock;      // Line and block we've drawn up to so far this frame
 
-int nLastLine, nLastBlock;      // Line and block we've drawn up to so far this frame
+MACHINE_LOCAL bool fDirect;                   // Drawing straight to the display target this frame?
+MACHINE_LOCAL VIDEOTARGET sTarget;            // Display target for direct drawing
+MACHINE_LOCAL int nOsdTop, nOsdBottom;        // Lines outside this range are under the on-screen display
+MACHINE_LOCAL BYTE abLine[WIDTH_BLOCKS<<4];   // Scratch line for direct drawing
 
-DWORD dwStatusTime;             // Time the status line was made visible
+MACHINE_LOCAL DWORD dwStatusTime;             // Time the status line was made visible
 
-int s_nWidth, s_nHeight;
+MACHINE_LOCAL int s_nWidth, s_nHeight;
 
-char szStatus[128], szProfile[128];
-char szScreenPath[MAX_PATH];
+MACHINE_LOCAL char szStatus[128], szProfile[128];
+MACHINE_LOCAL char aszPerf[MAX_PERF_TIMERS+2][64];    // subsystem timing lines: heading, timers, then total
+MACHINE_LOCAL char szScreenPath[MAX_PATH];
 
 
 typedef struct
@@ -83,7 +113,7 @@ typedef struct
 }
 REGION;
 
-REGION asViews[] =
+MACHINE_LOCAL REGION asViews[] =
 {
     { SCREEN_BLOCKS, SCREEN_LINES },
     { SCREEN_BLOCKS+2, SCREEN_LINES+20 },
@@ -92,11 +122,52 @@ REGION asViews[] =
     { WIDTH_BLOCKS, HEIGHT_LINES },
 };
 
+// Display settings a line was drawn with, which must all match to keep it
+typedef struct
+{
+    BYTE abClut[N_CLUT_REGS];
+    BYTE bVmpr, bBorder, bHmpr;
+    bool fFlash;
+}
+LINE_KEY;
+
+typedef struct
+{
+    bool fValid;                // drawn whole, with sKey
+    LINE_KEY sKey;
+}
+LINE_STATE;
+
+MACHINE_LOCAL LINE_STATE asLines[HEIGHT_LINES];     // by view row
+MACHINE_LOCAL bool afWritten[HEIGHT_LINES];         // by line, screen data written since drawn
+
+// Display register change, for replay when the frame is next drawn
+typedef struct
+{
+    DWORD dwTime;               // cycle position the change takes effect
+    BYTE bReg, bVal;            // register (CLUT entry, or one below), and its new value
+}
+FRAME_EVENT;
+
+enum { evBorder = N_CLUT_REGS, evVmpr, evHmpr };
+
+const int MAX_FRAME_EVENTS = 4096;                  // changes logged before drawing to make room
+
+MACHINE_LOCAL FRAME_EVENT asEvents[MAX_FRAME_EVENTS];
+MACHINE_LOCAL int nEvents;
+
 namespace Frame
 {
 static void DrawOSD (CScreen *pScreen_);
 static void Flip (CScreen *pScreen_);
 
+// Forget how all lines were drawn, so they're drawn again
+static void InvalidateLines ()
+{
+    for (int i = 0 ; i < HEIGHT_LINES ; i++)
+        asLines[i].fValid = false;
+}
+
 bool Init (bool fFirstInit_/*=false*/)
 {
     Exit(true);
@@ -118,9 +189,8 @@ bool Init (bool fFirstInit_/*=false*/)
     s_nWidth = (s_nViewRight - s_nViewLeft) << 4;
     s_nHeight = (s_nViewBottom - s_nViewTop) << 1;
 
-    // Create two SAM screens and two GUI screens, to allow for double-buffering
+    // Create a SAM screen, which keeps unchanged lines, and two GUI screens for double-buffering
     pScreen = new CScreen(s_nWidth, s_nHeight);
-    pLastScreen = new CScreen(s_nWidth, s_nHeight);
     pGuiScreen = new CScreen(s_nWidth, s_nHeight);
     pLastGuiScreen = new CScreen(s_nWidth, s_nHeight);
 
@@ -128,17 +198,20 @@ bool Init (bool fFirstInit_/*=false*/)
     pFrame = new CFrame();
 
     // Check we created everything successfully
-    if (!pScreen || !pLastScreen || !pGuiScreen || !pLastGuiScreen || !pFrame)
+    if (!pScreen || !pGuiScreen || !pLastGuiScreen || !pFrame)
     {
         Message(msgFatal, "Out of memory!");
         return false;
     }
 
-    // Drawn screen is the last (initially blank) screen
-    pDisplayScreen = pLastScreen;
+    // Drawn screen is the (initially blank) SAM screen, with every line still to draw
+    pDisplayScreen = pScreen;
+    fDirect = false;
+    InvalidateLines();
 
-    // Set the renderer display mode
-    pFrame->SetMode(vmpr);
+    // Set the renderer display registers, including the mode
+    pFrame->SyncRegs();
+    nEvents = 0;
 
     // Prepare for new frame
     Flyback();
@@ -156,7 +229,6 @@ void Exit (bool fReInit_/*=false*/)
 
     delete pFrame; pFrame = nullptr;
     delete pScreen; pScreen = nullptr;
-    delete pLastScreen; pLastScreen = nullptr;
     delete pGuiScreen; pGuiScreen = nullptr;
     delete pLastGuiScreen; pLastGuiScreen = nullptr;
 
@@ -186,15 +258,142 @@ void SetView (UINT uBlocks_, UINT uLines_)
 }
 
 
-// Update the frame image to the current raster position
-void Update ()
+// Convert palette index pixels to a target row, or clear them to black if there's no palette
+static void ConvertPixels (BYTE *pbRow_, const BYTE *pb_, int nOffset_, int nWidth_, const DWORD *pdwPalette_)
 {
-    // Don't do anything if the current frame is being skipped
-    if (!fDrawFrame)
+    if (sTarget.nDepth == 32)
+    {
+        DWORD *pdw = reinterpret_cast<DWORD*>(pbRow_) + nOffset_;
+
+        if (!pdwPalette_)
+            memset(pdw, 0, nWidth_ * sizeof(DWORD));
+        else
+        {
+            for (int i = 0 ; i < nWidth_ ; i++)
+                pdw[i] = pdwPalette_[pb_[i]];
+        }
+    }
+    else
+    {
+        WORD *pw = reinterpret_cast<WORD*>(pbRow_) + nOffset_;
+
+        if (!pdwPalette_)
+            memset(pw, 0, nWidth_ * sizeof(WORD));
+        else
+        {
+            for (int i = 0 ; i < nWidth_ ; i++)
+                pw[i] = static_cast<WORD>(pdwPalette_[pb_[i]]);
+        }
+    }
+}
+
+// Put pixels on a line of the display target, and mark the line as changed
+static void PutPixels (int nRow_, const BYTE *pb_, int nOffset_, int nWidth_)
+{
+    BYTE *pbRow = sTarget.pbPixels + nRow_ * sTarget.lPitch;
+    ConvertPixels(pbRow, pb_, nOffset_, nWidth_, sTarget.pdwPalette);
+
+    // Include the scanline row below, if the target has one
+    if (sTarget.lScanOffset)
+        ConvertPixels(pbRow + sTarget.lScanOffset, pb_, nOffset_, nWidth_, sTarget.pdwScanline);
+
+    Video::SetLineDirty(nRow_);
+}
+
+// Fetch the display settings at the drawing position, for comparing with those a line was last drawn with
+static void GetLineKey (LINE_KEY *pKey_)
+{
+    const FRAME_REGS &sRegs = pFrame->GetRegs();
+
+    for (int i = 0 ; i < N_CLUT_REGS ; i++)
+        pKey_->abClut[i] = static_cast<BYTE>(sRegs.auClut[i]);
+
+    pKey_->bVmpr = sRegs.bVmpr;
+    pKey_->bBorder = sRegs.bBorder;
+    pKey_->bHmpr = sRegs.bHmpr & HMPR_MD3COL_MASK;
+    pKey_->fFlash = g_fFlashPhase;
+}
+
+// Draw a line segment, either to the CScreen frame or through the scratch line to the display target.
+// If a key is given, a whole line drawn before with the same settings and data is left as it is
+static void DrawLine (int nLine_, int nFrom_, int nTo_, const LINE_KEY *pKey_)
+{
+    // Ignore segments outside the view port
+    if (nLine_ < s_nViewTop || nLine_ >= s_nViewBottom || nFrom_ >= s_nViewRight || nTo_ <= s_nViewLeft)
+        return;
+
+    int nRow = nLine_ - s_nViewTop;
+    bool fOsd = fDirect && (nRow < nOsdTop || nRow >= nOsdBottom);
+    LINE_STATE *pLine = &asLines[nRow];
+
+    // Lines under the on-screen display must be drawn to the CScreen frame each time when drawing directly
+    if (pKey_ && !fOsd)
+    {
+        bool fWhole = nFrom_ <= s_nViewLeft && nTo_ >= s_nViewRight;
+
+        // Keep the previous pixels if nothing that affects them has changed
+        if (fWhole && pLine->fValid && !afWritten[nLine_] && !memcmp(&pLine->sKey, pKey_, sizeof(*pKey_)))
+            return;
+
+        pLine->fValid = fWhole;
+        pLine->sKey = *pKey_;
+    }
+    else
+        pLine->fValid = false;
+
+    afWritten[nLine_] = false;
+
+    // Lines under the on-screen display are converted once it's drawn over them
+    if (!fDirect || fOsd)
+    {
+        pFrame->UpdateLine(pScreen->GetLine(nRow), nLine_, nFrom_, nTo_);
+
+        // Show the changed line, except in the GUI, which finds its own changes
+        if (pKey_ && !fDirect)
+            Video::SetLineDirty(nRow);
+
         return;
+    }
+
+    pFrame->UpdateLine(abLine, nLine_, nFrom_, nTo_);
+
+    // Convert the visible part of the segment to the target
+    int nFrom = std::max(s_nViewLeft, nFrom_), nTo = std::min(nTo_, s_nViewRight);
+    if (nFrom < nTo)
+    {
+        int nOffset = (nFrom - s_nViewLeft) << 4;
+        PutPixels(nRow, abLine + nOffset, nOffset, (nTo - nFrom) << 4);
+    }
+}
+
+// Fetch the horizontal raster position (in cycles) and line for a given frame cycle position
+static int GetRasterPos (DWORD dwTime_, int *pnLine_)
+{
+    if (dwTime_ >= BORDER_PIXELS)
+    {
+        DWORD dwScreenCycles = dwTime_ - BORDER_PIXELS;
+        *pnLine_ = dwScreenCycles / TSTATES_PER_LINE;
+        return dwScreenCycles % TSTATES_PER_LINE;
+    }
+
+    // FIXME: the very start of the interrupt frame is from the final line of the display
+    *pnLine_ = 0;
+    return 0;
+}
 
-    // Work out the line and block for the current position
-    int nLine, nBlock = GetRasterPos(&nLine) >> 3;
+// Draw the frame image from the last drawn position up to a given cycle position
+static void DrawTo (DWORD dwTime_)
+{
+    // Unchanged lines are kept, except under the GUI, which may have changed memory directly
+    LINE_KEY sKey, *pKey = nullptr;
+    if (!GUI::IsActive())
+    {
+        GetLineKey(&sKey);
+        pKey = &sKey;
+    }
+
+    // Work out the line and block for the position
+    int nLine, nBlock = GetRasterPos(dwTime_, &nLine) >> 3;
 
     // Restrict the drawing to the visible area
     int nFrom = std::max(nLastLine, s_nViewTop), nTo = std::min(nLine, s_nViewBottom-1);
@@ -204,7 +403,7 @@ void Update ()
     {
         if (nBlock > nLastBlock)
         {
-            pFrame->UpdateLine(pScreen, nLine, nLastBlock, nBlock);
+            DrawLine(nLine, nLastBlock, nBlock, pKey);
             nLastBlock = nBlock;
         }
     }
@@ -219,7 +418,7 @@ void Update ()
             if (nFrom == nLastLine)
             {
                 // Finish the line, and exclude it from the draw range
-                pFrame->UpdateLine(pScreen, nLastLine, nLastBlock, WIDTH_BLOCKS);
+                DrawLine(nLastLine, nLastBlock, WIDTH_BLOCKS, pKey);
                 nFrom++;
             }
 
@@ -227,7 +426,7 @@ void Update ()
             if (nTo == nLine)
             {
                 // Draw a partial line
-                pFrame->UpdateLine(pScreen, nLine, 0, nBlock);
+                DrawLine(nLine, 0, nBlock, pKey);
 
                 // Exclude the line from the block as we've drawn it now
                 nTo--;
@@ -237,7 +436,7 @@ void Update ()
             for (int i = nFrom ; i <= nTo ; i++)
             {
                 // Draw a complete line
-                pFrame->UpdateLine(pScreen, i, 0, WIDTH_BLOCKS);
+                DrawLine(i, 0, WIDTH_BLOCKS, pKey);
             }
         }
 
@@ -247,73 +446,28 @@ void Update ()
     }
 }
 
+static void ApplyEvent (const FRAME_EVENT *pEvent_);
 
-// Begin the frame by copying from the previous frame, up to the last cange
-static void CopyBeforeLastUpdate ()
+// Update the frame image to the current raster position, replaying the logged changes on the way
+void Update ()
 {
-    // Determine the range in the visible area
-    int nBottom = std::min(nLastLine, s_nViewBottom-1) - s_nViewTop;
-
-    // If there anything to copy?
-    if (nBottom > 0)
-    {
-        // Copy the last partial line first
-        if (nBottom == (nLastLine-s_nViewTop))
-        {
-            BYTE* pLine = pScreen->GetLine(nBottom);
-            BYTE* pLastLine = pLastScreen->GetLine(nBottom);
-
-            int nRight = std::max(nLastBlock, s_nViewRight) - s_nViewLeft;
-            if (nRight > 0)
-                memcpy(pLine, pLastLine, nRight<<4);
-
-            nBottom--;
-        }
-
-        // Copy the remaining full lines
-        for (int i = 0 ; i <= nBottom ; i++)
-        {
-            BYTE* pLine = pScreen->GetLine(i);
-            BYTE* pLastLine = pLastScreen->GetLine(i);
-            memcpy(pLine, pLastLine, pScreen->GetPitch());
-        }
-    }
-}
+    // Don't do anything if the current frame is being skipped
+    if (!fDrawFrame)
+        return;
 
-// Complete the drawn frame after the raster using data from the previous frame
-static void CopyAfterRaster ()
-{
-    // Work out the range that is within the visible area
-    int nTop = std::max(nLastLine, s_nViewTop) - s_nViewTop;
-    int nBottom = s_nViewBottom - s_nViewTop;
+    CPerfScope perf(ptFrame);
 
-    // If there anything to copy?
-    if (nTop <= nBottom)
+    for (int i = 0 ; i < nEvents ; i++)
     {
-        // Complete the undrawn section of the current line, if any
-        if (nTop == (nLastLine-s_nViewTop))
-        {
-            BYTE* pLine = pScreen->GetLine(nTop);
-            BYTE* pLastLine = pLastScreen->GetLine(nTop);
-
-            int nOffset = (std::max(s_nViewLeft, nLastBlock) - s_nViewLeft) << 4;
-            int nWidth = pScreen->GetPitch() - nOffset;
-            if (nWidth > 0)
-                memcpy(pLine+nOffset, pLastLine+nOffset, nWidth);
-
-            nTop++;
-        }
-
-        // Copy the remaining lines
-        for (int i = nTop ; i < nBottom ; i++)
-        {
-            BYTE* pLine = pScreen->GetLine(i);
-            BYTE* pLastLine = pLastScreen->GetLine(i);
-            memcpy(pLine, pLastLine, pScreen->GetPitch());
-        }
+        DrawTo(asEvents[i].dwTime);
+        ApplyEvent(&asEvents[i]);
     }
+
+    nEvents = 0;
+    DrawTo(g_dwCycleCounter);
 }
 
+
 // Highlight the current raster position if it's on the visible display
 static void DrawRaster (CScreen *pScreen_)
 {
@@ -333,7 +487,7 @@ static void DrawRaster (CScreen *pScreen_)
     int nLine = (nLastLine - s_nViewTop) << 1;  // line number doubled due to GUI screen
 
     // Look up the next cycle colour
-    static int nPhase = 0;
+    static MACHINE_LOCAL int nPhase = 0;
     BYTE bColour = anFlash[++nPhase & 0xf];
 
     // Write the 2x2 pixel block
@@ -343,28 +497,124 @@ static void DrawRaster (CScreen *pScreen_)
 }
 
 
-// Begin the frame by copying from the previous frame, up to the last cange
+// Decide whether the frame can be drawn straight to the display target
+static bool UseDirect ()
+{
+    // The GUI, screenshots and recordings all need complete CScreen frames
+    if (!GetOption(directrender) || GUI::IsActive() || fSaveScreen || GIF::IsRecording() || AVI::IsRecording())
+        return false;
+
+    return Video::GetTarget(&sTarget);
+}
+
+// Find the lines the on-screen display may draw over, which are those outside the returned range
+static void FindOsdLines (int *pnTop_, int *pnBottom_)
+{
+    int nHeight = GetHeight() >> 1;
+    int nTop = 0, nBottom = nHeight;
+
+    // Drive LEDs are 2 lines, at the top or bottom of the view
+    if (GetOption(drivelights))
+    {
+        if ((GetOption(drivelights)-1) & 1)
+            nBottom = nHeight-4;
+        else
+            nTop = 4;
+    }
+
+    // Profile text and subsystem timings at the top, including the shadow
+    if (GetOption(perfstats) && aszPerf[0][0])
+        nTop = 4 + (MAX_PERF_TIMERS+2)*(CHAR_HEIGHT+2);
+    else if (GetOption(profile))
+        nTop = std::max(nTop, CHAR_HEIGHT+3);
+
+    // Status text at the bottom
+    if (GetOption(status) && szStatus[0])
+        nBottom = nHeight-CHAR_HEIGHT-2;
+
+    *pnTop_ = nTop;
+    *pnBottom_ = nBottom;
+}
+
+// Lines the on-screen display has been drawn over must be drawn again next time, to remove it
+static void ReleaseOsdLines ()
+{
+    int nTop, nBottom;
+    FindOsdLines(&nTop, &nBottom);
+
+    for (int i = 0, nHeight = GetHeight() >> 1 ; i < nHeight ; i++)
+    {
+        if (i < nTop || i >= nBottom)
+        {
+            asLines[i].fValid = false;
+
+            // Show the overlay, unless it's converted to the target separately
+            if (!fDirect)
+                Video::SetLineDirty(i);
+        }
+    }
+}
+
+// Stop drawing directly, redrawing the SAM screen from the current display memory
+static void EndDirect ()
+{
+    for (int i = s_nViewTop ; i < s_nViewBottom ; i++)
+        pFrame->UpdateLine(pScreen->GetLine(i-s_nViewTop), i, 0, WIDTH_BLOCKS);
+
+    // The display no longer matches the CScreen frame, so it all needs redrawing
+    InvalidateLines();
+    fDirect = false;
+    Video::SetDirty();
+}
+
+// Begin the frame, choosing how it's drawn
 void Begin ()
 {
+    // Pick up register changes made outside the I/O code, such as by a reset or the debugger
+    if (!nEvents)
+        pFrame->SyncRegs();
+
     // Return if we're skipping this frame
     if (!fDrawFrame)
         return;
 
-    // If we're debugging, copy up to the last-update position from the previous frame
-    CopyBeforeLastUpdate();
+    bool fWasDirect = fDirect;
+    fDirect = UseDirect();
+
+    if (fDirect)
+    {
+        // Redraw lines the display wants redrawn, or all of them if it was showing something else
+        for (int i = 0, nHeight = GetHeight() >> 1 ; i < nHeight ; i++)
+        {
+            if (!fWasDirect || Video::IsLineDirty(i))
+                asLines[i].fValid = false;
+        }
+
+        FindOsdLines(&nOsdTop, &nOsdBottom);
+    }
+    else if (fWasDirect)
+        EndDirect();
 }
 
 // Complete the displayed frame at the end of an emulated frame
 void End ()
 {
+#ifdef __LIBRETRO__
+    // Sync decides whether the next frame is drawn, so remember this one
+    bool fDrawn = fDrawFrame;
+#endif
+
     // Was the current frame drawn?
     if (fDrawFrame)
     {
+        CPerfScope perf(ptFrame);
+
         // Update the screen to the current raster position
         Update();
 
-        // If we're debugging, copy after the raster from the previous frame
-        CopyAfterRaster();
+        // Fall back on the CScreen frame if the GUI was started, or a recording
+        if (fDirect && !UseDirect())
+            EndDirect();
 
         if (GUI::IsActive())
         {
@@ -389,24 +639,43 @@ void End ()
             // Submit the completed frame
             Flip(pGuiScreen);
         }
-        else
+        else if (fDirect)
         {
-            // Screenshot required?
-            if (fSaveScreen)
+            // Overlay the floppy LEDs and status text
+            DrawOSD(pScreen);
+
+            // Convert the lines under them, which weren't drawn directly
+            for (int i = 0, nHeight = GetHeight() >> 1 ; i < nHeight ; i++)
             {
-                PNG::Save(pScreen);
-                fSaveScreen = false;
+                if (i < nOsdTop || i >= nOsdBottom)
+                    PutPixels(i, pScreen->GetLine(i), 0, pScreen->GetPitch());
             }
 
-            // Add the frame to any recordings
-            GIF::AddFrame(pScreen);
-            AVI::AddFrame(pScreen);
+            ReleaseOsdLines();
+        }
+        else
+        {
+            {
+                CPerfScope perfRecord(ptRecord);
+
+                // Screenshot required?
+                if (fSaveScreen)
+                {
+                    PNG::Save(pScreen);
+                    fSaveScreen = false;
+                }
+
+                // Add the frame to any recordings
+                GIF::AddFrame(pScreen);
+                AVI::AddFrame(pScreen);
+            }
 
             // Overlay the floppy LEDs and status text
             DrawOSD(pScreen);
+            ReleaseOsdLines();
 
-            // Submit the completed frame
-            Flip(pScreen);
+            // Submit the completed frame, with changed lines already marked by the drawing
+            pDisplayScreen = pScreen;
         }
 
         // Redraw what's new
@@ -415,6 +684,13 @@ void End ()
 
     // Decide whether we should draw the next frame
     Sync();
+
+#ifdef __LIBRETRO__
+    // Return to the front-end once the frame is in the video buffer, so it's
+    // presented without an extra frame of delay
+    if (fDrawn)
+        co_switch(mainThread);
+#endif
 }
 
 // Flyback to start drawing new frame
@@ -424,7 +700,6 @@ void Flyback ()
     nLastLine = nLastBlock = 0;
 
     // Toggle paper/ink colours every 16 emulated frames for the flash attribute in modes 1 and 2
-    static int nFlash = 0;
     if (!(++nFlash % 16))
         g_fFlashPhase = !g_fFlashPhase;
 
@@ -439,7 +714,7 @@ void Flyback ()
 
 void Sync ()
 {
-    static DWORD dwLastProfile, dwLastDrawn;
+    static MACHINE_LOCAL DWORD dwLastProfile, dwLastDrawn;
     DWORD dwNow = OSD::GetTime();
 
     // Determine whether we're running at increased speed during disk activity
@@ -480,6 +755,19 @@ void Sync ()
 
         // Reset frame counter
         nFrame = 0;
+
+        // Format the subsystem timings from the recent frames
+        PERF_STATS asStats[MAX_PERF_TIMERS], sTotal;
+        if (Perf::GetStats(asStats, &sTotal))
+        {
+            sprintf(aszPerf[0], "%-6s %6s %6s %6s", "ms", "min", "avg", "p99");
+
+            for (int i = 0 ; i <= MAX_PERF_TIMERS ; i++)
+            {
+                const PERF_STATS *p = (i < MAX_PERF_TIMERS) ? &asStats[i] : &sTotal;
+                sprintf(aszPerf[i+1], "%-6s %6.2f %6.2f %6.2f", Perf::GetName(i), p->dMin, p->dAvg, p->dP99);
+            }
+        }
     }
 
     // Throttle the speed when the GUI is active, as the I/O code isn't doing it
@@ -487,6 +775,7 @@ void Sync ()
     {
         // Add a frame's worth of silence
         static BYTE abSilence[SAMPLE_FREQ*SAMPLE_BLOCK/EMULATED_FRAMES_PER_SECOND];
+        CPerfScope perf(ptSync);
         Audio::AddData(abSilence, sizeof(abSilence));
     }
 }
@@ -494,21 +783,20 @@ void Sync ()
 
 void Redraw ()
 {
-    // Draw the last complete frame
-    Video::Update(pDisplayScreen);
-}
+    CPerfScope perf(ptVideo);
 
-#ifdef __LIBRETRO__
-extern "C" {
-#define LIBCO_C 
-#include "libco/libco.h"
-extern cothread_t mainThread;
-extern cothread_t emuThread;
+    // Draw the last complete frame, or show what's been drawn to the target
+    if (fDirect)
+        Video::UpdateTarget();
+    else
+        Video::Update(pDisplayScreen);
 }
-#endif
+
 // Determine the frame difference from last time and flip buffers
 void Flip (CScreen *pScreen_)
 {
+    CPerfScope perf(ptFlip);
+
     int nHeight = pScreen_->GetHeight() >> (GUI::IsActive() ? 0 : 1);
 
     DWORD* pdwA = reinterpret_cast<DWORD*>(pScreen_->GetLine(0));
@@ -533,12 +821,8 @@ void Flip (CScreen *pScreen_)
     // Remember the last drawn screen, to compare differences next time
     pDisplayScreen = pScreen_;
 
-    // Flip screen buffers
-    std::swap(pScreen, pLastScreen);
+    // Flip GUI screen buffers
     std::swap(pGuiScreen, pLastGuiScreen);
-#ifdef __LIBRETRO__
-	co_switch(mainThread);
-#endif
 }
 
 
@@ -583,6 +867,21 @@ void DrawOSD (CScreen* pScreen_)
         pScreen_->DrawString(nX-2, 1, szProfile, WHITE);
     }
 
+    // Show the subsystem timings, in the fixed font to keep the columns aligned
+    if (GetOption(perfstats) && !GUI::IsActive() && aszPerf[0][0])
+    {
+        pScreen_->SetFont(&sFixedFont);
+
+        for (int i = 0 ; i < MAX_PERF_TIMERS+2 ; i++)
+        {
+            int nY = 4 + i*(CHAR_HEIGHT+2);
+            pScreen_->DrawString(5, nY+1, aszPerf[i], BLACK);
+            pScreen_->DrawString(4, nY,   aszPerf[i], WHITE);
+        }
+
+        pScreen_->SetFont(&sPropFont);
+    }
+
     // Any active status line?
     if (GetOption(status) && szStatus[0])
     {
@@ -617,29 +916,43 @@ void SetStatus (const char *pcszFormat_, ...)
 // Fetch the current horizontal raster position (in cycles) and the current line
 int GetRasterPos (int *pnLine_)
 {
-    if (g_dwCycleCounter >= BORDER_PIXELS)
-    {
-        DWORD dwScreenCycles = g_dwCycleCounter - BORDER_PIXELS;
-        *pnLine_ = dwScreenCycles / TSTATES_PER_LINE;
-        return dwScreenCycles % TSTATES_PER_LINE;
-    }
-
-    // FIXME: the very start of the interrupt frame is from the final line of the display
-    *pnLine_ = 0;
-    return 0;
+    return GetRasterPos(g_dwCycleCounter, pnLine_);
 }
 
 // Fetch the 4 bytes the ASIC uses to generate the next 8-pixel cell
 void GetAsicData (BYTE *pb0_, BYTE *pb1_, BYTE *pb2_, BYTE *pb3_)
 {
-    pFrame->GetAsicData(pb0_, pb1_, pb2_, pb3_);
+    // Bring the drawing registers up to date first
+    Update();
+
+    pFrame->GetAsicData(g_dwCycleCounter, pb0_, pb1_, pb2_, pb3_);
 }
 
-// Handle screen mode changes
-// Changes on the main screen may generate an artefact by using old data in the new mode (described by Dave Laundon)
-void ChangeMode (BYTE bNewVmpr_)
+// Return the line to draw a single block artefact into
+static BYTE *GetArtefactLine (int nLine_)
+{
+    int nRow = nLine_ - s_nViewTop;
+    return (fDrawFrame && fDirect && nRow >= nOsdTop && nRow < nOsdBottom) ? abLine : pScreen->GetLine(nRow);
+}
+
+// Convert a single block artefact to the display target, if it was drawn to the scratch line
+static void PutArtefact (const BYTE *pbLine_, int nLine_, int nBlock_)
+{
+    // The line no longer matches its drawing settings alone
+    if (nLine_ >= s_nViewTop && nLine_ < s_nViewBottom)
+        asLines[nLine_ - s_nViewTop].fValid = false;
+
+    if (pbLine_ == abLine)
+    {
+        int nOffset = (nBlock_ - s_nViewLeft) << 4;
+        PutPixels(nLine_ - s_nViewTop, abLine + nOffset, nOffset, 16);
+    }
+}
+
+// Screen mode changes on the main screen may generate an artefact by using old data in the new mode (described by Dave Laundon)
+static void ModeArtefact (DWORD dwTime_, BYTE bNewVmpr_)
 {
-    int nLine, nBlock = GetRasterPos(&nLine) >> 3;
+    int nLine, nBlock = GetRasterPos(dwTime_, &nLine) >> 3;
 
     // Action only needs to be taken on main screen lines
     if (IsScreenLine(nLine))
@@ -648,56 +961,176 @@ void ChangeMode (BYTE bNewVmpr_)
         if (nBlock < (BORDER_BLOCKS+SCREEN_BLOCKS))
         {
             // Is the mode changing between 1/2 <-> 3/4 on the main screen?
-            if (((vmpr_mode ^ bNewVmpr_) & VMPR_MDE1_MASK) && nBlock >= BORDER_BLOCKS)
+            if (((pFrame->GetRegs().bVmpr ^ bNewVmpr_) & VMPR_MDE1_MASK) && nBlock >= BORDER_BLOCKS)
             {
-                BYTE *pbLine = pScreen->GetLine(nLine-s_nViewTop);
+                BYTE *pbLine = GetArtefactLine(nLine);
 
                 // Draw the artefact and advance the draw position
-                pFrame->ModeChange(pbLine, nLine, nBlock, bNewVmpr_);
+                pFrame->ModeChange(pbLine, nLine, nBlock, dwTime_, bNewVmpr_);
+                PutArtefact(pbLine, nLine, nBlock);
 
                 nLastBlock += (VIDEO_DELAY >> 3);
             }
         }
     }
-
-    // Update the mode in the rendering object
-    pFrame->SetMode(bNewVmpr_);
 }
 
-
-// Handle the screen being enabled, which causes a border pixel artefact (reported by Andrew Collier)
-void ChangeScreen (BYTE bNewBorder_)
+// The screen being enabled causes a border pixel artefact (reported by Andrew Collier)
+static void ScreenArtefact (DWORD dwTime_, BYTE bNewBorder_)
 {
-    int nLine, nBlock = GetRasterPos(&nLine) >> 3;
+    int nLine, nBlock = GetRasterPos(dwTime_, &nLine) >> 3;
 
     // Only draw if the artefact cell is visible
     if (nLine >= s_nViewTop && nLine < s_nViewBottom && nBlock >= s_nViewLeft && nBlock < s_nViewRight)
     {
-        BYTE *pbLine = pScreen->GetLine(nLine-s_nViewTop);
+        BYTE *pbLine = GetArtefactLine(nLine);
 
         // Draw the artefact and advance the draw position
         pFrame->ScreenChange(pbLine, nLine, nBlock, bNewBorder_);
+        PutArtefact(pbLine, nLine, nBlock);
         nLastBlock += (VIDEO_DELAY >> 3);
     }
 }
 
+// Apply a logged change to the drawing registers, drawing any artefact it causes at its position
+static void ApplyEvent (const FRAME_EVENT *pEvent_)
+{
+    BYTE bVal = pEvent_->bVal;
+
+    switch (pEvent_->bReg)
+    {
+        case evVmpr:
+            ModeArtefact(pEvent_->dwTime, bVal);
+            pFrame->SetMode(bVal);
+            break;
+
+        case evBorder:
+        {
+            BYTE bBorder = pFrame->GetRegs().bBorder;
+
+            // Enabling the screen in mode 3 or 4?
+            if (((bBorder ^ bVal) & BORD_SOFF_MASK) && (bBorder & BORD_SOFF_MASK) && (pFrame->GetRegs().bVmpr & VMPR_MDE1_MASK))
+                ScreenArtefact(pEvent_->dwTime, bVal);
+
+            pFrame->SetBorder(bVal);
+            break;
+        }
+
+        case evHmpr:
+            pFrame->SetHmpr(bVal);
+            break;
+
+        default:
+            pFrame->SetClut(pEvent_->bReg, bVal);
+            break;
+    }
+}
+
+// Log a display register change at the current cycle position, to be drawn from there when the frame is next updated
+static void LogEvent (BYTE bReg_, BYTE bVal_)
+{
+    FRAME_EVENT sEvent = { g_dwCycleCounter, bReg_, bVal_ };
+
+    // There's nothing to draw in skipped frames, so the change applies straight away
+    if (!fDrawFrame)
+        ApplyEvent(&sEvent);
+    else
+    {
+        // Draw up to the current position if there's no room for more changes
+        if (nEvents == MAX_FRAME_EVENTS)
+            Update();
+
+        asEvents[nEvents++] = sEvent;
+    }
+}
+
+// Handle screen mode or page changes, which the I/O code times for when they become visible
+void ChangeMode (BYTE bNewVmpr_)
+{
+    // Screen writes are only checked against the new display page, so draw the lines
+    // using the old page or mode now, before later writes to it can change them
+    if ((bNewVmpr_ ^ vmpr) & (VMPR_MODE_MASK|VMPR_PAGE_MASK))
+        Update();
+
+    LogEvent(evVmpr, bNewVmpr_);
+}
+
+// Handle border colour changes, and the screen being disabled or enabled
+void ChangeBorder (BYTE bNewBorder_)
+{
+    LogEvent(evBorder, bNewBorder_);
+}
+
+// Handle a CLUT entry change
+void ChangeClut (int nReg_, BYTE bVal_)
+{
+    LogEvent(static_cast<BYTE>(nReg_), bVal_);
+}
+
+// Handle HMPR changes, which select the mode 3 colours
+void ChangeHmpr (BYTE bNewHmpr_)
+{
+    LogEvent(evHmpr, bNewHmpr_);
+}
+
 // A screen line in a specified range is being written to, so we need to ensure it's up-to-date
 void TouchLines (int nFrom_, int nTo_)
 {
     // Is the line being modified in the area since we last updated
     if (nTo_ >= nLastLine && nFrom_ <= (int)((g_dwCycleCounter - BORDER_PIXELS) / TSTATES_PER_LINE))
         Update();
+
+    // The lines must be drawn again, even if their settings are unchanged
+    for (int i = std::max(nFrom_, 0), nTo = std::min(nTo_, HEIGHT_LINES-1) ; i <= nTo ; i++)
+        afWritten[i] = true;
+}
+
+
+// Save or restore the raster and flash state, re-selecting the rendering mode on load
+void Serialize (CState &state_)
+{
+    state_.Section(STATE_TAG('F','R','M',' '));
+
+    state_.Value(nLastLine);
+    state_.Value(nLastBlock);
+    state_.Value(nFlash);
+    state_.Value(g_fFlashPhase);
+
+    if (state_.IsLoading())
+    {
+        // Memory has changed without passing through the write checks
+        InvalidateLines();
+
+        // Discard changes logged since the restored point, and take the restored registers
+        nEvents = 0;
+        if (pFrame)
+            pFrame->SyncRegs();
+    }
 }
 
 } // nsmespace Frame
 
 
+// Take the current emulated display registers, when there are no logged changes to replay
+void CFrame::SyncRegs ()
+{
+    for (int i = 0 ; i < N_CLUT_REGS ; i++)
+        m_sRegs.auClut[i] = clut[i];
+
+    m_sRegs.bHmpr = hmpr;
+    m_sRegs.bBorder = border;
+    UpdateMode3Clut();
+    SetMode(vmpr);
+}
+
 // Set a new screen mode (VMPR value)
 void CFrame::SetMode (BYTE bNewVmpr_)
 {
     static FNLINEUPDATE apfnLineUpdates[] =
         { &CFrame::Mode1Line, &CFrame::Mode2Line, &CFrame::Mode3Line, &CFrame::Mode4Line };
 
+    m_sRegs.bVmpr = bNewVmpr_ & (VMPR_MODE_MASK|VMPR_PAGE_MASK);
+
     m_pLineUpdate = apfnLineUpdates[(bNewVmpr_ & VMPR_MODE_MASK) >> 5];
 
     // Bit 0 of the VMPR page is always taken as zero for modes 3 and 4
@@ -705,40 +1138,65 @@ void CFrame::SetMode (BYTE bNewVmpr_)
     m_pbScreenData = PageReadPtr(nPage);
 }
 
-// Update a line segment of display or border
-void CFrame::UpdateLine (CScreen *pScreen_, int nLine_, int nFrom_, int nTo_)
+// Set a new border colour and screen-off state
+void CFrame::SetBorder (BYTE bVal_)
 {
-    // Is the line within the view port?
-    if (nLine_ >= s_nViewTop && nLine_ < s_nViewBottom)
-    {
-        // Fetch the screen data pointer for the line
-        BYTE* pbLine = pScreen_->GetLine(nLine_-s_nViewTop);
+    m_sRegs.bBorder = bVal_;
+}
+
+// Set a new CLUT entry value
+void CFrame::SetClut (int nReg_, BYTE bVal_)
+{
+    m_sRegs.auClut[nReg_] = bVal_;
+    UpdateMode3Clut();
+}
 
-        // Screen off in mode 3 or 4?
-        if (BORD_SOFF && VMPR_MODE_3_OR_4)
-            BlackLine(pbLine, nFrom_, nTo_);
+// Set a new HMPR value, for the mode 3 colour selection
+void CFrame::SetHmpr (BYTE bVal_)
+{
+    m_sRegs.bHmpr = bVal_;
+    UpdateMode3Clut();
+}
 
-        // Line on the main screen?
-        else if (nLine_ >= TOP_BORDER_LINES && nLine_ < (TOP_BORDER_LINES+SCREEN_LINES))
-            (this->*m_pLineUpdate)(pbLine, nLine_, nFrom_, nTo_);
+// Update the 4 colours available to mode 3 (note: the middle colours are switched)
+void CFrame::UpdateMode3Clut ()
+{
+    BYTE bBCD48 = (m_sRegs.bHmpr & HMPR_MD3COL_MASK) >> 3;
+    m_sRegs.auMode3Clut[0] = m_sRegs.auClut[bBCD48 | 0];
+    m_sRegs.auMode3Clut[1] = m_sRegs.auClut[bBCD48 | 2];
+    m_sRegs.auMode3Clut[2] = m_sRegs.auClut[bBCD48 | 1];
+    m_sRegs.auMode3Clut[3] = m_sRegs.auClut[bBCD48 | 3];
+}
 
-        // Top or bottom border
-        else// if (nLine_ < TOP_BORDER_LINES || nLine_ >= (TOP_BORDER_LINES+SCREEN_LINES))
-            BorderLine(pbLine, nFrom_, nTo_);
-    }
+// Update a line segment of display or border, for a line within the view port
+void CFrame::UpdateLine (BYTE *pbLine_, int nLine_, int nFrom_, int nTo_)
+{
+    // Screen off in mode 3 or 4?
+    if ((m_sRegs.bBorder & BORD_SOFF_MASK) && (m_sRegs.bVmpr & VMPR_MDE1_MASK))
+        BlackLine(pbLine_, nFrom_, nTo_);
+
+    // Line on the main screen?
+    else if (nLine_ >= TOP_BORDER_LINES && nLine_ < (TOP_BORDER_LINES+SCREEN_LINES))
+        (this->*m_pLineUpdate)(pbLine_, nLine_, nFrom_, nTo_);
+
+    // Top or bottom border
+    else// if (nLine_ < TOP_BORDER_LINES || nLine_ >= (TOP_BORDER_LINES+SCREEN_LINES))
+        BorderLine(pbLine_, nFrom_, nTo_);
 }
 
-// Fetch the internal ASIC working values used when drawing the display
-void CFrame::GetAsicData (BYTE *pb0_, BYTE *pb1_, BYTE *pb2_, BYTE *pb3_)
+// Fetch the internal ASIC working values used when drawing the display at a given cycle position
+void CFrame::GetAsicData (DWORD dwTime_, BYTE *pb0_, BYTE *pb1_, BYTE *pb2_, BYTE *pb3_)
 {
-    int nLine = g_dwCycleCounter / TSTATES_PER_LINE, nBlock = (g_dwCycleCounter % TSTATES_PER_LINE) >> 3;
+    int nLine = dwTime_ / TSTATES_PER_LINE, nBlock = (dwTime_ % TSTATES_PER_LINE) >> 3;
 
     nLine -= TOP_BORDER_LINES;
     nBlock -= BORDER_BLOCKS+BORDER_BLOCKS;
     if (nBlock < 0) { nLine--; nBlock = SCREEN_BLOCKS-1; }
     if (nLine < 0 || nLine >= SCREEN_LINES) { nLine = SCREEN_LINES-1; nBlock = SCREEN_BLOCKS-1; }
 
-    if (VMPR_MODE_3_OR_4)
+    BYTE bMode = m_sRegs.bVmpr & VMPR_MODE_MASK;
+
+    if (bMode & VMPR_MDE1_MASK)
     {
         BYTE* pb = m_pbScreenData + (nLine << 7) + (nBlock << 2);
         *pb0_ = pb[0];
@@ -748,8 +1206,8 @@ void CFrame::GetAsicData (BYTE *pb0_, BYTE *pb1_, BYTE *pb2_, BYTE *pb3_)
     }
     else
     {
-        BYTE* pData = m_pbScreenData + ((VMPR_MODE == MODE_1) ? g_awMode1LineToByte[nLine] + nBlock : (nLine << 5) + nBlock);
-        BYTE* pAttr = (VMPR_MODE == MODE_1) ? m_pbScreenData + 6144 + ((nLine & 0xf8) << 2) + nBlock : pData + 0x2000;
+        BYTE* pData = m_pbScreenData + ((bMode == MODE_1) ? g_awMode1LineToByte[nLine] + nBlock : (nLine << 5) + nBlock);
+        BYTE* pAttr = (bMode == MODE_1) ? m_pbScreenData + 6144 + ((nLine & 0xf8) << 2) + nBlock : pData + 0x2000;
         *pb0_ = *pb1_ = *pData;
         *pb2_ = *pb3_ = *pAttr;
     }
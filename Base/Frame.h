@@ -21,16 +21,24 @@
 // Notes:
 //  Contains portions of the drawing code are from the original SAMGRX.C
 //  ASIC artefact during mode change identified by Dave Laundon
+//
+//  Changes to the display registers are logged with their time, rather than
+//  drawing up to the raster on each one.  The log is replayed when the frame
+//  is next drawn, with CFrame keeping its own copy of the registers as they
+//  were at each point, so drawing doesn't depend on the emulated state.
 
 #ifndef FRAME_H
 #define FRAME_H
 
 #include "CPU.h"
 #include "IO.h"
+#include "Render.h"
 #include "Screen.h"
 #include "Util.h"
 
 
+class CState;
+
 namespace Frame
 {
     bool Init (bool fFirstInit_=false);
@@ -47,7 +55,9 @@ namespace Frame
 
     void GetAsicData (BYTE *pb0_, BYTE *pb1_, BYTE *pb2_, BYTE *pb3_);
     void ChangeMode (BYTE bNewVmpr_);
-    void ChangeScreen (BYTE bNewBorder_);
+    void ChangeBorder (BYTE bNewBorder_);
+    void ChangeClut (int nReg_, BYTE bVal_);
+    void ChangeHmpr (BYTE bNewHmpr_);
 
     void Sync ();
     void Redraw ();
@@ -59,6 +69,8 @@ namespace Frame
     void SetView (UINT uBlocks_, UINT uLines_);
 
     void SetStatus (const char *pcszFormat_, ...);
+
+    void Serialize (CState &state_);
 }
 
 
@@ -67,34 +79,50 @@ inline BYTE AttrBg (BYTE bAttr_) { return (((bAttr_) >> 3) & 0xf); }
 inline BYTE AttrFg (BYTE bAttr_) { return ((((bAttr_) >> 3) & 8) | ((bAttr_) & 7)); }
 
 
-extern bool fDrawFrame, g_fFlashPhase;
-extern int nFrame;
+extern MACHINE_LOCAL bool fDrawFrame, g_fFlashPhase;
+extern MACHINE_LOCAL int nFrame;
 
-extern int s_nWidth, s_nHeight;         // in mode 3 pixels
-extern int s_nViewTop, s_nViewBottom;   // in lines
-extern int s_nViewLeft, s_nViewRight;   // in screen blocks
+extern MACHINE_LOCAL int s_nWidth, s_nHeight;         // in mode 3 pixels
+extern MACHINE_LOCAL int s_nViewTop, s_nViewBottom;   // in lines
+extern MACHINE_LOCAL int s_nViewLeft, s_nViewRight;   // in screen blocks
 
-extern WORD g_awMode1LineToByte[SCREEN_LINES];
+extern MACHINE_LOCAL WORD g_awMode1LineToByte[SCREEN_LINES];
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Display registers used for drawing, which trail the emulated ones until logged changes are replayed
+typedef struct
+{
+    UINT auClut[N_CLUT_REGS];   // palette index for each CLUT entry
+    UINT auMode3Clut[4];        // mode 3 colours, from the CLUT and HMPR
+    BYTE bVmpr, bHmpr, bBorder;
+}
+FRAME_REGS;
+
 // Generic base for all screen classes
 class CFrame
 {
     typedef void (CFrame::* FNLINEUPDATE)(BYTE *pbLine_, int nLine_, int nFrom_, int nTo_);
 
     public:
-        CFrame () : m_pLineUpdate(&CFrame::Mode1Line), m_pbScreenData(nullptr) { }
+        CFrame () : m_pLineUpdate(&CFrame::Mode1Line), m_pbScreenData(nullptr), m_sRegs() { }
         CFrame (const CFrame &) = delete;
         void operator= (const CFrame &) = delete;
         virtual ~CFrame () = default;
 
     public:
+        const FRAME_REGS &GetRegs () const { return m_sRegs; }
+        void SyncRegs ();
+
         void SetMode (BYTE bVal_);
-        void UpdateLine (CScreen *pScreen_, int nLine_, int nFrom_, int nTo_);
-        void GetAsicData (BYTE *pb0_, BYTE *pb1_, BYTE *pb2_, BYTE *pb3_);
+        void SetBorder (BYTE bVal_);
+        void SetClut (int nReg_, BYTE bVal_);
+        void SetHmpr (BYTE bVal_);
+
+        void UpdateLine (BYTE *pbLine_, int nLine_, int nFrom_, int nTo_);
+        void GetAsicData (DWORD dwTime_, BYTE *pb0_, BYTE *pb1_, BYTE *pb2_, BYTE *pb3_);
 
-        void ModeChange (BYTE *pbLine_, int nLine_, int nBlock_, BYTE bNewVmpr_);
+        void ModeChange (BYTE *pbLine_, int nLine_, int nBlock_, DWORD dwTime_, BYTE bNewVmpr_);
         void ScreenChange (BYTE *pbLine_, int nLine_, int nBlock_, BYTE bNewBorder_);
 
     protected:
@@ -108,9 +136,13 @@ class CFrame
         void Mode3Line (BYTE *pbLine_, int nLine_, int nFrom_, int nTo_);
         void Mode4Line (BYTE *pbLine_, int nLine_, int nFrom_, int nTo_);
 
+        void UpdateMode3Clut ();
+        UINT BorderColour () const { return m_sRegs.auClut[BORD_VAL(m_sRegs.bBorder)]; }
+
     protected:
         FNLINEUPDATE m_pLineUpdate;     // Function used to draw current mode
         BYTE *m_pbScreenData;           // Cached pointer to start of RAM page containing video memory
+        FRAME_REGS m_sRegs;             // Display registers at the current drawing position
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -121,7 +153,7 @@ inline void CFrame::LeftBorder (BYTE *pbLine_, int nFrom_, int nTo_)
 
     // Draw the required section of the left border, if any
     if (nFrom < nTo)
-        memset(pbLine_ + ((nFrom-s_nViewLeft) << 4), clut[border_col], (nTo - nFrom) << 4);
+        memset(pbLine_ + ((nFrom-s_nViewLeft) << 4), BorderColour(), (nTo - nFrom) << 4);
 }
 
 inline void CFrame::RightBorder (BYTE *pbLine_, int nFrom_, int nTo_)
@@ -130,7 +162,7 @@ inline void CFrame::RightBorder (BYTE *pbLine_, int nFrom_, int nTo_)
 
     // Draw the required section of the right border, if any
     if (nFrom < nTo)
-        memset(pbLine_ + ((nFrom-s_nViewLeft) << 4), clut[border_col], (nTo - nFrom) << 4);
+        memset(pbLine_ + ((nFrom-s_nViewLeft) << 4), BorderColour(), (nTo - nFrom) << 4);
 }
 
 inline void CFrame::BorderLine (BYTE *pbLine_, int nFrom_, int nTo_)
@@ -140,7 +172,7 @@ inline void CFrame::BorderLine (BYTE *pbLine_, int nFrom_, int nTo_)
 
     // Draw the required section of the border, if any
     if (nFrom < nTo)
-        memset(pbLine_ + ((nFrom-s_nViewLeft) << 4), clut[border_col], (nTo - nFrom) << 4);
+        memset(pbLine_ + ((nFrom-s_nViewLeft) << 4), BorderColour(), (nTo - nFrom) << 4);
 }
 
 inline void CFrame::BlackLine (BYTE *pbLine_, int nFrom_, int nTo_)
@@ -172,27 +204,7 @@ inline void CFrame::Mode1Line (BYTE *pbLine_, int nLine_, int nFrom_, int nTo_)
         BYTE *pbAttrMem = m_pbScreenData + 6144 + ((nLine_ & 0xf8) << 2) + (nFrom - BORDER_BLOCKS);
 
         // The actual screen line
-        for (int i = nFrom; i < nTo; i++)
-        {
-            BYTE bData = *pbDataMem++, bAttr = *pbAttrMem++, bInk = AttrFg(bAttr), bPaper = AttrBg(bAttr);
-
-            // toggle the colours if we're in the inverse part of the FLASH cycle
-            if (g_fFlashPhase && (bAttr & 0x80))
-                std::swap(bInk, bPaper);
-
-            BYTE ink = clut[bInk], paper = clut[bPaper];
-
-            pFrame[0]  = pFrame[1]  = (bData & 0x80) ? ink : paper;
-            pFrame[2]  = pFrame[3]  = (bData & 0x40) ? ink : paper;
-            pFrame[4]  = pFrame[5]  = (bData & 0x20) ? ink : paper;
-            pFrame[6]  = pFrame[7]  = (bData & 0x10) ? ink : paper;
-            pFrame[8]  = pFrame[9]  = (bData & 0x08) ? ink : paper;
-            pFrame[10] = pFrame[11] = (bData & 0x04) ? ink : paper;
-            pFrame[12] = pFrame[13] = (bData & 0x02) ? ink : paper;
-            pFrame[14] = pFrame[15] = (bData & 0x01) ? ink : paper;
-
-            pFrame += 16;
-        }
+        g_pRenderer->pfnAttr(pFrame, pbDataMem, pbAttrMem, nTo - nFrom, m_sRegs.auClut, g_fFlashPhase);
     }
 
     // Draw the required section of the right border, if any
@@ -217,27 +229,7 @@ inline void CFrame::Mode2Line (BYTE *pbLine_, int nLine_, int nFrom_, int nTo_)
         BYTE *pbAttrMem = pbDataMem + 0x2000;
 
         // The actual screen line
-        for (int i = nFrom; i < nTo; i++)
-        {
-            BYTE bData = *pbDataMem++, bAttr = *pbAttrMem++, bInk = AttrFg(bAttr), bPaper = AttrBg(bAttr);
-
-            // toggle the colours if we're in the inverse part of the FLASH cycle
-            if (g_fFlashPhase && (bAttr & 0x80))
-                std::swap(bInk, bPaper);
-
-            BYTE ink = clut[bInk], paper = clut[bPaper];
-
-            pFrame[0]  = pFrame[1]  = (bData & 0x80) ? ink : paper;
-            pFrame[2]  = pFrame[3]  = (bData & 0x40) ? ink : paper;
-            pFrame[4]  = pFrame[5]  = (bData & 0x20) ? ink : paper;
-            pFrame[6]  = pFrame[7]  = (bData & 0x10) ? ink : paper;
-            pFrame[8]  = pFrame[9]  = (bData & 0x08) ? ink : paper;
-            pFrame[10] = pFrame[11] = (bData & 0x04) ? ink : paper;
-            pFrame[12] = pFrame[13] = (bData & 0x02) ? ink : paper;
-            pFrame[14] = pFrame[15] = (bData & 0x01) ? ink : paper;
-
-            pFrame += 16;
-        }
+        g_pRenderer->pfnAttr(pFrame, pbDataMem, pbAttrMem, nTo - nFrom, m_sRegs.auClut, g_fFlashPhase);
     }
 
     // Draw the required section of the right border, if any
@@ -261,38 +253,7 @@ inline void CFrame::Mode3Line (BYTE *pbLine_, int nLine_, int nFrom_, int nTo_)
         BYTE *pbDataMem = m_pbScreenData + (nLine_ << 7) + ((nFrom - BORDER_BLOCKS) << 2);
 
         // The actual screen line
-        for (int i = nFrom; i < nTo; i++)
-        {
-            BYTE bData;
-
-            bData = pbDataMem[0];
-            pFrame[0] = mode3clut[ bData         >> 6];
-            pFrame[1] = mode3clut[(bData & 0x30) >> 4];
-            pFrame[2] = mode3clut[(bData & 0x0c) >> 2];
-            pFrame[3] = mode3clut[(bData & 0x03)     ];
-
-            bData = pbDataMem[1];
-            pFrame[4] = mode3clut[ bData         >> 6];
-            pFrame[5] = mode3clut[(bData & 0x30) >> 4];
-            pFrame[6] = mode3clut[(bData & 0x0c) >> 2];
-            pFrame[7] = mode3clut[(bData & 0x03)     ];
-
-            bData = pbDataMem[2];
-            pFrame[8]  = mode3clut[ bData         >> 6];
-            pFrame[9]  = mode3clut[(bData & 0x30) >> 4];
-            pFrame[10] = mode3clut[(bData & 0x0c) >> 2];
-            pFrame[11] = mode3clut[(bData & 0x03)     ];
-
-            bData = pbDataMem[3];
-            pFrame[12] = mode3clut[ bData         >> 6];
-            pFrame[13] = mode3clut[(bData & 0x30) >> 4];
-            pFrame[14] = mode3clut[(bData & 0x0c) >> 2];
-            pFrame[15] = mode3clut[(bData & 0x03)     ];
-
-            pFrame += 16;
-
-            pbDataMem += 4;
-        }
+        g_pRenderer->pfnMode3(pFrame, pbDataMem, nTo - nFrom, m_sRegs.auMode3Clut);
     }
 
     // Draw the required section of the right border, if any
@@ -316,46 +277,24 @@ inline void CFrame::Mode4Line (BYTE *pbLine_, int nLine_, int nFrom_, int nTo_)
         BYTE *pbDataMem = ((nFrom - BORDER_BLOCKS) << 2) + m_pbScreenData + (nLine_ << 7);
 
         // The actual screen line
-        for (int i = nFrom; i < nTo; i++)
-        {
-            BYTE bData;
-
-            bData = pbDataMem[0];
-            pFrame[0]  = pFrame[1]  = clut[bData >> 4];
-            pFrame[2]  = pFrame[3]  = clut[bData & 0x0f];
-
-            bData = pbDataMem[1];
-            pFrame[4]  = pFrame[5]  = clut[bData >> 4];
-            pFrame[6]  = pFrame[7]  = clut[bData & 0x0f];
-
-            bData = pbDataMem[2];
-            pFrame[8]  = pFrame[9]  = clut[bData >> 4];
-            pFrame[10] = pFrame[11] = clut[bData & 0x0f];
-
-            bData = pbDataMem[3];
-            pFrame[12] = pFrame[13] = clut[bData >> 4];
-            pFrame[14] = pFrame[15] = clut[bData & 0x0f];
-
-            pFrame += 16;
-            pbDataMem += 4;
-        }
+        g_pRenderer->pfnMode4(pFrame, pbDataMem, nTo - nFrom, m_sRegs.auClut);
     }
 
     // Draw the required section of the right border, if any
     RightBorder(pbLine_, nFrom_, nTo_);
 }
 
-inline void CFrame::ModeChange (BYTE *pbLine_, int nLine_, int nBlock_, BYTE bNewVmpr_)
+inline void CFrame::ModeChange (BYTE *pbLine_, int nLine_, int nBlock_, DWORD dwTime_, BYTE bNewVmpr_)
 {
     int nScreenLine = nLine_ - TOP_BORDER_LINES;
     BYTE ab[4];
 
     // Fetch the 4 display data bytes for the original mode
     BYTE b0, b1, b2, b3;
-    GetAsicData(&b0, &b1, &b2, &b3);
+    GetAsicData(dwTime_, &b0, &b1, &b2, &b3);
 
     // Perform the necessary massaging the ASIC does to prepare for display
-    if (VMPR_MODE_3_OR_4)
+    if (m_sRegs.bVmpr & VMPR_MDE1_MASK)
     {
         // Mode 3+4
         ab[0] = ab[1] = ( b0       & 0x80) | ((b0 << 3) & 0x40) |
@@ -435,13 +374,13 @@ inline void CFrame::ScreenChange (BYTE *pbLine_, int /*nLine_*/, int nBlock_, BY
     // Part of the first pixel is the previous border colour, from when the screen was disabled.
     // We don't have the resolution to show only part, but using the most significant colour bits
     // in the least significant position will reduce the intensity enough to be close
-    pFrame[0] = clut[border_col] >> 4;
+    pFrame[0] = BorderColour() >> 4;
 
     // The rest of the cell is the new border colour, even on the main screen since the ASIC has no data!
                  pFrame[1]  = pFrame[2]  = pFrame[3]  =
     pFrame[4]  = pFrame[5]  = pFrame[6]  = pFrame[7]  =
     pFrame[8]  = pFrame[9]  = pFrame[10] = pFrame[11] =
-    pFrame[12] = pFrame[13] = pFrame[14] = pFrame[15] = clut[BORD_COL(bNewBorder_)];
+    pFrame[12] = pFrame[13] = pFrame[14] = pFrame[15] = m_sRegs.auClut[BORD_VAL(bNewBorder_)];
 }
 
 #endif  // FRAME_H
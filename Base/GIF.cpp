@@ -32,18 +32,18 @@
 namespace GIF
 {
 
-static BYTE *pbCurr, *pbFirst, *pbSub;
+static MACHINE_LOCAL BYTE *pbCurr, *pbFirst, *pbSub;
 
-static char szPath[MAX_PATH], *pszFile;
-static FILE *f;
+static MACHINE_LOCAL char szPath[MAX_PATH], *pszFile;
+static MACHINE_LOCAL FILE *f;
 
-static int nDelay = 0;
-static long lDelayOffset;
-static int wl, wt, ww, wh;	// left/top/width/height for change rect
-static int nFrameSkip = 3;	// 50/2 = 25fps (FF/Chrome/Safari/Opera), 50/3 = 16.6fps (IE grrr!)
+static MACHINE_LOCAL int nDelay = 0;
+static MACHINE_LOCAL long lDelayOffset;
+static MACHINE_LOCAL int wl, wt, ww, wh;	// left/top/width/height for change rect
+static MACHINE_LOCAL int nFrameSkip = 3;	// 50/2 = 25fps (FF/Chrome/Safari/Opera), 50/3 = 16.6fps (IE grrr!)
 
 enum LoopState { kNone, kIgnoreFirstChange, kWaitLoopStart, kLoopStarted };
-static LoopState nLoopState;
+static MACHINE_LOCAL LoopState nLoopState;
 
 #define COLOUR_DEPTH	7	// 128 SAM colours
 
@@ -455,7 +455,7 @@ void AddFrame (CScreen *pScreen_)
     }
 
     // GIF isn't suited to full framerate recording, so frame-skip
-    static int nFrames;
+    static MACHINE_LOCAL int nFrames;
     if ((nFrames++ % nFrameSkip))
         return;
 
@@ -40,13 +40,13 @@
 #include "UI.h"
 #include "Video.h"
 
-CWindow *GUI::s_pGUI;
-int GUI::s_nX, GUI::s_nY;
+MACHINE_LOCAL CWindow *GUI::s_pGUI;
+MACHINE_LOCAL int GUI::s_nX, GUI::s_nY;
 
-static DWORD dwLastClick = 0;   // Time of last double-click
+static MACHINE_LOCAL DWORD dwLastClick = 0;   // Time of last double-click
 
-std::queue<CWindow *> GUI::s_garbageQueue;
-std::stack<CWindow*> GUI::s_dialogStack;
+MACHINE_LOCAL std::queue<CWindow *> GUI::s_garbageQueue;
+MACHINE_LOCAL std::stack<CWindow*> GUI::s_dialogStack;
 
 bool GUI::SendMessage (int nMessage_, int nParam1_/*=0*/, int nParam2_/*=0*/)
 {
@@ -64,8 +64,8 @@ bool GUI::SendMessage (int nMessage_, int nParam1_/*=0*/, int nParam2_/*=0*/)
     // Check for double-clicks
     else if (nMessage_ == GM_BUTTONDOWN)
     {
-        static int nLastX, nLastY;
-        static bool fDouble = false;
+        static MACHINE_LOCAL int nLastX, nLastY;
+        static MACHINE_LOCAL bool fDouble = false;
 
         // Work out how long it's been since the last click, and how much the mouse has moved
         DWORD dwNow = OSD::GetTime();
@@ -715,7 +715,7 @@ void CCheckBox::Draw (CScreen* pScreen_)
 
 bool CCheckBox::OnMessage (int nMessage_, int nParam1_, int /*nParam2_*/)
 {
-    static bool fPressed = false;
+    static MACHINE_LOCAL bool fPressed = false;
 
     switch (nMessage_)
     {
@@ -1111,7 +1111,7 @@ void CRadioButton::Draw (CScreen* pScreen_)
 
 bool CRadioButton::OnMessage (int nMessage_, int nParam1_, int /*nParam2_*/)
 {
-    static bool fPressed = false;
+    static MACHINE_LOCAL bool fPressed = false;
 
     switch (nMessage_)
     {
@@ -1419,7 +1419,7 @@ void CComboBox::Select (const char* pcszItem_)
 
 const char* CComboBox::GetSelectedText ()
 {
-    static char sz[256];
+    static MACHINE_LOCAL char sz[256];
     strncpy(sz, GetText(), sizeof(sz)-1);
     sz[sizeof(sz)-1] = '\0';
 
@@ -1625,8 +1625,8 @@ void CScrollBar::Draw (CScreen* pScreen_)
 
 bool CScrollBar::OnMessage (int nMessage_, int nParam1_, int nParam2_)
 {
-    static int nDragOffset;
-    static bool fDragging;
+    static MACHINE_LOCAL int nDragOffset;
+    static MACHINE_LOCAL bool fDragging;
 
     // We're inert (and invisible) if there's no scroll range
     if (m_nMaxPos <= 0)
@@ -1939,7 +1939,7 @@ void CListView::Draw (CScreen* pScreen_)
 
 bool CListView::OnMessage (int nMessage_, int nParam1_, int nParam2_)
 {
-    static char szPrefix[16] = "";
+    static MACHINE_LOCAL char szPrefix[16] = "";
 
     // Give the scrollbar first look at the message, but prevent it remaining active
     bool fRet = CWindow::OnMessage(nMessage_, nParam1_, nParam2_);
@@ -2009,7 +2009,7 @@ bool CListView::OnMessage (int nMessage_, int nParam1_, int nParam2_)
 
                 default:
                 {
-                    static DWORD dwLastChar = 0;
+                    static MACHINE_LOCAL DWORD dwLastChar = 0;
                     DWORD dwNow = OSD::GetTime();
 
                     // Clear the buffer on any non-printing characters or if too long since the last one
@@ -2253,7 +2253,7 @@ const GUI_ICON* CFileView::GetFileIcon (const char* pcszFile_)
 // Get the full path of the current item
 const char* CFileView::GetFullPath () const
 {
-    static char szPath[MAX_PATH];
+    static MACHINE_LOCAL char szPath[MAX_PATH];
     const CListViewItem* pItem;
 
     if (!m_pszPath || !(pItem = GetItem()))
@@ -59,10 +59,10 @@ class GUI
         static void Delete (CWindow* pWindow_);
 
     protected:
-        static CWindow *s_pGUI;
-        static std::queue<CWindow *> s_garbageQueue;
-        static std::stack<CWindow*> s_dialogStack;
-        static int s_nX, s_nY;
+        static MACHINE_LOCAL CWindow *s_pGUI;
+        static MACHINE_LOCAL std::queue<CWindow *> s_garbageQueue;
+        static MACHINE_LOCAL std::stack<CWindow*> s_dialogStack;
+        static MACHINE_LOCAL int s_nX, s_nY;
 
         friend class CWindow;
         friend class CDialog;     // only needed for test cross-hair to access cursor position
@@ -34,7 +34,7 @@
 #include "Video.h"
 
 
-OPTIONS g_opts;
+MACHINE_LOCAL OPTIONS g_opts;
 
 // Helper macro for detecting options changes
 #define Changed(o)         (g_opts.o != GetOption(o))
@@ -95,7 +95,7 @@ void CAboutDialog::EraseBackground (CScreen* pScreen_)
 ////////////////////////////////////////////////////////////////////////////////
 
 // Persist show-hidden option between uses, shared by all file selectors
-bool CFileDialog::s_fShowHidden = false;
+MACHINE_LOCAL bool CFileDialog::s_fShowHidden = false;
 
 CFileDialog::CFileDialog (const char* pcszCaption_, const char* pcszPath_, const FILEFILTER* pcFileFilter_, int *pnFilter_,
     CWindow* pParent_/*=nullptr*/) : CDialog(pParent_, 527, 339+22, pcszCaption_), m_pcFileFilter(pcFileFilter_), m_pnFilter(pnFilter_)
@@ -190,7 +190,7 @@ void CFileDialog::OnNotify (CWindow* pWindow_, int nParam_)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-static int nFloppyFilter = 0;
+static MACHINE_LOCAL int nFloppyFilter = 0;
 static const FILEFILTER sFloppyFilter =
 {
 #ifdef USE_ZLIB
@@ -257,7 +257,7 @@ void CInsertFloppy::OnOK ()
 
 ////////////////////////////////////////////////////////////////////////////////
 
-static int nTapeFilter = 0;
+static MACHINE_LOCAL int nTapeFilter = 0;
 static const FILEFILTER sTapeFilter =
 {
 #ifdef USE_ZLIB
@@ -360,7 +360,7 @@ CHDDProperties::CHDDProperties (CEditControl* pEdit_, CWindow* pParent_, const c
 
 void CHDDProperties::OnNotify (CWindow* pWindow_, int /*nParam_*/)
 {
-    static int nHardDiskFilter = 0;
+    static MACHINE_LOCAL int nHardDiskFilter = 0;
     static const FILEFILTER sHardDiskFilter =
     {
         "Hard disk images (*.hdf)|"
@@ -576,7 +576,7 @@ class CSystemOptions final : public CDialog
     public:
         void OnNotify (CWindow* pWindow_, int /*nParam_*/) override
         {
-            static int nROMFilter = 0;
+            static MACHINE_LOCAL int nROMFilter = 0;
             static const FILEFILTER sROMFilter =
             {
                 "ROM Images (.rom;.bin)|"
@@ -1315,9 +1315,9 @@ void COptionsDialog::OnNotify (CWindow* pWindow_, int nParam_)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-char CImportDialog::s_szFile[MAX_PATH];
-UINT CImportDialog::s_uAddr = 32768, CImportDialog::s_uPage, CImportDialog::s_uOffset;
-bool CImportDialog::s_fUseBasic = true;
+MACHINE_LOCAL char CImportDialog::s_szFile[MAX_PATH];
+MACHINE_LOCAL UINT CImportDialog::s_uAddr = 32768, CImportDialog::s_uPage, CImportDialog::s_uOffset;
+MACHINE_LOCAL bool CImportDialog::s_fUseBasic = true;
 
 CImportDialog::CImportDialog (CWindow* pParent_)
     : CDialog(pParent_, 230, 165, "Import Data")
@@ -1348,7 +1348,7 @@ CImportDialog::CImportDialog (CWindow* pParent_)
 
 void CImportDialog::OnNotify (CWindow* pWindow_, int nParam_)
 {
-    static int nImportFilter = 0;
+    static MACHINE_LOCAL int nImportFilter = 0;
     static const FILEFILTER sImportFilter =
     {
         "Binary files (*.bin)|"
@@ -1418,6 +1418,7 @@ void CImportDialog::OnNotify (CWindow* pWindow_, int nParam_)
         {
             // Read directly into system memory
             uRead += fread(PageWritePtr(uPage)+uOffset, 1, uChunk, hFile);
+            MarkPageWritten(uPage);
 
             // Wrap to page 0 after ROM0
             if (uPage == ROM0+1)
@@ -1435,7 +1436,7 @@ void CImportDialog::OnNotify (CWindow* pWindow_, int nParam_)
 }
 
 
-UINT CExportDialog::s_uLength = 16384;  // show 16K as the initial export length
+MACHINE_LOCAL UINT CExportDialog::s_uLength = 16384;  // show 16K as the initial export length
 
 CExportDialog::CExportDialog (CWindow* pParent_)
     : CImportDialog(pParent_)
@@ -1516,9 +1517,9 @@ void CExportDialog::OnNotify (CWindow* pWindow_, int nParam_)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-char CNewDiskDialog::s_szFile[MAX_PATH];
-UINT CNewDiskDialog::s_uType = 0;
-bool CNewDiskDialog::s_fCompress, CNewDiskDialog::s_fFormat = true;
+MACHINE_LOCAL char CNewDiskDialog::s_szFile[MAX_PATH];
+MACHINE_LOCAL UINT CNewDiskDialog::s_uType = 0;
+MACHINE_LOCAL bool CNewDiskDialog::s_fCompress, CNewDiskDialog::s_fFormat = true;
 
 CNewDiskDialog::CNewDiskDialog (int nDrive_, CWindow* pParent_/*=nullptr*/)
     : CDialog(pParent_, 355, 100, "New Disk")
@@ -47,7 +47,7 @@ class CFileDialog : public CDialog
         virtual void OnOK () = 0;
 
     protected:
-        static bool s_fShowHidden;
+        static MACHINE_LOCAL bool s_fShowHidden;
 
     protected:
         CFileView* m_pFileView = nullptr;
@@ -179,9 +179,9 @@ class CImportDialog : public CDialog
         CFrameControl *m_pFrame = nullptr;
 
     protected:
-        static char s_szFile[];
-        static UINT s_uAddr, s_uPage, s_uOffset;
-        static bool s_fUseBasic;
+        static MACHINE_LOCAL char s_szFile[];
+        static MACHINE_LOCAL UINT s_uAddr, s_uPage, s_uOffset;
+        static MACHINE_LOCAL bool s_fUseBasic;
 };
 
 class CExportDialog final : public CImportDialog
@@ -195,7 +195,7 @@ class CExportDialog final : public CImportDialog
 
     protected:
         CEditControl *m_pLength = nullptr;
-        static UINT s_uLength;
+        static MACHINE_LOCAL UINT s_uLength;
 };
 
 
@@ -216,10 +216,10 @@ class CNewDiskDialog final : public CDialog
         CTextButton *m_pCancel = nullptr;
 
     protected:
-        static char s_szFile[MAX_PATH];
-        static UINT s_uType;
-        static bool s_fCompress;
-        static bool s_fFormat;
+        static MACHINE_LOCAL char s_szFile[MAX_PATH];
+        static MACHINE_LOCAL UINT s_uType;
+        static MACHINE_LOCAL bool s_fCompress;
+        static MACHINE_LOCAL bool s_fFormat;
 };
 
 
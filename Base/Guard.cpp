@@ -0,0 +1,331 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Guard.cpp: Write watchpoints using host page protection
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  When the only breakpoints are memory writes, the host pages holding the
+//  watched locations are made read-only while the CPU core runs, so it needs
+//  no checks of its own.  A write to one of those pages faults, and the
+//  handler unprotects the page and sets the trap flag to single-step the
+//  write, with the trap handler re-protecting it afterwards.  Faults on the
+//  unwatched parts of a page are handled the same way, just without a hit.
+//
+//  Hits are the fault address if it's watched, or any watched byte changed by
+//  a wider write.  They end the core's run of instructions after the current
+//  one, so the full breakpoint list is checked at the same point as before.
+//  The handlers only set g_nGuardStop for that, as the core's own state may
+//  be held in registers while it runs.
+//
+//  Protection is only applied while the core runs, so state loading, rewind
+//  and the debugger can write memory freely.  Other signals are passed on to
+//  any previous handlers.
+//
+//  Each fault costs tens of microseconds, so watching busy pages is slower
+//  than checking the breakpoint index after every instruction.  If a run of
+//  the core has too many faults it's ended early, and the indexed core used
+//  for a while instead, for longer each time protection proves too busy.
+
+#include "SimCoupe.h"
+#include "Guard.h"
+
+MACHINE_LOCAL volatile sig_atomic_t g_nGuardStop;
+
+#ifdef USE_GUARD
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "CPU.h"
+#include "Memory.h"
+
+const size_t MEMORY_SIZE = TOTAL_PAGES*MEM_PAGE_SIZE;
+const size_t MAX_STEP_PAGES = 4;        // pages unprotected by one host instruction
+const size_t SNAPSHOT_SIZE = 64;        // bytes checked for changes by wider writes
+const greg_t TRAP_FLAG = 0x100;         // EFLAGS single-step bit
+const UINT MAX_FAULTS = 16;             // faults in one run of the core before protection costs more than it saves
+const int BUSY_CHUNKS = 16;             // runs of the core to use the index for after too many faults
+const int MAX_BUSY_CHUNKS = 1024;       // limit as that doubles for repeated busy runs
+
+static MACHINE_LOCAL size_t uHostPage;                                    // host page size, once known
+static MACHINE_LOCAL const BYTE *pbWatchMap;                              // bit per byte of pMemory watched for writes
+static MACHINE_LOCAL std::vector<BYTE> vProtected;                        // flag per host page of pMemory protected when armed
+static MACHINE_LOCAL std::vector<std::pair<size_t, size_t>> vRuns;        // offsets and lengths of protected page runs
+static MACHINE_LOCAL bool fArmed;
+static MACHINE_LOCAL UINT uFaults;                                        // faults since being armed
+static MACHINE_LOCAL int nBusyChunks, nBusyLength = BUSY_CHUNKS;          // runs left before protection is tried again, and next length
+
+static MACHINE_LOCAL BYTE *apbStepPages[MAX_STEP_PAGES];                  // pages unprotected for the current step
+static MACHINE_LOCAL size_t uStepPages;
+static MACHINE_LOCAL BYTE *pbStepAddr;                                    // first fault address for the current step
+static MACHINE_LOCAL BYTE abSnapshot[SNAPSHOT_SIZE];                      // memory from that address before the step
+static MACHINE_LOCAL size_t uSnapshotLen;
+
+static MACHINE_LOCAL BYTE * volatile pbHit1, * volatile pbHit2;           // watched locations written since the last check
+
+// Signal handlers are shared by all machines
+static struct sigaction saOldSegv, saOldTrap;               // handlers from before ours
+static std::mutex mutexHandlers;
+static int nHandlerUsers;                                   // machines armed, needing our handlers installed
+
+
+static inline bool IsWatched (size_t uOffset_)
+{
+    return (pbWatchMap[uOffset_ >> 3] & (1 << (uOffset_ & 7))) != 0;
+}
+
+static void RecordHit (BYTE *pb_)
+{
+    if (!pbHit1)
+        pbHit1 = pb_;
+    else if (!pbHit2 && pb_ != pbHit1)
+        pbHit2 = pb_;
+
+    // Return to the main loop after the current instruction, to check the breakpoint list
+    g_nGuardStop |= GUARD_HIT;
+}
+
+// Pass a signal we're not interested in to the previous handler
+static void ChainSignal (int nSig_, siginfo_t *pInfo_, void *pvContext_, const struct sigaction &saOld_)
+{
+    if (saOld_.sa_flags & SA_SIGINFO)
+        saOld_.sa_sigaction(nSig_, pInfo_, pvContext_);
+    else if (saOld_.sa_handler != SIG_DFL && saOld_.sa_handler != SIG_IGN)
+        saOld_.sa_handler(nSig_);
+    else if (saOld_.sa_handler == SIG_IGN && nSig_ != SIGSEGV)
+    {
+        // An ignored trap carries on, leaving our handlers installed
+    }
+    else
+    {
+        // Take the default action, which ends the process, rather than removing our handlers
+        // from under the machines still armed.  The raised signal is delivered on return.
+        struct sigaction sa = {};
+        sigemptyset(&sa.sa_mask);
+        sa.sa_handler = SIG_DFL;
+        sigaction(nSig_, &sa, nullptr);
+        raise(nSig_);
+    }
+}
+
+// Unprotect a page written to, and single-step the write
+static void OnSegv (int nSig_, siginfo_t *pInfo_, void *pvContext_)
+{
+    uintptr_t uAddr = reinterpret_cast<uintptr_t>(pInfo_->si_addr), uBase = reinterpret_cast<uintptr_t>(pMemory);
+    size_t uOffset = static_cast<size_t>(uAddr - uBase);
+
+    if (!fArmed || uAddr < uBase || uOffset >= MEMORY_SIZE || !vProtected[uOffset / uHostPage] || uStepPages == MAX_STEP_PAGES)
+        return ChainSignal(nSig_, pInfo_, pvContext_, saOldSegv);
+
+    // Return to the main loop to select the indexed core if protection is too busy
+    if (++uFaults == MAX_FAULTS)
+        g_nGuardStop |= GUARD_BUSY;
+
+    BYTE *pbPage = pMemory + (uOffset / uHostPage * uHostPage);
+    mprotect(pbPage, uHostPage, PROT_READ|PROT_WRITE);
+    apbStepPages[uStepPages++] = pbPage;
+
+    // An unaligned write may fault again on the next page, but the step starts at the first fault
+    if (uStepPages == 1)
+    {
+        pbStepAddr = pMemory + uOffset;
+        uSnapshotLen = std::min(SNAPSHOT_SIZE, MEMORY_SIZE - uOffset);
+        memcpy(abSnapshot, pbStepAddr, uSnapshotLen);
+    }
+
+    reinterpret_cast<ucontext_t*>(pvContext_)->uc_mcontext.gregs[REG_EFL] |= TRAP_FLAG;
+}
+
+// Check the completed write for hits, and re-protect the pages
+static void OnTrap (int nSig_, siginfo_t *pInfo_, void *pvContext_)
+{
+    if (!uStepPages)
+        return ChainSignal(nSig_, pInfo_, pvContext_, saOldTrap);
+
+    reinterpret_cast<ucontext_t*>(pvContext_)->uc_mcontext.gregs[REG_EFL] &= ~TRAP_FLAG;
+
+    size_t uOffset = static_cast<size_t>(pbStepAddr - pMemory);
+    for (size_t u = 0 ; u < uSnapshotLen ; u++)
+    {
+        if ((!u || pbStepAddr[u] != abSnapshot[u]) && IsWatched(uOffset+u))
+            RecordHit(pbStepAddr+u);
+    }
+
+    for (size_t u = 0 ; u < uStepPages ; u++)
+        mprotect(apbStepPages[u], uHostPage, PROT_READ);
+
+    uStepPages = 0;
+}
+
+
+namespace Guard
+{
+
+// Protection needs pMemory aligned to host pages that are no larger than our own
+bool IsAvailable ()
+{
+    static const long lPageSize = sysconf(_SC_PAGESIZE);
+
+    return lPageSize > 0 && !(MEM_PAGE_SIZE % lPageSize) && pMemory &&
+           !(reinterpret_cast<uintptr_t>(pMemory) % static_cast<uintptr_t>(lPageSize));
+}
+
+// Return whether recent faults are too frequent for protection to be worthwhile, counting down the rest
+bool IsBusy ()
+{
+    if (!nBusyChunks)
+        return false;
+
+    nBusyChunks--;
+    return true;
+}
+
+// Set the write breakpoint map, or null if there's nothing to watch
+void SetMap (const BYTE *pbWriteMap_)
+{
+    // The old map may be about to be freed, so stop using it
+    Disarm();
+
+    pbWatchMap = pbWriteMap_;
+    vRuns.clear();
+
+    if (!pbWatchMap || !IsAvailable())
+        return;
+
+    uHostPage = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    vProtected.assign(MEMORY_SIZE / uHostPage, 0);
+
+    // Protect each page with any watched locations, joining neighbouring pages into runs
+    for (size_t u = 0, uMapLen = uHostPage / 8 ; u < vProtected.size() ; u++)
+    {
+        const BYTE *pbMap = pbWatchMap + u*uMapLen;
+        if (std::find_if(pbMap, pbMap+uMapLen, [] (BYTE b) { return b != 0; }) == pbMap+uMapLen)
+            continue;
+
+        vProtected[u] = 1;
+
+        if (!vRuns.empty() && vRuns.back().first + vRuns.back().second == u*uHostPage)
+            vRuns.back().second += uHostPage;
+        else
+            vRuns.push_back(std::make_pair(u*uHostPage, uHostPage));
+    }
+}
+
+
+// Write-protect the watched pages, and catch the faults from writing to them
+void Arm ()
+{
+    if (fArmed || vRuns.empty())
+        return;
+
+    // Our handlers are installed while any machine is armed
+    {
+        std::lock_guard<std::mutex> lock(mutexHandlers);
+        if (!nHandlerUsers++)
+        {
+            struct sigaction sa = {};
+            sigemptyset(&sa.sa_mask);
+            sa.sa_flags = SA_SIGINFO;
+
+            sa.sa_sigaction = OnSegv;
+            sigaction(SIGSEGV, &sa, &saOldSegv);
+            sa.sa_sigaction = OnTrap;
+            sigaction(SIGTRAP, &sa, &saOldTrap);
+        }
+    }
+
+    fArmed = true;
+    uFaults = 0;
+
+    for (auto &run : vRuns)
+        mprotect(pMemory + run.first, run.second, PROT_READ);
+}
+
+void Disarm ()
+{
+    if (!fArmed)
+        return;
+
+    for (auto &run : vRuns)
+        mprotect(pMemory + run.first, run.second, PROT_READ|PROT_WRITE);
+
+    {
+        std::lock_guard<std::mutex> lock(mutexHandlers);
+        if (!--nHandlerUsers)
+        {
+            sigaction(SIGSEGV, &saOldSegv, nullptr);
+            sigaction(SIGTRAP, &saOldTrap, nullptr);
+        }
+    }
+
+    fArmed = false;
+
+    if (uFaults < MAX_FAULTS)
+        nBusyLength = BUSY_CHUNKS;
+    else
+    {
+        nBusyChunks = nBusyLength;
+        nBusyLength = std::min(nBusyLength*2, MAX_BUSY_CHUNKS);
+    }
+}
+
+
+// Return whether faults have proved protection too busy, and clear the core's stop request
+bool TakeBusy ()
+{
+    bool fBusy = (g_nGuardStop & GUARD_BUSY) != 0;
+    g_nGuardStop = 0;
+    return fBusy;
+}
+
+bool IsHit ()
+{
+    return pbHit1 != nullptr;
+}
+
+// Return the watched locations written, in the same form as the tracked accesses, and clear them
+void TakeHits (BYTE **ppb1_, BYTE **ppb2_)
+{
+    *ppb1_ = pbHit1;
+    *ppb2_ = pbHit2;
+    pbHit1 = pbHit2 = nullptr;
+}
+
+} // namespace Guard
+
+#else
+
+namespace Guard
+{
+bool IsAvailable () { return false; }
+bool IsBusy () { return false; }
+bool TakeBusy () { return false; }
+void SetMap (const BYTE * /*pbWriteMap_*/) { }
+void Arm () { }
+void Disarm () { }
+bool IsHit () { return false; }
+void TakeHits (BYTE **ppb1_, BYTE **ppb2_) { *ppb1_ = *ppb2_ = nullptr; }
+}
+
+#endif  // USE_GUARD
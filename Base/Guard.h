@@ -0,0 +1,49 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Guard.h: Write watchpoints using host page protection
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef GUARD_H
+#define GUARD_H
+
+#include <signal.h>
+
+// Faulting writes are single-stepped using the x86 trap flag, which needs Linux signal contexts
+#if defined(__linux__) && defined(__x86_64__)
+#define USE_GUARD
+#endif
+
+// Set by the fault handlers to end the core's run of instructions, which polls it
+enum { GUARD_HIT=1, GUARD_BUSY=2 };
+extern MACHINE_LOCAL volatile sig_atomic_t g_nGuardStop;
+
+namespace Guard
+{
+    bool IsAvailable ();
+    bool IsBusy ();
+    void SetMap (const BYTE *pbWriteMap_);
+
+    void Arm ();
+    void Disarm ();
+
+    bool TakeBusy ();
+    bool IsHit ();
+    void TakeHits (BYTE **ppb1_, BYTE **ppb2_);
+}
+
+#endif  // GUARD_H
@@ -25,6 +25,7 @@
 
 #include "HardDisk.h"
 #include "IDEDisk.h"
+#include "Perf.h"
 
 
 CHardDisk::CHardDisk (const char* path)
@@ -248,12 +249,14 @@ void CHDFHardDisk::Close ()
 
 bool CHDFHardDisk::ReadSector (UINT uSector_, BYTE* pb_)
 {
+    CPerfScope perf(ptDisk);
     off_t lOffset = m_uDataOffset + static_cast<off_t>(uSector_) * m_uSectorSize;
     return m_hfDisk && !fseek(m_hfDisk, lOffset, SEEK_SET) && (fread(pb_, 1, m_uSectorSize, m_hfDisk) == m_uSectorSize);
 }
 
 bool CHDFHardDisk::WriteSector (UINT uSector_, BYTE* pb_)
 {
+    CPerfScope perf(ptDisk);
     off_t lOffset = m_uDataOffset + static_cast<off_t>(uSector_) * m_uSectorSize;
     return m_hfDisk && !fseek(m_hfDisk, lOffset, SEEK_SET) && (fwrite(pb_, 1, m_uSectorSize, m_hfDisk) == m_uSectorSize);
 }
@@ -0,0 +1,175 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Heatmap.cpp: Memory access heatmap and coverage
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  While active, a dedicated CPU core passes the physical location of every
+//  data read, data write and code fetch here.  Writes are charged to the
+//  location they'd be read from, as breakpoints are, so writes to ROM still
+//  show against the ROM.  Code fetches include operand bytes, so coverage
+//  shows every byte that was run as code.
+//
+//  Each type has a heat value per byte, bumped on access and halved every few
+//  frames so only recent activity stands out.  The coverage bits are never
+//  cleared by decay, only by a reset.  Pages are allocated when first accessed.
+//
+//  The binary coverage export is a flat image of every page from INTMEM to
+//  ROM1, with one byte per location holding the coverage bits.  The CSV export
+//  lists runs of locations with the same non-zero coverage.
+
+#include "SimCoupe.h"
+#include "Heatmap.h"
+
+#include "CPU.h"
+
+const int HEAT_DECAY_FRAMES = 8;    // frames between halving the heat, so a single access fades in ~1.3s
+
+MACHINE_LOCAL HEAT_PAGE *apHeatPages[TOTAL_PAGES];
+
+static MACHINE_LOCAL bool fActive;
+static MACHINE_LOCAL int nDecayFrames;
+
+
+namespace Heatmap
+{
+
+void Exit (bool fReInit_/*=false*/)
+{
+    if (!fReInit_)
+    {
+        Stop();
+        Reset();
+    }
+}
+
+
+// Start or resume recording, keeping any existing results
+void Start ()
+{
+    if (fActive)
+        return;
+
+    // Return to the main loop to select a CPU core that records accesses
+    g_fBreak = true;
+    fActive = true;
+}
+
+void Stop ()
+{
+    if (!fActive)
+        return;
+
+    g_fBreak = true;
+    fActive = false;
+}
+
+// Discard the heat and coverage for all pages
+void Reset ()
+{
+    for (auto &pPage : apHeatPages)
+    {
+        delete pPage;
+        pPage = nullptr;
+    }
+
+    nDecayFrames = 0;
+}
+
+bool IsActive ()
+{
+    return fActive;
+}
+
+
+// Cool the pages touched so far, so the heat reflects recent activity
+void FrameEnd ()
+{
+    if (!fActive || ++nDecayFrames < HEAT_DECAY_FRAMES)
+        return;
+
+    nDecayFrames = 0;
+
+    for (auto pPage : apHeatPages)
+    {
+        if (!pPage)
+            continue;
+
+        for (auto &abHeat : pPage->abHeat)
+        {
+            for (auto &bHeat : abHeat)
+                bHeat >>= 1;
+        }
+    }
+}
+
+HEAT_PAGE *AllocPage (int nPage_)
+{
+    HEAT_PAGE *pPage = new HEAT_PAGE;
+    memset(pPage, 0, sizeof(*pPage));
+    return apHeatPages[nPage_] = pPage;
+}
+
+// Return the heat and coverage for a page, or null if it hasn't been accessed
+const HEAT_PAGE *GetPage (int nPage_)
+{
+    return (nPage_ >= 0 && nPage_ < TOTAL_PAGES) ? apHeatPages[nPage_] : nullptr;
+}
+
+
+// Save the coverage of all pages, as a binary image or a CSV list of runs
+bool Save (const char *pcszPath_, bool fCSV_/*=false*/)
+{
+    static const BYTE abEmpty[MEM_PAGE_SIZE] = {};
+
+    FILE *f = fopen(pcszPath_, fCSV_ ? "w" : "wb");
+    if (!f)
+        return false;
+
+    if (fCSV_)
+        fprintf(f, "Page,Start,End,Read,Write,Exec\n");
+
+    for (int nPage = INTMEM ; nPage <= ROM1 ; nPage++)
+    {
+        const BYTE *pbCover = apHeatPages[nPage] ? apHeatPages[nPage]->abCover : abEmpty;
+
+        if (!fCSV_)
+        {
+            fwrite(pbCover, MEM_PAGE_SIZE, 1, f);
+            continue;
+        }
+
+        for (int nStart = 0, nEnd ; nStart < MEM_PAGE_SIZE ; nStart = nEnd)
+        {
+            BYTE bCover = pbCover[nStart];
+            for (nEnd = nStart+1 ; nEnd < MEM_PAGE_SIZE && pbCover[nEnd] == bCover ; nEnd++);
+
+            if (bCover)
+            {
+                fprintf(f, "%s,%04X,%04X,%d,%d,%d\n", Memory::PageDesc(nPage, true), nStart, nEnd-1,
+                        !!(bCover & (1 << htRead)), !!(bCover & (1 << htWrite)), !!(bCover & (1 << htExec)));
+            }
+        }
+    }
+
+    bool fOK = !ferror(f);
+    fclose(f);
+    return fOK;
+}
+
+} // namespace Heatmap
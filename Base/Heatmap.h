@@ -0,0 +1,68 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Heatmap.h: Memory access heatmap and coverage
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include "Memory.h"
+
+enum eHeatType { htRead, htWrite, htExec, MAX_HEAT_TYPES };
+
+const BYTE HEAT_STEP = 64;      // heat added by each access, saturating at 255
+
+typedef struct
+{
+    BYTE abHeat[MAX_HEAT_TYPES][MEM_PAGE_SIZE];     // recent access intensity, decaying over time
+    BYTE abCover[MEM_PAGE_SIZE];                    // access types ever seen, as (1 << eHeatType) bits
+} HEAT_PAGE;
+
+extern MACHINE_LOCAL HEAT_PAGE *apHeatPages[TOTAL_PAGES];
+
+
+namespace Heatmap
+{
+    void Exit (bool fReInit_=false);
+
+    void Start ();
+    void Stop ();
+    void Reset ();
+    bool IsActive ();
+
+    void FrameEnd ();
+    HEAT_PAGE *AllocPage (int nPage_);
+    const HEAT_PAGE *GetPage (int nPage_);
+    bool Save (const char *pcszPath_, bool fCSV_=false);
+
+    // Record an access to a location in physical memory
+    inline void Access (const BYTE *pb_, eHeatType nType_)
+    {
+        int nPage = PtrPage(pb_), nOffset = PtrOffset(pb_);
+
+        HEAT_PAGE *pPage = apHeatPages[nPage];
+        if (!pPage)
+            pPage = AllocPage(nPage);
+
+        BYTE &bHeat = pPage->abHeat[nType_][nOffset];
+        bHeat = (bHeat > 255-HEAT_STEP) ? 255 : bHeat+HEAT_STEP;
+        pPage->abCover[nOffset] |= (1 << nType_);
+    }
+}
+
+#endif  // HEATMAP_H
@@ -44,62 +44,64 @@
 #include "OSD.h"
 #include "Parallel.h"
 #include "Paula.h"
+#include "Reverse.h"
 #include "SAMDOS.h"
 #include "SAMVox.h"
 #include "SDIDE.h"
 #include "SID.h"
 #include "Sound.h"
+#include "State.h"
 #include "Tape.h"
 #include "Util.h"
 #include "Video.h"
 
-CDiskDevice *pFloppy1, *pFloppy2, *pBootDrive;
-CAtaAdapter *pAtom, *pAtomLite, *pSDIDE;
+MACHINE_LOCAL CDiskDevice *pFloppy1, *pFloppy2, *pBootDrive;
+MACHINE_LOCAL CAtaAdapter *pAtom, *pAtomLite, *pSDIDE;
 
-CPrintBuffer *pPrinterFile;
-CMonoDACDevice *pMonoDac;
-CStereoDACDevice *pStereoDac;
+MACHINE_LOCAL CPrintBuffer *pPrinterFile;
+MACHINE_LOCAL CMonoDACDevice *pMonoDac;
+MACHINE_LOCAL CStereoDACDevice *pStereoDac;
 
-CClockDevice *pSambus, *pDallas;
-CMouseDevice *pMouse;
+MACHINE_LOCAL CClockDevice *pSambus, *pDallas;
+MACHINE_LOCAL CMouseDevice *pMouse;
 
-CMidiDevice *pMidi;
-CBeeperDevice *pBeeper;
-CBlueAlphaDevice *pBlueAlpha;
-CSAMVoxDevice *pSAMVox;
-CPaulaDevice *pPaula;
-CDAC *pDAC;
-CSAA *pSAA;
-CSID *pSID;
+MACHINE_LOCAL CMidiDevice *pMidi;
+MACHINE_LOCAL CBeeperDevice *pBeeper;
+MACHINE_LOCAL CBlueAlphaDevice *pBlueAlpha;
+MACHINE_LOCAL CSAMVoxDevice *pSAMVox;
+MACHINE_LOCAL CPaulaDevice *pPaula;
+MACHINE_LOCAL CDAC *pDAC;
+MACHINE_LOCAL CSAA *pSAA;
+MACHINE_LOCAL CSID *pSID;
 
 
 // Port read/write addresses for I/O breakpoints
-WORD wPortRead, wPortWrite;
-BYTE bPortInVal, bPortOutVal;
+MACHINE_LOCAL WORD wPortRead, wPortWrite;
+MACHINE_LOCAL BYTE bPortInVal, bPortOutVal;
 
 // Paging ports for internal and external memory
-BYTE vmpr, hmpr, lmpr, lepr, hepr;
-BYTE vmpr_mode, vmpr_page1, vmpr_page2;
+MACHINE_LOCAL BYTE vmpr, hmpr, lmpr, lepr, hepr;
+MACHINE_LOCAL BYTE vmpr_mode, vmpr_page1, vmpr_page2;
 
-BYTE border, border_col;
+MACHINE_LOCAL BYTE border, border_col;
 
-BYTE keyboard;
-BYTE status_reg;
-BYTE line_int;
-BYTE lpen;
-BYTE attr;
+MACHINE_LOCAL BYTE keyboard;
+MACHINE_LOCAL BYTE status_reg;
+MACHINE_LOCAL BYTE line_int;
+MACHINE_LOCAL BYTE lpen;
+MACHINE_LOCAL BYTE attr;
 
-UINT clut[N_CLUT_REGS], mode3clut[4];
+MACHINE_LOCAL UINT clut[N_CLUT_REGS], mode3clut[4];
 
-BYTE keyports[9];       // 8 rows of keys (+ 1 row for unscanned keys)
-BYTE keybuffer[9];      // working buffer for key changed, activated mid-frame
+MACHINE_LOCAL BYTE keyports[9];       // 8 rows of keys (+ 1 row for unscanned keys)
+MACHINE_LOCAL BYTE keybuffer[9];      // working buffer for key changed, activated mid-frame
 
-bool fASICStartup;      // If set, the ASIC will be unresponsive shortly after first power-on
+MACHINE_LOCAL bool fASICStartup;      // If set, the ASIC will be unresponsive shortly after first power-on
 
-int g_nAutoLoad = AUTOLOAD_NONE;    // don't auto-load on startup
+MACHINE_LOCAL int g_nAutoLoad = AUTOLOAD_NONE;    // don't auto-load on startup
 
 #ifdef _DEBUG
-static BYTE abUnhandled[32];    // track unhandled port access in debug mode
+static MACHINE_LOCAL BYTE abUnhandled[32];    // track unhandled port access in debug mode
 #endif
 
 //////////////////////////////////////////////////////////////////////////////
@@ -305,9 +307,8 @@ void OutHmpr (BYTE bVal_)
     // Have the mode3 BCD4/8 bits changed?
     if ((hmpr ^ bVal_) & HMPR_MD3COL_MASK)
     {
-        // The changes are effective immediately in mode 3
-        if (vmpr_mode == MODE_3)
-            Frame::Update();
+        // The display logs the change, which is effective immediately in mode 3
+        Frame::ChangeHmpr(bVal_);
 
         // Update the mode 3 colours
         PaletteChange(bVal_);
@@ -354,8 +355,8 @@ void OutClut (WORD wPort_, BYTE bVal_)
     // Has the clut value actually changed?
     if (clut[wPort_] != bVal_)
     {
-        // Draw up to the current point with the previous settings
-        Frame::Update();
+        // The display is drawn with the previous setting up to the current point
+        Frame::ChangeClut(wPort_, bVal_);
 
         // Update the clut entry and the mode 3 palette
         clut[wPort_] = bVal_;
@@ -398,6 +399,9 @@ BYTE In (WORD wPort_)
             }
             else
             {
+                // Mouse reads advance its state, so only keyboard reads may be idle polling
+                CPU::IdlePoll();
+
                 if (!(bPortHigh & 0x80)) bRet &= keyports[7];
                 if (!(bPortHigh & 0x40)) bRet &= keyports[6];
                 if (!(bPortHigh & 0x20)) bRet &= keyports[5];
@@ -415,6 +419,8 @@ BYTE In (WORD wPort_)
         // keyboard 2
         case STATUS_PORT:
         {
+            CPU::IdlePoll();
+
             if (!(bPortHigh & 0x80)) bRet &= keyports[7];
             if (!(bPortHigh & 0x40)) bRet &= keyports[6];
             if (!(bPortHigh & 0x20)) bRet &= keyports[5];
@@ -612,6 +618,9 @@ BYTE In (WORD wPort_)
         }
     }
 
+    // Log the value for reverse execution, or replace it with the one logged when replaying
+    bRet = Reverse::PortIn(bRet);
+
     // Store the value for breakpoint use, then return it
     return bPortInVal = bRet;
 }
@@ -636,26 +645,19 @@ void Out (WORD wPort_, BYTE bVal_)
         {
             bool fScreenOffChange = ((border ^ bVal_) & BORD_SOFF_MASK) && VMPR_MODE_3_OR_4;
 
-            // Has the border changed colour or the screen been enabled/disabled?
-            if (fScreenOffChange || ((border ^ bVal_) & BORD_COLOUR_MASK))
-                Frame::Update();
-
-            // Change of screen enable state?
-            if (fScreenOffChange)
+            // If the screen is being disabled, determine the current ATTR value to return whilst disabled
+            if (fScreenOffChange && !BORD_SOFF)
             {
-                // If the display is now enabled, consider a border change artefact
-                if (BORD_SOFF)
-                    Frame::ChangeScreen(bVal_);
-
-                // Otherwise determine the current ATTR value to return whilst disabled
-                else
-                {
-                    BYTE b1, b2, b3, b4;
-                    Frame::GetAsicData(&b1, &b2, &b3, &b4);
-                    attr = b3;
-                }
+                BYTE b1, b2, b3, b4;
+                Frame::GetAsicData(&b1, &b2, &b3, &b4);
+                attr = b3;
             }
 
+            // Has the border changed colour or the screen been enabled/disabled?
+            // The display also tracks the screen state in modes 1 and 2, for later mode changes
+            if ((border ^ bVal_) & (BORD_SOFF_MASK|BORD_COLOUR_MASK))
+                Frame::ChangeBorder(bVal_);
+
             // If the speaker bit has been toggled, generate a click
             if ((border ^ bVal_) & BORD_BEEP_MASK)
                 pBeeper->Out(wPort_, bVal_);
@@ -685,22 +687,18 @@ void Out (WORD wPort_, BYTE bVal_)
                 // Are either the current mode or the new mode 3 or 4?  i.e. bit MDE1 is set
                 if ((bVal_ | vmpr) & VMPR_MDE1_MASK)
                 {
-                    // Changes to the screen MODE are visible straight away
-                    Frame::Update();
-
-                    // Change only the screen MODE for the transition block
+                    // Changes to the screen MODE are visible straight away,
+                    // so change only the screen MODE for the transition block
                     OutVmpr((bVal_ & VMPR_MODE_MASK) | (vmpr & ~VMPR_MODE_MASK));
                 }
                 // Otherwise both modes are 1 or 2
                 else
                 {
-                    // There are no visible changes in the transition block
+                    // There are no visible changes in the transition block, so the display
+                    // takes the whole change from there - the check below will not be triggered
                     g_dwCycleCounter += VIDEO_DELAY;
-                    Frame::Update();
-                    g_dwCycleCounter -= VIDEO_DELAY;
-
-                    // Do the whole change here - the check below will not be triggered
                     OutVmpr(bVal_);
+                    g_dwCycleCounter -= VIDEO_DELAY;
                 }
 
                 // The video mode has changed so update the active memory contention.
@@ -714,10 +712,8 @@ void Out (WORD wPort_, BYTE bVal_)
                 // Changes to screen PAGE aren't visible until 8 tstates later
                 // as the memory has been read by the ASIC already
                 g_dwCycleCounter += VIDEO_DELAY;
-                Frame::Update();
-                g_dwCycleCounter -= VIDEO_DELAY;
-
                 OutVmpr(bVal_);
+                g_dwCycleCounter -= VIDEO_DELAY;
             }
         }
         break;
@@ -928,7 +924,9 @@ void FrameUpdate ()
     pAtomLite->FrameEnd();
     pPrinterFile->FrameEnd();
 
-    Input::Update();
+    // Host input is left for the live frames, rather than being consumed by those the debugger replays
+    if (!Reverse::IsReplaying())
+        Input::Update();
 
     if (!g_nTurbo)
         Sound::FrameUpdate();
@@ -946,7 +944,7 @@ void UpdateInput()
 
 const COLOUR* GetPalette ()
 {
-    static COLOUR asPalette[N_PALETTE_COLOURS];
+    static MACHINE_LOCAL COLOUR asPalette[N_PALETTE_COLOURS];
 
     // Look-up table for an even intensity spread, used to map SAM colours to RGB
     static const BYTE abIntensities[] = { 0x00, 0x24, 0x49, 0x6d, 0x92, 0xb6, 0xdb, 0xff };
@@ -1113,4 +1111,53 @@ bool Rst48Hook ()
     return false;
 }
 
+
+// Save or restore the ASIC registers and the state of all attached devices
+void Serialize (CState &state_)
+{
+    state_.Section(STATE_TAG('I','O',' ',' '));
+
+    state_.Value(vmpr);
+    state_.Value(hmpr);
+    state_.Value(lmpr);
+    state_.Value(lepr);
+    state_.Value(hepr);
+    state_.Value(vmpr_mode);
+    state_.Value(vmpr_page1);
+    state_.Value(vmpr_page2);
+    state_.Value(border);
+    state_.Value(border_col);
+    state_.Value(keyboard);
+    state_.Value(status_reg);
+    state_.Value(line_int);
+    state_.Value(lpen);
+    state_.Value(attr);
+    state_.Value(clut);
+    state_.Value(keyports);
+    state_.Value(keybuffer);
+    state_.Value(fASICStartup);
+
+    // Devices are always present, so the layout doesn't depend on the options
+    CIoDevice *apDevices[] = { pDAC, pSAA, pSID, pBlueAlpha, pSambus, pDallas, pMouse, pFloppy1, pFloppy2, pAtom, pAtomLite, pSDIDE };
+    for (auto pDevice : apDevices)
+    {
+        if (pDevice)
+            pDevice->Serialize(state_);
+    }
+
+    if (state_.IsLoading())
+    {
+        // Rebuild the derived paging, palette and contention state
+        UpdatePaging();
+        PaletteChange(hmpr);
+        CPU::UpdateContention(CPU::IsContentionActive());
+    }
+}
+
 } // namespace IO
+
+
+void CDiskDevice::Serialize (CState &state_)
+{
+    state_.Value(m_uActive);
+}
@@ -30,6 +30,8 @@ typedef struct {
 enum { AUTOLOAD_NONE, AUTOLOAD_DISK, AUTOLOAD_TAPE };
 
 
+class CState;
+
 namespace IO
 {
     bool Init (bool fFirstInit_=false);
@@ -56,6 +58,8 @@ namespace IO
     bool EiHook ();
     bool Rst8Hook ();
     bool Rst48Hook ();
+
+    void Serialize (CState &state_);
 }
 
 
@@ -74,6 +78,8 @@ class CIoDevice
 
         virtual bool LoadState (const char * /*file*/) { return true; }  // preserve basic state (such as NVRAM)
         virtual bool SaveState (const char * /*file*/) { return true; }
+
+        virtual void Serialize (CState & /*state*/) { }  // save or restore the full device state
 };
 
 enum { drvNone, drvFloppy, drvAtom, drvAtomLite, drvSDIDE };
@@ -85,6 +91,7 @@ class CDiskDevice :  public CIoDevice
 
     public:
         void FrameEnd () override { if (m_uActive) m_uActive--; }
+        void Serialize (CState &state_) override;
 
     public:
         virtual bool Insert (const char* /*image*/, bool /*autoload*/=false) { return false; }
@@ -226,30 +233,30 @@ class CDiskDevice :  public CIoDevice
 
 
 // Keyboard matrix buffer
-extern BYTE keybuffer[9];
+extern MACHINE_LOCAL BYTE keybuffer[9];
 
 // Last port read/written
-extern WORD wPortRead, wPortWrite;
-extern BYTE bPortInVal, bPortOutVal;
+extern MACHINE_LOCAL WORD wPortRead, wPortWrite;
+extern MACHINE_LOCAL BYTE bPortInVal, bPortOutVal;
 
 // Paging ports for internal and external memory
-extern BYTE vmpr, hmpr, lmpr, lepr, hepr;
-extern BYTE vmpr_mode, vmpr_page1, vmpr_page2;
+extern MACHINE_LOCAL BYTE vmpr, hmpr, lmpr, lepr, hepr;
+extern MACHINE_LOCAL BYTE vmpr_mode, vmpr_page1, vmpr_page2;
 
-extern BYTE keyboard, border;
-extern BYTE border_col;
+extern MACHINE_LOCAL BYTE keyboard, border;
+extern MACHINE_LOCAL BYTE border_col;
 
 // Write only ports
-extern BYTE line_int;
-extern UINT clut[N_CLUT_REGS], mode3clut[4];
+extern MACHINE_LOCAL BYTE line_int;
+extern MACHINE_LOCAL UINT clut[N_CLUT_REGS], mode3clut[4];
 
 // Read only ports
-extern BYTE status_reg;
-extern BYTE lpen;
+extern MACHINE_LOCAL BYTE status_reg;
+extern MACHINE_LOCAL BYTE lpen;
 
-extern CDiskDevice *pFloppy1, *pFloppy2, *pBootDrive;
-extern CIoDevice *pParallel1, *pParallel2;
+extern MACHINE_LOCAL CDiskDevice *pFloppy1, *pFloppy2, *pBootDrive;
+extern MACHINE_LOCAL CIoDevice *pParallel1, *pParallel2;
 
-extern int g_nAutoLoad;
+extern MACHINE_LOCAL int g_nAutoLoad;
 
 #endif
@@ -24,8 +24,8 @@
 namespace Joystick
 {
 
-static int anPosition[MAX_JOYSTICKS];
-static DWORD adwButtons[MAX_JOYSTICKS];
+static MACHINE_LOCAL int anPosition[MAX_JOYSTICKS];
+static MACHINE_LOCAL DWORD adwButtons[MAX_JOYSTICKS];
 
 
 void Init (bool /*fFirstInit_*/)
@@ -39,12 +39,12 @@ typedef struct
 } MAPPED_KEY;
 
 
-int anNativeKey[HK_MAX-HK_MIN+1];
+MACHINE_LOCAL int anNativeKey[HK_MAX-HK_MIN+1];
 
-int nComboKey, nComboMods;
-DWORD dwComboTime;
+MACHINE_LOCAL int nComboKey, nComboMods;
+MACHINE_LOCAL DWORD dwComboTime;
 
-BYTE abKeys[512>>3];
+MACHINE_LOCAL BYTE abKeys[512>>3];
 inline bool IsPressed(int k)    { return !!(abKeys[k>>3] & (1<<(k&7))); }
 inline void PressKey(int k)     { abKeys[k>>3] |= (1 << (k&7)); }
 inline void ReleaseKey(int k)   { abKeys[k>>3] &= ~(1 << (k&7)); }
@@ -61,7 +61,7 @@ static void ProcessUnshiftedKeys (MAPPED_KEY* asKeys_);
 
 
 // Main keyboard matrix (minus modifiers)
-MAPPED_KEY asKeyMatrix[] =
+MACHINE_LOCAL MAPPED_KEY asKeyMatrix[] =
 {
     { HK_LSHIFT }, { 'z' },      { 'x' },     { 'c' },     { 'v' },      { HK_KP1 },  { HK_KP2 },  { HK_KP3 },
     { 'a' },       { 's' },      { 'd' },     { 'f' },     { 'g' },      { HK_KP4 },  { HK_KP5 },  { HK_KP6 },
@@ -77,7 +77,7 @@ MAPPED_KEY asKeyMatrix[] =
 };
 
 // SAM-specific keys
-MAPPED_KEY asSamKeys[] =
+MACHINE_LOCAL MAPPED_KEY asSamKeys[] =
 {
     { '!',  SK_SHIFT,  SK_1 },      { '@',  SK_SHIFT,  SK_2 },      { '#',  SK_SHIFT,  SK_3 },
     { '$',  SK_SHIFT,  SK_4 },      { '%',  SK_SHIFT,  SK_5 },      { '&',  SK_SHIFT,  SK_6 },
@@ -109,7 +109,7 @@ MAPPED_KEY asSamKeys[] =
 };
 
 // Spectrum-specific keys
-MAPPED_KEY asSpectrumKeys[] =
+MACHINE_LOCAL MAPPED_KEY asSpectrumKeys[] =
 {
     { '!',  SK_SYMBOL, SK_1 },      { '@',  SK_SYMBOL, SK_2 },      { '#',  SK_SYMBOL, SK_3 },
     { '$',  SK_SYMBOL, SK_4 },      { '%',  SK_SYMBOL, SK_5 },      { '&',  SK_SYMBOL, SK_6 },
@@ -25,9 +25,9 @@
 namespace Keyin
 {
 
-static BYTE *pbInput;
-static int nPos = -1;
-static bool fMapChars = true;
+static MACHINE_LOCAL BYTE *pbInput;
+static MACHINE_LOCAL int nPos = -1;
+static MACHINE_LOCAL bool fMapChars = true;
 
 BYTE MapChar (BYTE b_);
 
@@ -103,6 +103,7 @@ bool Next ()
     // Simulate the key press
     PageWritePtr(0)[0x5c08-0x4000] = bKey;  // set key in LASTK
     PageWritePtr(0)[0x5c3b-0x4000] |= 0x20; // signal key available in FLAGS
+    MarkPageWritten(0);
 
     // Run at turbo speed during input
     g_nTurbo |= TURBO_KEYIN;
@@ -115,7 +116,7 @@ bool Next ()
 // Map special case input characters to the SAM key code equivalent
 BYTE MapChar (BYTE b_)
 {
-    static BYTE abMap[256];
+    static MACHINE_LOCAL BYTE abMap[256];
 
     // Does the map need initialising?
     if (!abMap['A'])
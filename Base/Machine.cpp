@@ -0,0 +1,191 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Machine.cpp: Independent emulated machines, each on its own thread
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  The emulation state is spread over module globals, which are declared
+//  MACHINE_LOCAL so builds defining USE_MACHINES give each thread its own
+//  copy.  A machine is a thread that owns one set, with work for it queued
+//  to run there, so the rest of the code is unchanged and single machine
+//  builds pay nothing for it.  Constant tables are still shared.
+//
+//  Start-up and shutdown load and save the shared settings file, so only
+//  one machine does either at a time.  The rest runs independently.
+//
+//  Memory used by a machine is its copy of the module state, the guest
+//  memory, generated code and any history kept for rewind and reverse
+//  execution.  Smaller allocations, such as the display buffers, are left
+//  out as they don't depend on what the machine is running.
+
+#include "SimCoupe.h"
+#include "Machine.h"
+
+#ifdef USE_MACHINES
+
+#ifdef __linux__
+#include <link.h>
+#endif
+
+#include "Dynarec.h"
+#include "Main.h"
+#include "Memory.h"
+#include "Reverse.h"
+#include "Rewind.h"
+
+static std::mutex mutexStartStop;       // held while a machine starts or stops
+
+
+#ifdef __linux__
+// Return the size of the main program's thread-local block, which holds the machine state
+static int FindTlsSize (struct dl_phdr_info *pInfo_, size_t /*uSize_*/, void *pv_)
+{
+    for (int i = 0 ; i < pInfo_->dlpi_phnum ; i++)
+    {
+        if (pInfo_->dlpi_phdr[i].p_type == PT_TLS)
+            *reinterpret_cast<size_t*>(pv_) = pInfo_->dlpi_phdr[i].p_memsz;
+    }
+
+    // The main program is listed first, so stop after it
+    return 1;
+}
+#endif
+
+static size_t GetStaticsSize ()
+{
+    size_t uSize = 0;
+#ifdef __linux__
+    dl_iterate_phdr(FindTlsSize, &uSize);
+#endif
+    return uSize;
+}
+
+
+CMachine::CMachine ()
+{
+    m_thread = std::thread(&CMachine::ThreadProc, this);
+}
+
+CMachine::~CMachine ()
+{
+    Exit();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fStopping = true;
+    }
+
+    m_cvWork.notify_one();
+    m_thread.join();
+}
+
+
+// Start the machine with the given command-line options, on its own thread
+bool CMachine::Init (int argc_, char* argv_[])
+{
+    bool fOK = false;
+
+    Call([&] {
+        std::lock_guard<std::mutex> lock(mutexStartStop);
+        fOK = Main::Init(argc_, argv_);
+    });
+    Wait();
+
+    // A failed start still needs cleaning up
+    m_fInit = true;
+    return fOK;
+}
+
+void CMachine::Exit ()
+{
+    if (!m_fInit)
+        return;
+
+    Call([] {
+        std::lock_guard<std::mutex> lock(mutexStartStop);
+        Main::Exit(false);
+    });
+    Wait();
+
+    m_fInit = false;
+}
+
+
+// Queue work to run on the machine's thread, with access to its state
+void CMachine::Call (std::function<void()> fn_)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_qJobs.push_back(std::move(fn_));
+    }
+
+    m_cvWork.notify_one();
+}
+
+// Wait for all queued work to finish
+void CMachine::Wait ()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cvIdle.wait(lock, [this] { return m_qJobs.empty() && !m_fBusy; });
+}
+
+
+void CMachine::GetMemory (MACHINE_MEMORY *pMemory_)
+{
+    Call([pMemory_] {
+        REWIND_STATS sRewind;
+        REVERSE_STATS sReverse;
+        Rewind::GetStats(&sRewind);
+        Reverse::GetStats(&sReverse);
+
+        pMemory_->uStatics = GetStaticsSize();
+        pMemory_->uMemory = pMemory ? (TOTAL_PAGES+1)*MEM_PAGE_SIZE : 0;    // as allocated by Memory::Init
+        pMemory_->uCode = Dynarec::GetMemoryUsed();
+        pMemory_->uHistory = sRewind.uTotalBytes + sReverse.uTotalBytes;
+    });
+    Wait();
+
+    pMemory_->uTotal = pMemory_->uStatics + pMemory_->uMemory + pMemory_->uCode + pMemory_->uHistory;
+}
+
+
+void CMachine::ThreadProc ()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;)
+    {
+        m_cvWork.wait(lock, [this] { return !m_qJobs.empty() || m_fStopping; });
+
+        if (m_qJobs.empty())
+            break;
+
+        std::function<void()> fn = std::move(m_qJobs.front());
+        m_qJobs.pop_front();
+        m_fBusy = true;
+
+        lock.unlock();
+        fn();
+        lock.lock();
+
+        m_fBusy = false;
+        m_cvIdle.notify_all();
+    }
+}
+
+#endif  // USE_MACHINES
@@ -0,0 +1,75 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Machine.h: Independent emulated machines, each on its own thread
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#ifdef USE_MACHINES
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+typedef struct
+{
+    size_t uStatics;        // per-thread copy of the module state
+    size_t uMemory;         // guest RAM and ROM
+    size_t uCode;           // dynarec code and block tables
+    size_t uHistory;        // rewind and reverse execution history
+    size_t uTotal;
+}
+MACHINE_MEMORY;
+
+
+class CMachine final
+{
+    public:
+        CMachine ();
+        CMachine (const CMachine &) = delete;
+        void operator= (const CMachine &) = delete;
+        ~CMachine ();
+
+    public:
+        bool Init (int argc_, char* argv_[]);
+        void Exit ();
+
+        void Call (std::function<void()> fn_);
+        void Wait ();
+
+        void GetMemory (MACHINE_MEMORY *pMemory_);
+
+    protected:
+        void ThreadProc ();
+
+    protected:
+        std::thread m_thread {};
+        std::mutex m_mutex {};
+        std::condition_variable m_cvWork {}, m_cvIdle {};
+        std::deque<std::function<void()>> m_qJobs {};
+        bool m_fBusy = false;       // a job is running
+        bool m_fStopping = false;   // thread asked to finish
+        bool m_fInit = false;       // machine initialised, and needing Exit
+};
+
+#endif  // USE_MACHINES
+
+#endif  // MACHINE_H
@@ -56,7 +56,7 @@ bool Init (int argc_, char* argv_[])
     return OSD::Init(true) && Frame::Init(true) && CPU::Init(true) && UI::Init(true) && Sound::Init(true) && Input::Init(true) && Video::Init(true);
 }
 
-void Exit ()
+void Exit (bool fSaveOptions_/*=true*/)
 {
     GUI::Stop();
 
@@ -68,7 +68,9 @@ void Exit ()
     Frame::Exit();
     OSD::Exit();
 
-    Options::Save();
+    // The benchmark driver leaves the emulator's saved settings alone
+    if (fSaveOptions_)
+        Options::Save();
 
     Util::Exit();
 }
@@ -24,7 +24,7 @@
 namespace Main
 {
     bool Init (int argc_, char* argv_[]);
-    void Exit ();
+    void Exit (bool fSaveOptions_=true);
 }
 
 #endif  // MAIN_H
@@ -25,35 +25,40 @@
 #include "CPU.h"
 #include "Options.h"
 #include "OSD.h"
+#include "State.h"
 #include "Stream.h"
 #include "Util.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 
 // Single block holding all memory needed
-BYTE *pMemory;
+MACHINE_LOCAL BYTE *pMemory;
 
 // Master read and write lists that are static for a given memory configuration
-int anReadPages[TOTAL_PAGES];
-int anWritePages[TOTAL_PAGES];
+MACHINE_LOCAL int anReadPages[TOTAL_PAGES];
+MACHINE_LOCAL int anWritePages[TOTAL_PAGES];
 
 // Page numbers present in each of the 4 sections in the 64K address range
-int anSectionPages[4];
-bool afSectionContended[4];
+MACHINE_LOCAL int anSectionPages[4];
+MACHINE_LOCAL bool afSectionContended[4];
 
 // Array of pointers for memory to use when reading from or writing to each each section
-BYTE *apbSectionReadPtrs[4];
-BYTE *apbSectionWritePtrs[4];
+MACHINE_LOCAL BYTE *apbSectionReadPtrs[4];
+MACHINE_LOCAL BYTE *apbSectionWritePtrs[4];
+
+// Pages that may have been written since the last state checkpoint
+MACHINE_LOCAL bool afPageWritten[TOTAL_PAGES];
 
 // Look-up tables for fast mapping between mode 1 display addresses and line numbers
-WORD g_awMode1LineToByte[SCREEN_LINES];
-BYTE g_abMode1ByteToLine[SCREEN_LINES];
+MACHINE_LOCAL WORD g_awMode1LineToByte[SCREEN_LINES];
+MACHINE_LOCAL BYTE g_abMode1ByteToLine[SCREEN_LINES];
 
 ////////////////////////////////////////////////////////////////////////////////
 
 namespace Memory
 {
-static bool fUpdateRom;
+static MACHINE_LOCAL BYTE *pbMemoryBlock;     // allocation holding the aligned pMemory
+static MACHINE_LOCAL bool fUpdateRom;
 
 static void SetConfig ();
 static bool LoadRoms ();
@@ -70,10 +75,14 @@ bool Init (bool fFirstInit_/*=false*/)
             g_awMode1LineToByte[g_abMode1ByteToLine[uOffset]] = uOffset << 5;
         }
 
-        // Allocate a single block for our memory requirements
-        if (!(pMemory = new BYTE[TOTAL_PAGES*MEM_PAGE_SIZE]))
+        // Allocate a single block for our memory requirements, aligned to a page so that
+        // host pages don't straddle ours, allowing them to be protected for watchpoints
+        if (!(pbMemoryBlock = new BYTE[(TOTAL_PAGES+1)*MEM_PAGE_SIZE]))
             Message(msgFatal, "Out of memory!");
 
+        uintptr_t uMisalign = reinterpret_cast<uintptr_t>(pbMemoryBlock) & (MEM_PAGE_SIZE-1);
+        pMemory = pbMemoryBlock + (uMisalign ? MEM_PAGE_SIZE-uMisalign : 0);
+
         // Initialise memory to 0xff
         memset(pMemory, 0xff, TOTAL_PAGES*MEM_PAGE_SIZE);
 
@@ -92,6 +101,9 @@ bool Init (bool fFirstInit_/*=false*/)
         fUpdateRom = false;
     }
 
+    // Any existing checkpoint is now out of date
+    MarkAllWritten();
+
     return true;
 }
 
@@ -99,8 +111,8 @@ void Exit (bool fReInit_/*=false*/)
 {
     if (!fReInit_)
     {
-        delete[] pMemory;
-        pMemory = nullptr;
+        delete[] pbMemoryBlock;
+        pbMemoryBlock = pMemory = nullptr;
     }
 }
 
@@ -118,10 +130,65 @@ void UpdateRom ()
 }
 
 
+// Save or restore the contents of all active RAM and ROM pages
+void Serialize (CState &state_)
+{
+    state_.Section(STATE_TAG('M','E','M',' '));
+
+    int nIntPages = (GetOption(mainmem) == 256) ? N_PAGES_MAIN / 2 : N_PAGES_MAIN;
+    int nExtPages = std::min(GetOption(externalmem), MAX_EXTERNAL_MB) * N_PAGES_1MB;
+
+    // Store the page counts so a different memory configuration is rejected
+    int nPages = nIntPages, nExt = nExtPages;
+    state_.Value(nPages);
+    state_.Value(nExt);
+
+    if (nPages != nIntPages || nExt != nExtPages)
+        state_.SetError();
+    else if (!state_.IsCheckpoint())
+    {
+        state_.Data(pMemory + INTMEM*MEM_PAGE_SIZE, nIntPages*MEM_PAGE_SIZE);
+        state_.Data(pMemory + EXTMEM*MEM_PAGE_SIZE, nExtPages*MEM_PAGE_SIZE);
+        state_.Data(pMemory + ROM0*MEM_PAGE_SIZE, 2*MEM_PAGE_SIZE);
+
+        // Memory no longer matches any checkpoint
+        if (state_.IsLoading())
+            MarkAllWritten();
+    }
+    else
+    {
+        // Checkpoints only transfer pages written since the last one, as the rest already match
+        const int anFirst[] = { INTMEM, EXTMEM, ROM0 }, anCount[] = { nIntPages, nExtPages, 2 };
+        for (int i = 0 ; i < 3 ; i++)
+        {
+            for (int nPage = anFirst[i] ; nPage < anFirst[i]+anCount[i] ; nPage++)
+            {
+                if (afPageWritten[nPage])
+                    state_.Data(pMemory + nPage*MEM_PAGE_SIZE, MEM_PAGE_SIZE);
+                else
+                    state_.Skip(MEM_PAGE_SIZE);
+            }
+        }
+
+        // Start tracking afresh, with the currently writable pages assumed written
+        memset(afPageWritten, 0, sizeof(afPageWritten));
+        for (int i = SECTION_A ; i <= SECTION_D ; i++)
+            afPageWritten[PtrPage(apbSectionWritePtrs[i])] = true;
+    }
+}
+
+// Flag all pages as needing a full copy at the next checkpoint
+void MarkAllWritten ()
+{
+    for (int i = 0 ; i < TOTAL_PAGES ; i++)
+        afPageWritten[i] = true;
+}
+
+
 // Memory page description, for the debugger
 const char *PageDesc (int nPage_, bool fCompact_/*=false*/)
 {
-    static char sz[32];
+    static MACHINE_LOCAL char sz[32];
     const char *pcszSep = fCompact_ ? "" : " ";
 
     if (nPage_ >= INTMEM && nPage_ < EXTMEM)
@@ -24,6 +24,8 @@
 
 #include "Frame.h"
 
+class CState;
+
 namespace Memory
 {
     bool Init (bool fFirstInit_=false);
@@ -32,25 +34,30 @@ namespace Memory
     void UpdateConfig ();
     void UpdateRom ();
 
+    void Serialize (CState &state_);
+    void MarkAllWritten ();
+
     const char *PageDesc (int nPage_, bool fCompact_=false);
 }
 
 enum { INTMEM, EXTMEM=N_PAGES_MAIN, ROM0=EXTMEM+(N_PAGES_1MB*MAX_EXTERNAL_MB), ROM1, SCRATCH_READ, SCRATCH_WRITE, TOTAL_PAGES };
 enum eSection { SECTION_A, SECTION_B, SECTION_C, SECTION_D };
 
-extern BYTE *pMemory;
+extern MACHINE_LOCAL BYTE *pMemory;
+
+extern MACHINE_LOCAL int anReadPages[TOTAL_PAGES];
+extern MACHINE_LOCAL int anWritePages[TOTAL_PAGES];
 
-extern int anReadPages[];
-extern int anWritePages[];
+extern MACHINE_LOCAL int anSectionPages[4];
+extern MACHINE_LOCAL bool afSectionContended[4];
 
-extern int anSectionPages[4];
-extern bool afSectionContended[4];
+extern MACHINE_LOCAL BYTE* apbSectionReadPtrs[4];
+extern MACHINE_LOCAL BYTE* apbSectionWritePtrs[4];
 
-extern BYTE* apbSectionReadPtrs[4];
-extern BYTE* apbSectionWritePtrs[4];
+extern MACHINE_LOCAL bool afPageWritten[TOTAL_PAGES];
 
-extern BYTE g_abMode1ByteToLine[SCREEN_LINES];
-extern WORD g_awMode1LineToByte[SCREEN_LINES];
+extern MACHINE_LOCAL BYTE g_abMode1ByteToLine[SCREEN_LINES];
+extern MACHINE_LOCAL WORD g_awMode1LineToByte[SCREEN_LINES];
 
 
 // Map a 16-bit address through the memory indirection - allows fast paging
@@ -72,6 +79,9 @@ inline bool ReadOnlyAddr (WORD wAddr_) { return apbSectionWritePtrs[AddrSection(
 inline int PtrPage (const void *pv_) { return int((reinterpret_cast<const BYTE*>(pv_)-pMemory)/MEM_PAGE_SIZE); }
 inline int PtrOffset (const void *pv_) { return int((reinterpret_cast<const BYTE*>(pv_)-pMemory) & (MEM_PAGE_SIZE-1)); }
 
+// Flag a page written outside the normal paging, so the next checkpoint includes it
+inline void MarkPageWritten (int nPage_) { afPageWritten[anWritePages[nPage_]] = true; }
+
 void write_to_screen_vmpr0 (WORD wAddr_);
 void write_to_screen_vmpr1 (WORD wAddr_);
 void write_word (WORD wAddr_, WORD wVal_);
@@ -124,6 +134,9 @@ inline void PageIn (eSection nSection_, int nPage_)
     apbSectionReadPtrs[nSection_] = PageReadPtr(nPage_);
     apbSectionWritePtrs[nSection_] = PageWritePtr(nPage_);
 
+    // Any page paged in for writing may change before the next checkpoint
+    afPageWritten[anWritePages[nPage_]] = true;
+
     // If section A is write-protected, writes should be discarded
     if ((nSection_ == SECTION_A) && (lmpr & LMPR_WPROT))
         apbSectionWritePtrs[nSection_] = PageWritePtr(SCRATCH_WRITE);
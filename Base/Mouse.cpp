@@ -28,6 +28,7 @@
 
 #include "CPU.h"
 #include "Options.h"
+#include "State.h"
 #include "Util.h"
 
 
@@ -114,6 +115,20 @@ void CMouseDevice::SetButton (int nButton_, bool fPressed_/*=true*/)
         m_bButtons &= ~bBit;
 }
 
+// Save or restore the read state, leaving host movement and buttons untouched
+void CMouseDevice::Serialize (CState &state_)
+{
+    state_.Section(STATE_TAG('M','O','U','S'));
+
+    // Include unread movement, so frames replayed from a checkpoint see it again
+    state_.Value(m_nDeltaX);
+    state_.Value(m_nDeltaY);
+    state_.Value(m_nReadX);
+    state_.Value(m_nReadY);
+    state_.Value(m_sMouse);
+    state_.Value(m_uBuffer);
+}
+
 // Report whetheer the mouse is actively in use
 bool CMouseDevice::IsActive () const
 {
@@ -46,6 +46,7 @@ class CMouseDevice : public CIoDevice
     public:
         void Reset () override;
         BYTE In (WORD wPort_) override;
+        void Serialize (CState &state_) override;
 
     public:
         void Move (int nDeltaX_, int nDeltaY_);
@@ -62,6 +63,6 @@ class CMouseDevice : public CIoDevice
         UINT m_uBuffer = 0;                 // Read position in mouse data
 };
 
-extern CMouseDevice *pMouse;
+extern MACHINE_LOCAL CMouseDevice *pMouse;
 
 #endif // MOUSE_H
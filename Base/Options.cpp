@@ -50,14 +50,14 @@ typedef struct
     bool fSpecified;
 } OPTION;
 
-OPTIONS s_Options;
+MACHINE_LOCAL OPTIONS s_Options;
 
 // Helper macros for structure definition below
 #define OPT_S(o,v,s)        { o, OT_STRING, {&s_Options.v}, (s), 0,  false }
 #define OPT_N(o,v,n)        { o, OT_INT,    {&s_Options.v}, "", (n), false }
 #define OPT_F(o,v,f)        { o, OT_BOOL,   {&s_Options.v}, "",  0,  (f) }
 
-OPTION aOptions[] =
+static MACHINE_LOCAL OPTION aOptions[] =
 {
     OPT_N("CfgVersion",   cfgversion,     0),         // Config compatability number
     OPT_F("FirstRun",     firstrun,       true),      // Non-zero if this is the first run
@@ -76,6 +76,7 @@ OPTION aOptions[] =
     OPT_F("Filter",       filter,         true),      // Filter the image when stretching
     OPT_F("FilterGUI",    filtergui,      false),     // Don't filter the image when the GUI is active
     OPT_N("Direct3D",     direct3d,       -1),        // Automatic use of D3D (currently, Vista or later)
+    OPT_F("DirectRender", directrender,   true),      // Skip the palette index frame when not needed
 
     OPT_N("AviReduce",    avireduce,      1),         // Record 44kHz 8-bit stereo audio (50% saving)
     OPT_F("AviScanlines", aviscanlines,   false),     // Don't include scanlines in AVI recordings
@@ -89,6 +90,10 @@ OPTION aOptions[] =
     OPT_N("ExternalMem",  externalmem,    0),         // No external memory
     OPT_F("CMOSZ80",      cmosz80,        false),     // CMOS rather than NMOS Z80?
     OPT_N("Speed",        speed,          100),       // Default to 100% speed
+    OPT_N("Rewind",       rewind,         0),         // No rewind history
+    OPT_N("ReverseMem",   reversemem,     64),        // 64MB of debugger reverse execution history
+    OPT_F("Dynarec",      dynarec,        false),     // Interpret all Z80 code
+    OPT_F("IdleSkip",     idleskip,       true),      // Skip HALTs and polling loops to the next event
 
     OPT_N("Drive1",       drive1,         1),         // Floppy drive 1 present
     OPT_N("Drive2",       drive2,         1),         // Floppy drive 2 present
@@ -157,6 +162,7 @@ OPTION aOptions[] =
 
     OPT_N("DriveLights",  drivelights,    1),         // Show drive activity lights
     OPT_F("Profile",      profile,        true),      // Show only emulation speed and framerate
+    OPT_F("PerfStats",    perfstats,      false),     // Don't show subsystem timings
     OPT_F("Status",       status,         true),      // Show status line for changed options, etc.
 
     OPT_F("BreakOnExec",  breakonexec,    false),     // Don't break on code auto-execute
@@ -227,7 +233,7 @@ void* GetDefault (const char* pcszName_)
     }
 
     // This should never happen, thanks to a compile-time check in the header
-    static void* pv = nullptr;
+    static MACHINE_LOCAL void* pv = nullptr;
     return &pv;
 }
 
@@ -301,7 +307,7 @@ bool Load (int argc_, char* argv_[])
         }
         else
         {
-            static int nDrive = 1;
+            static MACHINE_LOCAL int nDrive = 1;
 
             // Bare filenames will be inserted into drive 1 then 2
             switch (nDrive++)
@@ -42,6 +42,7 @@ typedef struct
     bool    filter;                 // Filter image when stretching? (if available)
     bool    filtergui;              // Filter image when the GUI is active? (if available)
     int     direct3d;               // Use Direct3D? <0=auto, 0=disable, >0=enable
+    bool    directrender;           // Render straight to the display's pixel format, when possible?
 
     int     avireduce;              // Reduce AVI audio size (0=lossless to 4=muted)
     bool    aviscanlines;           // Include scanlines in AVI recording?
@@ -55,6 +56,10 @@ typedef struct
     int     externalmem;            // Number of MB of external memory
     bool    cmosz80;                // CMOS rather than NMOS Z80?
     int     speed;                  // Running speed (percentage)
+    int     rewind;                 // Seconds of rewind history to keep (0=disabled)
+    int     reversemem;             // MB of reverse execution history for the debugger (0=disabled)
+    bool    dynarec;                // Compile hot Z80 code to native code? (x86-64 only)
+    bool    idleskip;               // Skip ahead through idle HALTs and polling loops?
 
     int     drive1;                 // Drive 1 type
     int     drive2;                 // Drive 2 type
@@ -125,6 +130,7 @@ typedef struct
 
     int     drivelights;            // Show floppy drive LEDs
     bool    profile;                // Show profile stats?
+    bool    perfstats;              // Show subsystem timing stats?
     bool    status;                 // Show status line?
 
     bool    breakonexec;            // Break on code auto-execute?
@@ -143,7 +149,7 @@ namespace Options
     bool Load (int argc_, char* argv[]);
     bool Save ();
 
-    extern OPTIONS s_Options;
+    extern MACHINE_LOCAL OPTIONS s_Options;
 }
 
 
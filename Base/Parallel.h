@@ -106,6 +106,6 @@ class CStereoDACDevice : public CIoDevice
         BYTE m_bControl, m_bData;
 };
 
-extern CPrintBuffer *pPrinterFile;
+extern MACHINE_LOCAL CPrintBuffer *pPrinterFile;
 
 #endif  // PARALLEL_H
@@ -29,6 +29,6 @@ class CPaulaDevice : public CIoDevice
         void Out (WORD wPort_, BYTE bVal_) override;
 };
 
-extern CPaulaDevice *pPaula;
+extern MACHINE_LOCAL CPaulaDevice *pPaula;
 
 #endif  // PAULA_H
@@ -0,0 +1,198 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Perf.cpp: Host timing of emulator subsystems
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  Timers nest, with the inner one pausing the outer, so each subsystem is
+//  charged only for its own time.  This means the CPU total excludes any
+//  line rendering or sound generation triggered by port writes.  Whatever
+//  isn't covered by a timer between frame ends is charged to ptOther.
+//
+//  The per-frame totals for the most recent frames are kept in a ring, for
+//  the on-screen summary and for saving as CSV.
+
+#include "SimCoupe.h"
+#include "Perf.h"
+
+#include <algorithm>
+#include <chrono>
+
+const int PERF_HISTORY = 256;   // frames of history kept, just over 5 seconds
+const int MAX_PERF_DEPTH = 16;  // deepest nesting of timers
+
+static const char *aszNames[MAX_PERF_TIMERS] =
+{
+    "CPU", "Frame", "Flip", "Video", "Sound", "Disk", "Record", "Sync", "Other"
+};
+
+static MACHINE_LOCAL uint64_t aullFrame[MAX_PERF_TIMERS];                 // nanoseconds for each timer this frame
+static MACHINE_LOCAL float aafHistory[PERF_HISTORY][MAX_PERF_TIMERS];     // milliseconds for each timer in recent frames
+static MACHINE_LOCAL int nHistory, nHistoryNext;                          // frames in the history, and next position
+static MACHINE_LOCAL int anStack[MAX_PERF_DEPTH], nDepth;                 // running timers, the innermost active
+static MACHINE_LOCAL uint64_t ullLast, ullFrameStart;                     // time of the last timer change, and frame start
+
+static inline uint64_t Now ()
+{
+    auto tNow = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(tNow).count());
+}
+
+// Fill in the statistics for one column of the history
+static void GetColumnStats (int nTimer_, PERF_STATS *pStats_)
+{
+    float afTimes[PERF_HISTORY];
+    double dTotal = 0.0;
+
+    for (int i = 0 ; i < nHistory ; i++)
+    {
+        float fTime = 0.0f;
+
+        // A negative timer selects the total of all timers for the frame
+        if (nTimer_ >= 0)
+            fTime = aafHistory[i][nTimer_];
+        else
+        {
+            for (int j = 0 ; j < MAX_PERF_TIMERS ; j++)
+                fTime += aafHistory[i][j];
+        }
+
+        afTimes[i] = fTime;
+        dTotal += fTime;
+    }
+
+    std::sort(afTimes, afTimes+nHistory);
+
+    pStats_->dMin = afTimes[0];
+    pStats_->dAvg = dTotal / nHistory;
+    pStats_->dP99 = afTimes[(nHistory-1) * 99 / 100];
+    pStats_->dMax = afTimes[nHistory-1];
+}
+
+
+namespace Perf
+{
+
+// Start timing a subsystem, pausing any timer already running
+void Start (int nTimer_)
+{
+    uint64_t ullNow = Now();
+
+    if (nDepth)
+        aullFrame[anStack[nDepth-1]] += ullNow - ullLast;
+
+    if (nDepth < MAX_PERF_DEPTH)
+        anStack[nDepth] = nTimer_;
+
+    nDepth++;
+    ullLast = ullNow;
+}
+
+// Stop the innermost timer, resuming any outer one
+void Stop ()
+{
+    uint64_t ullNow = Now();
+
+    if (--nDepth < MAX_PERF_DEPTH)
+        aullFrame[anStack[nDepth]] += ullNow - ullLast;
+
+    ullLast = ullNow;
+}
+
+// Add the totals for the completed frame to the history
+void FrameEnd ()
+{
+    uint64_t ullNow = Now();
+
+    // Charge any running timer up to this point
+    if (nDepth && nDepth <= MAX_PERF_DEPTH)
+        aullFrame[anStack[nDepth-1]] += ullNow - ullLast;
+    ullLast = ullNow;
+
+    // Time outside the timers is charged to other, unless this is the first frame
+    uint64_t ullTimed = 0;
+    for (int i = 0 ; i < MAX_PERF_TIMERS ; i++)
+        ullTimed += aullFrame[i];
+
+    uint64_t ullElapsed = ullFrameStart ? ullNow - ullFrameStart : ullTimed;
+    aullFrame[ptOther] += (ullElapsed > ullTimed) ? ullElapsed - ullTimed : 0;
+    ullFrameStart = ullNow;
+
+    for (int i = 0 ; i < MAX_PERF_TIMERS ; i++)
+    {
+        aafHistory[nHistoryNext][i] = aullFrame[i] / 1000000.0f;
+        aullFrame[i] = 0;
+    }
+
+    nHistoryNext = (nHistoryNext + 1) % PERF_HISTORY;
+    nHistory = std::min(nHistory+1, PERF_HISTORY);
+}
+
+
+const char *GetName (int nTimer_)
+{
+    return (nTimer_ >= 0 && nTimer_ < MAX_PERF_TIMERS) ? aszNames[nTimer_] : "Total";
+}
+
+// Fill in the statistics for each timer, and optionally the frame total, returning the frames covered
+int GetStats (PERF_STATS *pStats_, PERF_STATS *pTotal_/*=nullptr*/)
+{
+    if (!nHistory)
+        return 0;
+
+    for (int i = 0 ; i < MAX_PERF_TIMERS ; i++)
+        GetColumnStats(i, &pStats_[i]);
+
+    if (pTotal_)
+        GetColumnStats(-1, pTotal_);
+
+    return nHistory;
+}
+
+// Save the per-frame history as CSV, oldest frame first
+bool Save (const char *pcszPath_)
+{
+    FILE *f = fopen(pcszPath_, "w");
+    if (!f)
+        return false;
+
+    fprintf(f, "Frame");
+    for (int i = 0 ; i < MAX_PERF_TIMERS ; i++)
+        fprintf(f, ",%s", aszNames[i]);
+    fprintf(f, ",Total\n");
+
+    for (int i = 0 ; i < nHistory ; i++)
+    {
+        const float *pfTimes = aafHistory[(nHistoryNext - nHistory + i + PERF_HISTORY) % PERF_HISTORY];
+        float fTotal = 0.0f;
+
+        fprintf(f, "%d", i - nHistory + 1);
+        for (int j = 0 ; j < MAX_PERF_TIMERS ; j++)
+        {
+            fprintf(f, ",%.3f", pfTimes[j]);
+            fTotal += pfTimes[j];
+        }
+        fprintf(f, ",%.3f\n", fTotal);
+    }
+
+    bool fOK = !ferror(f);
+    fclose(f);
+    return fOK;
+}
+
+} // namespace Perf
@@ -0,0 +1,54 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Perf.h: Host timing of emulator subsystems
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef PERF_H
+#define PERF_H
+
+// Subsystems timed, with ptOther for any time not covered by them
+enum ePerfTimer { ptCPU, ptFrame, ptFlip, ptVideo, ptSound, ptDisk, ptRecord, ptSync, ptOther, MAX_PERF_TIMERS };
+
+typedef struct
+{
+    double dMin, dAvg, dP99, dMax;  // milliseconds per frame over the recent history
+} PERF_STATS;
+
+
+namespace Perf
+{
+    void Start (int nTimer_);
+    void Stop ();
+    void FrameEnd ();
+
+    const char *GetName (int nTimer_);
+    int GetStats (PERF_STATS *pStats_, PERF_STATS *pTotal_=nullptr);
+    bool Save (const char *pcszPath_);
+}
+
+// Time the rest of the enclosing scope against a subsystem, pausing any outer timer meanwhile
+class CPerfScope
+{
+    public:
+        CPerfScope (int nTimer_) { Perf::Start(nTimer_); }
+        CPerfScope (const CPerfScope &) = delete;
+        void operator= (const CPerfScope &) = delete;
+        ~CPerfScope () { Perf::Stop(); }
+};
+
+#endif  // PERF_H
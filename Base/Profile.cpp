@@ -0,0 +1,481 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Profile.cpp: Guest code profiler
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  While active, each instruction boundary charges the T-states since the
+//  previous one, including any contention, to the physical location of the
+//  previous instruction and to the function it was running in.
+//
+//  Functions are identified by the physical location of their entry point,
+//  and tracked on a shadow stack by CALL, RST, interrupt acceptance and RET.
+//  A return pops any frames at or below the stack position it returns from,
+//  so returns that don't match a call (such as PUSH+RET jumps) are ignored,
+//  and frames skipped by discarding return addresses are dropped later.
+//
+//  Costs are kept against a calling context tree, with a node for each
+//  distinct chain of calls.  It can be saved as folded stacks for flame
+//  graphs, or summarised per function in callgrind format.
+
+#include "SimCoupe.h"
+#include "Profile.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+#include "CPU.h"
+#include "Memory.h"
+#include "Symbol.h"
+
+const DWORD PROFILE_ROOT = 0xffffffff;  // function for code run outside any call
+const size_t MAX_PROFILE_DEPTH = 1024;  // deepest call stack tracked
+
+typedef struct
+{
+    uint64_t aullTime[MEM_PAGE_SIZE];   // T-states at each offset
+    DWORD adwCount[MEM_PAGE_SIZE];      // instructions executed at each offset
+} PROFILE_PAGE;
+
+typedef struct
+{
+    DWORD dwFunc;           // physical location of the function entry point
+    int nParent;            // calling node, or -1 for the root
+    WORD wSite;             // address of the instruction making the call
+    uint64_t ullTime;       // T-states spent in the function itself, in this context
+    uint64_t ullInstrs;     // instructions executed in the function itself
+    uint64_t ullCalls;      // times called in this context
+} PROFILE_NODE;
+
+typedef struct
+{
+    int nNode;              // node entered by the call
+    WORD wRetSP;            // stack location of the return address
+} PROFILE_FRAME;
+
+typedef struct
+{
+    WORD wAddr;             // entry point address when first called
+    std::string sName;
+} PROFILE_FUNC;
+
+static MACHINE_LOCAL bool fActive;
+
+static MACHINE_LOCAL std::unique_ptr<PROFILE_PAGE> apPages[TOTAL_PAGES];  // allocated when code first runs in the page
+static MACHINE_LOCAL std::vector<PROFILE_NODE> vNodes;                    // calling context tree, parents before children
+static MACHINE_LOCAL std::unordered_map<uint64_t, int> mChildren;         // node for each parent node and function
+static MACHINE_LOCAL std::unordered_map<DWORD, PROFILE_FUNC> mFuncs;      // details of each function seen
+static MACHINE_LOCAL std::vector<PROFILE_FRAME> vStack;                   // shadow call stack
+
+static MACHINE_LOCAL int nNode, nInstrNode;               // current node, and the node of the previous instruction
+static MACHINE_LOCAL uint64_t *pullLastTime;              // T-states counter for the previous instruction
+static MACHINE_LOCAL DWORD *pdwLastCount;                 // execution counter for the previous instruction
+static MACHINE_LOCAL DWORD dwLastTime;                    // cycle counter at the previous instruction boundary
+static MACHINE_LOCAL WORD wLastPC;                        // address of the previous instruction
+static MACHINE_LOCAL uint64_t ullTotal;                   // T-states profiled
+
+
+// Name a location from the symbol table, falling back on the page and address
+static std::string GetName (int nPage_, WORD wAddr_, bool fAllowOffset_)
+{
+    std::string sName = Symbol::LookupAddr(wAddr_, 0, fAllowOffset_);
+
+    if (sName.empty())
+    {
+        char sz[32];
+        snprintf(sz, sizeof(sz), "%s:%04X", Memory::PageDesc(nPage_, true), wAddr_);
+        sName = sz;
+    }
+
+    return sName;
+}
+
+// Return the address of a page offset with the current paging, or just the offset if it's not paged in
+static WORD GetPagedAddr (int nPage_, WORD wOffset_)
+{
+    for (int i = SECTION_A ; i <= SECTION_D ; i++)
+    {
+        if (GetSectionPage(static_cast<eSection>(i)) == nPage_)
+            return static_cast<WORD>(i*MEM_PAGE_SIZE + wOffset_);
+    }
+
+    return wOffset_;
+}
+
+// Total the costs of each node and all its callees, relying on parents coming before children
+static void GetInclusive (std::vector<uint64_t> &vTime_, std::vector<uint64_t> &vInstrs_)
+{
+    vTime_.resize(vNodes.size());
+    vInstrs_.resize(vNodes.size());
+
+    for (size_t i = 0 ; i < vNodes.size() ; i++)
+    {
+        vTime_[i] = vNodes[i].ullTime;
+        vInstrs_[i] = vNodes[i].ullInstrs;
+    }
+
+    for (size_t i = vNodes.size()-1 ; i > 0 ; i--)
+    {
+        vTime_[vNodes[i].nParent] += vTime_[i];
+        vInstrs_[vNodes[i].nParent] += vInstrs_[i];
+    }
+}
+
+// Return whether a node's function is also one of its callers, so recursion isn't counted twice
+static bool IsRecursive (int nNode_)
+{
+    DWORD dwFunc = vNodes[nNode_].dwFunc;
+
+    for (int n = vNodes[nNode_].nParent ; n > 0 ; n = vNodes[n].nParent)
+    {
+        if (vNodes[n].dwFunc == dwFunc)
+            return true;
+    }
+
+    return false;
+}
+
+static std::string GetFuncName (DWORD dwFunc_)
+{
+    return (dwFunc_ == PROFILE_ROOT) ? "(top)" : mFuncs.find(dwFunc_)->second.sName;
+}
+
+static WORD GetFuncAddr (DWORD dwFunc_)
+{
+    return (dwFunc_ == PROFILE_ROOT) ? 0 : mFuncs.find(dwFunc_)->second.wAddr;
+}
+
+
+namespace Profile
+{
+
+void Exit (bool fReInit_/*=false*/)
+{
+    if (!fReInit_)
+    {
+        Stop();
+        Reset();
+    }
+}
+
+
+// Start or resume profiling, keeping any existing results
+void Start ()
+{
+    if (fActive)
+        return;
+
+    if (vNodes.empty())
+        Reset();
+
+    // The call stack is unknown, so start again from the top
+    vStack.clear();
+    nNode = nInstrNode = 0;
+    pullLastTime = nullptr;
+    dwLastTime = g_dwCycleCounter;
+
+    // Return to the main loop to select a CPU core that profiles
+    g_fBreak = true;
+    fActive = true;
+}
+
+void Stop ()
+{
+    fActive = false;
+}
+
+// Discard all results
+void Reset ()
+{
+    for (auto &pPage : apPages)
+        pPage.reset();
+
+    vNodes.clear();
+    vNodes.push_back({ PROFILE_ROOT, -1, 0, 0, 0, 0 });
+    mChildren.clear();
+    mFuncs.clear();
+    vStack.clear();
+
+    nNode = nInstrNode = 0;
+    pullLastTime = nullptr;
+    pdwLastCount = nullptr;
+    dwLastTime = g_dwCycleCounter;
+    ullTotal = 0;
+}
+
+bool IsActive ()
+{
+    return fActive;
+}
+
+
+// Charge the previous instruction at an instruction boundary, and note the next one
+void Record ()
+{
+    DWORD dwTime = g_dwCycleCounter - dwLastTime;
+    dwLastTime = g_dwCycleCounter;
+
+    if (pullLastTime)
+    {
+        *pullLastTime += dwTime;
+        (*pdwLastCount)++;
+
+        PROFILE_NODE &node = vNodes[nInstrNode];
+        node.ullTime += dwTime;
+        node.ullInstrs++;
+
+        ullTotal += dwTime;
+    }
+
+    size_t uOffset = static_cast<size_t>(AddrReadPtr(PC) - pMemory);
+    int nPage = static_cast<int>(uOffset / MEM_PAGE_SIZE);
+    uOffset %= MEM_PAGE_SIZE;
+
+    PROFILE_PAGE *pPage = apPages[nPage].get();
+    if (!pPage)
+        apPages[nPage].reset(pPage = new PROFILE_PAGE());
+
+    pullLastTime = &pPage->aullTime[uOffset];
+    pdwLastCount = &pPage->adwCount[uOffset];
+    nInstrNode = nNode;
+    wLastPC = PC;
+}
+
+// A call, RST or interrupt has pushed a return address and jumped to PC
+void OnCall ()
+{
+    DWORD dwFunc = static_cast<DWORD>(AddrReadPtr(PC) - pMemory);
+    uint64_t ullKey = (static_cast<uint64_t>(nNode) << 32) | dwFunc;
+    int nChild;
+
+    auto it = mChildren.find(ullKey);
+    if (it != mChildren.end())
+        nChild = it->second;
+    else
+    {
+        nChild = static_cast<int>(vNodes.size());
+        vNodes.push_back({ dwFunc, nNode, wLastPC, 0, 0, 0 });
+        mChildren[ullKey] = nChild;
+
+        // Name new functions while the paging is the same as for the call
+        if (mFuncs.find(dwFunc) == mFuncs.end())
+            mFuncs.insert({ dwFunc, { PC, GetName(dwFunc / MEM_PAGE_SIZE, PC, false) } });
+    }
+
+    vNodes[nChild].ullCalls++;
+
+    // Calls beyond the maximum depth are charged to the caller
+    if (vStack.size() < MAX_PROFILE_DEPTH)
+    {
+        vStack.push_back({ nChild, SP });
+        nNode = nChild;
+    }
+}
+
+// A return is about to pop the address at SP
+void OnRet ()
+{
+    while (!vStack.empty() && static_cast<WORD>(SP - vStack.back().wRetSP) < 0x8000)
+        vStack.pop_back();
+
+    nNode = vStack.empty() ? 0 : vStack.back().nNode;
+}
+
+// Keep the instruction timings continuous across the frame counter adjustment
+void FrameEnd ()
+{
+    dwLastTime -= TSTATES_PER_FRAME;
+}
+
+
+uint64_t GetTotal ()
+{
+    return ullTotal;
+}
+
+// Summarise the costs for each function, most expensive first
+void GetFunctions (std::vector<PROFILE_ENTRY> &vEntries_)
+{
+    vEntries_.clear();
+    if (vNodes.empty())
+        return;
+
+    std::vector<uint64_t> vTime, vInstrs;
+    GetInclusive(vTime, vInstrs);
+
+    std::unordered_map<DWORD, size_t> mIndex;
+
+    for (size_t i = 0 ; i < vNodes.size() ; i++)
+    {
+        const PROFILE_NODE &node = vNodes[i];
+
+        auto it = mIndex.find(node.dwFunc);
+        if (it == mIndex.end())
+        {
+            int nPage = (node.dwFunc == PROFILE_ROOT) ? -1 : static_cast<int>(node.dwFunc / MEM_PAGE_SIZE);
+            it = mIndex.insert({ node.dwFunc, vEntries_.size() }).first;
+            vEntries_.push_back({ nPage, GetFuncAddr(node.dwFunc), GetFuncName(node.dwFunc), 0, 0, 0 });
+        }
+
+        PROFILE_ENTRY &entry = vEntries_[it->second];
+        entry.ullSelf += node.ullTime;
+        entry.ullCount += node.ullCalls;
+
+        if (!IsRecursive(static_cast<int>(i)))
+            entry.ullTotal += vTime[i];
+    }
+
+    std::sort(vEntries_.begin(), vEntries_.end(), [] (const PROFILE_ENTRY &a, const PROFILE_ENTRY &b)
+        { return a.ullTotal > b.ullTotal || (a.ullTotal == b.ullTotal && a.ullSelf > b.ullSelf); });
+}
+
+// Return the most expensive individual instruction locations
+void GetAddresses (std::vector<PROFILE_ENTRY> &vEntries_, size_t uMaxEntries_)
+{
+    vEntries_.clear();
+
+    for (int nPage = 0 ; nPage < TOTAL_PAGES ; nPage++)
+    {
+        PROFILE_PAGE *pPage = apPages[nPage].get();
+        if (!pPage)
+            continue;
+
+        for (WORD wOffset = 0 ; wOffset < MEM_PAGE_SIZE ; wOffset++)
+        {
+            if (pPage->adwCount[wOffset])
+                vEntries_.push_back({ nPage, wOffset, "", pPage->aullTime[wOffset], 0, pPage->adwCount[wOffset] });
+        }
+    }
+
+    auto itEnd = vEntries_.begin() + std::min(uMaxEntries_, vEntries_.size());
+    std::partial_sort(vEntries_.begin(), itEnd, vEntries_.end(), [] (const PROFILE_ENTRY &a, const PROFILE_ENTRY &b)
+        { return a.ullSelf > b.ullSelf; });
+    vEntries_.erase(itEnd, vEntries_.end());
+
+    // Only the locations kept are named, using the current paging
+    for (auto &entry : vEntries_)
+    {
+        entry.wAddr = GetPagedAddr(entry.nPage, entry.wAddr);
+        entry.sName = GetName(entry.nPage, entry.wAddr, true);
+    }
+}
+
+
+// Save the call graph as folded stacks, or per-function costs and calls in callgrind format
+bool Save (const char *pcszPath_, bool fFolded_/*=false*/)
+{
+    FILE *f = fopen(pcszPath_, "w");
+    if (!f)
+        return false;
+
+    if (vNodes.empty())
+        Reset();
+
+    if (fFolded_)
+    {
+        // One line per calling context, with the chain of names from the top
+        for (size_t i = 0 ; i < vNodes.size() ; i++)
+        {
+            if (!vNodes[i].ullTime)
+                continue;
+
+            std::string sStack;
+            for (int n = static_cast<int>(i) ; n >= 0 ; n = vNodes[n].nParent)
+                sStack = GetFuncName(vNodes[n].dwFunc) + (sStack.empty() ? "" : ";") + sStack;
+
+            fprintf(f, "%s %llu\n", sStack.c_str(), static_cast<unsigned long long>(vNodes[i].ullTime));
+        }
+    }
+    else
+    {
+        std::vector<uint64_t> vTime, vInstrs;
+        GetInclusive(vTime, vInstrs);
+
+        typedef struct { uint64_t ullSelf, ullInstrs; int nId; } FUNC_COST;
+        typedef struct { uint64_t ullCalls, ullTime, ullInstrs; WORD wSite; } CALL_COST;
+        std::map<DWORD, FUNC_COST> mCosts;
+        std::map<std::pair<DWORD,DWORD>, CALL_COST> mCalls;
+
+        for (size_t i = 0 ; i < vNodes.size() ; i++)
+        {
+            const PROFILE_NODE &node = vNodes[i];
+
+            FUNC_COST &cost = mCosts[node.dwFunc];
+            cost.ullSelf += node.ullTime;
+            cost.ullInstrs += node.ullInstrs;
+
+            if (node.nParent >= 0)
+            {
+                auto it = mCalls.find({ vNodes[node.nParent].dwFunc, node.dwFunc });
+                if (it == mCalls.end())
+                    it = mCalls.insert({ { vNodes[node.nParent].dwFunc, node.dwFunc }, { 0, 0, 0, node.wSite } }).first;
+
+                it->second.ullCalls += node.ullCalls;
+                it->second.ullTime += vTime[i];
+                it->second.ullInstrs += vInstrs[i];
+            }
+        }
+
+        fprintf(f, "# callgrind format\nversion: 1\ncreator: SimCoupe\npositions: instr\nevents: Tstates Instructions\n");
+        fprintf(f, "summary: %llu %llu\n", static_cast<unsigned long long>(vTime[0]), static_cast<unsigned long long>(vInstrs[0]));
+
+        // Functions are given numbers, with the name only written the first time
+        int nIds = 0;
+        for (auto &it : mCosts)
+            it.second.nId = ++nIds;
+
+        std::vector<bool> vNamed(nIds+1);
+        auto FuncRef = [&] (DWORD dwFunc_)
+        {
+            int nId = mCosts[dwFunc_].nId;
+            std::string s = "(" + std::to_string(nId) + ")";
+            if (!vNamed[nId])
+            {
+                s += " " + GetFuncName(dwFunc_);
+                vNamed[nId] = true;
+            }
+            return s;
+        };
+
+        auto itCall = mCalls.begin();
+        for (auto &it : mCosts)
+        {
+            fprintf(f, "\nfn=%s\n", FuncRef(it.first).c_str());
+            fprintf(f, "0x%04X %llu %llu\n", GetFuncAddr(it.first),
+                    static_cast<unsigned long long>(it.second.ullSelf), static_cast<unsigned long long>(it.second.ullInstrs));
+
+            // Calls are ordered by caller, in the same order as the functions
+            for ( ; itCall != mCalls.end() && itCall->first.first == it.first ; ++itCall)
+            {
+                const CALL_COST &call = itCall->second;
+                fprintf(f, "cfn=%s\n", FuncRef(itCall->first.second).c_str());
+                fprintf(f, "calls=%llu 0x%04X\n", static_cast<unsigned long long>(call.ullCalls), GetFuncAddr(itCall->first.second));
+                fprintf(f, "0x%04X %llu %llu\n", call.wSite,
+                        static_cast<unsigned long long>(call.ullTime), static_cast<unsigned long long>(call.ullInstrs));
+            }
+        }
+    }
+
+    bool fOK = !ferror(f);
+    fclose(f);
+    return fOK;
+}
+
+} // namespace Profile
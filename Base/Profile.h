@@ -0,0 +1,58 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Profile.h: Guest code profiler
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <string>
+#include <vector>
+
+typedef struct
+{
+    int nPage;              // memory page, or -1 for the root of the call graph
+    WORD wAddr;             // logical address, for functions the entry point when first called
+    std::string sName;      // symbol name or page:offset location
+    uint64_t ullSelf;       // T-states spent at the location, or in the function excluding callees
+    uint64_t ullTotal;      // T-states in the function including callees (functions only)
+    uint64_t ullCount;      // times called for functions, or instructions executed for addresses
+} PROFILE_ENTRY;
+
+
+namespace Profile
+{
+    void Exit (bool fReInit_=false);
+
+    void Start ();
+    void Stop ();
+    void Reset ();
+    bool IsActive ();
+
+    void Record ();
+    void OnCall ();
+    void OnRet ();
+    void FrameEnd ();
+
+    uint64_t GetTotal ();
+    void GetFunctions (std::vector<PROFILE_ENTRY> &vEntries_);
+    void GetAddresses (std::vector<PROFILE_ENTRY> &vEntries_, size_t uMaxEntries_);
+    bool Save (const char *pcszPath_, bool fFolded_=false);
+}
+
+#endif  // PROFILE_H
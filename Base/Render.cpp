@@ -0,0 +1,363 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Render.cpp: Screen data expansion for the display line renderers
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  The scalar versions are the reference, with the others checked against
+//  them by Verify.  The fastest version supported by the host is chosen at
+//  start-up, and can be overridden by name for comparison.
+//
+//  SSE2 expands each mode 1+2 block in one go, comparing the data byte
+//  against a mask of each pixel bit and blending the ink and paper with the
+//  result.  It has no byte shuffle for palette lookups, so modes 3+4 use the
+//  scalar versions.
+//
+//  AVX2 does two blocks per 32-byte write.  The palette fits a register, so
+//  colour indices are looked up 16 or 32 at a time with byte shuffles.  The
+//  FLASH swap of ink and paper is masked in rather than branched on.
+
+#include "SimCoupe.h"
+#include "Render.h"
+
+#include "Frame.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 code is compiled on demand for the functions needing it, and only used if the host supports it
+#if defined(__x86_64__) && defined(__GNUC__)
+#define USE_AVX2
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+const int VERIFY_RUNS = 256;            // random lines checked for each renderer
+const int VERIFY_BLOCKS = 32;           // longest line checked, in blocks
+
+
+static void ScalarAttr (BYTE *pbOut_, const BYTE *pbData_, const BYTE *pbAttr_, int nBlocks_, const UINT *pClut_, bool fFlash_)
+{
+    for (int i = 0 ; i < nBlocks_ ; i++)
+    {
+        BYTE bData = *pbData_++, bAttr = *pbAttr_++, bInk = AttrFg(bAttr), bPaper = AttrBg(bAttr);
+
+        // toggle the colours if we're in the inverse part of the FLASH cycle
+        if (fFlash_ && (bAttr & 0x80))
+            std::swap(bInk, bPaper);
+
+        BYTE ink = pClut_[bInk], paper = pClut_[bPaper];
+
+        pbOut_[0]  = pbOut_[1]  = (bData & 0x80) ? ink : paper;
+        pbOut_[2]  = pbOut_[3]  = (bData & 0x40) ? ink : paper;
+        pbOut_[4]  = pbOut_[5]  = (bData & 0x20) ? ink : paper;
+        pbOut_[6]  = pbOut_[7]  = (bData & 0x10) ? ink : paper;
+        pbOut_[8]  = pbOut_[9]  = (bData & 0x08) ? ink : paper;
+        pbOut_[10] = pbOut_[11] = (bData & 0x04) ? ink : paper;
+        pbOut_[12] = pbOut_[13] = (bData & 0x02) ? ink : paper;
+        pbOut_[14] = pbOut_[15] = (bData & 0x01) ? ink : paper;
+
+        pbOut_ += 16;
+    }
+}
+
+static void ScalarMode3 (BYTE *pbOut_, const BYTE *pbData_, int nBlocks_, const UINT *pClut_)
+{
+    for (int i = 0 ; i < nBlocks_*4 ; i++)
+    {
+        BYTE bData = *pbData_++;
+
+        pbOut_[0] = pClut_[ bData         >> 6];
+        pbOut_[1] = pClut_[(bData & 0x30) >> 4];
+        pbOut_[2] = pClut_[(bData & 0x0c) >> 2];
+        pbOut_[3] = pClut_[(bData & 0x03)     ];
+
+        pbOut_ += 4;
+    }
+}
+
+static void ScalarMode4 (BYTE *pbOut_, const BYTE *pbData_, int nBlocks_, const UINT *pClut_)
+{
+    for (int i = 0 ; i < nBlocks_*4 ; i++)
+    {
+        BYTE bData = *pbData_++;
+
+        pbOut_[0] = pbOut_[1] = pClut_[bData >> 4];
+        pbOut_[2] = pbOut_[3] = pClut_[bData & 0x0f];
+
+        pbOut_ += 4;
+    }
+}
+
+#ifdef USE_SSE2
+
+// Pixel bits for each output byte of a mode 1+2 block, with every pixel shown twice
+static inline __m128i AttrBits ()
+{
+    return _mm_setr_epi8(char(0x80), char(0x80), 0x40, 0x40, 0x20, 0x20, 0x10, 0x10, 8, 8, 4, 4, 2, 2, 1, 1);
+}
+
+// Pack 16 palette entries into bytes, truncated as the scalar code does
+static inline __m128i LoadClut (const UINT *pClut_)
+{
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i *p = reinterpret_cast<const __m128i*>(pClut_);
+
+    __m128i a = _mm_and_si128(_mm_loadu_si128(p+0), mask), b = _mm_and_si128(_mm_loadu_si128(p+1), mask);
+    __m128i c = _mm_and_si128(_mm_loadu_si128(p+2), mask), d = _mm_and_si128(_mm_loadu_si128(p+3), mask);
+    return _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+}
+
+static void Sse2Attr (BYTE *pbOut_, const BYTE *pbData_, const BYTE *pbAttr_, int nBlocks_, const UINT *pClut_, bool fFlash_)
+{
+    const __m128i bits = AttrBits();
+    BYTE bFlash = fFlash_ ? 0xff : 0x00;
+
+    for (int i = 0 ; i < nBlocks_ ; i++)
+    {
+        BYTE bAttr = pbAttr_[i];
+        BYTE ink = pClut_[AttrFg(bAttr)], paper = pClut_[AttrBg(bAttr)];
+
+        // Swap ink and paper for the inverse part of the FLASH cycle
+        BYTE bSwap = (ink ^ paper) & bFlash & static_cast<BYTE>(-(bAttr >> 7));
+        ink ^= bSwap;
+        paper ^= bSwap;
+
+        __m128i set = _mm_cmpeq_epi8(_mm_and_si128(_mm_set1_epi8(static_cast<char>(pbData_[i])), bits), bits);
+        __m128i out = _mm_or_si128(_mm_and_si128(set, _mm_set1_epi8(static_cast<char>(ink))),
+                                   _mm_andnot_si128(set, _mm_set1_epi8(static_cast<char>(paper))));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pbOut_ + i*16), out);
+    }
+}
+
+#endif  // USE_SSE2
+
+#ifdef USE_AVX2
+
+// Repeat each of the first 8 bytes 4 times, spread over both lanes
+static inline AVX2_TARGET __m256i Repeat4 (const BYTE *pb_)
+{
+    const __m256i rep = _mm256_setr_epi8(0,0,0,0, 1,1,1,1, 2,2,2,2, 3,3,3,3, 4,4,4,4, 5,5,5,5, 6,6,6,6, 7,7,7,7);
+    return _mm256_shuffle_epi8(_mm256_broadcastq_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pb_))), rep);
+}
+
+static AVX2_TARGET void Avx2Attr (BYTE *pbOut_, const BYTE *pbData_, const BYTE *pbAttr_, int nBlocks_, const UINT *pClut_, bool fFlash_)
+{
+    const __m128i clut = LoadClut(pClut_);
+    const __m128i flash = _mm_set1_epi8(static_cast<char>(fFlash_ ? 0x80 : 0x00));
+    const __m256i bits = _mm256_broadcastsi128_si256(AttrBits());
+    int i = 0;
+
+    for ( ; i+16 <= nBlocks_ ; i += 16)
+    {
+        __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pbData_+i));
+        __m128i attr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pbAttr_+i));
+
+        // Colour indices for 16 blocks, with ink and paper swapped for the inverse part of the FLASH cycle
+        __m128i paper = _mm_and_si128(_mm_srli_epi16(attr, 3), _mm_set1_epi8(0x0f));
+        __m128i ink = _mm_or_si128(_mm_and_si128(paper, _mm_set1_epi8(8)), _mm_and_si128(attr, _mm_set1_epi8(7)));
+        __m128i swap = _mm_and_si128(_mm_xor_si128(ink, paper), _mm_cmpeq_epi8(_mm_and_si128(attr, flash), _mm_set1_epi8(char(0x80))));
+        ink = _mm_shuffle_epi8(clut, _mm_xor_si128(ink, swap));
+        paper = _mm_shuffle_epi8(clut, _mm_xor_si128(paper, swap));
+
+        __m256i data2 = _mm256_broadcastsi128_si256(data);
+        __m256i ink2 = _mm256_broadcastsi128_si256(ink), paper2 = _mm256_broadcastsi128_si256(paper);
+
+        // Select a block for each lane, and expand a pair at a time
+        __m256i sel = _mm256_inserti128_si256(_mm256_setzero_si256(), _mm_set1_epi8(1), 1);
+        for (int j = 0 ; j < 16 ; j += 2)
+        {
+            __m256i d = _mm256_shuffle_epi8(data2, sel);
+            __m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(d, bits), bits);
+            __m256i out = _mm256_blendv_epi8(_mm256_shuffle_epi8(paper2, sel), _mm256_shuffle_epi8(ink2, sel), set);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pbOut_ + (i+j)*16), out);
+
+            sel = _mm256_add_epi8(sel, _mm256_set1_epi8(2));
+        }
+    }
+
+    Sse2Attr(pbOut_ + i*16, pbData_ + i, pbAttr_ + i, nBlocks_ - i, pClut_, fFlash_);
+}
+
+static AVX2_TARGET void Avx2Mode3 (BYTE *pbOut_, const BYTE *pbData_, int nBlocks_, const UINT *pClut_)
+{
+    // Only the first 4 entries are used, and the rest are zero
+    const __m128i mask = _mm_set1_epi32(0xff);
+    __m128i clut4 = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pClut_)), mask);
+    const __m256i clut = _mm256_broadcastsi128_si256(_mm_packus_epi16(_mm_packs_epi32(clut4, _mm_setzero_si128()), _mm_setzero_si128()));
+
+    // High and low bit of each pixel's colour index, within the repeated data bytes
+    const __m256i hi = _mm256_set1_epi32(0x02082080), lo = _mm256_set1_epi32(0x01041040);
+    int i = 0;
+
+    for ( ; i+2 <= nBlocks_ ; i += 2)
+    {
+        __m256i data = Repeat4(pbData_ + i*4);
+        __m256i index = _mm256_or_si256(_mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(data, hi), hi), _mm256_set1_epi8(2)),
+                                        _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(data, lo), lo), _mm256_set1_epi8(1)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pbOut_ + i*16), _mm256_shuffle_epi8(clut, index));
+    }
+
+    ScalarMode3(pbOut_ + i*16, pbData_ + i*4, nBlocks_ - i, pClut_);
+}
+
+static AVX2_TARGET void Avx2Mode4 (BYTE *pbOut_, const BYTE *pbData_, int nBlocks_, const UINT *pClut_)
+{
+    const __m256i clut = _mm256_broadcastsi128_si256(LoadClut(pClut_));
+    const __m256i nibble = _mm256_set1_epi8(0x0f), first = _mm256_set1_epi32(0x0000ffff);
+    int i = 0;
+
+    for ( ; i+2 <= nBlocks_ ; i += 2)
+    {
+        __m256i data = Repeat4(pbData_ + i*4);
+
+        // The first 2 pixels from each byte use the high nibble, the other 2 the low nibble
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(data, 4), nibble), low = _mm256_and_si256(data, nibble);
+        __m256i index = _mm256_blendv_epi8(low, high, first);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pbOut_ + i*16), _mm256_shuffle_epi8(clut, index));
+    }
+
+    ScalarMode4(pbOut_ + i*16, pbData_ + i*4, nBlocks_ - i, pClut_);
+}
+
+#endif  // USE_AVX2
+
+
+static const RENDERER asRenderers[] =
+{
+    { "scalar", ScalarAttr, ScalarMode3, ScalarMode4 },
+#ifdef USE_SSE2
+    { "sse2", Sse2Attr, ScalarMode3, ScalarMode4 },
+#endif
+#ifdef USE_AVX2
+    { "avx2", Avx2Attr, Avx2Mode3, Avx2Mode4 },
+#endif
+};
+
+static bool IsSupported (const RENDERER &renderer_)
+{
+#ifdef USE_AVX2
+    if (renderer_.pfnMode3 == Avx2Mode3)
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }
+#endif
+    (void)renderer_;
+    return true;
+}
+
+// The list is in order of speed, so pick the last the host supports
+static const RENDERER *FindBest ()
+{
+    const RENDERER *pBest = asRenderers;
+
+    for (auto &renderer : asRenderers)
+    {
+        if (IsSupported(renderer))
+            pBest = &renderer;
+    }
+
+    return pBest;
+}
+
+const RENDERER *g_pRenderer = FindBest();
+
+
+// Simple generator for repeatable test data
+static BYTE NextRandom (DWORD &dwSeed_)
+{
+    dwSeed_ = dwSeed_ * 1103515245 + 12345;
+    return static_cast<BYTE>(dwSeed_ >> 16);
+}
+
+namespace Render
+{
+
+// Use a renderer by name, if the host supports it
+bool Select (const char *pcszName_)
+{
+    for (auto &renderer : asRenderers)
+    {
+        if (!strcasecmp(renderer.pcszName, pcszName_) && IsSupported(renderer))
+        {
+            g_pRenderer = &renderer;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Check each supported renderer gives the same output as the scalar versions, returning the first that doesn't
+bool Verify (const char **ppcszFailed_)
+{
+    const int nOutLen = VERIFY_BLOCKS*16 + 16;      // with space to catch overruns
+    BYTE abData[VERIFY_BLOCKS*4], abAttr[VERIFY_BLOCKS], abExpected[nOutLen], abOut[nOutLen];
+    UINT auClut[N_CLUT_REGS];
+    DWORD dwSeed = 1;
+
+    for (auto &renderer : asRenderers)
+    {
+        if (&renderer == asRenderers || !IsSupported(renderer))
+            continue;
+
+        for (int nRun = 0 ; nRun < VERIFY_RUNS ; nRun++)
+        {
+            for (auto &b : abData) b = NextRandom(dwSeed);
+            for (auto &b : abAttr) b = NextRandom(dwSeed);
+            for (auto &u : auClut) u = NextRandom(dwSeed) & (N_PALETTE_COLOURS-1);
+
+            // Cover every length, and both FLASH phases
+            int nBlocks = 1 + (nRun % VERIFY_BLOCKS);
+            bool fFlash = (nRun & 1) != 0;
+
+            for (int nMode = 1 ; nMode <= 4 ; nMode++)
+            {
+                memset(abExpected, 0xee, sizeof(abExpected));
+                memset(abOut, 0xee, sizeof(abOut));
+
+                if (nMode <= 2)
+                {
+                    ScalarAttr(abExpected, abData, abAttr, nBlocks, auClut, fFlash);
+                    renderer.pfnAttr(abOut, abData, abAttr, nBlocks, auClut, fFlash);
+                }
+                else
+                {
+                    PFNPIXELBLOCKS pfnScalar = (nMode == 3) ? ScalarMode3 : ScalarMode4;
+                    PFNPIXELBLOCKS pfnRender = (nMode == 3) ? renderer.pfnMode3 : renderer.pfnMode4;
+                    pfnScalar(abExpected, abData, nBlocks, auClut);
+                    pfnRender(abOut, abData, nBlocks, auClut);
+                }
+
+                if (memcmp(abExpected, abOut, sizeof(abOut)))
+                {
+                    *ppcszFailed_ = renderer.pcszName;
+                    return false;
+                }
+            }
+        }
+    }
+
+    *ppcszFailed_ = nullptr;
+    return true;
+}
+
+} // namespace Render
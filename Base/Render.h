@@ -0,0 +1,44 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Render.h: Screen data expansion for the display line renderers
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef RENDER_H
+#define RENDER_H
+
+// Expand screen blocks to 16 palette indices each, for modes 1+2 (data and attribute bytes) or 3+4 (4 data bytes)
+typedef void (*PFNATTRBLOCKS)(BYTE *pbOut_, const BYTE *pbData_, const BYTE *pbAttr_, int nBlocks_, const UINT *pClut_, bool fFlash_);
+typedef void (*PFNPIXELBLOCKS)(BYTE *pbOut_, const BYTE *pbData_, int nBlocks_, const UINT *pClut_);
+
+typedef struct
+{
+    const char *pcszName;
+    PFNATTRBLOCKS pfnAttr;      // modes 1+2, 1 bit per pixel with ink and paper from the attribute
+    PFNPIXELBLOCKS pfnMode3;    // 2 bits per pixel, through the 4 entry mode 3 palette
+    PFNPIXELBLOCKS pfnMode4;    // 4 bits per pixel, each shown twice
+} RENDERER;
+
+extern const RENDERER *g_pRenderer;     // fastest supported by the host, shared by all machines
+
+namespace Render
+{
+    bool Select (const char *pcszName_);
+    bool Verify (const char **ppcszFailed_);
+}
+
+#endif  // RENDER_H
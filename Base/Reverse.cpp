@@ -0,0 +1,528 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Reverse.cpp: Reverse execution for the debugger
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  While the debugger is armed, by being open or having breakpoints set, the
+//  machine state is checkpointed every few frames and each value read from an
+//  I/O port is logged.  Going backwards restores an earlier checkpoint and
+//  runs forwards again, with port reads answered from the log, so the same
+//  instructions run with the same results.
+//
+//  Positions are T-states since recording started, and matches are only
+//  looked for at instruction boundaries, where the debugger would stop.  A
+//  reverse operation replays from the newest checkpoint before the current
+//  position, noting the last matches before it, and moves to older ones
+//  until enough are found.  It then replays from that checkpoint again to
+//  stop at the match.  History after it is dropped, as running on records a
+//  new future.
+//
+//  Checkpoints are held like the rewind history, as reverse deltas from the
+//  newest state.  When the memory limit is reached, the oldest checkpoints
+//  are thinned out, doubling their spacing while a gap can still be replayed
+//  quickly at the measured replay speed, and beyond that the oldest go.
+//
+//  Idle skipping is disabled while recording, as it skips port reads that a
+//  replay would make.  Changes made from the debugger aren't recorded, and
+//  disk and tape media aren't part of the state, so those are left as they
+//  are now when going back past them.
+
+#include "SimCoupe.h"
+#include "Reverse.h"
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include "Breakpoint.h"
+#include "CPU.h"
+#include "Debug.h"
+#include "Frame.h"
+#include "Memory.h"
+#include "Options.h"
+#include "Rewind.h"
+#include "State.h"
+
+const int CHECKPOINT_FRAMES = 10;           // frames between new checkpoints
+const double REPLAY_TIME = 0.4;             // seconds to replay the widest gap, allowing for a scan and a seek within a second
+const double DEFAULT_REPLAY_FPS = 500.0;    // replay speed assumed until it's been measured
+const int MAX_STEP_BACK = 100000;           // most instructions stepped back at once
+
+enum { rmStep, rmBreak, rmWrite };          // what a reverse operation stops at
+
+typedef struct
+{
+    uint64_t ullFrame;          // frames since recording started
+    uint64_t ullTime;           // T-states since recording started
+    uint64_t ullRun;            // first port log run after it
+    std::vector<BYTE> vDelta;   // changes from the next checkpoint back to this one, or empty for the newest
+} CHECKPOINT;
+
+typedef struct
+{
+    BYTE bValue;                // value read
+    WORD wCount;                // consecutive reads returning it
+} PORTRUN;
+
+static MACHINE_LOCAL std::vector<CHECKPOINT> vCheckpoints;                // oldest first
+static MACHINE_LOCAL std::vector<BYTE> vReference, vCapture, vScratch;    // newest checkpoint, capture workspace, and state being replayed
+static MACHINE_LOCAL std::deque<PORTRUN> dqPortLog;                       // port reads since the oldest checkpoint
+static MACHINE_LOCAL uint64_t ullRunBase;                                 // run number of the first in the log
+static MACHINE_LOCAL bool fNewRun = true;                                 // next read starts a new run
+static MACHINE_LOCAL size_t uDeltaBytes;                                  // total size of held deltas
+static MACHINE_LOCAL uint64_t ullFrame;                                   // frames since recording started
+static MACHINE_LOCAL bool fRecording, fSuspended;
+
+static MACHINE_LOCAL bool fReplaying, fSeeking, fStopped;
+static MACHINE_LOCAL int nMode;
+static MACHINE_LOCAL const BYTE *pbWatch;                                 // location watched for writes
+static MACHINE_LOCAL uint64_t ullEnd;                                     // position a scan stops at
+static MACHINE_LOCAL uint64_t ullCount, ullTarget;                        // boundaries since the restore, and the one a seek stops at
+static MACHINE_LOCAL std::vector<uint64_t> vMatches;                      // ring of the most recent matches in a scan
+static MACHINE_LOCAL uint64_t ullMatches;                                 // matches in the current scan
+static MACHINE_LOCAL uint64_t ullCursorRun;                               // next port log run to replay
+static MACHINE_LOCAL WORD wCursorPos;                                     // reads already replayed from it
+static MACHINE_LOCAL uint64_t ullReplayFrames;                            // frames replayed by the current operation
+static MACHINE_LOCAL double dReplayFps = DEFAULT_REPLAY_FPS;
+
+
+static uint64_t GetTime ()
+{
+    return ullFrame*TSTATES_PER_FRAME + g_dwCycleCounter;
+}
+
+static size_t GetBytes ()
+{
+    return vReference.size() + uDeltaBytes + dqPortLog.size()*sizeof(PORTRUN);
+}
+
+// Widest checkpoint gap that can be replayed in the time allowed
+static uint64_t GetMaxGap ()
+{
+    uint64_t ullFrames = static_cast<uint64_t>(dReplayFps * REPLAY_TIME);
+    return std::max(ullFrames, static_cast<uint64_t>(CHECKPOINT_FRAMES*2)) * TSTATES_PER_FRAME;
+}
+
+// Remove every other checkpoint, oldest first, merging the deltas either side of each
+static void Thin (size_t uTarget_)
+{
+    uint64_t ullMaxGap = GetMaxGap();
+    std::vector<BYTE> vMask(vReference.size()), vZero(vReference.size());
+
+    for (size_t i = 1 ; i+1 < vCheckpoints.size() && GetBytes() > uTarget_ ; i++)
+    {
+        CHECKPOINT &prev = vCheckpoints[i-1], &curr = vCheckpoints[i];
+        if (vCheckpoints[i+1].ullTime - prev.ullTime > ullMaxGap)
+            continue;
+
+        // The combined XOR leads from the next checkpoint straight back to the previous one,
+        // and applying both deltas again returns the mask to zeros for the next merge
+        std::vector<BYTE> vDelta;
+        Rewind::ApplyDelta(vMask, curr.vDelta);
+        Rewind::ApplyDelta(vMask, prev.vDelta);
+        Rewind::EncodeDelta(vDelta, vZero, vMask);
+        Rewind::ApplyDelta(vMask, curr.vDelta);
+        Rewind::ApplyDelta(vMask, prev.vDelta);
+
+        uDeltaBytes -= prev.vDelta.size() + curr.vDelta.size();
+        uDeltaBytes += vDelta.size();
+
+        prev.vDelta.swap(vDelta);
+        vCheckpoints.erase(vCheckpoints.begin()+i);
+    }
+}
+
+static void DropOldest ()
+{
+    uDeltaBytes -= vCheckpoints.front().vDelta.size();
+    vCheckpoints.erase(vCheckpoints.begin());
+
+    // Port reads before the new oldest checkpoint will never be replayed
+    for ( ; ullRunBase < vCheckpoints.front().ullRun && !dqPortLog.empty() ; ullRunBase++)
+        dqPortLog.pop_front();
+}
+
+// Keep within the memory limit, thinning the older history then dropping the oldest
+static void Limit ()
+{
+    size_t uLimit = static_cast<size_t>(GetOption(reversemem)) << 20;
+    if (GetBytes() <= uLimit)
+        return;
+
+    // Free a quarter at a time, so thinning isn't repeated for every checkpoint
+    Thin(uLimit/4*3);
+
+    while (GetBytes() > uLimit && vCheckpoints.size() > 1)
+        DropOldest();
+}
+
+// Capture the state at the end of a frame as the newest checkpoint
+static void Checkpoint ()
+{
+    size_t uSize = State::GetSize();
+    vCapture.resize(uSize);
+    if (!uSize || !State::Save(vCapture.data(), uSize))
+    {
+        Reverse::Clear();
+        return;
+    }
+
+    // The previous newest checkpoint becomes the changes back to it
+    if (!vCheckpoints.empty())
+    {
+        std::vector<BYTE> &vDelta = vCheckpoints.back().vDelta;
+        Rewind::EncodeDelta(vDelta, vReference, vCapture);
+        vDelta.shrink_to_fit();
+        uDeltaBytes += vDelta.size();
+    }
+
+    vReference.swap(vCapture);
+    vCheckpoints.push_back({ ullFrame, GetTime(), ullRunBase + dqPortLog.size(), {} });
+    fNewRun = true;
+
+    Limit();
+}
+
+// Load the scratch state, which holds the given checkpoint, ready to replay from it
+static bool Restore (size_t uIndex_)
+{
+    const CHECKPOINT &cp = vCheckpoints[uIndex_];
+    if (!State::Load(vScratch.data(), vScratch.size()))
+        return false;
+
+    ullFrame = cp.ullFrame;
+    ullCursorRun = cp.ullRun;
+    wCursorPos = 0;
+    ullCount = 0;
+
+    // Accesses from before the checkpoint mustn't match
+    pbMemRead1 = pbMemRead2 = pbMemWrite1 = pbMemWrite2 = nullptr;
+    wPortRead = wPortWrite = 0;
+    return true;
+}
+
+// Run forwards until stopped at an instruction boundary, or the limit is reached
+static void Replay (uint64_t ullLimit_)
+{
+    for (fStopped = false ; !fStopped && GetTime() < ullLimit_ ; )
+    {
+        // Replayed frames aren't drawn
+        fDrawFrame = false;
+        CPU::ReplayFrame();
+    }
+}
+
+// Discard the history after the position we've arrived at, from the checkpoint replayed
+static void Truncate (size_t uIndex_)
+{
+    for (size_t i = uIndex_ ; i < vCheckpoints.size() ; i++)
+        uDeltaBytes -= vCheckpoints[i].vDelta.size();
+
+    vCheckpoints.erase(vCheckpoints.begin()+uIndex_+1, vCheckpoints.end());
+    std::vector<BYTE>().swap(vCheckpoints.back().vDelta);
+    vReference.swap(vScratch);
+
+    // Keep the port reads replayed so far, including those from the current run
+    size_t uRun = static_cast<size_t>(ullCursorRun - ullRunBase);
+    if (uRun < dqPortLog.size())
+    {
+        if (wCursorPos)
+            dqPortLog[uRun++].wCount = wCursorPos;
+
+        dqPortLog.erase(dqPortLog.begin()+uRun, dqPortLog.end());
+    }
+
+    fNewRun = true;
+}
+
+static bool IsMatch ()
+{
+    switch (nMode)
+    {
+        case rmBreak:
+            return Breakpoint::FindHit(false) != nullptr;
+
+        case rmWrite:
+        {
+            // Clear the tracked writes, so only those by the next instruction are checked next time
+            bool fHit = (pbMemWrite1 == pbWatch || pbMemWrite2 == pbWatch);
+            pbMemWrite1 = pbMemWrite2 = nullptr;
+            return fHit;
+        }
+    }
+
+    return true;
+}
+
+// Go back to the given number of matching instruction boundaries before the current position,
+// returning false with the machine unchanged if the history doesn't go back far enough
+static bool Find (int nMode_, uint64_t ullCount_, const BYTE *pbWatch_=nullptr)
+{
+    if (!fRecording || fReplaying || vCheckpoints.empty())
+        return false;
+
+    // Keep the current state, to return to if there's no match
+    size_t uSize = State::GetSize();
+    vCapture.resize(uSize);
+    if (uSize != vReference.size() || !State::Save(vCapture.data(), uSize))
+        return false;
+
+    uint64_t ullNow = GetTime(), ullNowFrame = ullFrame;
+    bool fDraw = fDrawFrame, fFound = false, fOK = true;
+    size_t uIndex = vCheckpoints.size();
+
+    nMode = nMode_;
+    pbWatch = pbWatch_;
+    vScratch = vReference;
+    ullReplayFrames = 0;
+    fReplaying = true;
+    Rewind::Suspend(true);
+
+    auto tStart = std::chrono::steady_clock::now();
+
+    for (ullEnd = ullNow ; !fFound && fOK && uIndex-- > 0 ; )
+    {
+        // Step the scratch state back to this checkpoint
+        if (uIndex+1 < vCheckpoints.size())
+            fOK = Rewind::ApplyDelta(vScratch, vCheckpoints[uIndex].vDelta);
+
+        // Skip a checkpoint at the current position
+        if (!fOK || vCheckpoints[uIndex].ullTime >= ullEnd)
+            continue;
+
+        // Scan forwards from it, keeping the most recent matches
+        vMatches.assign(static_cast<size_t>(ullCount_), 0);
+        ullMatches = 0;
+        fSeeking = false;
+
+        if (!(fOK = Restore(uIndex)))
+            break;
+
+        Replay(ullEnd);
+
+        if (ullMatches < ullCount_)
+        {
+            // Look for the rest before this checkpoint, including the boundary it's at
+            ullCount_ -= ullMatches;
+            ullEnd = vCheckpoints[uIndex].ullTime + 1;
+            continue;
+        }
+
+        // Replay from the same checkpoint again, stopping at the match
+        ullTarget = vMatches[(ullMatches - ullCount_) % vMatches.size()];
+        fSeeking = true;
+
+        if ((fOK = Restore(uIndex)))
+        {
+            Replay(ullNow);
+            fFound = fStopped;
+        }
+    }
+
+    fReplaying = fSeeking = false;
+    Rewind::Suspend(false);
+    fDrawFrame = fDraw;
+
+    // Update the replay speed that checkpoint spacing is limited by
+    std::chrono::duration<double> tReplay = std::chrono::steady_clock::now() - tStart;
+    if (ullReplayFrames >= CHECKPOINT_FRAMES && tReplay.count() > 0.0)
+        dReplayFps = (dReplayFps + ullReplayFrames / tReplay.count()) / 2;
+
+    if (fFound)
+        Truncate(uIndex);
+    else
+    {
+        State::Load(vCapture.data(), uSize);
+        ullFrame = ullNowFrame;
+
+        // A damaged history is no use
+        if (!fOK)
+            Reverse::Clear();
+    }
+
+    std::vector<BYTE>().swap(vScratch);
+    std::vector<uint64_t>().swap(vMatches);
+    return fFound;
+}
+
+
+namespace Reverse
+{
+
+void Exit (bool /*fReInit_=false*/)
+{
+    Clear();
+
+    std::vector<BYTE>().swap(vCapture);
+    std::vector<BYTE>().swap(vScratch);
+}
+
+// Discard the history, which restarts at the next frame end if the debugger is still armed
+void Clear ()
+{
+    std::vector<CHECKPOINT>().swap(vCheckpoints);
+    std::vector<BYTE>().swap(vReference);
+    std::deque<PORTRUN>().swap(dqPortLog);
+
+    ullRunBase = 0;
+    fNewRun = true;
+    uDeltaBytes = 0;
+    ullFrame = 0;
+    fRecording = false;
+}
+
+
+bool IsRecording ()
+{
+    return fRecording;
+}
+
+bool IsReplaying ()
+{
+    return fReplaying;
+}
+
+// Suspend recording for frames that will be discarded, such as those run ahead
+void Suspend (bool fSuspend_)
+{
+    fSuspended = fSuspend_;
+}
+
+
+// Count the frame, and take a checkpoint when one is due
+void FrameEnd ()
+{
+    if (fReplaying)
+    {
+        ullFrame++;
+        ullReplayFrames++;
+        return;
+    }
+
+    if (fSuspended)
+        return;
+
+    // Record while the debugger is open or has breakpoints set, but not while rewinding
+    bool fArmed = GetOption(reversemem) && (Debug::IsActive() || Debug::IsBreakpointSet()) && !Rewind::IsActive();
+    if (!fArmed)
+    {
+        if (fRecording)
+            Clear();
+
+        return;
+    }
+
+    ullFrame++;
+
+    // Start recording, or start again if a configuration change has resized the state
+    if (!fRecording || State::GetSize() != vReference.size())
+    {
+        Clear();
+        fRecording = true;
+        Checkpoint();
+    }
+    else if (ullFrame - vCheckpoints.back().ullFrame >= CHECKPOINT_FRAMES)
+        Checkpoint();
+}
+
+// Log a value read from a port while recording, or return the logged value while replaying
+BYTE PortIn (BYTE bValue_)
+{
+    if (fReplaying)
+    {
+        size_t uRun = static_cast<size_t>(ullCursorRun - ullRunBase);
+        if (uRun < dqPortLog.size())
+        {
+            const PORTRUN &run = dqPortLog[uRun];
+            bValue_ = run.bValue;
+
+            if (++wCursorPos == run.wCount)
+            {
+                ullCursorRun++;
+                wCursorPos = 0;
+            }
+        }
+    }
+    else if (fRecording && !fSuspended)
+    {
+        if (!fNewRun && dqPortLog.back().bValue == bValue_ && dqPortLog.back().wCount != 0xffff)
+            dqPortLog.back().wCount++;
+        else
+        {
+            dqPortLog.push_back({ bValue_, 1 });
+            fNewRun = false;
+        }
+    }
+
+    return bValue_;
+}
+
+// Note an instruction boundary while replaying, returning true to stop there
+bool CheckStop ()
+{
+    ullCount++;
+
+    if (fSeeking)
+        fStopped = (ullCount == ullTarget);
+    else if (GetTime() >= ullEnd)
+        fStopped = true;
+    else if (IsMatch())
+        vMatches[ullMatches++ % vMatches.size()] = ullCount;
+
+    return fStopped;
+}
+
+
+bool StepBack (int nCount_/*=1*/)
+{
+    return nCount_ > 0 && nCount_ <= MAX_STEP_BACK && Find(rmStep, static_cast<uint64_t>(nCount_));
+}
+
+// Go back to the previous breakpoint hit
+bool RunBack ()
+{
+    return Find(rmBreak, 1);
+}
+
+// Go back to just after the previous write to an address, in the current paging
+bool RunBackToWrite (WORD wAddr_)
+{
+    return Find(rmWrite, 1, AddrReadPtr(wAddr_));
+}
+
+
+void GetStats (REVERSE_STATS *pStats_)
+{
+    pStats_->nCheckpoints = static_cast<int>(vCheckpoints.size());
+    pStats_->dSeconds = vCheckpoints.empty() ? 0.0 :
+        static_cast<double>(GetTime() - vCheckpoints.front().ullTime) / TSTATES_PER_FRAME / EMULATED_FRAMES_PER_SECOND;
+    pStats_->nMinSpacing = pStats_->nMaxSpacing = 0;
+
+    for (size_t i = 1 ; i < vCheckpoints.size() ; i++)
+    {
+        int nSpacing = static_cast<int>(vCheckpoints[i].ullFrame - vCheckpoints[i-1].ullFrame);
+        pStats_->nMinSpacing = (i == 1) ? nSpacing : std::min(pStats_->nMinSpacing, nSpacing);
+        pStats_->nMaxSpacing = std::max(pStats_->nMaxSpacing, nSpacing);
+    }
+
+    pStats_->uTotalBytes = GetBytes() + vCapture.capacity() + vCheckpoints.capacity()*sizeof(CHECKPOINT);
+    pStats_->dReplayFps = dReplayFps;
+}
+
+} // namespace Reverse
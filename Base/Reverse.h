@@ -0,0 +1,56 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Reverse.h: Reverse execution for the debugger
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef REVERSE_H
+#define REVERSE_H
+
+typedef struct
+{
+    int nCheckpoints;       // checkpoints held
+    double dSeconds;        // emulated time covered by the history
+    int nMinSpacing;        // fewest frames between neighbouring checkpoints
+    int nMaxSpacing;        // most frames between neighbouring checkpoints
+    size_t uTotalBytes;     // memory used by the checkpoints and port log
+    double dReplayFps;      // measured re-execution speed, in frames per second
+}
+REVERSE_STATS;
+
+
+namespace Reverse
+{
+    void Exit (bool fReInit_=false);
+    void Clear ();
+
+    bool IsRecording ();
+    bool IsReplaying ();
+    void Suspend (bool fSuspend_);
+
+    void FrameEnd ();
+    BYTE PortIn (BYTE bValue_);
+    bool CheckStop ();
+
+    bool StepBack (int nCount_=1);
+    bool RunBack ();
+    bool RunBackToWrite (WORD wAddr_);
+
+    void GetStats (REVERSE_STATS *pStats_);
+}
+
+#endif  // REVERSE_H
@@ -0,0 +1,300 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Rewind.cpp: In-memory rewind history
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  The full machine state is captured at the end of each frame, and kept as
+//  the reference copy.  The previous reference is then stored as a reverse
+//  delta against it, so rewinding just applies the newest delta and loads
+//  the result, and the oldest frame can be dropped without any work.
+//
+//  Deltas are built from 16K blocks of the state, which is mostly memory
+//  pages.  Unchanged blocks are skipped after a quick compare, and changed
+//  blocks are stored as a run-length encoded XOR of the old and new data.
+//  Most frames only touch a few pages, so a typical delta is a few KB.
+//  The delta functions are also used by the debugger's reverse history.
+
+#include "SimCoupe.h"
+#include "Rewind.h"
+
+#include <chrono>
+
+#include "Frame.h"
+#include "Options.h"
+#include "State.h"
+
+const size_t MIN_MATCH_RUN = 4;     // shortest matching run worth ending a literal run for
+
+static MACHINE_LOCAL std::vector<BYTE> vReference, vCapture;  // newest state, and capture workspace
+static MACHINE_LOCAL std::vector<std::vector<BYTE>> avFrames; // ring of deltas, each undoing one frame
+static MACHINE_LOCAL int nHead, nFrames;                      // next ring slot to fill, and number of frames held
+static MACHINE_LOCAL size_t uDeltaBytes;                      // total size of held deltas
+static MACHINE_LOCAL double dCaptureMs;                       // smoothed capture time
+static MACHINE_LOCAL bool fActive;                            // rewinding while set
+static MACHINE_LOCAL bool fSuspended;                         // frames aren't recorded while set
+
+
+// Append a run of bytes to a delta
+static inline void Append (std::vector<BYTE> &v_, const void *pv_, size_t uLen_)
+{
+    const BYTE *pb = reinterpret_cast<const BYTE*>(pv_);
+    v_.insert(v_.end(), pb, pb+uLen_);
+}
+
+// Encode the XOR of two blocks as repeated: matching run, literal run, literal XOR bytes
+static void EncodeBlock (std::vector<BYTE> &v_, const BYTE *pbOld_, const BYTE *pbNew_, size_t uLen_)
+{
+    size_t uPos = 0;
+
+    while (uPos < uLen_)
+    {
+        WORD wMatch = 0, wLiteral = 0;
+
+        while (uPos+wMatch < uLen_ && pbOld_[uPos+wMatch] == pbNew_[uPos+wMatch])
+            wMatch++;
+
+        uPos += wMatch;
+
+        // Extend the literal run over short matches, which would cost more to encode as a match
+        size_t uRun = 0;
+        while (uPos+wLiteral+uRun < uLen_ && uRun < MIN_MATCH_RUN)
+        {
+            if (pbOld_[uPos+wLiteral+uRun] == pbNew_[uPos+wLiteral+uRun])
+                uRun++;
+            else
+            {
+                wLiteral += static_cast<WORD>(uRun+1);
+                uRun = 0;
+            }
+        }
+
+        Append(v_, &wMatch, sizeof(wMatch));
+        Append(v_, &wLiteral, sizeof(wLiteral));
+
+        for (size_t i = uPos ; i < uPos+wLiteral ; i++)
+            v_.push_back(pbOld_[i] ^ pbNew_[i]);
+
+        uPos += wLiteral;
+    }
+}
+
+
+namespace Rewind
+{
+
+// Append the changes between two states of the same size to a delta, which undoes them in either direction
+void EncodeDelta (std::vector<BYTE> &vDelta_, const std::vector<BYTE> &vOld_, const std::vector<BYTE> &vNew_)
+{
+    for (size_t uOffset = 0, uSize = vNew_.size() ; uOffset < uSize ; uOffset += REWIND_BLOCK_SIZE)
+    {
+        size_t uLen = std::min(REWIND_BLOCK_SIZE, uSize-uOffset);
+        const BYTE *pbOld = vOld_.data()+uOffset, *pbNew = vNew_.data()+uOffset;
+
+        // Skip unchanged blocks
+        if (!memcmp(pbOld, pbNew, uLen))
+            continue;
+
+        WORD wBlock = static_cast<WORD>(uOffset / REWIND_BLOCK_SIZE), wLen = static_cast<WORD>(uLen);
+        Append(vDelta_, &wBlock, sizeof(wBlock));
+        Append(vDelta_, &wLen, sizeof(wLen));
+        EncodeBlock(vDelta_, pbOld, pbNew, uLen);
+    }
+}
+
+// Apply a delta to a state, to recover the one it was encoded against
+bool ApplyDelta (std::vector<BYTE> &vState_, const std::vector<BYTE> &vDelta_)
+{
+    const BYTE *pb = vDelta_.data(), *pbEnd = pb + vDelta_.size();
+
+    while (pb < pbEnd)
+    {
+        WORD wBlock, wLen;
+        memcpy(&wBlock, pb, sizeof(wBlock)); pb += sizeof(wBlock);
+        memcpy(&wLen, pb, sizeof(wLen)); pb += sizeof(wLen);
+
+        size_t uOffset = wBlock * REWIND_BLOCK_SIZE;
+        if (uOffset+wLen > vState_.size())
+            return false;
+
+        BYTE *pbState = vState_.data() + uOffset;
+        for (size_t uPos = 0 ; uPos < wLen ; )
+        {
+            WORD wMatch, wLiteral;
+            memcpy(&wMatch, pb, sizeof(wMatch)); pb += sizeof(wMatch);
+            memcpy(&wLiteral, pb, sizeof(wLiteral)); pb += sizeof(wLiteral);
+
+            for (uPos += wMatch ; wLiteral-- ; uPos++)
+                pbState[uPos] ^= *pb++;
+        }
+    }
+
+    return pb == pbEnd;
+}
+
+
+void Exit (bool /*fReInit_=false*/)
+{
+    Clear();
+
+    // Release all memory used by the history
+    std::vector<BYTE>().swap(vReference);
+    std::vector<BYTE>().swap(vCapture);
+    std::vector<std::vector<BYTE>>().swap(avFrames);
+}
+
+// Discard the rewind history
+void Clear ()
+{
+    for (auto &vDelta : avFrames)
+        vDelta.clear();
+
+    vReference.clear();
+    nHead = nFrames = 0;
+    uDeltaBytes = 0;
+}
+
+
+// Capture the state at the end of a frame
+void FrameEnd ()
+{
+    size_t uMaxFrames = GetOption(rewind) * EMULATED_FRAMES_PER_SECOND;
+
+    // Frames played while rewinding or suspended aren't recorded
+    if (fActive || fSuspended)
+        return;
+
+    // Resize the history if the setting has changed
+    if (uMaxFrames != avFrames.size())
+    {
+        Exit();
+        avFrames.resize(uMaxFrames);
+    }
+
+    if (!uMaxFrames)
+        return;
+
+    auto tStart = std::chrono::steady_clock::now();
+
+    size_t uSize = State::GetSize();
+    vCapture.resize(uSize);
+    if (!uSize || !State::Save(vCapture.data(), uSize))
+        return;
+
+    // Start afresh from the first frame, or if the configuration changed the state size
+    if (vReference.size() != uSize)
+    {
+        Clear();
+        vReference.swap(vCapture);
+        return;
+    }
+
+    // Re-use the oldest slot when the history is full
+    auto &vDelta = avFrames[nHead];
+    uDeltaBytes -= vDelta.size();
+    vDelta.clear();
+    EncodeDelta(vDelta, vReference, vCapture);
+
+    uDeltaBytes += vDelta.size();
+    nHead = (nHead+1) % static_cast<int>(avFrames.size());
+    nFrames = std::min(nFrames+1, static_cast<int>(avFrames.size()));
+
+    // The new state becomes the reference for the next frame
+    vReference.swap(vCapture);
+
+    std::chrono::duration<double, std::milli> tCapture = std::chrono::steady_clock::now() - tStart;
+    dCaptureMs = dCaptureMs ? (dCaptureMs*0.95 + tCapture.count()*0.05) : tCapture.count();
+}
+
+// Restore the previous frame from the history, holding at the oldest frame available
+bool Step ()
+{
+    if (vReference.empty())
+        return false;
+
+    if (nFrames)
+    {
+        nHead = (nHead + static_cast<int>(avFrames.size()) - 1) % static_cast<int>(avFrames.size());
+        nFrames--;
+
+        auto &vDelta = avFrames[nHead];
+        bool fOK = ApplyDelta(vReference, vDelta);
+
+        uDeltaBytes -= vDelta.size();
+        vDelta.clear();
+
+        if (!fOK)
+        {
+            Clear();
+            return false;
+        }
+    }
+
+    if (!State::Load(vReference.data(), vReference.size()))
+    {
+        Clear();
+        return false;
+    }
+
+    return true;
+}
+
+
+bool IsActive ()
+{
+    return fActive;
+}
+
+void SetActive (bool fActive_)
+{
+    if (fActive_ == fActive)
+        return;
+
+    fActive = fActive_;
+
+    // Report the history cost when rewinding stops, to help tune the depth
+    if (!fActive && GetOption(rewind))
+    {
+        REWIND_STATS s;
+        GetStats(&s);
+        Frame::SetStatus("Rewind: %d/%d frames, %uK, %.2fms/frame",
+                         s.nFrames, s.nMaxFrames, static_cast<UINT>(s.uTotalBytes/1024), s.dCaptureMs);
+    }
+}
+
+// Suspend recording for frames that will be discarded, such as those run ahead
+void Suspend (bool fSuspend_)
+{
+    fSuspended = fSuspend_;
+}
+
+
+void GetStats (REWIND_STATS *pStats_)
+{
+    size_t uTotal = vReference.capacity() + vCapture.capacity() + avFrames.capacity()*sizeof(avFrames[0]);
+    for (auto &vDelta : avFrames)
+        uTotal += vDelta.capacity();
+
+    pStats_->nFrames = nFrames;
+    pStats_->nMaxFrames = static_cast<int>(avFrames.size());
+    pStats_->uDeltaBytes = uDeltaBytes;
+    pStats_->uTotalBytes = uTotal;
+    pStats_->dCaptureMs = dCaptureMs;
+}
+
+} // namespace Rewind
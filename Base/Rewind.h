@@ -0,0 +1,57 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Rewind.h: In-memory rewind history
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <vector>
+
+const size_t REWIND_BLOCK_SIZE = 0x4000;    // state is compared in 16K blocks, matching the memory page size
+
+typedef struct
+{
+    int nFrames;            // frames of history held
+    int nMaxFrames;         // frames of history allowed by the current setting
+    size_t uDeltaBytes;     // size of the stored frame deltas
+    size_t uTotalBytes;     // total memory used, including the reference state
+    double dCaptureMs;      // average time to capture a frame
+}
+REWIND_STATS;
+
+
+namespace Rewind
+{
+    void Exit (bool fReInit_=false);
+    void Clear ();
+
+    void FrameEnd ();
+    bool Step ();
+
+    bool IsActive ();
+    void SetActive (bool fActive_);
+    void Suspend (bool fSuspend_);
+
+    void GetStats (REWIND_STATS *pStats_);
+
+    void EncodeDelta (std::vector<BYTE> &vDelta_, const std::vector<BYTE> &vOld_, const std::vector<BYTE> &vNew_);
+    bool ApplyDelta (std::vector<BYTE> &vState_, const std::vector<BYTE> &vDelta_);
+}
+
+#endif  // REWIND_H
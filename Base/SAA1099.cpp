@@ -41,6 +41,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "SimCoupe.h"
 
 #include "SAA1099.h"
+#include "State.h"
 
 //////////////////////////////////////////////////////////////////////
 // CSAAAmp: tone and noise mixing, envelope application and amplification
@@ -179,6 +180,29 @@ void CSAAAmp::Mute(bool bMute)
 	m_bMute = bMute;
 }
 
+void CSAAAmp::Serialize(CState &state)
+{
+	state.Value(leftleveltimes16);
+	state.Value(leftleveltimes32);
+	state.Value(leftlevela0x0e);
+	state.Value(leftlevela0x0etimes2);
+	state.Value(rightleveltimes16);
+	state.Value(rightleveltimes32);
+	state.Value(rightlevela0x0e);
+	state.Value(rightlevela0x0etimes2);
+	state.Value(m_nOutputIntermediate);
+	state.Value(m_nMixMode);
+	state.Value(m_bMute);
+	state.Value(last_level_byte);
+	state.Value(level_unchanged);
+	state.Value(last_leftlevel);
+	state.Value(last_rightlevel);
+	state.Value(leftlevel_unchanged);
+	state.Value(rightlevel_unchanged);
+	state.Value(cached_last_leftoutput);
+	state.Value(cached_last_rightoutput);
+}
+
 
 void CSAAAmp::Tick()
 {
@@ -213,7 +237,7 @@ void CSAAAmp::Tick()
 
 CSAAAmp::stereolevel CSAAAmp::TickAndOutputStereo()
 {
-	static stereolevel retval;
+	static MACHINE_LOCAL stereolevel retval;
 	static const stereolevel zeroval = { {0,0} };
 
 	// first, do the Tick:
@@ -552,6 +576,26 @@ bool CSAAEnv::IsActive () const
 	return m_bEnabled;
 }
 
+void CSAAEnv::Serialize(CState &state)
+{
+	state.Value(m_nLeftLevel);
+	state.Value(m_nRightLevel);
+	state.Pointer(m_pEnvData, cs_EnvData);
+	state.Value(m_bEnabled);
+	state.Value(m_bInvertRightChannel);
+	state.Value(m_nPhase);
+	state.Value(m_nPhasePosition);
+	state.Value(m_bEnvelopeEnded);
+	state.Value(m_nPhaseAdd);
+	state.Value(m_bLooping);
+	state.Value(m_nNumberOfPhases);
+	state.Value(m_nResolution);
+	state.Value(m_bNewData);
+	state.Value(m_nNextData);
+	state.Value(m_bOkForNewData);
+	state.Value(m_bClockExternally);
+}
+
 
 //////////////////////////////////////////////////////////////////////
 // CSAAFreq: frequency generator
@@ -559,7 +603,7 @@ bool CSAAEnv::IsActive () const
 // Currently only 7-bit fractional accuracy on oscillator periods
 
 // frequency lookup table, built in constructor below
-unsigned long CSAAFreq::m_FreqTable[8][256];
+MACHINE_LOCAL unsigned long CSAAFreq::m_FreqTable[8][256];
 
 
 CSAAFreq::CSAAFreq(CSAANoise * const NoiseGenerator, CSAAEnv * const EnvGenerator)
@@ -753,6 +797,21 @@ void CSAAFreq::Sync(bool bSync)
 	}
 }
 
+void CSAAFreq::Serialize(CState &state)
+{
+	state.Value(m_nCounter);
+	state.Value(m_nAdd);
+	state.Value(m_nLevel);
+	state.Value(m_nCurrentOffset);
+	state.Value(m_nCurrentOctave);
+	state.Value(m_nNextOffset);
+	state.Value(m_nNextOctave);
+	state.Value(m_bIgnoreOffsetData);
+	state.Value(m_bNewData);
+	state.Value(m_bSync);
+	state.Value(m_nSampleRateTimes4K);
+}
+
 
 //////////////////////////////////////////////////////////////////////
 // CSAANoise: noise generator
@@ -853,6 +912,16 @@ void CSAANoise::Sync(bool bSync)
 	m_bSync = bSync;
 }
 
+void CSAANoise::Serialize(CState &state)
+{
+	state.Value(m_nCounter);
+	state.Value(m_nAdd);
+	state.Value(m_bSync);
+	state.Value(m_nSampleRateTimes4K);
+	state.Value(m_nSourceMode);
+	state.Value(m_nRand);
+}
+
 void CSAANoise::SetSampleRate(int nSampleRate)
 {
 	m_nCounter = 0;	// don't bother adjusting existing value
@@ -1138,6 +1207,19 @@ BYTE CSAASound::ReadAddress()
 	return m_nCurrentSaaReg;
 }
 
+void CSAASound::Serialize(CState &state)
+{
+	state.Section(STATE_TAG('S','A','A',' '));
+	state.Value(m_nCurrentSaaReg);
+	state.Value(m_bOutputEnabled);
+	state.Value(m_bSync);
+
+	for (auto pOsc : Osc) pOsc->Serialize(state);
+	for (auto pNoise : Noise) pNoise->Serialize(state);
+	for (auto pAmp : Amp) pAmp->Serialize(state);
+	for (auto pEnv : Env) pEnv->Serialize(state);
+}
+
 void CSAASound::GenerateMany(BYTE * pBuffer, int nSamples)
 {
 	CSAAAmp::stereolevel stereoval;
@@ -8,6 +8,8 @@
 #ifndef SAA1099_H
 #define SAA1099_H
 
+class CState;
+
 class CSAAEnv
 {
 	typedef struct
@@ -52,6 +54,7 @@ public:
 	unsigned short LeftLevel() const;
 	unsigned short RightLevel() const;
 	bool IsActive() const;
+	void Serialize(CState &state);
 
 };
 
@@ -83,6 +86,7 @@ public:
 	unsigned short Level() const;
 	unsigned short LevelTimesTwo() const;
 	void Sync(bool bSync);
+	void Serialize(CState &state);
 
 };
 
@@ -90,7 +94,7 @@ public:
 class CSAAFreq
 {
 protected:
-	static unsigned long m_FreqTable[8][256];
+	static MACHINE_LOCAL unsigned long m_FreqTable[8][256];
 
 	unsigned long m_nCounter = 0;
 	unsigned long m_nAdd = 0;
@@ -121,6 +125,7 @@ public:
 	void Sync(bool bSync);
 	unsigned short Tick();
 	unsigned short Level() const;
+	void Serialize(CState &state);
 
 };
 
@@ -166,6 +171,7 @@ public:
 	void Tick();
 	unsigned short TickAndOutputMono();
 	stereolevel TickAndOutputStereo();
+	void Serialize(CState &state);
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -195,6 +201,7 @@ public:
 	BYTE ReadAddress();
 
 	void GenerateMany(BYTE * pBuffer, int nSamples);
+	void Serialize(CState &state);
 };
 
 #endif // SAA1099_H
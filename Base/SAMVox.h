@@ -29,6 +29,6 @@ class CSAMVoxDevice : public CIoDevice
         void Out (WORD wPort_, BYTE bVal_) override;
 };
 
-extern CSAMVoxDevice *pSAMVox;
+extern MACHINE_LOCAL CSAMVoxDevice *pSAMVox;
 
 #endif  // SAMVOX_H
@@ -30,6 +30,7 @@
 #include "SDIDE.h"
 
 #include "Options.h"
+#include "State.h"
 
 
 BYTE CSDIDEDevice::In (WORD wPort_)
@@ -81,3 +82,12 @@ void CSDIDEDevice::Out (WORD wPort_, BYTE bVal_)
             break;
     }
 }
+
+void CSDIDEDevice::Serialize (CState &state_)
+{
+    CAtaAdapter::Serialize(state_);
+
+    state_.Value(m_bAddressLatch);
+    state_.Value(m_bDataLatch);
+    state_.Value(m_fDataLatched);
+}
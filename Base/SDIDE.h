@@ -28,6 +28,7 @@ class CSDIDEDevice : public CAtaAdapter
     public:
         BYTE In (WORD wPort_) override;
         void Out (WORD wPort_, BYTE bVal_) override;
+        void Serialize (CState &state_) override;
 
     protected:
         BYTE m_bAddressLatch = 0;
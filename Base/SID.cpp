@@ -23,6 +23,7 @@
 
 #include "CPU.h"
 #include "Options.h"
+#include "Perf.h"
 
 
 CSID::CSID ()
@@ -63,6 +64,7 @@ void CSID::Update (bool fFrameEnd_=false)
     if (!m_pSID || nNeeded <= 0)
         return;
 
+    CPerfScope perf(ptSound);
     short *ps = reinterpret_cast<short*>(m_pbFrameSample + m_nSamplesThisFrame*SAMPLE_BLOCK);
 
     if (g_fReset)
@@ -56,6 +56,6 @@ class CSID final : public CSoundDevice
         int m_nChipType = 0;
 };
 
-extern CSID *pSID;
+extern MACHINE_LOCAL CSID *pSID;
 
 #endif // SID_H
@@ -32,9 +32,9 @@
 #include "Font.h"
 
 
-static int nClipX, nClipY, nClipWidth, nClipHeight;    // Clip box for any screen drawing
+static MACHINE_LOCAL int nClipX, nClipY, nClipWidth, nClipHeight;    // Clip box for any screen drawing
 
-static const GUIFONT* pFont = &sGUIFont;
+static MACHINE_LOCAL const GUIFONT* pFont = &sGUIFont;
 
 
 CScreen::CScreen (int nWidth_, int nHeight_)
@@ -45,6 +45,13 @@
 typedef unsigned int        UINT;
 typedef unsigned long       ULONG;
 
+/* Machine state is held per thread in builds running several machines, each on its own thread */
+#ifdef USE_MACHINES
+#define MACHINE_LOCAL   thread_local
+#else
+#define MACHINE_LOCAL
+#endif
+
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
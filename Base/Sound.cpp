@@ -26,10 +26,13 @@
 #include "CPU.h"
 #include "Frame.h"
 #include "Options.h"
+#include "Perf.h"
+#include "Reverse.h"
 #include "SID.h"
+#include "State.h"
 #include "WAV.h"
 
-static BYTE *pbSampleBuffer;
+static MACHINE_LOCAL BYTE *pbSampleBuffer;
 
 static void MixAudio (BYTE *pDst_, const BYTE *pSrc_, int nLen_);
 static int AdjustSpeed (BYTE *pb_, int nSize_, int nSpeed_);
@@ -66,7 +69,8 @@ void Sound::Silence ()
 
 void Sound::FrameUpdate ()
 {
-    static bool fSidUsed = false;
+    CPerfScope perf(ptSound);
+    static MACHINE_LOCAL bool fSidUsed = false;
 
     // Track whether SID has been used, to avoid unnecessary sample generation+mixing
     fSidUsed |= pSID->GetSampleCount() != 0;
@@ -75,6 +79,10 @@ void Sound::FrameUpdate ()
     pSAA->FrameEnd();   // catch-up to the DAC position
     if (fSidUsed) pSID->FrameEnd();
 
+    // Frames replayed by the debugger are silent, but still end the device frames to keep their state in step
+    if (Reverse::IsReplaying())
+        return;
+
     // Use the DAC as the master clock for sample count
     int nSamples = pDAC->GetSampleCount();
     int nSize = nSamples*SAMPLE_BLOCK;
@@ -85,15 +93,19 @@ void Sound::FrameUpdate ()
     if (fSidUsed && GetOption(sid)) MixAudio(pbSampleBuffer, pSID->GetSampleBuffer(), nSize);
 
     // Add the frame to any recordings
-    WAV::AddFrame(pbSampleBuffer, nSize);
-    AVI::AddFrame(pbSampleBuffer, nSize);
+    {
+        CPerfScope perfRecord(ptRecord);
+        WAV::AddFrame(pbSampleBuffer, nSize);
+        AVI::AddFrame(pbSampleBuffer, nSize);
+    }
 
 #if SAMPLE_FREQ == 44100 && SAMPLE_BITS == 16 && SAMPLE_CHANNELS == 2
     // Scale the audio to fit the require running speed
     nSize = AdjustSpeed(pbSampleBuffer, nSize, GetOption(speed));
 #endif
 
-    // Queue the data for playback
+    // Queue the data for playback, which may wait if we're running ahead
+    CPerfScope perfSync(ptSync);
     Audio::AddData(pbSampleBuffer, nSize);
 }
 
@@ -107,6 +119,7 @@ void CSAA::Update (bool fFrameEnd_=false)
     if (nNeeded <= 0)
         return;
 
+    CPerfScope perf(ptSound);
     BYTE *pb = m_pbFrameSample + m_nSamplesThisFrame*SAMPLE_BLOCK;
 
     if (g_fReset)
@@ -123,6 +136,12 @@ void CSAA::FrameEnd ()
     m_nSamplesThisFrame = 0;
 }
 
+void CSAA::Serialize (CState &state_)
+{
+    CSoundDevice::Serialize(state_);
+    m_pSAASound->Serialize(state_);
+}
+
 void CSAA::Out (WORD wPort_, BYTE bVal_)
 {
     Update();
@@ -173,6 +192,38 @@ void CDAC::FrameEnd ()
     buf_right.read_samples(ps+1, m_nSamplesThisFrame, 1);
 }
 
+// Save or restore the un-read portion of a Blip_Buffer, which is zero beyond a frame's worth of samples
+static void SerializeBlipBuffer (CState &state_, Blip_Buffer &buf_)
+{
+    long lPending = std::min(buf_.buffer_size_, static_cast<long>(2*(SAMPLE_FREQ/EMULATED_FRAMES_PER_SECOND)+32));
+    long lReader = buf_.reader_state();
+
+    state_.Value(buf_.offset_);
+    state_.Value(lReader);
+    state_.Data(buf_.buffer_, lPending*sizeof(*buf_.buffer_));
+
+    if (state_.IsLoading())
+        buf_.reader_state(lReader);
+}
+
+void CDAC::Serialize (CState &state_)
+{
+    CSoundDevice::Serialize(state_);
+    SerializeBlipBuffer(state_, buf_left);
+    SerializeBlipBuffer(state_, buf_right);
+
+    int anAmps[] = { synth_left.last_amp(), synth_right.last_amp(), synth_left2.last_amp(), synth_right2.last_amp() };
+    state_.Value(anAmps);
+
+    if (state_.IsLoading())
+    {
+        synth_left.last_amp(anAmps[0]);
+        synth_right.last_amp(anAmps[1]);
+        synth_left2.last_amp(anAmps[2]);
+        synth_right2.last_amp(anAmps[3]);
+    }
+}
+
 void CDAC::OutputLeft (BYTE bVal_)
 {
     synth_left.update(g_dwCycleCounter, bVal_);
@@ -230,6 +281,16 @@ CSoundDevice::CSoundDevice ()
     memset(m_pbFrameSample, 0x00, nSize);
 }
 
+// Save or restore the samples generated so far in the current frame
+void CSoundDevice::Serialize (CState &state_)
+{
+    int nSamplesPerFrame = (SAMPLE_FREQ / EMULATED_FRAMES_PER_SECOND)+1;
+
+    state_.Section(STATE_TAG('S','N','D',' '));
+    state_.Value(m_nSamplesThisFrame);
+    state_.Data(m_pbFrameSample, nSamplesPerFrame*SAMPLE_BLOCK);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 // Basic audio mixing
@@ -53,6 +53,8 @@ class CSoundDevice : public CIoDevice
         int GetSampleCount () { return m_nSamplesThisFrame; }
         BYTE *GetSampleBuffer () { return m_pbFrameSample; }
 
+        void Serialize (CState &state_) override;
+
     protected:
         int m_nSamplesThisFrame = 0;
         BYTE *m_pbFrameSample = nullptr;
@@ -69,6 +71,7 @@ class CSAA final : public CSoundDevice
     public:
         void Update (bool fFrameEnd_);
         void FrameEnd () override;
+        void Serialize (CState &state_) override;
 
         void Out (WORD wPort_, BYTE bVal_) override;
 
@@ -87,6 +90,7 @@ class CDAC final : public CSoundDevice
 
         void Update (bool fFrameEnd_);
         void FrameEnd () override;
+        void Serialize (CState &state_) override;
 
         void OutputLeft (BYTE bVal_);
         void OutputRight (BYTE bVal_);
@@ -110,7 +114,7 @@ class CBeeperDevice final : public CIoDevice
 };
 
 
-extern CSAA *pSAA;
-extern CDAC *pDAC;
+extern MACHINE_LOCAL CSAA *pSAA;
+extern MACHINE_LOCAL CDAC *pDAC;
 
 #endif  // SOUND_H
@@ -0,0 +1,165 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// State.cpp: Machine save state serialisation
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  The state is a snapshot of the running machine, taken between frames.
+//  It covers the CPU, memory, ASIC and the state of the attached devices,
+//  but not the contents of inserted disk media, which stay with the drive.
+//
+//  The layout is fixed for a given memory and device configuration, so the
+//  size is checked before anything is changed by a load.
+//
+//  Checkpoints are a cheaper save and restore for short-lived snapshots, such
+//  as run-ahead.  They reuse a single buffer, and only memory pages that may
+//  have been written since the previous checkpoint or restore are copied.
+
+#include "SimCoupe.h"
+#include "State.h"
+
+#include "AtaAdapter.h"
+#include "CPU.h"
+#include "Frame.h"
+#include "IO.h"
+#include "Memory.h"
+#include "Tape.h"
+
+const DWORD STATE_MAGIC = STATE_TAG('S','I','M','S');
+
+typedef struct
+{
+    DWORD dwMagic;
+    DWORD dwVersion;
+    DWORD dwSize;       // total size, including this header
+}
+STATE_HEADER;
+
+static MACHINE_LOCAL const void *pvCheckpoint;    // buffer in step with memory for the unwritten pages
+
+
+// Serialise all components in a fixed order
+static void Serialize (CState &state_)
+{
+    Memory::Serialize(state_);
+    IO::Serialize(state_);
+    CPU::Serialize(state_);
+    Frame::Serialize(state_);
+}
+
+
+namespace State
+{
+
+// Size needed to save the current machine state, or 0 if the machine isn't running
+size_t GetSize ()
+{
+    if (!pMemory)
+        return 0;
+
+    CState state;
+    Serialize(state);
+    return sizeof(STATE_HEADER) + state.GetPos();
+}
+
+static bool SaveState (void *pv_, size_t uSize_, bool fCheckpoint_)
+{
+    size_t uStateSize = GetSize();
+    if (!uStateSize || uSize_ < uStateSize)
+        return false;
+
+    STATE_HEADER sHeader { STATE_MAGIC, STATE_VERSION, static_cast<DWORD>(uStateSize) };
+    memcpy(pv_, &sHeader, sizeof(sHeader));
+
+    CState state(reinterpret_cast<BYTE*>(pv_) + sizeof(sHeader), uStateSize - sizeof(sHeader), false, fCheckpoint_);
+    Serialize(state);
+    return state.IsOK();
+}
+
+static bool LoadState (const void *pv_, size_t uSize_, bool fCheckpoint_)
+{
+    size_t uStateSize = GetSize();
+    if (!uStateSize || uSize_ < uStateSize)
+        return false;
+
+    // Reject states from other versions or configurations before touching anything
+    STATE_HEADER sHeader;
+    memcpy(&sHeader, pv_, sizeof(sHeader));
+    if (sHeader.dwMagic != STATE_MAGIC || sHeader.dwVersion != STATE_VERSION || sHeader.dwSize != uStateSize)
+    {
+        TRACE("State::Load(): incompatible state (version %u, size %u)\n", sHeader.dwVersion, sHeader.dwSize);
+        return false;
+    }
+
+    CState state(const_cast<BYTE*>(reinterpret_cast<const BYTE*>(pv_)) + sizeof(sHeader), uStateSize - sizeof(sHeader), true, fCheckpoint_);
+    Serialize(state);
+    return state.IsOK();
+}
+
+
+bool Save (void *pv_, size_t uSize_)
+{
+    return SaveState(pv_, uSize_, false);
+}
+
+bool Load (const void *pv_, size_t uSize_)
+{
+    // A full load leaves memory marked as written, so the next checkpoint is complete
+    return LoadState(pv_, uSize_, false);
+}
+
+
+// Snapshot the state into a buffer re-used from the previous checkpoint
+bool Checkpoint (void *pv_, size_t uSize_)
+{
+    // A different buffer needs all pages
+    if (pv_ != pvCheckpoint)
+        Memory::MarkAllWritten();
+
+    pvCheckpoint = nullptr;
+    if (!SaveState(pv_, uSize_, true))
+        return false;
+
+    pvCheckpoint = pv_;
+    return true;
+}
+
+// Return to the last checkpoint, which must be in the supplied buffer
+bool Restore (const void *pv_, size_t uSize_)
+{
+    if (!pvCheckpoint || pv_ != pvCheckpoint)
+        return false;
+
+    if (!LoadState(pv_, uSize_, true))
+    {
+        pvCheckpoint = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+// Disk and tape contents aren't part of the state, so they can't be rolled back
+bool IsMediaBusy ()
+{
+    return pFloppy1->IsActive() || pFloppy2->IsActive() ||
+           pAtom->IsActive() || pAtomLite->IsActive() || pSDIDE->IsActive() ||
+           Tape::IsPlaying();
+}
+
+} // namespace State
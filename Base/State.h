@@ -0,0 +1,119 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// State.h: Machine save state serialisation
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef STATE_H
+#define STATE_H
+
+// Bump this whenever the layout of any serialised component changes
+const DWORD STATE_VERSION = 2;
+
+#define STATE_TAG(a,b,c,d)  ((DWORD)(a) | ((DWORD)(b) << 8) | ((DWORD)(c) << 16) | ((DWORD)(d) << 24))
+
+
+// Two-way archive used to save, load or measure the machine state.
+// Components implement a single Serialize() function, so the save and load
+// layouts can't get out of step.  Values are stored in native byte order.
+// Checkpoints use the same layout, but may skip data known to be unchanged.
+class CState
+{
+    public:
+        CState () = default;    // measure size only
+        CState (void *pv_, size_t uSize_, bool fLoading_, bool fCheckpoint_=false)
+            : m_pb(reinterpret_cast<BYTE*>(pv_)), m_uSize(uSize_), m_fLoading(fLoading_), m_fCheckpoint(fCheckpoint_) { }
+
+    public:
+        bool IsLoading () const { return m_fLoading; }
+        bool IsCheckpoint () const { return m_fCheckpoint; }
+        bool IsOK () const { return !m_fError; }
+        void SetError () { m_fError = true; }
+        size_t GetPos () const { return m_uPos; }
+
+        void Data (void *pv_, size_t uLen_)
+        {
+            if (m_pb)
+            {
+                if (m_fError || m_uPos + uLen_ > m_uSize)
+                {
+                    SetError();
+                    return;
+                }
+
+                if (m_fLoading)
+                    memcpy(pv_, m_pb + m_uPos, uLen_);
+                else
+                    memcpy(m_pb + m_uPos, pv_, uLen_);
+            }
+
+            m_uPos += uLen_;
+        }
+
+        template <typename T> void Value (T &t_) { Data(&t_, sizeof(t_)); }
+
+        // Step over data left untouched in the buffer
+        void Skip (size_t uLen_)
+        {
+            if (m_pb && m_uPos + uLen_ > m_uSize)
+                SetError();
+
+            m_uPos += uLen_;
+        }
+
+        // Section marker, to detect a mismatched layout when loading
+        void Section (DWORD dwTag_)
+        {
+            DWORD dw = dwTag_;
+            Value(dw);
+
+            if (dw != dwTag_)
+                SetError();
+        }
+
+        // Pointer stored as an offset into a known block
+        template <typename T> void Pointer (T* &p_, T *pBase_)
+        {
+            int nOffset = p_ ? static_cast<int>(p_ - pBase_) : -1;
+            Value(nOffset);
+
+            if (m_fLoading)
+                p_ = (nOffset < 0) ? nullptr : pBase_ + nOffset;
+        }
+
+    protected:
+        BYTE *m_pb = nullptr;
+        size_t m_uSize = 0;
+        size_t m_uPos = 0;
+        bool m_fLoading = false;
+        bool m_fCheckpoint = false;
+        bool m_fError = false;
+};
+
+
+namespace State
+{
+    size_t GetSize ();
+    bool Save (void *pv_, size_t uSize_);
+    bool Load (const void *pv_, size_t uSize_);
+
+    bool Checkpoint (void *pv_, size_t uSize_);
+    bool Restore (const void *pv_, size_t uSize_);
+    bool IsMediaBusy ();
+}
+
+#endif  // STATE_H
@@ -31,9 +31,9 @@ static const int MAX_SYMBOL_OFFSET = 3;
 typedef std::map <WORD, std::string> AddrToSym;
 typedef std::map <std::string, WORD> SymToAddr;
 
-static AddrToSym ram_symbols, rom_symbols;
-static AddrToSym port_symbols;
-static SymToAddr symbol_values;
+static MACHINE_LOCAL AddrToSym ram_symbols, rom_symbols;
+static MACHINE_LOCAL AddrToSym port_symbols;
+static MACHINE_LOCAL SymToAddr symbol_values;
 
 
 // Read a cPickler format file, as used by pyz80 for symbols
@@ -33,16 +33,16 @@ namespace Tape
 
 #ifdef USE_LIBSPECTRUM
 
-static bool g_fPlaying;
-static std::string strFilePath;
-static std::string strFileName;
+static MACHINE_LOCAL bool g_fPlaying;
+static MACHINE_LOCAL std::string strFilePath;
+static MACHINE_LOCAL std::string strFileName;
 
 const DWORD SPECTRUM_TSTATES_PER_SECOND = 3500000;
 
-static libspectrum_tape *pTape;
-static libspectrum_byte* pbTape;
-static bool fEar;
-static libspectrum_dword tremain = 0;
+static MACHINE_LOCAL libspectrum_tape *pTape;
+static MACHINE_LOCAL libspectrum_byte* pbTape;
+static MACHINE_LOCAL bool fEar;
+static MACHINE_LOCAL libspectrum_dword tremain = 0;
 
 // Return whether the supplied filename appears to be a tape image
 bool IsRecognised (const char *pcsz_)
@@ -306,7 +306,8 @@ bool LoadTrap ()
         if (!nWanted)
             break;
 
-        // Write new byte
+        // Write new byte, which may be to the display
+        check_video_write(wDest);
         write_byte(wDest, H);
         wDest++;
         nWanted--;
@@ -333,7 +334,7 @@ bool LoadTrap ()
 // Return a string describing a give tape block
 const char *GetBlockDetails (libspectrum_tape_block *block)
 {
-    static char sz[128];
+    static MACHINE_LOCAL char sz[128];
     sz[0] = '\0';
 
     char szExtra[64] = "";
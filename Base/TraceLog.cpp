@@ -0,0 +1,516 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// TraceLog.cpp: Streaming instruction trace log
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  A record is written at each instruction boundary, holding the state
+//  before the next instruction and the accesses made by the one before:
+//
+//    BYTE  flags (TR_*)
+//    BYTE  T-states since the previous record, or DWORD with TR_LONG_TIME
+//    WORD  PC
+//    BYTE  4 instruction bytes at PC, only with TR_INSTR
+//    mask  changed register bytes, 7 bits per byte with bit 7 set to continue
+//    BYTE  new value for each changed register byte, in mask bit order
+//    DWORD+BYTE  physical offset and value for each memory read then write
+//    WORD+BYTE   port and value for an input then output
+//
+//  Instruction bytes are only stored if they differ from the last ones seen
+//  at the same PC, which the reader tracks the same way.  The file starts
+//  with a signature and the full register set, and is compressed by zlib.
+//  Values are little-endian, but the register set is stored in host order.
+//
+//  Records are built in one of a pool of buffers, normally just two.  Full
+//  buffers are passed to a background thread for compression and writing,
+//  and a new buffer is allocated if none are free.  Once MAX_BUFFERS are in
+//  use, the emulation waits for the writer to free one instead, since each
+//  record depends on the previous ones and none can be dropped.
+
+#include "SimCoupe.h"
+#include "TraceLog.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "IO.h"
+#include "Memory.h"
+
+#ifdef USE_ZLIB
+typedef gzFile TRACEFILE;
+#define TRACE_WRITE_MODE    "wb1"   // fastest compression, to keep up with the emulation
+#define TraceOpen(p,m)      gzopen(p, m)
+#define TraceRead(f,p,n)    gzread(f, p, static_cast<unsigned>(n))
+#define TraceWrite(f,p,n)   gzwrite(f, p, static_cast<unsigned>(n))
+#define TraceClose(f)       gzclose(f)
+#else
+typedef FILE* TRACEFILE;
+#define TRACE_WRITE_MODE    "wb"
+#define TraceOpen(p,m)      fopen(p, m)
+#define TraceRead(f,p,n)    fread(p, 1, n, f)
+#define TraceWrite(f,p,n)   fwrite(p, 1, n, f)
+#define TraceClose(f)       fclose(f)
+#endif
+
+static const char TRACE_SIGNATURE[] = "SimCoupeTrace1";
+
+const size_t TRACE_BUFFER_SIZE = 0x100000;  // size of each record buffer
+const size_t MAX_RECORD_SIZE = 128;         // largest possible record, with some to spare
+const int MAX_BUFFERS = 8;                  // buffers allocated before waiting for the writer
+
+// Record flags
+enum { TR_READS=0x03, TR_WRITES=0x0c, TR_PORT_IN=0x10, TR_PORT_OUT=0x20, TR_INSTR=0x40, TR_LONG_TIME=0x80 };
+const int TR_WRITE_SHIFT = 2;
+
+// Register bytes in mask bit order, with those most likely to change first so the mask stays short
+#define REG_OFFSET(r)   static_cast<BYTE>(offsetof(Z80Regs, r))
+static const BYTE abRegOrder[] =
+{
+    REG_OFFSET(r), REG_OFFSET(af.b.l), REG_OFFSET(af.b.h), REG_OFFSET(hl.b.l), REG_OFFSET(hl.b.h),
+    REG_OFFSET(bc.b.l), REG_OFFSET(bc.b.h), REG_OFFSET(de.b.l), REG_OFFSET(de.b.h),
+    REG_OFFSET(sp.b.l), REG_OFFSET(sp.b.h), REG_OFFSET(ix.b.l), REG_OFFSET(ix.b.h), REG_OFFSET(iy.b.l), REG_OFFSET(iy.b.h),
+    REG_OFFSET(iff1), REG_OFFSET(iff2), REG_OFFSET(halted), REG_OFFSET(r7), REG_OFFSET(i), REG_OFFSET(im),
+    REG_OFFSET(af_.b.l), REG_OFFSET(af_.b.h), REG_OFFSET(bc_.b.l), REG_OFFSET(bc_.b.h),
+    REG_OFFSET(de_.b.l), REG_OFFSET(de_.b.h), REG_OFFSET(hl_.b.l), REG_OFFSET(hl_.b.h)
+};
+
+static MACHINE_LOCAL bool fActive;
+
+// Emulation thread state
+static MACHINE_LOCAL std::vector<BYTE> vBuffer;           // buffer being filled
+static MACHINE_LOCAL BYTE *pbPos, *pbEnd;                 // write position and usable end of buffer
+static MACHINE_LOCAL Z80Regs sLastRegs;                   // registers at the previous record
+static MACHINE_LOCAL DWORD dwLastTime;                    // cycle counter at the previous record
+static MACHINE_LOCAL DWORD adwInstrs[0x10000];            // last instruction bytes seen at each address
+static MACHINE_LOCAL int nLastPort;                       // port access type of the previous instruction
+static MACHINE_LOCAL TRACELOG_STATS sStats;
+
+// Shared with the writer thread, which is given the emulation thread's copy
+typedef struct
+{
+    TRACEFILE hFile = nullptr;
+    std::mutex mutex {};
+    std::condition_variable cvWork {};
+    std::condition_variable cvFree {};
+    std::deque<std::vector<BYTE>> qFull {};     // buffers waiting to be written
+    std::vector<std::vector<BYTE>> vFree {};    // written buffers available for re-use
+    bool fStopping = false;
+}
+TRACEWRITER;
+
+static MACHINE_LOCAL TRACEWRITER sWriter;
+static MACHINE_LOCAL std::thread writer;
+
+// Compress and write full buffers in the background
+static void WriterThread (TRACEWRITER *pWriter_)
+{
+    std::unique_lock<std::mutex> lock(pWriter_->mutex);
+
+    while (1)
+    {
+        pWriter_->cvWork.wait(lock, [pWriter_] { return !pWriter_->qFull.empty() || pWriter_->fStopping; });
+
+        // Stop once everything has been written
+        if (pWriter_->qFull.empty())
+            break;
+
+        std::vector<BYTE> v(std::move(pWriter_->qFull.front()));
+        pWriter_->qFull.pop_front();
+
+        // Compression is done without the lock, so the emulation thread isn't held up
+        lock.unlock();
+        TraceWrite(pWriter_->hFile, v.data(), v.size());
+        lock.lock();
+
+        pWriter_->vFree.push_back(std::move(v));
+        pWriter_->cvFree.notify_one();
+    }
+}
+
+// Pass the current buffer to the writer, and optionally start a new one
+static void Flush (bool fNewBuffer_=true)
+{
+    std::unique_lock<std::mutex> lock(sWriter.mutex);
+
+    vBuffer.resize(pbPos - vBuffer.data());
+    sStats.ullBytes += vBuffer.size();
+    sWriter.qFull.push_back(std::move(vBuffer));
+    sWriter.cvWork.notify_one();
+
+    if (!fNewBuffer_)
+        return;
+
+    // If the writer has all the buffers we allow, wait for it to finish one
+    if (sWriter.vFree.empty() && sStats.nBuffers >= MAX_BUFFERS)
+    {
+        auto tStart = std::chrono::steady_clock::now();
+        sWriter.cvFree.wait(lock, [] { return !sWriter.vFree.empty(); });
+
+        std::chrono::duration<double, std::milli> tWait = std::chrono::steady_clock::now() - tStart;
+        sStats.dWaitTime += tWait.count();
+        sStats.nWaits++;
+    }
+
+    // Re-use a written buffer if there is one, otherwise allocate another
+    if (!sWriter.vFree.empty())
+    {
+        vBuffer = std::move(sWriter.vFree.back());
+        sWriter.vFree.pop_back();
+    }
+    else
+        sStats.nBuffers++;
+
+    vBuffer.resize(TRACE_BUFFER_SIZE);
+    pbPos = vBuffer.data();
+    pbEnd = pbPos + vBuffer.size() - MAX_RECORD_SIZE;
+}
+
+// Return whether an instruction can read (1) or write (2) a port, from its opcode bytes
+static int GetPortAccess (DWORD dwInstr_)
+{
+    BYTE bOp = dwInstr_ & 0xff, bOp2 = (dwInstr_ >> 8) & 0xff;
+
+    if (bOp == 0xdb)
+        return 1;
+    else if (bOp == 0xd3)
+        return 2;
+    else if (bOp != 0xed)
+        return 0;
+
+    // in r,(c) and out (c),r
+    if ((bOp2 & 0xc6) == 0x40)
+        return (bOp2 & 1) ? 2 : 1;
+
+    // Block input and output
+    if ((bOp2 & 0xe6) == 0xa2)
+        return (bOp2 & 1) ? 2 : 1;
+
+    return 0;
+}
+
+static inline void WriteDword (BYTE *&pb_, DWORD dw_)
+{
+    *pb_++ = dw_ & 0xff;
+    *pb_++ = (dw_ >> 8) & 0xff;
+    *pb_++ = (dw_ >> 16) & 0xff;
+    *pb_++ = dw_ >> 24;
+}
+
+static inline void WriteAccess (BYTE *&pb_, BYTE *&pbAccess_)
+{
+    WriteDword(pb_, static_cast<DWORD>(pbAccess_ - pMemory));
+    *pb_++ = *pbAccess_;
+    pbAccess_ = nullptr;
+}
+
+
+namespace TraceLog
+{
+
+void Exit (bool fReInit_/*=false*/)
+{
+    if (!fReInit_)
+        Stop();
+}
+
+
+// Start recording to a new trace file
+bool Start (const char *pcszPath_)
+{
+    Stop();
+
+    if (!(sWriter.hFile = TraceOpen(pcszPath_, TRACE_WRITE_MODE)))
+        return false;
+
+    // The header is written directly, as the writer isn't running yet
+    BYTE bRegsSize = sizeof(regs);
+    TraceWrite(sWriter.hFile, TRACE_SIGNATURE, sizeof(TRACE_SIGNATURE));
+    TraceWrite(sWriter.hFile, &bRegsSize, sizeof(bRegsSize));
+    TraceWrite(sWriter.hFile, &regs, sizeof(regs));
+
+    sLastRegs = regs;
+    dwLastTime = g_dwCycleCounter;
+    memset(adwInstrs, 0, sizeof(adwInstrs));
+    nLastPort = 0;
+    pbMemRead1 = pbMemRead2 = pbMemWrite1 = pbMemWrite2 = nullptr;
+
+    sStats = {};
+    sStats.nBuffers = 2;
+    sWriter.vFree.resize(1);
+    vBuffer.resize(TRACE_BUFFER_SIZE);
+    pbPos = vBuffer.data();
+    pbEnd = pbPos + vBuffer.size() - MAX_RECORD_SIZE;
+
+    sWriter.fStopping = false;
+    writer = std::thread(WriterThread, &sWriter);
+
+    // Return to the main loop to select a CPU core that records the trace
+    g_fBreak = true;
+    return fActive = true;
+}
+
+// Stop recording, waiting for the remaining records to be written
+void Stop ()
+{
+    if (!fActive)
+        return;
+
+    fActive = false;
+    Flush(false);
+
+    {
+        std::lock_guard<std::mutex> lock(sWriter.mutex);
+        sWriter.fStopping = true;
+        sWriter.cvWork.notify_one();
+    }
+
+    writer.join();
+    TraceClose(sWriter.hFile);
+    sWriter.hFile = nullptr;
+
+    // Release the buffer memory
+    std::vector<BYTE>().swap(vBuffer);
+    std::vector<std::vector<BYTE>>().swap(sWriter.vFree);
+}
+
+bool IsActive ()
+{
+    return fActive;
+}
+
+
+// Record the state at an instruction boundary, and the accesses made by the previous instruction
+void Record ()
+{
+    if (pbPos > pbEnd)
+        Flush();
+
+    BYTE *pb = pbPos, *pbFlags = pb++, bFlags = 0;
+
+    DWORD dwTime = g_dwCycleCounter - dwLastTime;
+    dwLastTime = g_dwCycleCounter;
+
+    if (dwTime < 0x100)
+        *pb++ = static_cast<BYTE>(dwTime);
+    else
+    {
+        bFlags |= TR_LONG_TIME;
+        WriteDword(pb, dwTime);
+    }
+
+    *pb++ = PCL;
+    *pb++ = PCH;
+
+    // Instruction bytes are only needed if they've changed since the last time at this address
+    DWORD dwInstr = read_byte(PC) | (read_byte(PC+1) << 8) | (read_byte(PC+2) << 16) | (read_byte(PC+3) << 24);
+    if (dwInstr != adwInstrs[PC])
+    {
+        adwInstrs[PC] = dwInstr;
+        bFlags |= TR_INSTR;
+        WriteDword(pb, dwInstr);
+    }
+
+    // Build the changed register mask, and the list of new values
+    const BYTE *pbRegs = reinterpret_cast<const BYTE*>(&regs);
+    BYTE *pbLastRegs = reinterpret_cast<BYTE*>(&sLastRegs);
+    BYTE abChanged[sizeof(abRegOrder)];
+    DWORD dwMask = 0;
+    int nChanged = 0;
+
+    for (size_t i = 0 ; i < sizeof(abRegOrder) ; i++)
+    {
+        BYTE bOffset = abRegOrder[i];
+        if (pbRegs[bOffset] != pbLastRegs[bOffset])
+        {
+            dwMask |= 1U << i;
+            abChanged[nChanged++] = pbLastRegs[bOffset] = pbRegs[bOffset];
+        }
+    }
+
+    do
+    {
+        *pb++ = (dwMask & 0x7f) | ((dwMask > 0x7f) ? 0x80 : 0);
+        dwMask >>= 7;
+    }
+    while (dwMask);
+
+    memcpy(pb, abChanged, nChanged);
+    pb += nChanged;
+
+    // Memory accesses by the previous instruction
+    if (pbMemRead1) { WriteAccess(pb, pbMemRead1); bFlags += 1; }
+    if (pbMemRead2) { WriteAccess(pb, pbMemRead2); bFlags += 1; }
+    if (pbMemWrite1) { WriteAccess(pb, pbMemWrite1); bFlags += 1 << TR_WRITE_SHIFT; }
+    if (pbMemWrite2) { WriteAccess(pb, pbMemWrite2); bFlags += 1 << TR_WRITE_SHIFT; }
+
+    // Port accesses by the previous instruction
+    if (nLastPort)
+    {
+        if (nLastPort == 1)
+        {
+            bFlags |= TR_PORT_IN;
+            *pb++ = wPortRead & 0xff;
+            *pb++ = wPortRead >> 8;
+            *pb++ = bPortInVal;
+        }
+        else
+        {
+            bFlags |= TR_PORT_OUT;
+            *pb++ = wPortWrite & 0xff;
+            *pb++ = wPortWrite >> 8;
+            *pb++ = bPortOutVal;
+        }
+    }
+
+    nLastPort = GetPortAccess(dwInstr);
+
+    *pbFlags = bFlags;
+    pbPos = pb;
+    sStats.ullRecords++;
+}
+
+// Keep the record timings continuous across the frame counter adjustment
+void FrameEnd ()
+{
+    dwLastTime -= TSTATES_PER_FRAME;
+}
+
+
+// Read a trace file, keeping up to the supplied number of the most recent entries
+bool Load (const char *pcszPath_, std::vector<TRACEDATA> &vTrace_, size_t uMaxEntries_)
+{
+    vTrace_.clear();
+
+    TRACEFILE hTrace = TraceOpen(pcszPath_, "rb");
+    if (!hTrace)
+        return false;
+
+    char szSignature[sizeof(TRACE_SIGNATURE)];
+    BYTE bRegsSize = 0;
+    Z80Regs sRegs;
+
+    if (TraceRead(hTrace, szSignature, sizeof(szSignature)) != sizeof(szSignature) ||
+        memcmp(szSignature, TRACE_SIGNATURE, sizeof(szSignature)) ||
+        TraceRead(hTrace, &bRegsSize, sizeof(bRegsSize)) != sizeof(bRegsSize) || bRegsSize != sizeof(sRegs) ||
+        TraceRead(hTrace, &sRegs, sizeof(sRegs)) != sizeof(sRegs))
+    {
+        TraceClose(hTrace);
+        return false;
+    }
+
+    std::vector<BYTE> vInstrs(0x10000*MAX_Z80_INSTR_LEN);
+    std::vector<BYTE> vData(TRACE_BUFFER_SIZE);
+    size_t uPos = 0, uLen = 0, uNext = 0;
+    bool fOK = true;
+
+    while (1)
+    {
+        // Keep at least a full record in the buffer, until the end of the file
+        if (uLen - uPos < MAX_RECORD_SIZE)
+        {
+            memmove(vData.data(), vData.data()+uPos, uLen-uPos);
+            uLen -= uPos;
+            uPos = 0;
+
+            int nRead = static_cast<int>(TraceRead(hTrace, vData.data()+uLen, vData.size()-uLen));
+            if (nRead > 0)
+                uLen += nRead;
+
+            if (uPos == uLen)
+                break;
+        }
+
+        const BYTE *pb = vData.data() + uPos, *pbStart = pb;
+        BYTE bFlags = *pb++;
+
+        if (bFlags & TR_LONG_TIME)
+            pb += sizeof(DWORD);
+        else
+            pb++;
+
+        WORD wPC = pb[0] | (pb[1] << 8);
+        pb += 2;
+
+        if (bFlags & TR_INSTR)
+        {
+            memcpy(&vInstrs[wPC*MAX_Z80_INSTR_LEN], pb, MAX_Z80_INSTR_LEN);
+            pb += MAX_Z80_INSTR_LEN;
+        }
+
+        DWORD dwMask = 0;
+        for (int nShift = 0 ; ; nShift += 7)
+        {
+            BYTE b = *pb++;
+            dwMask |= (b & 0x7f) << nShift;
+            if (!(b & 0x80))
+                break;
+        }
+
+        BYTE *pbRegs = reinterpret_cast<BYTE*>(&sRegs);
+        for (size_t i = 0 ; i < sizeof(abRegOrder) ; i++)
+        {
+            if (dwMask & (1U << i))
+                pbRegs[abRegOrder[i]] = *pb++;
+        }
+
+        // Skip the access details, which the trace view doesn't use
+        pb += (bFlags & TR_READS) * 5 + ((bFlags & TR_WRITES) >> TR_WRITE_SHIFT) * 5;
+        pb += ((bFlags & TR_PORT_IN) ? 3 : 0) + ((bFlags & TR_PORT_OUT) ? 3 : 0);
+
+        // Stop at a truncated record
+        if (static_cast<size_t>(pb - vData.data()) > uLen)
+        {
+            fOK = vTrace_.size() > 0;
+            break;
+        }
+
+        uPos += pb - pbStart;
+        sRegs.pc.w = wPC;
+
+        TRACEDATA sTrace;
+        sTrace.wPC = wPC;
+        memcpy(sTrace.abInstr, &vInstrs[wPC*MAX_Z80_INSTR_LEN], sizeof(sTrace.abInstr));
+        sTrace.regs = sRegs;
+
+        // Once full, the oldest entry is replaced
+        if (vTrace_.size() < uMaxEntries_)
+            vTrace_.push_back(sTrace);
+        else
+        {
+            vTrace_[uNext] = sTrace;
+            uNext = (uNext+1) % uMaxEntries_;
+        }
+    }
+
+    TraceClose(hTrace);
+
+    // Put the entries back in order
+    std::rotate(vTrace_.begin(), vTrace_.begin()+uNext, vTrace_.end());
+    return fOK;
+}
+
+
+void GetStats (TRACELOG_STATS *pStats_)
+{
+    *pStats_ = sStats;
+}
+
+} // namespace TraceLog
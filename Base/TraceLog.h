@@ -0,0 +1,61 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// TraceLog.h: Streaming instruction trace log
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef TRACELOG_H
+#define TRACELOG_H
+
+#include <vector>
+
+#include "CPU.h"
+#include "Disassem.h"
+
+typedef struct
+{
+    WORD wPC;                         // PC value
+    BYTE abInstr[MAX_Z80_INSTR_LEN];  // Instruction at PC
+    Z80Regs regs;                     // Register values
+} TRACEDATA;
+
+typedef struct
+{
+    uint64_t ullRecords;    // instructions recorded
+    uint64_t ullBytes;      // uncompressed size of the records
+    int nBuffers;           // buffers allocated, more than 2 if the writer fell behind
+    int nWaits;             // times the emulation waited for the writer, with all buffers in use
+    double dWaitTime;       // total time spent waiting, in milliseconds
+} TRACELOG_STATS;
+
+
+namespace TraceLog
+{
+    void Exit (bool fReInit_=false);
+
+    bool Start (const char *pcszPath_);
+    void Stop ();
+    bool IsActive ();
+
+    void Record ();
+    void FrameEnd ();
+
+    bool Load (const char *pcszPath_, std::vector<TRACEDATA> &vTrace_, size_t uMaxEntries_);
+    void GetStats (TRACELOG_STATS *pStats_);
+}
+
+#endif  // TRACELOG_H
@@ -0,0 +1,338 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Tracepoint.cpp: Breakpoints that log a formatted line and continue
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  Any breakpoint can be given a trace format, which turns it into a tracepoint.
+//  It's found through the same index and list checks as a normal breakpoint, but
+//  when hit it appends a line to the log rather than stopping in the debugger.
+//
+//  The format is literal text with values in braces, each either an expression
+//  or one of: tstates (T-states into the frame), line or cycle (raster position).
+//  An optional :spec picks the printf style, such as {hl:d} or {a:08b}, with
+//  expression values shown in hex by default.  Use {{ and }} for braces.
+//
+//  Lines go to a fixed ring of the most recent hits, and to a buffered file if
+//  one is set.  Formatting is done in place in the ring without allocating, to
+//  keep up with thousands of hits per frame.
+
+#include "SimCoupe.h"
+#include "Tracepoint.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "CPU.h"
+#include "Expr.h"
+#include "Frame.h"
+
+const size_t MAX_TRACE_LINES = 4096;        // lines kept in the ring
+const size_t TRACE_LINE_LEN = 128;          // longest line, including terminator
+const size_t TRACE_FILE_BUFFER = 256*1024;  // write buffer for the log file
+
+enum { tiText, tiExpr, tiTStates, tiLine, tiCycle };
+
+typedef struct
+{
+    int nType;              // literal text, or the value source
+    std::string sText;      // literal text, or printf format for the value (empty for automatic)
+    EXPR *pExpr;            // expression for tiExpr items
+    bool fBinary;           // value formatted as binary digits
+    int nWidth;             // minimum binary digits
+} TRACEITEM;
+
+typedef struct tagTRACEPOINT
+{
+    std::string sFormat;            // original format string
+    std::vector<TRACEITEM> vItems;  // literal text and values making up a line
+    uint64_t ullHits;               // lines logged by this tracepoint
+} TRACEPOINT;
+
+static MACHINE_LOCAL char aszLines[MAX_TRACE_LINES][TRACE_LINE_LEN];  // ring of recent lines
+static MACHINE_LOCAL uint64_t ullTotal;                               // lines logged since the ring was cleared
+static MACHINE_LOCAL FILE *hFile;                                     // optional log file
+
+
+// Check a value format spec, returning the printf format, or an empty string if it's invalid
+static std::string CheckSpec (const std::string &sSpec_, bool *pfBinary_, int *pnWidth_)
+{
+    size_t uDigits = sSpec_.find_first_not_of("0123456789");
+    if (uDigits == std::string::npos || uDigits+1 != sSpec_.length() || uDigits > 2)
+        return "";
+
+    char chType = sSpec_[uDigits];
+    *pfBinary_ = (chType == 'b');
+    *pnWidth_ = atoi(sSpec_.c_str());
+
+    return strchr("xXduocb", chType) ? "%" + sSpec_ : "";
+}
+
+// Compile a value from between braces, as a source and optional format spec
+static bool CompileValue (std::string sValue_, TRACEITEM &item_)
+{
+    size_t uColon = sValue_.rfind(':');
+    if (uColon != std::string::npos)
+    {
+        item_.sText = CheckSpec(sValue_.substr(uColon+1), &item_.fBinary, &item_.nWidth);
+        if (item_.sText.empty())
+            return false;
+
+        sValue_.erase(uColon);
+    }
+
+    if (!strcasecmp(sValue_.c_str(), "tstates"))
+        item_.nType = tiTStates;
+    else if (!strcasecmp(sValue_.c_str(), "line"))
+        item_.nType = tiLine;
+    else if (!strcasecmp(sValue_.c_str(), "cycle"))
+        item_.nType = tiCycle;
+    else if (!(item_.pExpr = Expr::Compile(sValue_.c_str())))
+        return false;
+
+    // Values other than expressions are shown in decimal by default
+    if (item_.nType != tiExpr && item_.sText.empty())
+        item_.sText = "%d";
+
+    return true;
+}
+
+// Format a value in binary, with at least the given number of digits
+static int FormatBinary (char *psz_, size_t uLen_, int nValue_, int nWidth_)
+{
+    char sz[33];
+    int nDigits = 0;
+
+    for (UINT u = static_cast<UINT>(nValue_) ; u || nDigits < nWidth_ || !nDigits ; u >>= 1)
+        sz[32 - ++nDigits] = '0' + (u & 1);
+
+    return snprintf(psz_, uLen_, "%.*s", nDigits, sz+32-nDigits);
+}
+
+
+namespace Tracepoint
+{
+
+void Exit (bool fReInit_/*=false*/)
+{
+    if (!fReInit_)
+        SetFile(nullptr);
+}
+
+
+// Compile a format string, returning null if any value in it is invalid
+TRACEPOINT *Compile (const char *pcszFormat_)
+{
+    TRACEPOINT *pTrace = new TRACEPOINT { pcszFormat_, {}, 0 };
+    std::string sText;
+    bool fOK = true;
+
+    for (const char *p = pcszFormat_ ; fOK && *p ; p++)
+    {
+        // Doubled braces are literal
+        if ((*p == '{' || *p == '}') && p[1] == *p)
+            sText += *p++;
+        else if (*p != '{')
+            sText += *p;
+        else
+        {
+            const char *pEnd = strchr(++p, '}');
+            TRACEITEM item { tiExpr, "", nullptr, false, 0 };
+
+            // The value must be terminated and valid
+            if (!pEnd || !CompileValue(std::string(p, pEnd), item))
+            {
+                Expr::Release(item.pExpr);
+                fOK = false;
+                break;
+            }
+
+            // Add any preceding text, then the value
+            if (!sText.empty())
+            {
+                pTrace->vItems.push_back({ tiText, sText, nullptr, false, 0 });
+                sText.clear();
+            }
+
+            pTrace->vItems.push_back(item);
+            p = pEnd;
+        }
+    }
+
+    if (!sText.empty())
+        pTrace->vItems.push_back({ tiText, sText, nullptr, false, 0 });
+
+    if (!fOK)
+    {
+        Release(pTrace);
+        pTrace = nullptr;
+    }
+
+    return pTrace;
+}
+
+void Release (TRACEPOINT *pTrace_)
+{
+    if (!pTrace_)
+        return;
+
+    for (auto &item : pTrace_->vItems)
+        Expr::Release(item.pExpr);
+
+    delete pTrace_;
+}
+
+const char *GetFormat (const TRACEPOINT *pTrace_)
+{
+    return pTrace_->sFormat.c_str();
+}
+
+uint64_t GetHits (const TRACEPOINT *pTrace_)
+{
+    return pTrace_->ullHits;
+}
+
+
+// Append a line for a tracepoint hit to the ring, and any log file
+void Hit (TRACEPOINT *pTrace_)
+{
+    char *pszLine = aszLines[ullTotal++ % MAX_TRACE_LINES];
+    size_t uLen = 0;
+
+    pTrace_->ullHits++;
+
+    for (auto &item : pTrace_->vItems)
+    {
+        size_t uLeft = TRACE_LINE_LEN - uLen;
+        int nValue = 0, nLen = 0;
+
+        switch (item.nType)
+        {
+            case tiText:
+                nLen = snprintf(pszLine+uLen, uLeft, "%s", item.sText.c_str());
+                break;
+
+            case tiExpr:
+                nValue = Expr::Eval(item.pExpr);
+                break;
+
+            case tiTStates:
+                nValue = static_cast<int>(g_dwCycleCounter);
+                break;
+
+            case tiLine:
+                Frame::GetRasterPos(&nValue);
+                break;
+
+            case tiCycle:
+            {
+                int nLine;
+                nValue = Frame::GetRasterPos(&nLine);
+                break;
+            }
+        }
+
+        if (item.nType == tiText)
+            ;
+        else if (item.fBinary)
+            nLen = FormatBinary(pszLine+uLen, uLeft, nValue, item.nWidth);
+        else if (!item.sText.empty())
+            nLen = snprintf(pszLine+uLen, uLeft, item.sText.c_str(), nValue);
+        else
+            nLen = snprintf(pszLine+uLen, uLeft, (nValue & ~0xff) ? "%04X" : "%02X", nValue);
+
+        // Truncate the line if it's full
+        uLen += std::min(static_cast<size_t>(std::max(nLen, 0)), uLeft-1);
+    }
+
+    pszLine[uLen] = '\0';
+
+    if (hFile)
+    {
+        pszLine[uLen] = '\n';
+        fwrite(pszLine, uLen+1, 1, hFile);
+        pszLine[uLen] = '\0';
+    }
+}
+
+
+// Also write the lines to a file, or stop writing them if no path is given
+bool SetFile (const char *pcszPath_)
+{
+    if (hFile)
+    {
+        fclose(hFile);
+        hFile = nullptr;
+    }
+
+    if (!pcszPath_)
+        return true;
+
+    if (!(hFile = fopen(pcszPath_, "w")))
+        return false;
+
+    setvbuf(hFile, nullptr, _IOFBF, TRACE_FILE_BUFFER);
+    return true;
+}
+
+// Write out any buffered lines, so the file is complete while it's still open
+void Flush ()
+{
+    if (hFile)
+        fflush(hFile);
+}
+
+void Clear ()
+{
+    ullTotal = 0;
+}
+
+// Save the lines in the ring, oldest first
+bool Save (const char *pcszPath_)
+{
+    FILE *f = fopen(pcszPath_, "w");
+    if (!f)
+        return false;
+
+    for (size_t u = 0 ; u < GetLineCount() ; u++)
+        fprintf(f, "%s\n", GetLine(u));
+
+    bool fOK = !ferror(f);
+    fclose(f);
+    return fOK;
+}
+
+
+size_t GetLineCount ()
+{
+    return static_cast<size_t>(std::min(ullTotal, static_cast<uint64_t>(MAX_TRACE_LINES)));
+}
+
+// Return a line from the ring, with 0 as the oldest
+const char *GetLine (size_t uLine_)
+{
+    return aszLines[(ullTotal - GetLineCount() + uLine_) % MAX_TRACE_LINES];
+}
+
+uint64_t GetTotal ()
+{
+    return ullTotal;
+}
+
+} // namespace Tracepoint
@@ -0,0 +1,48 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Tracepoint.h: Breakpoints that log a formatted line and continue
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef TRACEPOINT_H
+#define TRACEPOINT_H
+
+typedef struct tagTRACEPOINT TRACEPOINT;
+
+
+namespace Tracepoint
+{
+    void Exit (bool fReInit_=false);
+
+    TRACEPOINT *Compile (const char *pcszFormat_);
+    void Release (TRACEPOINT *pTrace_);
+    const char *GetFormat (const TRACEPOINT *pTrace_);
+    uint64_t GetHits (const TRACEPOINT *pTrace_);
+
+    void Hit (TRACEPOINT *pTrace_);
+
+    bool SetFile (const char *pcszPath_);
+    void Flush ();
+    void Clear ();
+    bool Save (const char *pcszPath_);
+
+    size_t GetLineCount ();
+    const char *GetLine (size_t uLine_);
+    uint64_t GetTotal ();
+}
+
+#endif  // TRACEPOINT_H
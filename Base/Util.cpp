@@ -37,7 +37,7 @@
 #include "UI.h"
 
 static const int TRACE_BUFFER_SIZE = 2048;
-static char* s_pszTrace;
+static MACHINE_LOCAL char* s_pszTrace;
 
 namespace Util
 {
@@ -137,7 +137,7 @@ const char *AbbreviateSize (uint64_t ullSize_)
         ullSize_ = (ullSize_+500) / 1000;
     }
 
-    static char sz[32] = {};
+    static MACHINE_LOCAL char sz[32] = {};
     snprintf(sz, sizeof(sz)-1, "%u%cB", static_cast<UINT>(ullSize_), pcszUnits[nUnits]);
     return sz;
 }
@@ -146,7 +146,7 @@ const char *AbbreviateSize (uint64_t ullSize_)
 // CRC-CCITT for id/data checksums, with bit and byte order swapped
 WORD CrcBlock (const void* pcv_, size_t uLen_, WORD wCRC_/*=0xffff*/)
 {
-    static WORD awCRC[256];
+    static MACHINE_LOCAL WORD awCRC[256];
 
     // Build the table if not already built
     if (!awCRC[1])
@@ -250,7 +250,7 @@ void TraceOutputString (const BYTE * /*pcb*/, UINT /*uLen=0*/)
 
 #else
 
-DWORD g_dwStart;
+MACHINE_LOCAL DWORD g_dwStart;
 
 static void TraceOutputString (const char *pcszFormat_, va_list pcvArgs);
 static void WriteTimeString (char* psz_);
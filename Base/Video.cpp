@@ -29,8 +29,8 @@
 namespace Video
 {
 
-static VideoBase *pVideo;
-static bool afDirty[HEIGHT_LINES*2];
+static MACHINE_LOCAL VideoBase *pVideo;
+static MACHINE_LOCAL bool afDirty[HEIGHT_LINES*2];
 
 
 bool Init (bool fFirstInit_)
@@ -83,6 +83,19 @@ void Update (CScreen* pScreen_)
         pVideo->Update(pScreen_, afDirty);
 }
 
+// Fetch the native buffer for drawing the frame directly, if the display has one
+bool GetTarget (VIDEOTARGET *pTarget_)
+{
+    return pVideo && pVideo->GetTarget(pTarget_);
+}
+
+// Show the lines drawn directly to the target since the last update
+void UpdateTarget ()
+{
+    if (pVideo)
+        pVideo->UpdateTarget(afDirty);
+}
+
 void UpdateSize ()
 {
     if (pVideo)
@@ -25,6 +25,18 @@
 
 enum { VCAP_STRETCH=1, VCAP_FILTER=2, VCAP_SCANHIRES=4 };
 
+// Native pixel buffer the frame can be drawn straight into, one emulated line at a time
+typedef struct
+{
+    BYTE *pbPixels;             // first pixel of the top line
+    long lPitch;                // bytes from one emulated line to the next
+    long lScanOffset;           // bytes to the scanline row below each line, or 0 for none
+    int nDepth;                 // 16 or 32 bits per pixel
+    const DWORD *pdwPalette;    // native colour for each palette index
+    const DWORD *pdwScanline;   // native scanline colours, or null for black scanlines
+}
+VIDEOTARGET;
+
 namespace Video
 {
     bool Init (bool fFirstInit_=false);
@@ -37,6 +49,8 @@ namespace Video
     bool CheckCaps (int nCaps_);
 
     void Update (CScreen* pScreen_);
+    bool GetTarget (VIDEOTARGET *pTarget_);
+    void UpdateTarget ();
     void UpdateSize ();
     void UpdatePalette ();
 
@@ -60,6 +74,10 @@ class VideoBase
 
         virtual void DisplayToSamSize (int* pnX_, int* pnY_) = 0;
         virtual void DisplayToSamPoint (int* pnX_, int* pnY_) = 0;
+
+        // Optional direct drawing, for displays that can offer their pixels
+        virtual bool GetTarget (VIDEOTARGET* /*pTarget_*/) { return false; }
+        virtual void UpdateTarget (bool* /*pafDirty_*/) { }
 };
 
 #endif
@@ -28,16 +28,16 @@
 namespace WAV
 {
 
-static char szPath[MAX_PATH], *pszFile;
-static FILE *f;
-static int nFrames, nSilent = 0;
-static bool fSegment;
+static MACHINE_LOCAL char szPath[MAX_PATH], *pszFile;
+static MACHINE_LOCAL FILE *f;
+static MACHINE_LOCAL int nFrames, nSilent = 0;
+static MACHINE_LOCAL bool fSegment;
 
 
 // RIFF header must be byte-packed
 #pragma pack(1)
 
-struct tagRIFF
+MACHINE_LOCAL struct tagRIFF
 {
     BYTE abRiffHeader[4];	// 'R','I','F','F'
     BYTE abWaveLen[4];
@@ -59,6 +59,13 @@
 
 #define cy              (F & FLAG_C)
 
+// Repeated HALTs are skipped up to the next event, in cores allowing it
+#define halt_skip()     do { if (fIdle_) SkipHalt(); } while (0)
+
+// Call graph tracking for the profiler, after a call has jumped or before a return pops
+#define profile_call()  do { if (fProfile_) Profile::OnCall(); } while (0)
+#define profile_ret()   do { if (fProfile_) Profile::OnRet(); } while (0)
+
 #define xh              (((REGPAIR*)pHlIxIy)->b.h)
 #define xl              (((REGPAIR*)pHlIxIy)->b.l)
 
@@ -178,6 +185,7 @@
                                 g_dwCycleCounter++; \
                                 push(PC+2); \
                                 PC = npc; \
+                                profile_call(); \
                             } \
                             else { \
                                 MEM_ACCESS(PC); \
@@ -187,7 +195,7 @@
                         } while (0)
 
 // Return
-#define ret(cc)         do { if (cc) { Debug::OnRet(); pop(PC); } } while (0)
+#define ret(cc)         do { if (cc) { Debug::OnRet(); profile_ret(); pop(PC); } } while (0)
 #define retn            do { IFF1 = IFF2; ret(true); } while (0)
 
 
@@ -419,7 +427,7 @@ HLinstr(0136)   E = timed_read_byte(addr);                          endinstr;
 HLinstr(0146)   H = timed_read_byte(addr);                          endinstr;   // ld h,(hl/ix+d/iy+d)
 HLinstr(0156)   L = timed_read_byte(addr);                          endinstr;   // ld l,(hl/ix+d/iy+d)
 
-instr(4,0166)   regs.halted = 1; PC--;                              endinstr;   // halt
+instr(4,0166)   regs.halted = 1; PC--; halt_skip();                 endinstr;   // halt
 
 HLinstr(0176)   A = timed_read_byte(addr);                          endinstr;   // ld a,(hl/ix+d/iy+d)
 
@@ -518,7 +526,8 @@ instr(5,0300)   ret(!(F & FLAG_Z));                                 endinstr;
 
 // ret z
 instr(5,0310)
-    if (Tape::RetZHook() || Debug::RetZHook())
+    // Both hooks trap ROM1 routines, so only call them when there's a chance of a match
+    if (PC >= 0xc000 && GetSectionPage(SECTION_D) == ROM1 && (Tape::RetZHook() || Debug::RetZHook()))
         break;
 
     ret(F & FLAG_Z);
@@ -627,15 +636,15 @@ instr(4,0373)   if (IO::EiHook()) break; IFF1 = IFF2 = 1; g_nTurbo &= ~TURBO_BOO
 instr(4,0353)   std::swap(DE,HL);                                   endinstr;   // ex de,hl
 
 
-instr(5,0307)   push(PC); PC = 000;                                 endinstr;   // rst 0
+instr(5,0307)   push(PC); PC = 000; profile_call();                 endinstr;   // rst 0
 
-instr(5,0317)   if (IO::Rst8Hook()) break; push(PC); PC = 010;      endinstr;   // rst 8
-instr(5,0327)   push(PC); PC = 020;                                 endinstr;   // rst 16
-instr(5,0337)   push(PC); PC = 030;                                 endinstr;   // rst 24
-instr(5,0347)   push(PC); PC = 040;                                 endinstr;   // rst 32
-instr(5,0357)   push(PC); PC = 050;                                 endinstr;   // rst 40
-instr(5,0367)   if (IO::Rst48Hook()) break; push(PC); PC = 060;     endinstr;   // rst 48
-instr(5,0377)   push(PC); PC = 070;                                 endinstr;   // rst 56
+instr(5,0317)   if (IO::Rst8Hook()) break; push(PC); PC = 010; profile_call(); endinstr;   // rst 8
+instr(5,0327)   push(PC); PC = 020; profile_call();                 endinstr;   // rst 16
+instr(5,0337)   push(PC); PC = 030; profile_call();                 endinstr;   // rst 24
+instr(5,0347)   push(PC); PC = 040; profile_call();                 endinstr;   // rst 32
+instr(5,0357)   push(PC); PC = 050; profile_call();                 endinstr;   // rst 40
+instr(5,0367)   if (IO::Rst48Hook()) break; push(PC); PC = 060; profile_call(); endinstr;   // rst 48
+instr(5,0377)   push(PC); PC = 070; profile_call();                 endinstr;   // rst 56
 
 #undef instr
 #undef endinstr
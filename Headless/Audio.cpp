@@ -0,0 +1,46 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Audio.cpp: Headless sound implementation
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  Generated samples are discarded rather than played, so nothing throttles
+//  the emulation speed.  The sound chips are still emulated, so their cost
+//  is included in any timings.
+
+#include "SimCoupe.h"
+#include "Audio.h"
+
+bool Audio::Init (bool /*fFirstInit_=false*/)
+{
+    return true;
+}
+
+void Audio::Exit (bool /*fReInit_=false*/)
+{
+}
+
+
+bool Audio::AddData (BYTE* /*pbData_*/, int /*nLength_*/)
+{
+    return true;
+}
+
+void Audio::Silence ()
+{
+}
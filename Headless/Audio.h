@@ -0,0 +1,35 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Audio.h: Headless sound implementation
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef AUDIO_H
+#define AUDIO_H
+
+class Audio
+{
+    public:
+        static bool Init (bool fFirstInit_=false);
+        static void Exit (bool fReInit_=false);
+
+        static bool IsAvailable () { return false; }
+        static bool AddData (BYTE* pbData_, int nLength_);
+        static void Silence ();
+};
+
+#endif  // AUDIO_H
@@ -0,0 +1,514 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Bench.cpp: Headless benchmark driver
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  Boots the emulated SAM with the supplied options and media, then runs a
+//  fixed number of frames as fast as possible.  Sound and video output are
+//  discarded by the headless front-end, so nothing throttles the speed.
+//
+//  Usage: simcoupe-bench [-frames n] [-warmup n] [-expr e] [-tracelog file] [-profile file]
+//                        [-timings file] [-heatmap file] [-tracepoint addr format]
+//                        [-watch addr len] [-reverse n] [-machines n] [-renderer name]
+//                        [options] [disk]
+//
+//  Any other options are passed through to the normal option processing,
+//  so -rom can be used to select the ROM image and a bare disk image path
+//  will be inserted and booted from drive 1.  Use -rewind n to include the
+//  cost of keeping n seconds of rewind history, which is also reported.
+//  Use -expr "expression" to also time evaluating a debugger expression,
+//  such as a breakpoint condition, compiled and interpreted.  Use -tracelog
+//  to stream an instruction trace of the measured frames to the given file;
+//  the time includes waiting for the writer to finish compressing it.  Use
+//  -profile to profile the guest code over the measured frames, saving the
+//  results in callgrind format and listing the most expensive functions.
+//  Use -timings to save the per-subsystem host timings of the final frames
+//  as CSV, and list their breakdown.  Use -heatmap to record memory access
+//  coverage over the measured frames, saving it as CSV (or a binary image if
+//  the file doesn't end in .csv) and listing the bytes read, written and run.
+//  Use -tracepoint to log a formatted line each time the given address runs,
+//  reporting the hits and the last line logged.  Use -watch to also log the
+//  instructions writing to the given range, reporting how they were caught.
+//  Use -reverse to record the debugger's reverse history over the measured
+//  frames, then time stepping back n instructions and a single instruction,
+//  listing the history kept.  A breakpoint that never stops is added to arm
+//  recording if no others are set.
+//
+//  Use -machines to instead run n independent machines on their own threads,
+//  each with the same options.  One machine is timed alone first, then all
+//  of them together, reporting the combined speed, how it scales against a
+//  single machine, and the memory used by each.
+//
+//  The display line renderers are checked against the scalar versions before
+//  each run, and the one used is listed.  Use -renderer to pick a specific
+//  one (scalar, sse2 or avx2) to compare their speeds.  The headless display
+//  converts frames to a 32-bit image, and its checksum is listed so -directrender 0
+//  can be used to check drawing through the palette index frame matches.
+
+#include "SimCoupe.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Breakpoint.h"
+#include "CPU.h"
+#include "Expr.h"
+#include "Frame.h"
+#include "Heatmap.h"
+#include "Machine.h"
+#include "Main.h"
+#include "Options.h"
+#include "Perf.h"
+#include "Profile.h"
+#include "Render.h"
+#include "Reverse.h"
+#include "Rewind.h"
+#include "TraceLog.h"
+#include "Tracepoint.h"
+#include "Util.h"
+#include "Video.h"
+
+static const int DEFAULT_FRAMES = 3000;     // 60 seconds of emulated time
+static const int DEFAULT_WARMUP = 0;
+static const int EXPR_EVALS = 10000000;     // evaluations per expression timing
+static const size_t PROFILE_FUNCS = 10;     // functions listed from the profile
+
+
+// Return the requested percentile from a sorted list of frame times
+static double Percentile (const std::vector<double> &vTimes_, int nPercent_)
+{
+    size_t uIndex = (vTimes_.size() - 1) * nPercent_ / 100;
+    return vTimes_[uIndex];
+}
+
+static void RunFrames (int nFrames_, std::vector<double> *pvTimes_=nullptr)
+{
+    for (int i = 0 ; i < nFrames_ ; i++)
+    {
+        auto tStart = std::chrono::steady_clock::now();
+
+        CPU::RunFrame();
+
+        if (pvTimes_)
+        {
+            std::chrono::duration<double, std::milli> tFrame = std::chrono::steady_clock::now() - tStart;
+            pvTimes_->push_back(tFrame.count());
+        }
+    }
+}
+
+// Turn the most recently added breakpoint into a tracepoint
+static bool SetLastTrace (const char *pcszFormat_)
+{
+    int nIndex = 0;
+    while (Breakpoint::GetAt(nIndex+1))
+        nIndex++;
+
+    return Breakpoint::SetTrace(nIndex, pcszFormat_);
+}
+
+// Time repeated evaluation of an expression, returning the nanoseconds per evaluation
+static double TimeExpr (const EXPR *pExpr_, bool fInterpret_, int *pnResult_)
+{
+    int nResult = 0;
+    auto tStart = std::chrono::steady_clock::now();
+
+    for (int i = 0 ; i < EXPR_EVALS ; i++)
+        nResult += fInterpret_ ? Expr::Interpret(pExpr_) : Expr::Eval(pExpr_);
+
+    std::chrono::duration<double, std::nano> tTotal = std::chrono::steady_clock::now() - tStart;
+    *pnResult_ = nResult;
+    return tTotal.count() / EXPR_EVALS;
+}
+
+// Run the frames on each machine at the same time, returning the seconds taken
+static double TimeMachines (const std::vector<std::unique_ptr<CMachine>> &vMachines_, int nFrames_)
+{
+    auto tStart = std::chrono::steady_clock::now();
+
+    for (auto &pMachine : vMachines_)
+        pMachine->Call([nFrames_] { RunFrames(nFrames_); });
+
+    for (auto &pMachine : vMachines_)
+        pMachine->Wait();
+
+    std::chrono::duration<double> tTotal = std::chrono::steady_clock::now() - tStart;
+    return tTotal.count();
+}
+
+// Compare the speed of several machines running together against one alone
+static int RunMachines (int nMachines_, int nFrames_, int nWarmup_, std::vector<char*> &vArgs_)
+{
+    std::vector<std::unique_ptr<CMachine>> vMachines;
+
+    for (int i = 0 ; i < nMachines_ ; i++)
+    {
+        vMachines.emplace_back(new CMachine());
+        if (!vMachines.back()->Init(static_cast<int>(vArgs_.size()-1), vArgs_.data()))
+            return 1;
+    }
+
+    TimeMachines(vMachines, nWarmup_);
+
+    // The first machine alone sets the speed to scale against
+    std::vector<std::unique_ptr<CMachine>> vFirst;
+    vFirst.push_back(std::move(vMachines[0]));
+    double dSingle = TimeMachines(vFirst, nFrames_);
+    vMachines[0] = std::move(vFirst[0]);
+
+    double dAll = TimeMachines(vMachines, nFrames_);
+
+    MACHINE_MEMORY sMemory;
+    vMachines[0]->GetMemory(&sMemory);
+
+    // Machines are stopped one at a time, as they save the shared settings
+    vMachines.clear();
+
+    double dSingleFps = nFrames_ / dSingle;
+    double dAllFps = nFrames_ * nMachines_ / dAll;
+
+    printf("Machines:    %d, %d frames each (+%d warm-up)\n", nMachines_, nFrames_, nWarmup_);
+    printf("Single:      %.3f s, %.1f frames/s (%.0f%%)\n", dSingle, dSingleFps, dSingleFps * 100 / EMULATED_FRAMES_PER_SECOND);
+    printf("Combined:    %.3f s, %.1f frames/s (%.0f%%)\n", dAll, dAllFps, dAllFps * 100 / EMULATED_FRAMES_PER_SECOND);
+    printf("Scaling:     %.2fx of %d (%.0f%% of linear)\n", dAllFps / dSingleFps, nMachines_,
+                dAllFps * 100 / dSingleFps / nMachines_);
+    printf("Memory:      %.1f KB per machine: state %.1f KB, guest %.1f KB, code %.1f KB, history %.1f KB\n",
+                sMemory.uTotal / 1024.0, sMemory.uStatics / 1024.0, sMemory.uMemory / 1024.0,
+                sMemory.uCode / 1024.0, sMemory.uHistory / 1024.0);
+
+    return 0;
+}
+
+
+int main (int argc_, char* argv_[])
+{
+    int nFrames = DEFAULT_FRAMES, nWarmup = DEFAULT_WARMUP;
+    const char *pcszExpr = nullptr, *pcszTraceLog = nullptr, *pcszProfile = nullptr, *pcszTimings = nullptr;
+    const char *pcszHeatmap = nullptr, *pcszTraceAddr = nullptr, *pcszTraceFormat = nullptr;
+    const char *pcszWatchAddr = nullptr, *pcszWatchLen = nullptr, *pcszRenderer = nullptr;
+    int nReverse = 0, nMachines = 0;
+
+    // Extract our own options, leaving the rest for the emulator
+    std::vector<char*> vArgs { argv_[0] };
+    for (int i = 1 ; i < argc_ ; i++)
+    {
+        if (!strcasecmp(argv_[i], "-frames") && i+1 < argc_)
+            nFrames = atoi(argv_[++i]);
+        else if (!strcasecmp(argv_[i], "-warmup") && i+1 < argc_)
+            nWarmup = atoi(argv_[++i]);
+        else if (!strcasecmp(argv_[i], "-expr") && i+1 < argc_)
+            pcszExpr = argv_[++i];
+        else if (!strcasecmp(argv_[i], "-tracelog") && i+1 < argc_)
+            pcszTraceLog = argv_[++i];
+        else if (!strcasecmp(argv_[i], "-profile") && i+1 < argc_)
+            pcszProfile = argv_[++i];
+        else if (!strcasecmp(argv_[i], "-timings") && i+1 < argc_)
+            pcszTimings = argv_[++i];
+        else if (!strcasecmp(argv_[i], "-heatmap") && i+1 < argc_)
+            pcszHeatmap = argv_[++i];
+        else if (!strcasecmp(argv_[i], "-tracepoint") && i+2 < argc_)
+        {
+            pcszTraceAddr = argv_[++i];
+            pcszTraceFormat = argv_[++i];
+        }
+        else if (!strcasecmp(argv_[i], "-watch") && i+2 < argc_)
+        {
+            pcszWatchAddr = argv_[++i];
+            pcszWatchLen = argv_[++i];
+        }
+        else if (!strcasecmp(argv_[i], "-reverse") && i+1 < argc_)
+            nReverse = atoi(argv_[++i]);
+        else if (!strcasecmp(argv_[i], "-machines") && i+1 < argc_)
+            nMachines = atoi(argv_[++i]);
+        else if (!strcasecmp(argv_[i], "-renderer") && i+1 < argc_)
+            pcszRenderer = argv_[++i];
+        else
+            vArgs.push_back(argv_[i]);
+    }
+
+    if (nFrames <= 0 || nWarmup < 0 || nReverse < 0 || nMachines < 0)
+    {
+        fprintf(stderr, "Usage: %s [-frames n] [-warmup n] [-expr e] [-tracelog file] [-profile file] [-timings file] [-heatmap file] [-tracepoint addr format] [-watch addr len] [-reverse n] [-machines n] [-renderer name] [options] [disk]\n", argv_[0]);
+        return 1;
+    }
+
+    if (pcszRenderer && !Render::Select(pcszRenderer))
+    {
+        fprintf(stderr, "Renderer not available: %s\n", pcszRenderer);
+        return 1;
+    }
+
+    // Any renderer giving different pixels is reported, but the run continues
+    const char *pcszMismatch = nullptr;
+    bool fRenderOK = Render::Verify(&pcszMismatch);
+
+    vArgs.push_back(nullptr);
+    if (nMachines)
+        return RunMachines(nMachines, nFrames, nWarmup, vArgs);
+
+    if (!Main::Init(static_cast<int>(vArgs.size()-1), vArgs.data()))
+    {
+        Main::Exit(false);
+        return 1;
+    }
+
+    // Frames before the measured run aren't timed
+    RunFrames(nWarmup);
+
+    // Compare the expression evaluators using the machine state after the warm-up
+    if (pcszExpr)
+    {
+        EXPR *pExpr = Expr::Compile(pcszExpr);
+        if (!pExpr)
+        {
+            fprintf(stderr, "Invalid expression: %s\n", pcszExpr);
+            Main::Exit(false);
+            return 1;
+        }
+
+        int nValue = Expr::Eval(pExpr), nCompiled, nInterpreted;
+        double dCompiled = TimeExpr(pExpr, false, &nCompiled);
+        double dInterpreted = TimeExpr(pExpr, true, &nInterpreted);
+        Expr::Release(pExpr);
+
+        printf("Expression:  %s = %d, compiled %.1f ns, interpreted %.1f ns%s\n", pcszExpr, nValue,
+                dCompiled, dInterpreted, (nCompiled == nInterpreted) ? "" : " (MISMATCH)");
+    }
+
+    std::vector<double> vTimes;
+    vTimes.reserve(nFrames);
+
+    if (pcszTraceLog && !TraceLog::Start(pcszTraceLog))
+    {
+        fprintf(stderr, "Failed to create trace log: %s\n", pcszTraceLog);
+        Main::Exit(false);
+        return 1;
+    }
+
+    if (pcszProfile)
+        Profile::Start();
+
+    if (pcszHeatmap)
+        Heatmap::Start();
+
+    // Tracepoints are added last, so they're at the end of the breakpoint list
+    if (pcszTraceAddr)
+    {
+        int nAddr = 0;
+        Expr::Eval(pcszTraceAddr, &nAddr);
+        Breakpoint::AddExec(AddrReadPtr(static_cast<WORD>(nAddr)), nullptr);
+
+        if (!SetLastTrace(pcszTraceFormat))
+        {
+            fprintf(stderr, "Invalid tracepoint format: %s\n", pcszTraceFormat);
+            Main::Exit(false);
+            return 1;
+        }
+    }
+
+    // Watched writes are logged with the address of the instruction after the write
+    if (pcszWatchAddr)
+    {
+        int nAddr = 0, nLength = 0;
+        Expr::Eval(pcszWatchAddr, &nAddr);
+        Expr::Eval(pcszWatchLen, &nLength);
+        Breakpoint::AddMemory(AddrReadPtr(static_cast<WORD>(nAddr)), atWrite, nullptr, std::max(nLength, 1));
+        SetLastTrace("{pc}");
+    }
+
+    // Recording is only armed while breakpoints are set, so add one with a condition that's never true
+    if (nReverse && !Breakpoint::IsSet())
+        Breakpoint::AddExec(AddrReadPtr(0), Expr::Compile("0"));
+
+    bool fGuarded = Breakpoint::IsGuarded();
+
+    auto tStart = std::chrono::steady_clock::now();
+    RunFrames(nFrames, &vTimes);
+    Profile::Stop();
+    Heatmap::Stop();
+
+    TRACELOG_STATS sTrace;
+    TraceLog::Stop();
+    TraceLog::GetStats(&sTrace);
+
+    std::chrono::duration<double> tTotal = std::chrono::steady_clock::now() - tStart;
+
+    std::vector<PROFILE_ENTRY> vFuncs;
+    uint64_t ullProfiled = Profile::GetTotal();
+    if (pcszProfile)
+    {
+        if (!Profile::Save(pcszProfile))
+            fprintf(stderr, "Failed to save profile: %s\n", pcszProfile);
+
+        Profile::GetFunctions(vFuncs);
+        if (vFuncs.size() > PROFILE_FUNCS)
+            vFuncs.erase(vFuncs.begin()+PROFILE_FUNCS, vFuncs.end());
+    }
+
+    PERF_STATS asPerf[MAX_PERF_TIMERS], sPerfTotal;
+    int nPerfFrames = Perf::GetStats(asPerf, &sPerfTotal);
+    if (pcszTimings && !Perf::Save(pcszTimings))
+        fprintf(stderr, "Failed to save timings: %s\n", pcszTimings);
+
+    // Count the locations covered by each access type, across all pages
+    size_t auCovered[MAX_HEAT_TYPES] = {};
+    if (pcszHeatmap)
+    {
+        size_t uLen = strlen(pcszHeatmap);
+        bool fCSV = uLen >= 4 && !strcasecmp(pcszHeatmap+uLen-4, ".csv");
+        if (!Heatmap::Save(pcszHeatmap, fCSV))
+            fprintf(stderr, "Failed to save heatmap: %s\n", pcszHeatmap);
+
+        for (int nPage = INTMEM ; nPage <= ROM1 ; nPage++)
+        {
+            const HEAT_PAGE *pPage = Heatmap::GetPage(nPage);
+            for (int i = 0 ; pPage && i < MEM_PAGE_SIZE ; i++)
+            {
+                for (int j = 0 ; j < MAX_HEAT_TYPES ; j++)
+                    auCovered[j] += (pPage->abCover[i] >> j) & 1;
+            }
+        }
+    }
+
+    // Time going back through the recorded history, from the end of the measured frames
+    REVERSE_STATS sReverse;
+    Reverse::GetStats(&sReverse);
+    double dStepMs = 0.0, dStepOneMs = 0.0;
+    bool fStepped = false;
+    if (nReverse)
+    {
+        auto tReverse = std::chrono::steady_clock::now();
+        fStepped = Reverse::StepBack(nReverse);
+        auto tStepOne = std::chrono::steady_clock::now();
+        fStepped = Reverse::StepBack() && fStepped;
+        auto tDone = std::chrono::steady_clock::now();
+
+        dStepMs = std::chrono::duration<double, std::milli>(tStepOne - tReverse).count();
+        dStepOneMs = std::chrono::duration<double, std::milli>(tDone - tStepOne).count();
+
+        // Keep the history recorded, but with the replay speed measured by going back through it
+        REVERSE_STATS sAfter;
+        Reverse::GetStats(&sAfter);
+        sReverse.dReplayFps = sAfter.dReplayFps;
+    }
+
+    uint64_t ullTraceHits = Tracepoint::GetTotal();
+    std::string sTraceLine = ullTraceHits ? Tracepoint::GetLine(Tracepoint::GetLineCount()-1) : "";
+    Breakpoint::RemoveAll();
+
+    REWIND_STATS sRewind;
+    Rewind::GetStats(&sRewind);
+    bool fRewind = GetOption(rewind) != 0;
+
+    // Checksum the final displayed image, which is the same however it was drawn
+    WORD wDisplayCrc = 0xffff;
+    VIDEOTARGET sTarget;
+    if (Video::GetTarget(&sTarget))
+    {
+        for (int i = 0, nHeight = Frame::GetHeight() >> 1 ; i < nHeight ; i++)
+            wDisplayCrc = CrcBlock(sTarget.pbPixels + i * sTarget.lPitch, Frame::GetWidth() * sizeof(DWORD), wDisplayCrc);
+    }
+    bool fDirect = GetOption(directrender);
+
+    Main::Exit(false);
+
+    std::sort(vTimes.begin(), vTimes.end());
+
+    double dSeconds = tTotal.count();
+    double dFps = nFrames / dSeconds;
+    double dMHz = static_cast<double>(nFrames) * TSTATES_PER_FRAME / dSeconds / 1000000.0;
+
+    printf("Frames:      %d (+%d warm-up)\n", nFrames, nWarmup);
+    printf("Time:        %.3f s\n", dSeconds);
+    printf("Speed:       %.1f frames/s (%.0f%%)\n", dFps, dFps * 100 / EMULATED_FRAMES_PER_SECOND);
+    printf("Z80 clock:   %.2f MHz effective\n", dMHz);
+    printf("Frame time:  min %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f ms\n",
+            vTimes.front(), Percentile(vTimes, 50), Percentile(vTimes, 90), Percentile(vTimes, 99), vTimes.back());
+    printf("Renderer:    %s, %s\n", g_pRenderer->pcszName, fRenderOK ? "all match scalar" : "MISMATCH");
+    if (!fRenderOK)
+        printf("  %s differs from scalar\n", pcszMismatch);
+    printf("Display:     %s, image CRC %04X\n", fDirect ? "drawn direct to 32-bit" : "converted from palette indices", wDisplayCrc);
+
+    if (fRewind)
+    {
+        printf("Rewind:      %d/%d frames, %.1f KB deltas (%.1f KB/frame), %.1f KB total, capture %.3f ms\n",
+                sRewind.nFrames, sRewind.nMaxFrames, sRewind.uDeltaBytes / 1024.0,
+                sRewind.nFrames ? sRewind.uDeltaBytes / 1024.0 / sRewind.nFrames : 0.0,
+                sRewind.uTotalBytes / 1024.0, sRewind.dCaptureMs);
+    }
+
+    if (pcszProfile && ullProfiled)
+    {
+        printf("Profile:     %.0f T-states, %s\n", static_cast<double>(ullProfiled), pcszProfile);
+        for (auto &func : vFuncs)
+        {
+            printf("  %-24s  self %6.2f%%  total %6.2f%%  calls %llu\n", func.sName.c_str(),
+                    func.ullSelf * 100.0 / ullProfiled, func.ullTotal * 100.0 / ullProfiled,
+                    static_cast<unsigned long long>(func.ullCount));
+        }
+    }
+
+    if (pcszWatchAddr)
+        printf("Watchpoint:  caught by %s\n", fGuarded ? "page protection, or the index when busy" : "breakpoint index");
+
+    if (pcszTraceAddr || pcszWatchAddr)
+    {
+        printf("Tracepoint:  %llu hits (%.1f/frame), last: %s\n", static_cast<unsigned long long>(ullTraceHits),
+                static_cast<double>(ullTraceHits) / nFrames, sTraceLine.c_str());
+    }
+
+    if (nReverse)
+    {
+        printf("Reverse:     %d checkpoints over %.1f s (every %d-%d frames), %.1f KB, replay %.0f frames/s\n",
+                sReverse.nCheckpoints, sReverse.dSeconds, sReverse.nMinSpacing, sReverse.nMaxSpacing,
+                sReverse.uTotalBytes / 1024.0, sReverse.dReplayFps);
+        printf("Step back:   %d instructions %.3f ms, 1 instruction %.3f ms%s\n", nReverse, dStepMs, dStepOneMs,
+                fStepped ? "" : " (FAILED)");
+    }
+
+    if (pcszHeatmap)
+    {
+        printf("Heatmap:     %zu bytes read, %zu written, %zu run, %s\n",
+                auCovered[htRead], auCovered[htWrite], auCovered[htExec], pcszHeatmap);
+    }
+
+    if (pcszTimings && nPerfFrames)
+    {
+        printf("Timings:     last %d frames, %s\n", nPerfFrames, pcszTimings);
+        for (int i = 0 ; i <= MAX_PERF_TIMERS ; i++)
+        {
+            const PERF_STATS &s = (i < MAX_PERF_TIMERS) ? asPerf[i] : sPerfTotal;
+            printf("  %-8s  min %7.3f  avg %7.3f  p99 %7.3f  max %7.3f ms  (%5.1f%%)\n", Perf::GetName(i),
+                    s.dMin, s.dAvg, s.dP99, s.dMax, sPerfTotal.dAvg ? s.dAvg * 100.0 / sPerfTotal.dAvg : 0.0);
+        }
+    }
+
+    if (pcszTraceLog)
+    {
+        printf("Trace log:   %llu instructions (%.1f M/s), %.1f MB raw (%.1f bytes each), %d buffers, %d waits (%.1fms)\n",
+                static_cast<unsigned long long>(sTrace.ullRecords), sTrace.ullRecords / dSeconds / 1000000.0,
+                sTrace.ullBytes / 1048576.0, sTrace.ullRecords ? static_cast<double>(sTrace.ullBytes) / sTrace.ullRecords : 0.0,
+                sTrace.nBuffers, sTrace.nWaits, sTrace.dWaitTime);
+    }
+
+    return 0;
+}
@@ -0,0 +1,65 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Floppy.h: Headless direct floppy access
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef FLOPPY_H
+#define FLOPPY_H
+
+#include "Stream.h"
+#include "VL1772.h"
+
+typedef struct
+{
+    BYTE sectors = 0;
+    BYTE cyl = 0, head = 0;     // physical track location
+} TRACK, *PTRACK;
+
+typedef struct
+{
+    BYTE cyl = 0, head = 0, sector = 0, size = 0;
+    BYTE status = 0;
+    BYTE *pbData = nullptr;
+} SECTOR, *PSECTOR;
+
+
+// Real disk access isn't supported, so streams are never recognised or opened
+class CFloppyStream final : public CStream
+{
+    public:
+        CFloppyStream (const char* pcszStream_, bool fReadOnly_=false) : CStream(pcszStream_, fReadOnly_) { }
+
+    public:
+        static bool IsRecognised (const char* /*pcszStream_*/) { return false; }
+
+    public:
+        void Close () override { }
+
+    public:
+        bool IsOpen () const override { return false; }
+        bool IsBusy (BYTE* /*pbStatus_*/, bool /*fWait_*/) { return false; }
+
+        // The normal stream functions are not used
+        bool Rewind () override { return false; }
+        size_t Read (void*, size_t) override { return 0; }
+        size_t Write (void*, size_t) override { return 0; }
+
+        BYTE StartCommand (BYTE /*bCommand_*/, PTRACK /*pTrack_*/=nullptr, UINT /*uSectorIndex_*/=0) { return RECORD_NOT_FOUND; }
+};
+
+#endif  // FLOPPY_H
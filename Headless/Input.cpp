@@ -0,0 +1,71 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// Input.cpp: Headless input
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  There are no input devices, so the SAM keyboard matrix only changes
+//  through automatic typing (Keyin) or direct access to keybuffer.
+
+#include "SimCoupe.h"
+#include "Input.h"
+
+#include "IO.h"
+
+bool Input::Init (bool /*fFirstInit_=false*/)
+{
+    Purge();
+    return true;
+}
+
+void Input::Exit (bool /*fReInit_=false*/)
+{
+}
+
+
+void Input::Update ()
+{
+}
+
+
+bool Input::IsMouseAcquired ()
+{
+    return false;
+}
+
+void Input::AcquireMouse (bool /*fAcquire_=true*/)
+{
+}
+
+// Release all SAM keys
+void Input::Purge ()
+{
+    memset(keybuffer, 0xff, sizeof(keybuffer));
+}
+
+
+int Input::MapChar (int nChar_, int * /*pnMods_=nullptr*/)
+{
+    // Regular ASCII characters map directly
+    return (nChar_ && nChar_ < 0x7f) ? nChar_ : 0;
+}
+
+int Input::MapKey (int nKey_)
+{
+    return nKey_;
+}
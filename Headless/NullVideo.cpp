@@ -0,0 +1,114 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// NullVideo.cpp: Video implementation that discards all output
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  There's no display, but the frame is still converted to a 32-bit image,
+//  one row per line, so timings include the cost of display output.  The
+//  image is also offered as a target for the frame to be drawn into.
+
+#include "SimCoupe.h"
+#include "NullVideo.h"
+
+#include "Frame.h"
+#include "GUI.h"
+#include "IO.h"
+
+NullVideo::~NullVideo ()
+{
+    delete[] m_pdwPixels;
+}
+
+int NullVideo::GetCaps () const
+{
+    return 0;
+}
+
+bool NullVideo::Init (bool /*fFirstInit_*/)
+{
+    m_pdwPixels = new DWORD[Frame::GetWidth() * Frame::GetHeight()]();
+    UpdatePalette();
+    return true;
+}
+
+
+// Convert the changed lines to the 32-bit image, as a real display would
+void NullVideo::Update (CScreen* pScreen_, bool *pafDirty_)
+{
+    int nWidth = Frame::GetWidth();
+    int nHeight = Frame::GetHeight() >> (GUI::IsActive() ? 0 : 1);
+
+    for (int i = 0 ; i < nHeight ; i++)
+    {
+        if (!pafDirty_[i])
+            continue;
+
+        BYTE *pb = pScreen_->GetLine(i);
+        DWORD *pdw = m_pdwPixels + i * nWidth;
+
+        for (int x = 0 ; x < nWidth ; x++)
+            pdw[x] = m_adwPalette[pb[x]];
+
+        pafDirty_[i] = false;
+    }
+}
+
+void NullVideo::UpdateSize ()
+{
+}
+
+void NullVideo::UpdatePalette ()
+{
+    const COLOUR *pSAM = IO::GetPalette();
+
+    for (int i = 0 ; i < N_PALETTE_COLOURS ; i++)
+        m_adwPalette[i] = (pSAM[i].bRed << 16) | (pSAM[i].bGreen << 8) | pSAM[i].bBlue;
+
+    Video::SetDirty();
+}
+
+
+// Offer the 32-bit image for direct drawing, without scanline rows
+bool NullVideo::GetTarget (VIDEOTARGET *pTarget_)
+{
+    pTarget_->pbPixels = reinterpret_cast<BYTE*>(m_pdwPixels);
+    pTarget_->lPitch = Frame::GetWidth() * sizeof(DWORD);
+    pTarget_->lScanOffset = 0;
+    pTarget_->nDepth = 32;
+    pTarget_->pdwPalette = m_adwPalette;
+    pTarget_->pdwScanline = nullptr;
+    return true;
+}
+
+// The lines are already in the image
+void NullVideo::UpdateTarget (bool *pafDirty_)
+{
+    for (int i = 0, nHeight = Frame::GetHeight() ; i < nHeight ; i++)
+        pafDirty_[i] = false;
+}
+
+
+// There's no display, so the SAM view is used as-is
+void NullVideo::DisplayToSamSize (int* /*pnX_*/, int* /*pnY_*/)
+{
+}
+
+void NullVideo::DisplayToSamPoint (int* /*pnX_*/, int* /*pnY_*/)
+{
+}
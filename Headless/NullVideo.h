@@ -0,0 +1,54 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// NullVideo.h: Video implementation that discards all output
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef NULLVIDEO_H
+#define NULLVIDEO_H
+
+#include "IO.h"
+#include "Video.h"
+
+class NullVideo : public VideoBase
+{
+    public:
+        NullVideo () = default;
+        NullVideo (const NullVideo &) = delete;
+        void operator= (const NullVideo &) = delete;
+        ~NullVideo ();
+
+    public:
+        int GetCaps () const override;
+        bool Init (bool fFirstInit_) override;
+
+        void Update (CScreen* pScreen_, bool *pafDirty_) override;
+        void UpdateSize () override;
+        void UpdatePalette () override;
+
+        void DisplayToSamSize (int* pnX_, int* pnY_) override;
+        void DisplayToSamPoint (int* pnX_, int* pnY_) override;
+
+        bool GetTarget (VIDEOTARGET *pTarget_) override;
+        void UpdateTarget (bool *pafDirty_) override;
+
+    private:
+        DWORD *m_pdwPixels = nullptr;               // 32-bit frame, not shown anywhere
+        DWORD m_adwPalette[N_PALETTE_COLOURS] {};
+};
+
+#endif // NULLVIDEO_H
@@ -0,0 +1,155 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// OSD.cpp: Headless OS-dependent routines
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  The headless build has no display, sound or input devices, and is used
+//  for benchmarking and automated runs of the emulation core.
+
+#include "SimCoupe.h"
+#include "OSD.h"
+
+#include "Options.h"
+#include "Parallel.h"
+
+bool OSD::Init (bool /*fFirstInit_=false*/)
+{
+    return true;
+}
+
+void OSD::Exit (bool /*fReInit_=false*/)
+{
+}
+
+
+// Return a DWORD containing a millisecond accurate time stamp
+// Note: calling could should allow for the value wrapping by only comparing differences
+DWORD OSD::GetTime ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<DWORD>(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+
+const char* OSD::MakeFilePath (int nDir_, const char* pcszFile_/*=""*/)
+{
+    static MACHINE_LOCAL char szPath[MAX_PATH*2];
+    szPath[0] = '\0';
+
+    // $HOME is a fairly safe default
+    const char *pcszHome = getenv("HOME");
+    if (pcszHome && *pcszHome)
+    {
+        strncpy(szPath, pcszHome, MAX_PATH-2);
+        szPath[MAX_PATH-2] = '\0';
+        strcat(szPath, "/");
+    }
+
+    switch (nDir_)
+    {
+        case MFP_SETTINGS:
+            strcat(szPath, ".simcoupe/");
+            break;
+
+        case MFP_INPUT:
+            // Input override, or the current directory
+            if (GetOption(inpath)[0])
+                strncpy(szPath, GetOption(inpath), MAX_PATH);
+            else
+                szPath[0] = '\0';
+            break;
+
+        case MFP_OUTPUT:
+            // Output override, or the current directory
+            if (GetOption(outpath)[0])
+                strncpy(szPath, GetOption(outpath), MAX_PATH-1);
+            else
+                szPath[0] = '\0';
+
+            szPath[MAX_PATH-1] = '\0';
+            break;
+
+        case MFP_RESOURCE:
+#ifdef RESOURCE_DIR
+            // If available, use the resource directory from the build process
+            strncpy(szPath, RESOURCE_DIR, MAX_PATH-1);
+            szPath[MAX_PATH-1] = '\0';
+#else
+            // Fall back on the current directory
+            szPath[0] = '\0';
+#endif
+            break;
+    }
+
+    // Create the directory if it doesn't already exist
+    // This assumes only the last component could be missing
+    if (szPath[0] && mkdir(szPath, 0755) != 0 && errno != EEXIST)
+        TRACE("!!! Failed to create directory: %s\n", szPath);
+
+    // Append any supplied filename (separator already added)
+    strncat(szPath, pcszFile_, sizeof(szPath)-strlen(szPath)-1);
+    szPath[sizeof(szPath)-1] = '\0';
+
+    // Return a pointer to the new path
+    return szPath;
+}
+
+
+// Check whether the specified path is accessible
+bool OSD::CheckPathAccess (const char* pcszPath_)
+{
+    return !access(pcszPath_, X_OK);
+}
+
+
+// Return whether a file/directory is normally hidden from a directory listing
+bool OSD::IsHidden (const char* pcszPath_)
+{
+    // Hide entries beginning with a dot
+    pcszPath_ = strrchr(pcszPath_, PATH_SEPARATOR);
+    return pcszPath_ && pcszPath_[1] == '.';
+}
+
+
+// Return the path to use for a given drive with direct floppy access
+const char* OSD::GetFloppyDevice (int nDrive_)
+{
+    static MACHINE_LOCAL char szDevice[] = "/dev/fd_";
+
+    szDevice[7] = '0' + nDrive_-1;
+    return szDevice;
+}
+
+
+void OSD::DebugTrace (const char* pcsz_)
+{
+    fprintf(stderr, "%s", pcsz_);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Dummy printer device implementation
+CPrinterDevice::CPrinterDevice () { }
+CPrinterDevice::~CPrinterDevice () { }
+bool CPrinterDevice::Open () { return false; }
+void CPrinterDevice::Close () { }
+void CPrinterDevice::Write (BYTE * /*pb_*/, size_t /*uLen_*/) { }
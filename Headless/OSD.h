@@ -0,0 +1,58 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// OSD.h: Headless OS-dependent routines
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef OSD_H
+#define OSD_H
+
+#include <sys/types.h>      // for _off_t definition
+#include <fcntl.h>
+
+#include <sys/ioctl.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#define HEADLESS
+
+#define PATH_SEPARATOR      '/'
+
+typedef unsigned int        DWORD;  // must be 32-bit
+typedef unsigned short      WORD;   // must be 16-bit
+typedef unsigned char       BYTE;   // must be 8-bit
+
+////////////////////////////////////////////////////////////////////////////////
+
+enum { MFP_SETTINGS, MFP_INPUT, MFP_OUTPUT, MFP_RESOURCE };
+
+class OSD
+{
+public:
+    static bool Init (bool fFirstInit_=false);
+    static void Exit (bool fReInit_=false);
+
+    static DWORD GetTime ();
+    static const char* MakeFilePath (int nDir_, const char* pcszFile_="");
+    static const char* GetFloppyDevice (int nDrive_);
+    static bool CheckPathAccess (const char* pcszPath_);
+    static bool IsHidden (const char* pcszPath_);
+
+    static void DebugTrace (const char* pcsz_);
+};
+
+#endif  // OSD_H
@@ -0,0 +1,80 @@
+// Part of SimCoupe - A SAM Coupe emulator
+//
+// UI.cpp: Headless user interface
+//
+//  Copyright (c) 1999-2015 Simon Owen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Notes:
+//  There are no external events to process, so the emulation runs until
+//  the driving code asks it to stop.
+
+#include "SimCoupe.h"
+#include "UI.h"
+
+#include "NullVideo.h"
+
+MACHINE_LOCAL bool g_fActive = true;
+MACHINE_LOCAL bool UI::s_fQuit;
+
+
+bool UI::Init (bool /*fFirstInit_=false*/)
+{
+    TRACE("UI::Init()\n");
+    s_fQuit = false;
+    return true;
+}
+
+void UI::Exit (bool fReInit_/*=false*/)
+{
+    TRACE("UI::Exit(%d)\n", fReInit_);
+}
+
+
+// Create a video object to render the display
+VideoBase *UI::GetVideo (bool fFirstInit_)
+{
+    VideoBase *pVideo = new NullVideo;
+
+    if (!pVideo->Init(fFirstInit_))
+    {
+        delete pVideo; pVideo = nullptr;
+        Message(msgError, "Video initialisation failed!");
+    }
+
+    return pVideo;
+}
+
+
+// Check and process any incoming messages
+bool UI::CheckEvents ()
+{
+    return !s_fQuit;
+}
+
+
+// No front-end specific actions
+bool UI::DoAction (int /*nAction_*/, bool /*fPressed_=true*/)
+{
+    return false;
+}
+
+
+void UI::ShowMessage (eMsgType eType_, const char* pcszMessage_)
+{
+    static const char* apcszTypes[] = { "Info", "Warning", "Error", "Fatal" };
+    fprintf(stderr, "%s: %s\n", apcszTypes[eType_], pcszMessage_);
+}
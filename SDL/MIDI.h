@@ -44,6 +44,6 @@ class CMidiDevice : public CIoDevice
         int m_nDevice = -1;        // Device handle, or -1 if not open
 };
 
-extern CMidiDevice *pMidi;
+extern MACHINE_LOCAL CMidiDevice *pMidi;
 
 #endif // MIDI_H
@@ -252,14 +252,23 @@ bool SDLSurface::DrawChanges (CScreen* pScreen_, bool *pafDirty_)
     if (pBack && SDL_MUSTLOCK(pBack))
         SDL_UnlockSurface(pBack);
 #endif
+    ShowChanges(pafDirty_, nHeight, nShift);
+
+    // Success
+    return true;
+}
+
+// Copy the changed lines from the back buffer to the display
+void SDLSurface::ShowChanges (bool *pafDirty_, int nHeight_, int nShift_)
+{
     // Find the first changed display line
     int nChangeFrom = 0;
-    for ( ; nChangeFrom < nHeight && !pafDirty_[nChangeFrom] ; nChangeFrom++);
+    for ( ; nChangeFrom < nHeight_ && !pafDirty_[nChangeFrom] ; nChangeFrom++);
 
-    if (nChangeFrom < nHeight)
+    if (nChangeFrom < nHeight_)
     {
         // Find the last change display line
-        int nChangeTo = nHeight-1;
+        int nChangeTo = nHeight_-1;
         for ( ; nChangeTo && !pafDirty_[nChangeTo] ; nChangeTo--);
 
         // Clear the dirty flags for the changed block
@@ -268,13 +277,13 @@ bool SDLSurface::DrawChanges (CScreen* pScreen_, bool *pafDirty_)
         // Calculate the dirty source and target areas - non-GUI displays require the height doubling
         SDL_Rect rect;
         rect.x = 0;
-        rect.y = nChangeFrom << nShift;
-        rect.w = pScreen_->GetPitch();
-        rect.h = ((nChangeTo - nChangeFrom + 1) << nShift);
+        rect.y = nChangeFrom << nShift_;
+        rect.w = Frame::GetWidth();
+        rect.h = ((nChangeTo - nChangeFrom + 1) << nShift_);
 
         SDL_Rect rectFront;
         rectFront.x = (pFront->w - rect.w) >> 1;
-        rectFront.y = rect.y + ((pFront->h - (nHeight << nShift)) >> 1);
+        rectFront.y = rect.y + ((pFront->h - (nHeight_ << nShift_)) >> 1);
         rectFront.w = rect.w;
         rectFront.h = rect.h;
 
@@ -284,11 +293,52 @@ bool SDLSurface::DrawChanges (CScreen* pScreen_, bool *pafDirty_)
         SDL_UpdateRects(pFront, 1, &rectFront);
 #endif
     }
+}
+
+
+// Offer a buffer for the frame to be drawn into directly, in the display format
+bool SDLSurface::GetTarget (VIDEOTARGET *pTarget_)
+{
+#ifdef __LIBRETRO__
+    // The front surface is the frame buffer passed to the front-end, so draw there and skip the blit
+    SDL_Surface *pSurface = pFront;
+    int nX = pFront ? (pFront->w - Frame::GetWidth()) >> 1 : 0;
+    int nY = pFront ? (pFront->h - Frame::GetHeight()) >> 1 : 0;
+#else
+    // The back buffer must be usable without locking
+    SDL_Surface *pSurface = (pBack && !SDL_MUSTLOCK(pBack)) ? pBack : nullptr;
+    int nX = 0, nY = 0;
+#endif
+    if (!pSurface)
+        return false;
+
+    int nDepth = pSurface->format->BitsPerPixel;
+    if (nDepth != 16 && nDepth != 32)
+        return false;
+
+    // Each emulated line is shown on two rows, the second for the scanline
+    pTarget_->pbPixels = static_cast<BYTE*>(pSurface->pixels) + nY * pSurface->pitch + nX * (nDepth >> 3);
+    pTarget_->lPitch = pSurface->pitch << 1;
+    pTarget_->lScanOffset = pSurface->pitch;
+    pTarget_->nDepth = nDepth;
+    pTarget_->pdwPalette = aulPalette;
+    pTarget_->pdwScanline = GetOption(scanlevel) ? aulScanline : nullptr;
 
-    // Success
     return true;
 }
 
+// Show the lines drawn directly to the target
+void SDLSurface::UpdateTarget (bool *pafDirty_)
+{
+    int nHeight = Frame::GetHeight() >> 1;
+#ifdef __LIBRETRO__
+    // Already in the front buffer
+    for (int i = 0 ; i < nHeight ; pafDirty_[i++] = false);
+#else
+    ShowChanges(pafDirty_, nHeight, 1);
+#endif
+}
+
 void SDLSurface::UpdateSize ()
 {
     int nWidth = Frame::GetWidth();
@@ -44,8 +44,12 @@ class SDLSurface : public VideoBase
         void DisplayToSamSize (int* pnX_, int* pnY_);
         void DisplayToSamPoint (int* pnX_, int* pnY_);
 
+        bool GetTarget (VIDEOTARGET *pTarget_);
+        void UpdateTarget (bool *pafDirty_);
+
     protected:
         bool DrawChanges (CScreen* pScreen_, bool *pafDirty_);
+        void ShowChanges (bool *pafDirty_, int nHeight_, int nShift_);
 
     private:
         SDL_Surface *pFront = nullptr;
@@ -7,6 +7,15 @@
 
 #include "libretro.h"
 
+#include <vector>
+
+#include "SimCoupe.h"
+#include "GUI.h"
+#include "Options.h"
+#include "Reverse.h"
+#include "Rewind.h"
+#include "State.h"
+
 #ifdef HAVE_LIBCO
 extern "C" {
 #define LIBCO_C 
@@ -28,6 +37,10 @@ char retro_system_data[512];
 
 bool opt_analog;
 
+static int nRunAhead;                   // frames to run ahead of the displayed frame
+static std::vector<BYTE> vRunAhead;     // checkpoint re-used each frame
+static bool fRunAheadMute;              // drop sound from frames run ahead
+
 int retrow=576;//640;
 int retroh=480;
 
@@ -59,7 +72,7 @@ int pre_main(const char *argv);
 void retro_audiocb(signed short int *sound_buffer,int sndbufsize){
    int x; 
 
-   if(pauseg==0)for(x=0;x<sndbufsize*2;x+=2)audio_cb(sound_buffer[x],sound_buffer[x+1]);	
+   if(pauseg==0 && !fRunAheadMute)for(x=0;x<sndbufsize*2;x+=2)audio_cb(sound_buffer[x],sound_buffer[x+1]);	
 }
 
 #if defined(_WIN32)
@@ -356,6 +369,15 @@ void retro_set_environment(retro_environment_t cb)
       {
          "simcoupe_sdl_analog","Use Analog; OFF|ON",
       },
+      {
+         "simcoupe_sdl_runahead","Run-ahead frames; 0|1|2",
+      },
+      {
+         "simcoupe_sdl_dynarec","Dynamic recompiler; OFF|ON",
+      },
+      {
+         "simcoupe_sdl_idleskip","Idle skipping; ON|OFF",
+      },
       { NULL, NULL },
    };
 
@@ -381,6 +403,24 @@ static void update_variables(void)
         fprintf(stderr, "[libretro-test]: Analog: %s.\n",opt_analog?"ON":"OFF");
    }
 
+   var.key = "simcoupe_sdl_runahead";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      nRunAhead = atoi(var.value);
+
+   var.key = "simcoupe_sdl_dynarec";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      SetOption(dynarec, strcmp(var.value, "ON") == 0);
+
+   var.key = "simcoupe_sdl_idleskip";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      SetOption(idleskip, strcmp(var.value, "ON") == 0);
+
 }
 
 void update_input()
@@ -388,6 +428,40 @@ void update_input()
   input_poll_cb();
 }
 
+#ifdef HAVE_LIBCO
+// Run extra frames with the current input and show the last of them, then
+// return to the real frame.  This hides the frames of delay before most
+// games react to input.  Media activity and the GUI can't be rolled back,
+// so the real frame is shown while they're busy.
+static void run_ahead()
+{
+   size_t uSize = State::GetSize();
+   if (!uSize || State::IsMediaBusy() || GUI::IsActive() || Rewind::IsActive())
+      return;
+
+   // The buffer is only reallocated if the machine configuration changes
+   if (vRunAhead.size() != uSize)
+      vRunAhead.resize(uSize);
+
+   if (!State::Checkpoint(vRunAhead.data(), uSize))
+      return;
+
+   fRunAheadMute = true;
+   Rewind::Suspend(true);
+   Reverse::Suspend(true);
+
+   for (int i = 0 ; i < nRunAhead && sdlinitok ; i++)
+      co_switch(emuThread);
+
+   Reverse::Suspend(false);
+   Rewind::Suspend(false);
+   fRunAheadMute = false;
+
+   if (sdlinitok)
+      State::Restore(vRunAhead.data(), uSize);
+}
+#endif
+
 
 #if 0
 static void keyboard_cb(bool down, unsigned keycode, uint32_t character, uint16_t mod)
@@ -426,19 +500,25 @@ void retro_set_controller_port_device(unsigned port, unsigned device)
     (void)device;
 }
 
+// Save states are taken between frames, while the emulation thread is parked in Frame::End()
 size_t retro_serialize_size(void)
 {
-	return 0;
+    return sdlinitok ? State::GetSize() : 0;
 }
 
 bool retro_serialize(void *data, size_t size)
 {
-    return false;
+    return sdlinitok && State::Save(data, size);
 }
 
 bool retro_unserialize(const void *data, size_t size)
 {
-    return false;
+    if (!sdlinitok || !State::Load(data, size))
+        return false;
+
+    // The debugger's reverse history can't lead to the loaded state
+    Reverse::Clear();
+    return true;
 }
 
 void retro_cheat_reset(void)
@@ -633,9 +713,13 @@ void retro_run(void)
 #endif
 	update_input();
 
-        video_cb(videoBuffer, retrow, retroh, retrow << 2);
 #ifdef HAVE_LIBCO
    co_switch(emuThread);
+
+   if (nRunAhead > 0)
+      run_ahead();
 #endif
+
+        video_cb(videoBuffer, retrow, retroh, retrow << 2);
 }
 